@@ -0,0 +1,276 @@
+﻿#include "AssetContainer.h"
+
+#include "CustomExceptions/Direct3dException.h"
+
+#include <cstring>
+
+namespace
+{
+	bool IsNameTerminated(const char (&name)[AssetNameLength])
+	{
+		return memchr(name, '\0', AssetNameLength) != nullptr;
+	}
+}
+
+AssetContainer::AssetContainer(const std::wstring& fileName)
+	: m_file(fileName)
+{
+	const auto data = m_file.GetData();
+
+	if (m_file.GetSize() < sizeof(AssetFileHeader))
+		throw Direct3dException("Asset container is too small to hold a header");
+
+	m_header = reinterpret_cast<const AssetFileHeader*>(data);
+	m_sections = reinterpret_cast<const AssetSection*>(data + sizeof(AssetFileHeader));
+	m_meshes = reinterpret_cast<const AssetMeshRecord*>(m_sections + m_header->SectionCount);
+	m_textures = reinterpret_cast<const AssetTextureRecord*>(m_meshes + m_header->MeshCount);
+
+	Validate();
+}
+
+void AssetContainer::Validate() const
+{
+	if (m_header->Magic != AssetFileMagic)
+		throw Direct3dException("Not an asset container");
+
+	if (m_header->Version != AssetFileVersion)
+		throw Direct3dException("Unsupported asset container version " + std::to_string(m_header->Version)
+			+ ", expected " + std::to_string(AssetFileVersion) + ". The container must be converted again.");
+
+	if (m_header->FileSize != m_file.GetSize())
+		throw Direct3dException("Asset container is truncated");
+
+	// The counts are 32-bit, so the table sizes can't overflow a 64-bit size
+	const auto tableSize = sizeof(AssetFileHeader)
+		+ static_cast<uint64_t>(m_header->SectionCount) * sizeof(AssetSection)
+		+ static_cast<uint64_t>(m_header->MeshCount) * sizeof(AssetMeshRecord)
+		+ static_cast<uint64_t>(m_header->TextureCount) * sizeof(AssetTextureRecord);
+
+	if (tableSize > m_header->FileSize)
+		throw Direct3dException("Asset container tables exceed the file");
+
+	for (uint32_t i = 0; i < m_header->SectionCount; i++)
+	{
+		const auto& section = m_sections[i];
+
+		if (section.Offset % AssetSectionAlignment != 0
+			|| section.Offset < tableSize
+			|| section.Offset > m_header->FileSize
+			|| section.Size > m_header->FileSize - section.Offset)
+			throw Direct3dException("Asset container section " + std::to_string(i) + " is out of bounds");
+	}
+
+	for (uint32_t i = 0; i < m_header->MeshCount; i++)
+	{
+		const auto& mesh = m_meshes[i];
+
+		if (!IsNameTerminated(mesh.Name)
+			|| mesh.VertexStride != sizeof(QuantizedVertex)
+			|| (mesh.IndexSize != 2 && mesh.IndexSize != 4))
+			throw Direct3dException("Asset container mesh " + std::to_string(i) + " is invalid");
+
+		if (GetSection(mesh.VertexSection, AssetSectionType::Vertices).Size
+				< static_cast<uint64_t>(mesh.VertexCount) * mesh.VertexStride
+			|| GetSection(mesh.IndexSection, AssetSectionType::Indices).Size
+				< static_cast<uint64_t>(mesh.IndexCount) * mesh.IndexSize)
+			throw Direct3dException("Asset container mesh " + std::to_string(i) + " exceeds its sections");
+
+		if (mesh.MeshletSection != InvalidAssetSection)
+		{
+			const auto& meshletSection = GetSection(mesh.MeshletSection, AssetSectionType::Meshlets);
+
+			if (meshletSection.Size % sizeof(Meshlet) != 0)
+				throw Direct3dException("Asset container mesh " + std::to_string(i) + " has an invalid meshlet section");
+
+			// Culling shaders trust the triangle ranges, so every meshlet is checked once here
+			const auto meshlets = reinterpret_cast<const Meshlet*>(m_file.GetData() + meshletSection.Offset);
+			const auto meshletCount = meshletSection.Size / sizeof(Meshlet);
+
+			for (uint64_t j = 0; j < meshletCount; j++)
+			{
+				if (meshlets[j].TriangleCount > MaxMeshletTriangles
+					|| static_cast<uint64_t>(meshlets[j].FirstTriangle) + meshlets[j].TriangleCount > mesh.IndexCount / 3)
+					throw Direct3dException("Asset container mesh " + std::to_string(i) + " has an invalid meshlet");
+			}
+		}
+
+		if (mesh.LodSection != InvalidAssetSection)
+		{
+			const auto& lodSection = GetSection(mesh.LodSection, AssetSectionType::Lods);
+
+			if (lodSection.Size % sizeof(MeshLod) != 0)
+				throw Direct3dException("Asset container mesh " + std::to_string(i) + " has an invalid LOD section");
+
+			const auto lods = reinterpret_cast<const MeshLod*>(m_file.GetData() + lodSection.Offset);
+			const auto lodCount = lodSection.Size / sizeof(MeshLod);
+
+			for (uint64_t j = 0; j < lodCount; j++)
+			{
+				if (lods[j].FirstIndex % 3 != 0
+					|| lods[j].IndexCount % 3 != 0
+					|| static_cast<uint64_t>(lods[j].FirstIndex) + lods[j].IndexCount > mesh.IndexCount)
+					throw Direct3dException("Asset container mesh " + std::to_string(i) + " has an invalid LOD");
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < m_header->TextureCount; i++)
+	{
+		const auto& texture = m_textures[i];
+
+		if (!IsNameTerminated(texture.Name)
+			|| texture.Width == 0
+			|| texture.Height == 0
+			|| texture.LevelCount == 0
+			|| texture.LevelCount > 32
+			|| texture.FirstLevelSection >= m_header->SectionCount)
+			throw Direct3dException("Asset container texture " + std::to_string(i) + " is invalid");
+
+		const auto description = GetTextureDescription(i);
+
+		for (uint32_t level = 0; level < texture.LevelCount; level++)
+		{
+			const auto& section = GetSection(texture.FirstLevelSection + level, AssetSectionType::TextureLevel);
+			const auto levelSize = GetLevelSizeInBytes(
+				description.Format,
+				GetLevelWidth(description, level),
+				GetLevelHeight(description, level));
+
+			if (section.Size < levelSize)
+				throw Direct3dException("Asset container texture " + std::to_string(i) + " exceeds its sections");
+		}
+	}
+}
+
+const AssetSection& AssetContainer::GetSection(uint32_t sectionIndex, AssetSectionType expectedType) const
+{
+	if (sectionIndex >= m_header->SectionCount || m_sections[sectionIndex].Type != expectedType)
+		throw Direct3dException("Asset container references an invalid section");
+
+	return m_sections[sectionIndex];
+}
+
+uint32_t AssetContainer::GetMeshCount() const
+{
+	return m_header->MeshCount;
+}
+
+uint32_t AssetContainer::GetTextureCount() const
+{
+	return m_header->TextureCount;
+}
+
+int AssetContainer::FindMesh(const std::string& name) const
+{
+	for (uint32_t i = 0; i < m_header->MeshCount; i++)
+	{
+		if (name == m_meshes[i].Name)
+			return static_cast<int>(i);
+	}
+
+	return -1;
+}
+
+int AssetContainer::FindTexture(const std::string& name) const
+{
+	for (uint32_t i = 0; i < m_header->TextureCount; i++)
+	{
+		if (name == m_textures[i].Name)
+			return static_cast<int>(i);
+	}
+
+	return -1;
+}
+
+MeshAssetView AssetContainer::GetMesh(uint32_t meshIndex) const
+{
+	const auto& mesh = m_meshes[meshIndex];
+	const auto data = m_file.GetData();
+
+	MeshAssetView view;
+	view.Vertices = reinterpret_cast<const QuantizedVertex*>(data + m_sections[mesh.VertexSection].Offset);
+	view.VertexCount = mesh.VertexCount;
+	view.Indices = data + m_sections[mesh.IndexSection].Offset;
+	view.IndexCount = mesh.IndexCount;
+	view.IndexFormat = mesh.IndexSize == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	view.PositionScale = DirectX::XMFLOAT3(mesh.PositionScale[0], mesh.PositionScale[1], mesh.PositionScale[2]);
+	view.PositionOffset = DirectX::XMFLOAT3(mesh.PositionOffset[0], mesh.PositionOffset[1], mesh.PositionOffset[2]);
+	view.Meshlets = nullptr;
+	view.MeshletCount = 0;
+
+	if (mesh.MeshletSection != InvalidAssetSection)
+	{
+		const auto& meshletSection = m_sections[mesh.MeshletSection];
+		view.Meshlets = reinterpret_cast<const Meshlet*>(data + meshletSection.Offset);
+		view.MeshletCount = static_cast<uint32_t>(meshletSection.Size / sizeof(Meshlet));
+	}
+
+	view.Lods = nullptr;
+	view.LodCount = 0;
+
+	if (mesh.LodSection != InvalidAssetSection)
+	{
+		const auto& lodSection = m_sections[mesh.LodSection];
+		view.Lods = reinterpret_cast<const MeshLod*>(data + lodSection.Offset);
+		view.LodCount = static_cast<uint32_t>(lodSection.Size / sizeof(MeshLod));
+	}
+
+	return view;
+}
+
+TextureDescription AssetContainer::GetTextureDescription(uint32_t textureIndex) const
+{
+	const auto& texture = m_textures[textureIndex];
+
+	TextureDescription description;
+	description.Format = static_cast<DXGI_FORMAT>(texture.Format);
+	description.Width = texture.Width;
+	description.Height = texture.Height;
+	description.LevelCount = texture.LevelCount;
+
+	return description;
+}
+
+const uint8_t* AssetContainer::GetTextureLevel(uint32_t textureIndex, uint32_t level) const
+{
+	return m_file.GetData() + m_sections[m_textures[textureIndex].FirstLevelSection + level].Offset;
+}
+
+size_t AssetContainer::GetFileSize() const
+{
+	return m_file.GetSize();
+}
+
+TextureSource CreateAssetTextureSource(std::shared_ptr<const AssetContainer> container, uint32_t textureIndex)
+{
+	TextureSource source;
+	source.Description = container->GetTextureDescription(textureIndex);
+	source.LoadLevels = [container, textureIndex](uint32_t firstLevel, uint32_t endLevel)
+	{
+		const auto description = container->GetTextureDescription(textureIndex);
+
+		TextureData levels;
+		levels.Format = description.Format;
+
+		// The levels are copied because the streamer owns what it uploads, but this is a plain memcpy out of the mapping.
+		// Any page faults happen here, on the worker thread that runs the load.
+		for (auto level = firstLevel; level < endLevel; level++)
+		{
+			const auto width = GetLevelWidth(description, level);
+			const auto height = GetLevelHeight(description, level);
+			const auto levelData = container->GetTextureLevel(textureIndex, level);
+
+			TextureLevel textureLevel;
+			textureLevel.Width = width;
+			textureLevel.Height = height;
+			textureLevel.RowPitch = GetRowPitch(description.Format, width);
+			textureLevel.Data.assign(levelData, levelData + GetLevelSizeInBytes(description.Format, width, height));
+
+			levels.Levels.push_back(std::move(textureLevel));
+		}
+
+		return levels;
+	};
+
+	return source;
+}
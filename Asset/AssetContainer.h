@@ -0,0 +1,72 @@
+﻿#pragma once
+
+#include "Asset/AssetFormat.h"
+#include "Asset/MappedFile.h"
+#include "Mesh/MeshletBuilder.h"
+#include "Mesh/MeshLod.h"
+#include "Rendering/VertexDefinitions.h"
+#include "Texture/TextureSource.h"
+
+#include <dxgiformat.h>
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// A mesh inside a mapped asset container. The pointers point straight into the mapping.
+struct MeshAssetView
+{
+	const QuantizedVertex* Vertices;
+	uint32_t VertexCount;
+	const void* Indices;
+	uint32_t IndexCount;
+	DXGI_FORMAT IndexFormat;
+	DirectX::XMFLOAT3 PositionScale;
+	DirectX::XMFLOAT3 PositionOffset;
+	// nullptr and 0 if the mesh was stored without meshlets
+	const Meshlet* Meshlets;
+	uint32_t MeshletCount;
+	// nullptr and 0 if the mesh was stored with a single level of detail
+	const MeshLod* Lods;
+	uint32_t LodCount;
+};
+
+/*
+ * A memory mapped asset container, see AssetFormat.h for the layout.
+ *
+ * Opening a container validates the header and the record tables, which are a few kilobytes at most,
+ * And touches nothing else. Asset data is paged in when the renderer uploads it, directly from the mapping,
+ * So startup time is bound by page faults rather than parsing.
+ */
+class AssetContainer
+{
+public:
+	AssetContainer(const std::wstring& fileName);
+
+	uint32_t GetMeshCount() const;
+	uint32_t GetTextureCount() const;
+
+	// Returns the index of the asset with the given name, or -1 if there is none
+	int FindMesh(const std::string& name) const;
+	int FindTexture(const std::string& name) const;
+
+	MeshAssetView GetMesh(uint32_t meshIndex) const;
+	TextureDescription GetTextureDescription(uint32_t textureIndex) const;
+	const uint8_t* GetTextureLevel(uint32_t textureIndex, uint32_t level) const;
+
+	size_t GetFileSize() const;
+
+private:
+	const AssetSection& GetSection(uint32_t sectionIndex, AssetSectionType expectedType) const;
+	void Validate() const;
+
+	MappedFile m_file;
+	const AssetFileHeader* m_header;
+	const AssetSection* m_sections;
+	const AssetMeshRecord* m_meshes;
+	const AssetTextureRecord* m_textures;
+};
+
+// Streams texture levels out of a mapped container. The container is kept alive by the source.
+TextureSource CreateAssetTextureSource(std::shared_ptr<const AssetContainer> container, uint32_t textureIndex);
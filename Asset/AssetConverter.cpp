@@ -0,0 +1,152 @@
+﻿#include "AssetConverter.h"
+
+#include "Asset/AssetWriter.h"
+#include "Asset/GltfImporter.h"
+#include "Asset/ObjImporter.h"
+#include "CustomExceptions/Direct3dException.h"
+#include "Externals/SDL/Include/SDL.h"
+#include "Mesh/MeshletBuilder.h"
+#include "Mesh/MeshOptimizer.h"
+#include "Mesh/MeshQuantization.h"
+#include "Mesh/MeshSimplifier.h"
+#include "Texture/DdsLoader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cwctype>
+#include <fstream>
+
+namespace
+{
+	std::string GetAssetName(const std::wstring& fileName)
+	{
+		const auto directoryEnd = fileName.find_last_of(L"/\\");
+		const auto nameStart = directoryEnd == std::wstring::npos ? 0 : directoryEnd + 1;
+		const auto extensionStart = fileName.find_last_of(L'.');
+		const auto nameEnd = extensionStart == std::wstring::npos || extensionStart < nameStart ? fileName.size() : extensionStart;
+
+		return std::string(fileName.begin() + nameStart, fileName.begin() + nameEnd);
+	}
+
+	std::wstring GetExtension(const std::wstring& fileName)
+	{
+		const auto extensionStart = fileName.find_last_of(L'.');
+
+		if (extensionStart == std::wstring::npos)
+			return std::wstring();
+
+		auto extension = fileName.substr(extensionStart + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](wchar_t character)
+		{
+			return static_cast<wchar_t>(towlower(character));
+		});
+
+		return extension;
+	}
+
+	// ParseFloat may round differently from strtof in rare halfway cases, so the importers are compared with a tolerance
+	bool AreNearlyEqual(const float* values, const float* referenceValues, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			if (std::abs(values[i] - referenceValues[i]) > 1e-6f * std::max(1.0f, std::abs(referenceValues[i])))
+				return false;
+		}
+
+		return true;
+	}
+}
+
+void ConvertAssets(const std::vector<std::wstring>& inputFileNames, const std::wstring& outputFileName, JobSystem& jobSystem)
+{
+	AssetContainerWriter writer;
+
+	for (const auto& inputFileName : inputFileNames)
+	{
+		const auto name = GetAssetName(inputFileName);
+		const auto extension = GetExtension(inputFileName);
+
+		if (extension == L"obj" || extension == L"glb")
+		{
+			auto mesh = extension == L"obj"
+				? ImportObjFile(inputFileName, jobSystem)
+				: ImportGlbFile(inputFileName, jobSystem);
+			const auto optimizationReport = OptimizeMesh(mesh);
+			const auto meshlets = BuildMeshlets(mesh);
+			// The levels of detail are appended after the meshlets have reordered level 0
+			const auto lods = GenerateMeshLods(mesh);
+			writer.AddMesh(name, QuantizeMesh(mesh), meshlets, lods);
+
+			SDL_Log("Converted mesh %s. %u vertices, %u triangles, %u meshlets, %u LODs down to %u triangles, ACMR: %.3f",
+				name.c_str(),
+				static_cast<unsigned int>(mesh.Vertices.size()),
+				lods[0].IndexCount / 3,
+				static_cast<unsigned int>(meshlets.size()),
+				static_cast<unsigned int>(lods.size()),
+				lods.back().IndexCount / 3,
+				optimizationReport.AcmrAfter);
+		}
+		else if (extension == L"dds")
+		{
+			const auto texture = LoadDdsFile(inputFileName);
+			writer.AddTexture(name, texture);
+
+			SDL_Log("Converted texture %s. Format: %d, %ux%u, %u mip levels",
+				name.c_str(),
+				static_cast<int>(texture.Format),
+				texture.Levels[0].Width,
+				texture.Levels[0].Height,
+				static_cast<unsigned int>(texture.Levels.size()));
+		}
+		else
+		{
+			throw Direct3dException("Unsupported asset type: " + std::string(inputFileName.begin(), inputFileName.end()));
+		}
+	}
+
+	const auto fileSize = writer.Write(outputFileName);
+
+	SDL_Log("Wrote asset container %s, %llu KB",
+		std::string(outputFileName.begin(), outputFileName.end()).c_str(),
+		static_cast<unsigned long long>(fileSize / 1024));
+}
+
+void BenchmarkObjImport(const std::wstring& fileName, JobSystem& jobSystem)
+{
+	const auto fileSizeInMegabytes = static_cast<double>(std::ifstream(fileName, std::ios::binary | std::ios::ate).tellg()) / (1024.0 * 1024.0);
+
+	const auto referenceStartCounter = SDL_GetPerformanceCounter();
+	const auto reference = ImportObjFileReference(fileName);
+	const auto referenceSeconds = static_cast<double>(SDL_GetPerformanceCounter() - referenceStartCounter) / SDL_GetPerformanceFrequency();
+
+	const auto startCounter = SDL_GetPerformanceCounter();
+	const auto mesh = ImportObjFile(fileName, jobSystem);
+	const auto seconds = static_cast<double>(SDL_GetPerformanceCounter() - startCounter) / SDL_GetPerformanceFrequency();
+
+	SDL_Log("OBJ import of %.1f MB. Reference: %.3f s (%.1f MB/s), parallel: %.3f s (%.1f MB/s) on %u threads, %.1fx faster",
+		fileSizeInMegabytes,
+		referenceSeconds,
+		fileSizeInMegabytes / referenceSeconds,
+		seconds,
+		fileSizeInMegabytes / seconds,
+		jobSystem.GetThreadCount(),
+		referenceSeconds / seconds);
+
+	// The vertex orders differ, so compare the triangles through their vertices
+	bool identical = mesh.Vertices.size() == reference.Vertices.size() && mesh.Indices.size() == reference.Indices.size();
+
+	for (size_t i = 0; identical && i < mesh.Indices.size(); i++)
+	{
+		const auto& vertex = mesh.Vertices[mesh.Indices[i]];
+		const auto& referenceVertex = reference.Vertices[reference.Indices[i]];
+
+		identical = AreNearlyEqual(&vertex.Position.x, &referenceVertex.Position.x, 3)
+			&& AreNearlyEqual(&vertex.Normal.x, &referenceVertex.Normal.x, 3)
+			&& AreNearlyEqual(&vertex.TexCoord.x, &referenceVertex.TexCoord.x, 2);
+	}
+
+	SDL_Log("%u vertices, %u triangles. %s",
+		static_cast<unsigned int>(mesh.Vertices.size()),
+		static_cast<unsigned int>(mesh.GetTriangleCount()),
+		identical ? "Both importers produce the same mesh." : "The importers produce DIFFERENT meshes!");
+}
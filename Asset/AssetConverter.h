@@ -0,0 +1,20 @@
+﻿#pragma once
+
+#include "Threading/JobSystem.h"
+
+#include <string>
+#include <vector>
+
+/*
+ * The offline asset converter. Every input file becomes one asset, named after the file without its directory and extension:
+ *
+ * .obj and .glb files are imported, optimized for the vertex cache and vertex fetch, and quantized, exactly like generated meshes.
+ * .dds files are stored as they are, so block compressed textures keep whatever quality the authoring tool produced.
+ *
+ * Run the application with --convert <output.rca> <input files...> to convert.
+ */
+void ConvertAssets(const std::vector<std::wstring>& inputFileNames, const std::wstring& outputFileName, JobSystem& jobSystem);
+
+// Imports an OBJ file with both ImportObjFile and ImportObjFileReference, logs their throughput and checks that
+// They produce the same mesh. Run the application with --benchmark-import <input.obj>.
+void BenchmarkObjImport(const std::wstring& fileName, JobSystem& jobSystem);
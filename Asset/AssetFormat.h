@@ -0,0 +1,100 @@
+﻿#pragma once
+
+#include <cstdint>
+
+/*
+ * The on-disk layout of an asset container (.rca file).
+ *
+ *     AssetFileHeader
+ *     AssetSection[SectionCount]
+ *     AssetMeshRecord[MeshCount]
+ *     AssetTextureRecord[TextureCount]
+ *     (padding)
+ *     Section data, each section starting on a new page
+ *
+ * Everything is stored exactly as the renderer consumes it - quantized vertices, indices in the index format
+ * The mesh is drawn with, block compressed texture levels - so loading a container is nothing but mapping it
+ * Into memory and pointing Direct3D at the bytes. All values are little endian.
+ *
+ * The version must be increased whenever any of these structures or the data they describe change.
+ * Containers with a different version are rejected rather than converted, since they are rebuilt from the source assets anyway.
+ */
+
+const uint32_t AssetFileMagic = 0x31414352; // "RCA1"
+const uint32_t AssetFileVersion = 2;
+
+// Sections start on page boundaries, so touching one asset never faults in the pages of its neighbours,
+// And every section is suitably aligned for any element type and SIMD access
+const uint32_t AssetSectionAlignment = 4096;
+
+const uint32_t AssetNameLength = 48;
+const uint32_t InvalidAssetSection = 0xFFFFFFFF;
+
+enum class AssetSectionType : uint32_t
+{
+	Vertices = 1,
+	Indices = 2,
+	Meshlets = 3,
+	TextureLevel = 4,
+	Lods = 5
+};
+
+struct AssetFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	// The size the file had when it was written, used to detect truncated files
+	uint64_t FileSize;
+	uint32_t SectionCount;
+	uint32_t MeshCount;
+	uint32_t TextureCount;
+	uint32_t Reserved;
+};
+
+struct AssetSection
+{
+	AssetSectionType Type;
+	uint32_t Reserved;
+	// Offset from the start of the file, a multiple of AssetSectionAlignment
+	uint64_t Offset;
+	uint64_t Size;
+};
+
+// A mesh of QuantizedVertex vertices. Names are zero terminated.
+struct AssetMeshRecord
+{
+	char Name[AssetNameLength];
+	float PositionScale[3];
+	float PositionOffset[3];
+	uint32_t VertexStride;
+	uint32_t VertexCount;
+	// 2 or 4. 16-bit index sections are padded to a whole number of 32-bit words.
+	uint32_t IndexSize;
+	uint32_t IndexCount;
+	uint32_t VertexSection;
+	uint32_t IndexSection;
+	// Meshlet structs (see MeshletBuilder.h), whose triangle ranges refer to the index section.
+	// InvalidAssetSection if the mesh has no meshlets.
+	uint32_t MeshletSection;
+	// MeshLod structs (see MeshLod.h), whose index ranges refer to the index section. Meshlets refer to level 0.
+	// InvalidAssetSection if the mesh has a single level.
+	uint32_t LodSection;
+};
+
+// A mip mapped 2D texture. Its levels are stored in LevelCount consecutive sections, starting with the largest level.
+struct AssetTextureRecord
+{
+	char Name[AssetNameLength];
+	// A DXGI_FORMAT
+	uint32_t Format;
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t LevelCount;
+	uint32_t FirstLevelSection;
+	uint32_t Reserved;
+};
+
+static_assert(sizeof(AssetFileHeader) == 32, "The asset file header must match the file layout");
+static_assert(sizeof(AssetSection) == 24, "The asset section header must match the file layout");
+static_assert(sizeof(AssetMeshRecord) == 104, "The asset mesh record must match the file layout");
+static_assert(sizeof(AssetTextureRecord) == 72, "The asset texture record must match the file layout");
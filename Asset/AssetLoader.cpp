@@ -0,0 +1,269 @@
+﻿#include "AssetLoader.h"
+
+#include "CustomExceptions/Direct3dException.h"
+
+#include <Windows.h>
+
+#include <algorithm>
+
+namespace
+{
+	// Files are read in pieces of this size, so a cancelled load stops reading soon
+	const DWORD ReadPieceSize = 1024 * 1024;
+
+	std::string ToNarrowString(const std::wstring& text)
+	{
+		return std::string(text.begin(), text.end());
+	}
+}
+
+bool AssetLoader::LoadOrder::operator()(const std::shared_ptr<PendingLoad>& a, const std::shared_ptr<PendingLoad>& b) const
+{
+	// std::priority_queue keeps the greatest element on top, so "less" means read later.
+	// Loads of the same priority are read in the order they were requested.
+	if (a->Request.Priority != b->Request.Priority)
+		return a->Request.Priority > b->Request.Priority;
+
+	return a->Sequence > b->Sequence;
+}
+
+AssetLoader::AssetLoader(JobSystem& jobSystem)
+	: m_jobSystem(jobSystem),
+	m_nextHandle(InvalidAssetLoadHandle + 1),
+	m_completedLoads(0),
+	m_failedLoads(0),
+	m_cancelledLoads(0),
+	m_shuttingDown(false),
+	m_bytesRead(0)
+{
+	m_ioThread = std::thread(&AssetLoader::IoThreadLoop, this);
+}
+
+AssetLoader::~AssetLoader()
+{
+	for (auto& load : m_loads)
+		load.second->Cancelled.store(true, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> lock(m_readQueueMutex);
+		m_shuttingDown = true;
+	}
+
+	m_readQueueCondition.notify_one();
+	m_ioThread.join();
+
+	// Decode jobs hold on to the loader until they have queued their result
+	m_jobSystem.Wait(m_decodeJobs);
+}
+
+AssetLoadHandle AssetLoader::Load(AssetLoadRequest request)
+{
+	auto load = std::make_shared<PendingLoad>();
+	load->Handle = m_nextHandle++;
+	load->Sequence = load->Handle;
+	load->Request = std::move(request);
+	load->Cancelled.store(false, std::memory_order_relaxed);
+
+	m_loads[load->Handle] = load;
+
+	if (load->Request.FileName.empty())
+	{
+		StartDecode(load);
+	}
+	else
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_readQueueMutex);
+			m_readQueue.push(load);
+		}
+
+		m_readQueueCondition.notify_one();
+	}
+
+	return load->Handle;
+}
+
+void AssetLoader::Cancel(AssetLoadHandle load)
+{
+	const auto pendingLoad = m_loads.find(load);
+
+	if (pendingLoad == m_loads.end())
+		return;
+
+	// The stages drop the load when they see the flag. Its queue entries go away on their own.
+	pendingLoad->second->Cancelled.store(true, std::memory_order_relaxed);
+	m_loads.erase(pendingLoad);
+	m_cancelledLoads++;
+}
+
+bool AssetLoader::IsPending(AssetLoadHandle load) const
+{
+	return m_loads.find(load) != m_loads.end();
+}
+
+void AssetLoader::DeliverCompletions()
+{
+	std::vector<std::shared_ptr<PendingLoad>> finishedLoads;
+
+	{
+		std::lock_guard<std::mutex> lock(m_finishedLoadsMutex);
+		finishedLoads.swap(m_finishedLoads);
+	}
+
+	for (auto& load : finishedLoads)
+	{
+		// Loads cancelled after they had finished are dropped here, they are no longer in m_loads
+		if (m_loads.erase(load->Handle) == 0)
+			continue;
+
+		if (load->Error.empty())
+		{
+			m_completedLoads++;
+			load->Completion();
+		}
+		else
+		{
+			m_failedLoads++;
+
+			if (load->Request.Failed)
+				load->Request.Failed(load->Error);
+		}
+	}
+}
+
+AssetLoaderStatistics AssetLoader::GetStatistics() const
+{
+	AssetLoaderStatistics statistics;
+	statistics.PendingLoads = static_cast<uint32_t>(m_loads.size());
+	statistics.CompletedLoads = m_completedLoads;
+	statistics.FailedLoads = m_failedLoads;
+	statistics.CancelledLoads = m_cancelledLoads;
+	statistics.BytesRead = m_bytesRead.load(std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> lock(m_readQueueMutex);
+		statistics.QueuedReads = static_cast<uint32_t>(m_readQueue.size());
+	}
+
+	return statistics;
+}
+
+void AssetLoader::IoThreadLoop()
+{
+	while (true)
+	{
+		std::shared_ptr<PendingLoad> load;
+
+		{
+			std::unique_lock<std::mutex> lock(m_readQueueMutex);
+			m_readQueueCondition.wait(lock, [this]() { return m_shuttingDown || !m_readQueue.empty(); });
+
+			if (m_shuttingDown)
+				return;
+
+			load = m_readQueue.top();
+			m_readQueue.pop();
+		}
+
+		if (load->Cancelled.load(std::memory_order_relaxed))
+			continue;
+
+		try
+		{
+			ReadAssetFile(*load);
+		}
+		catch (const std::exception& ex)
+		{
+			load->Error = ex.what();
+			Finish(std::move(load));
+			continue;
+		}
+
+		if (!load->Cancelled.load(std::memory_order_relaxed))
+			StartDecode(std::move(load));
+	}
+}
+
+void AssetLoader::ReadAssetFile(PendingLoad& load)
+{
+	const auto& fileName = load.Request.FileName;
+
+	// Every file is read front to back exactly once, which is what sequential scan tells the cache manager
+	const auto fileHandle = CreateFileW(
+		fileName.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		nullptr);
+
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		throw Direct3dException("Failed to open " + ToNarrowString(fileName) + ". Error code: "
+			+ std::to_string(GetLastError()));
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize))
+	{
+		const auto error = GetLastError();
+		CloseHandle(fileHandle);
+		throw Direct3dException("Failed to get the size of " + ToNarrowString(fileName) + ". Error code: "
+			+ std::to_string(error));
+	}
+
+	auto readSize = static_cast<size_t>(fileSize.QuadPart);
+	if (load.Request.MaxReadSize != 0)
+		readSize = std::min(readSize, load.Request.MaxReadSize);
+
+	load.FileData.resize(readSize);
+
+	size_t offset = 0;
+	while (offset < load.FileData.size() && !load.Cancelled.load(std::memory_order_relaxed))
+	{
+		const auto pieceSize = static_cast<DWORD>(std::min<size_t>(ReadPieceSize, load.FileData.size() - offset));
+		DWORD bytesRead = 0;
+
+		if (!::ReadFile(fileHandle, load.FileData.data() + offset, pieceSize, &bytesRead, nullptr) || bytesRead == 0)
+		{
+			const auto error = GetLastError();
+			CloseHandle(fileHandle);
+			throw Direct3dException("Failed to read " + ToNarrowString(fileName) + ". Error code: "
+				+ std::to_string(error));
+		}
+
+		offset += bytesRead;
+		m_bytesRead.fetch_add(bytesRead, std::memory_order_relaxed);
+	}
+
+	CloseHandle(fileHandle);
+}
+
+void AssetLoader::StartDecode(std::shared_ptr<PendingLoad> load)
+{
+	m_jobSystem.ScheduleBackground([this, load]()
+	{
+		if (load->Cancelled.load(std::memory_order_relaxed))
+			return;
+
+		// Exceptions must not escape a job, so every failure is handed to the main thread as an error message
+		try
+		{
+			load->Completion = load->Request.Decode(load->FileData);
+		}
+		catch (const std::exception& ex)
+		{
+			load->Error = ex.what();
+		}
+
+		// The file contents aren't needed anymore, and completions may wait a frame to be delivered
+		std::vector<uint8_t>().swap(load->FileData);
+
+		Finish(load);
+	}, &m_decodeJobs);
+}
+
+void AssetLoader::Finish(std::shared_ptr<PendingLoad> load)
+{
+	std::lock_guard<std::mutex> lock(m_finishedLoadsMutex);
+	m_finishedLoads.push_back(std::move(load));
+}
@@ -0,0 +1,142 @@
+﻿#pragma once
+
+#include "Threading/JobSystem.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using AssetLoadHandle = uint32_t;
+
+const AssetLoadHandle InvalidAssetLoadHandle = 0;
+
+// Loads of a higher priority are read before any load of a lower priority that is still waiting for the I/O thread
+enum class LoadPriority
+{
+	High,
+	Normal,
+	Low
+};
+
+struct AssetLoadRequest
+{
+	// The file that is read before decoding. Without a file name the load goes straight to the decode stage,
+	// Which is how assets that are generated instead of loaded are made asynchronous.
+	std::wstring FileName;
+
+	// Reads no more than this many bytes from the start of the file, e.g. only its headers. 0 reads the whole file.
+	size_t MaxReadSize;
+
+	LoadPriority Priority;
+
+	/*
+	 * Turns the contents of the file into an asset. Called on a worker thread, so it must not touch the device context
+	 * Or anything else owned by the main thread. Returns the completion, which is called on the main thread and
+	 * Hands the asset over, e.g. by creating GPU resources from it. Exceptions thrown by Decode fail the load.
+	 */
+	std::function<std::function<void()>(std::vector<uint8_t>& fileData)> Decode;
+
+	// Called on the main thread instead of the completion if reading or decoding failed. May be empty.
+	std::function<void(const std::string& error)> Failed;
+};
+
+struct AssetLoaderStatistics
+{
+	// Loads that haven't been delivered or cancelled yet
+	uint32_t PendingLoads;
+	uint32_t QueuedReads;
+	// Totals since the loader was created
+	uint32_t CompletedLoads;
+	uint32_t FailedLoads;
+	uint32_t CancelledLoads;
+	uint64_t BytesRead;
+};
+
+/*
+ * Loads assets in the background, so the application can show its window and render while they stream in.
+ *
+ * Every load goes through two stages. A dedicated I/O thread reads the file, one load at a time in priority order,
+ * Then the contents are decoded by a background job, which a thread waiting for the frame's own jobs never picks up.
+ * Decoding produces a completion that is queued for the main thread, which calls DeliverCompletions once per frame.
+ * GPU resources are only ever created there.
+ *
+ * A load can be cancelled at any stage. The I/O thread checks for cancellation between the pieces of a file,
+ * And a cancelled load is never decoded or delivered. Work that is already running finishes, but its result is dropped.
+ */
+class AssetLoader
+{
+public:
+	explicit AssetLoader(JobSystem& jobSystem);
+
+	// Cancels all loads, and waits for the I/O thread and any running decode jobs
+	~AssetLoader();
+
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	AssetLoadHandle Load(AssetLoadRequest request);
+
+	// Makes sure the completion of the load is never called. Does nothing if it has already been delivered.
+	void Cancel(AssetLoadHandle load);
+
+	bool IsPending(AssetLoadHandle load) const;
+
+	// Calls the completions of the loads that have finished since the last call. Call once per frame on the main thread.
+	void DeliverCompletions();
+
+	AssetLoaderStatistics GetStatistics() const;
+
+private:
+	struct PendingLoad
+	{
+		AssetLoadHandle Handle;
+		uint64_t Sequence;
+		AssetLoadRequest Request;
+		std::atomic<bool> Cancelled;
+		std::vector<uint8_t> FileData;
+		std::function<void()> Completion;
+		std::string Error;
+	};
+
+	struct LoadOrder
+	{
+		bool operator()(const std::shared_ptr<PendingLoad>& a, const std::shared_ptr<PendingLoad>& b) const;
+	};
+
+	void IoThreadLoop();
+
+	// Reads the file of the load, up to its MaxReadSize, into its FileData, unless the load is cancelled on the way
+	void ReadAssetFile(PendingLoad& load);
+
+	void StartDecode(std::shared_ptr<PendingLoad> load);
+	void Finish(std::shared_ptr<PendingLoad> load);
+
+	JobSystem& m_jobSystem;
+
+	// Only touched on the main thread
+	std::unordered_map<AssetLoadHandle, std::shared_ptr<PendingLoad>> m_loads;
+	AssetLoadHandle m_nextHandle;
+	uint32_t m_completedLoads;
+	uint32_t m_failedLoads;
+	uint32_t m_cancelledLoads;
+
+	std::priority_queue<std::shared_ptr<PendingLoad>, std::vector<std::shared_ptr<PendingLoad>>, LoadOrder> m_readQueue;
+	mutable std::mutex m_readQueueMutex;
+	std::condition_variable m_readQueueCondition;
+	bool m_shuttingDown;
+
+	std::vector<std::shared_ptr<PendingLoad>> m_finishedLoads;
+	std::mutex m_finishedLoadsMutex;
+
+	JobCounter m_decodeJobs;
+	std::atomic<uint64_t> m_bytesRead;
+	std::thread m_ioThread;
+};
@@ -0,0 +1,174 @@
+﻿#include "AssetWriter.h"
+
+#include "CustomExceptions/Direct3dException.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	uint64_t AlignOffset(uint64_t offset)
+	{
+		return (offset + AssetSectionAlignment - 1) / AssetSectionAlignment * AssetSectionAlignment;
+	}
+
+	void WritePadding(std::ofstream& file, uint64_t& offset, uint64_t alignedOffset)
+	{
+		static const char zeros[AssetSectionAlignment] = {};
+
+		file.write(zeros, static_cast<std::streamsize>(alignedOffset - offset));
+		offset = alignedOffset;
+	}
+}
+
+void AssetContainerWriter::AddMesh(
+	const std::string& name,
+	const QuantizedMesh& mesh,
+	const std::vector<Meshlet>& meshlets,
+	const std::vector<MeshLod>& lods)
+{
+	const auto& geometry = mesh.Geometry;
+
+	AssetMeshRecord record = {};
+	CopyName(name, record.Name);
+	record.PositionScale[0] = mesh.PositionScale.x;
+	record.PositionScale[1] = mesh.PositionScale.y;
+	record.PositionScale[2] = mesh.PositionScale.z;
+	record.PositionOffset[0] = mesh.PositionOffset.x;
+	record.PositionOffset[1] = mesh.PositionOffset.y;
+	record.PositionOffset[2] = mesh.PositionOffset.z;
+	record.VertexStride = sizeof(QuantizedVertex);
+	record.VertexCount = static_cast<uint32_t>(geometry.Vertices.size());
+	record.IndexCount = static_cast<uint32_t>(geometry.Indices.size());
+	record.MeshletSection = meshlets.empty()
+		? InvalidAssetSection
+		: AddSection(AssetSectionType::Meshlets, meshlets.data(), meshlets.size() * sizeof(Meshlet));
+	record.LodSection = lods.size() < 2
+		? InvalidAssetSection
+		: AddSection(AssetSectionType::Lods, lods.data(), lods.size() * sizeof(MeshLod));
+
+	record.VertexSection = AddSection(
+		AssetSectionType::Vertices,
+		geometry.Vertices.data(),
+		geometry.Vertices.size() * sizeof(QuantizedVertex));
+
+	// Indices are stored in the format they are drawn with, so they can be uploaded straight from the mapping
+	if (geometry.CanUse16BitIndices())
+	{
+		std::vector<uint16_t> shortIndices(geometry.Indices.begin(), geometry.Indices.end());
+
+		// Pad to a whole number of 32-bit words, like GpuMesh does
+		if (shortIndices.size() % 2 != 0)
+			shortIndices.push_back(0);
+
+		record.IndexSize = sizeof(uint16_t);
+		record.IndexSection = AddSection(
+			AssetSectionType::Indices,
+			shortIndices.data(),
+			shortIndices.size() * sizeof(uint16_t));
+	}
+	else
+	{
+		record.IndexSize = sizeof(uint32_t);
+		record.IndexSection = AddSection(
+			AssetSectionType::Indices,
+			geometry.Indices.data(),
+			geometry.Indices.size() * sizeof(uint32_t));
+	}
+
+	m_meshes.push_back(record);
+}
+
+void AssetContainerWriter::AddTexture(const std::string& name, const TextureData& texture)
+{
+	AssetTextureRecord record = {};
+	CopyName(name, record.Name);
+	record.Format = static_cast<uint32_t>(texture.Format);
+	record.Width = texture.Levels[0].Width;
+	record.Height = texture.Levels[0].Height;
+	record.LevelCount = static_cast<uint32_t>(texture.Levels.size());
+	record.FirstLevelSection = static_cast<uint32_t>(m_sections.size());
+
+	// Levels are stored tightly packed, which is the row pitch every level in TextureData already has
+	for (const auto& level : texture.Levels)
+		AddSection(AssetSectionType::TextureLevel, level.Data.data(), level.Data.size());
+
+	m_textures.push_back(record);
+}
+
+uint32_t AssetContainerWriter::AddSection(AssetSectionType type, const void* data, size_t size)
+{
+	AssetSection section = {};
+	section.Type = type;
+	section.Size = size;
+
+	const auto bytes = static_cast<const uint8_t*>(data);
+	m_sections.push_back(section);
+	m_sectionData.emplace_back(bytes, bytes + size);
+
+	return static_cast<uint32_t>(m_sections.size() - 1);
+}
+
+void AssetContainerWriter::CopyName(const std::string& name, char (&destination)[AssetNameLength])
+{
+	if (name.size() >= AssetNameLength)
+		throw Direct3dException("Asset name " + name + " is longer than " + std::to_string(AssetNameLength - 1) + " characters");
+
+	memcpy(destination, name.c_str(), name.size() + 1);
+}
+
+uint64_t AssetContainerWriter::Write(const std::wstring& fileName) const
+{
+	// Lay out the sections after the tables
+	auto sections = m_sections;
+	auto offset = AlignOffset(
+		sizeof(AssetFileHeader)
+		+ sections.size() * sizeof(AssetSection)
+		+ m_meshes.size() * sizeof(AssetMeshRecord)
+		+ m_textures.size() * sizeof(AssetTextureRecord));
+
+	for (auto& section : sections)
+	{
+		section.Offset = offset;
+		offset = AlignOffset(offset + section.Size);
+	}
+
+	AssetFileHeader header = {};
+	header.Magic = AssetFileMagic;
+	header.Version = AssetFileVersion;
+	header.FileSize = offset;
+	header.SectionCount = static_cast<uint32_t>(sections.size());
+	header.MeshCount = static_cast<uint32_t>(m_meshes.size());
+	header.TextureCount = static_cast<uint32_t>(m_textures.size());
+
+	std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+
+	if (!file)
+		throw Direct3dException("Failed to create asset container file");
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(sections.data()), sections.size() * sizeof(AssetSection));
+	file.write(reinterpret_cast<const char*>(m_meshes.data()), m_meshes.size() * sizeof(AssetMeshRecord));
+	file.write(reinterpret_cast<const char*>(m_textures.data()), m_textures.size() * sizeof(AssetTextureRecord));
+
+	uint64_t writtenBytes = sizeof(AssetFileHeader)
+		+ sections.size() * sizeof(AssetSection)
+		+ m_meshes.size() * sizeof(AssetMeshRecord)
+		+ m_textures.size() * sizeof(AssetTextureRecord);
+
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		WritePadding(file, writtenBytes, sections[i].Offset);
+
+		file.write(reinterpret_cast<const char*>(m_sectionData[i].data()), m_sectionData[i].size());
+		writtenBytes += m_sectionData[i].size();
+	}
+
+	// The file size is always a multiple of the section alignment, so the last section can be mapped as a whole page
+	WritePadding(file, writtenBytes, header.FileSize);
+
+	if (!file)
+		throw Direct3dException("Failed to write asset container file");
+
+	return header.FileSize;
+}
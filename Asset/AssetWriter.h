@@ -0,0 +1,38 @@
+﻿#pragma once
+
+#include "Asset/AssetFormat.h"
+#include "Mesh/MeshletBuilder.h"
+#include "Mesh/MeshLod.h"
+#include "Mesh/MeshQuantization.h"
+#include "Texture/TextureData.h"
+
+#include <string>
+#include <vector>
+
+/*
+ * Builds an asset container (see AssetFormat.h) from assets that have already been processed into
+ * Their final form. Used by the offline converter, never at runtime.
+ */
+class AssetContainerWriter
+{
+public:
+	// The meshlets and levels of detail may be empty. Otherwise they must refer to the mesh's index buffer.
+	void AddMesh(
+		const std::string& name,
+		const QuantizedMesh& mesh,
+		const std::vector<Meshlet>& meshlets,
+		const std::vector<MeshLod>& lods);
+	void AddTexture(const std::string& name, const TextureData& texture);
+
+	// Writes the container, replacing the file if it exists. Returns the size of the file.
+	uint64_t Write(const std::wstring& fileName) const;
+
+private:
+	uint32_t AddSection(AssetSectionType type, const void* data, size_t size);
+	static void CopyName(const std::string& name, char (&destination)[AssetNameLength]);
+
+	std::vector<AssetSection> m_sections;
+	std::vector<std::vector<uint8_t>> m_sectionData;
+	std::vector<AssetMeshRecord> m_meshes;
+	std::vector<AssetTextureRecord> m_textures;
+};
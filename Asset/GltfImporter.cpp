@@ -0,0 +1,392 @@
+﻿#include "GltfImporter.h"
+
+#include "Asset/JsonValue.h"
+#include "CustomExceptions/Direct3dException.h"
+#include "Mesh/MeshGenerator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t GlbMagic = 0x46546C67; // "glTF"
+	const uint32_t GlbChunkTypeJson = 0x4E4F534A; // "JSON"
+	const uint32_t GlbChunkTypeBin = 0x004E4942; // "BIN\0"
+
+	// Accessor component types, as defined by the glTF specification
+	const uint32_t ComponentTypeByte = 5120;
+	const uint32_t ComponentTypeUnsignedByte = 5121;
+	const uint32_t ComponentTypeShort = 5122;
+	const uint32_t ComponentTypeUnsignedShort = 5123;
+	const uint32_t ComponentTypeUnsignedInt = 5125;
+	const uint32_t ComponentTypeFloat = 5126;
+
+	const uint32_t PrimitiveModeTriangles = 4;
+
+	const size_t MissingIndex = static_cast<size_t>(-1);
+
+	struct GlbHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t Length;
+	};
+
+	struct GlbChunkHeader
+	{
+		uint32_t Length;
+		uint32_t Type;
+	};
+
+	struct GlbFile
+	{
+		std::ifstream File;
+		JsonValue Document;
+		uint64_t BinOffset;
+		uint64_t BinSize;
+	};
+
+	// The bytes of one accessor, with the stride between its elements
+	struct AccessorData
+	{
+		std::vector<uint8_t> Bytes;
+		size_t Count;
+		size_t Stride;
+		uint32_t ComponentType;
+		uint32_t ComponentCount;
+		bool Normalized;
+	};
+
+	uint32_t GetComponentSize(uint32_t componentType)
+	{
+		switch (componentType)
+		{
+		case ComponentTypeByte:
+		case ComponentTypeUnsignedByte:
+			return 1;
+		case ComponentTypeShort:
+		case ComponentTypeUnsignedShort:
+			return 2;
+		case ComponentTypeUnsignedInt:
+		case ComponentTypeFloat:
+			return 4;
+		default:
+			throw Direct3dException("Unsupported glTF component type " + std::to_string(componentType));
+		}
+	}
+
+	uint32_t GetComponentCount(const std::string& type)
+	{
+		if (type == "SCALAR")
+			return 1;
+		if (type == "VEC2")
+			return 2;
+		if (type == "VEC3")
+			return 3;
+		if (type == "VEC4")
+			return 4;
+
+		throw Direct3dException("Unsupported glTF accessor type " + type);
+	}
+
+	const JsonValue& GetElement(const JsonValue& document, const char* arrayName, size_t index)
+	{
+		const auto array = document.Find(arrayName);
+
+		if (array == nullptr || index >= array->GetSize())
+			throw Direct3dException(std::string("glTF file references a missing element of ") + arrayName);
+
+		return (*array)[index];
+	}
+
+	AccessorData ReadAccessor(GlbFile& glb, size_t accessorIndex)
+	{
+		const auto& accessor = GetElement(glb.Document, "accessors", accessorIndex);
+
+		if (accessor.Find("sparse") != nullptr)
+			throw Direct3dException("Sparse glTF accessors are not supported");
+
+		const auto type = accessor.Find("type");
+		const auto normalized = accessor.Find("normalized");
+
+		AccessorData data;
+		data.Count = accessor.GetIndex("count", 0);
+		data.ComponentType = static_cast<uint32_t>(accessor.GetIndex("componentType", 0));
+		data.ComponentCount = GetComponentCount(type != nullptr ? type->GetString() : std::string());
+		data.Normalized = normalized != nullptr && normalized->GetBool();
+
+		const size_t elementSize = GetComponentSize(data.ComponentType) * data.ComponentCount;
+		const auto bufferViewIndex = accessor.GetIndex("bufferView", MissingIndex);
+
+		// An accessor without a buffer view is all zeros
+		if (bufferViewIndex == MissingIndex)
+		{
+			data.Stride = elementSize;
+			data.Bytes.assign(data.Count * elementSize, 0);
+			return data;
+		}
+
+		const auto& bufferView = GetElement(glb.Document, "bufferViews", bufferViewIndex);
+
+		if (bufferView.GetIndex("buffer", 0) != 0)
+			throw Direct3dException("glTF buffer views must reference the binary chunk of the .glb file");
+
+		data.Stride = bufferView.GetIndex("byteStride", elementSize);
+
+		const auto viewOffset = static_cast<uint64_t>(bufferView.GetIndex("byteOffset", 0));
+		const auto viewLength = static_cast<uint64_t>(bufferView.GetIndex("byteLength", 0));
+		const auto accessorOffset = static_cast<uint64_t>(accessor.GetIndex("byteOffset", 0));
+		const auto size = data.Count == 0 ? 0 : static_cast<uint64_t>(data.Count - 1) * data.Stride + elementSize;
+
+		if (data.Stride < elementSize
+			|| viewOffset + viewLength > glb.BinSize
+			|| accessorOffset + size > viewLength)
+			throw Direct3dException("glTF accessor " + std::to_string(accessorIndex) + " is out of bounds");
+
+		// Only the bytes of this accessor are read
+		data.Bytes.resize(static_cast<size_t>(size));
+		glb.File.seekg(static_cast<std::streamoff>(glb.BinOffset + viewOffset + accessorOffset));
+		glb.File.read(reinterpret_cast<char*>(data.Bytes.data()), static_cast<std::streamsize>(size));
+
+		if (!glb.File)
+			throw Direct3dException("Failed to read glTF accessor " + std::to_string(accessorIndex));
+
+		return data;
+	}
+
+	// Reads one component as a float. Normalized integers are mapped to [0, 1] or [-1, 1] as the specification defines.
+	float ReadComponent(const AccessorData& data, size_t element, uint32_t component)
+	{
+		const auto bytes = data.Bytes.data() + element * data.Stride;
+
+		switch (data.ComponentType)
+		{
+		case ComponentTypeFloat:
+		{
+			float value;
+			memcpy(&value, bytes + component * 4, sizeof(value));
+			return value;
+		}
+		case ComponentTypeUnsignedByte:
+		{
+			const auto value = bytes[component];
+			return data.Normalized ? value / 255.0f : value;
+		}
+		case ComponentTypeByte:
+		{
+			const auto value = static_cast<int8_t>(bytes[component]);
+			return data.Normalized ? std::max(value / 127.0f, -1.0f) : value;
+		}
+		case ComponentTypeUnsignedShort:
+		{
+			uint16_t value;
+			memcpy(&value, bytes + component * 2, sizeof(value));
+			return data.Normalized ? value / 65535.0f : value;
+		}
+		case ComponentTypeShort:
+		{
+			int16_t value;
+			memcpy(&value, bytes + component * 2, sizeof(value));
+			return data.Normalized ? std::max(value / 32767.0f, -1.0f) : value;
+		}
+		default:
+			throw Direct3dException("Unsupported glTF vertex attribute component type");
+		}
+	}
+
+	uint32_t ReadIndex(const AccessorData& data, size_t element)
+	{
+		const auto bytes = data.Bytes.data() + element * data.Stride;
+
+		switch (data.ComponentType)
+		{
+		case ComponentTypeUnsignedByte:
+			return bytes[0];
+		case ComponentTypeUnsignedShort:
+		{
+			uint16_t value;
+			memcpy(&value, bytes, sizeof(value));
+			return value;
+		}
+		case ComponentTypeUnsignedInt:
+		{
+			uint32_t value;
+			memcpy(&value, bytes, sizeof(value));
+			return value;
+		}
+		default:
+			throw Direct3dException("Unsupported glTF index component type");
+		}
+	}
+
+	void OpenGlbFile(const std::wstring& fileName, GlbFile& glb)
+	{
+		glb.File.open(fileName, std::ios::binary);
+
+		if (!glb.File)
+			throw Direct3dException("Failed to open glTF file");
+
+		GlbHeader header;
+		GlbChunkHeader jsonChunk;
+		glb.File.read(reinterpret_cast<char*>(&header), sizeof(header));
+		glb.File.read(reinterpret_cast<char*>(&jsonChunk), sizeof(jsonChunk));
+
+		if (!glb.File || header.Magic != GlbMagic || header.Version != 2 || jsonChunk.Type != GlbChunkTypeJson)
+			throw Direct3dException("Not a binary glTF 2.0 file");
+
+		std::vector<char> json(jsonChunk.Length);
+		glb.File.read(json.data(), json.size());
+
+		if (!glb.File)
+			throw Direct3dException("glTF file is truncated");
+
+		// JSON chunks are padded with spaces, which the parser skips as whitespace
+		glb.Document = ParseJson(json.data(), json.size());
+
+		// The binary chunk is optional. Its contents are read on demand, accessor by accessor.
+		GlbChunkHeader binChunk;
+		glb.File.read(reinterpret_cast<char*>(&binChunk), sizeof(binChunk));
+
+		if (glb.File && binChunk.Type == GlbChunkTypeBin)
+		{
+			glb.BinOffset = sizeof(GlbHeader) + 2 * sizeof(GlbChunkHeader) + static_cast<uint64_t>(jsonChunk.Length);
+			glb.BinSize = binChunk.Length;
+		}
+		else
+		{
+			glb.BinOffset = 0;
+			glb.BinSize = 0;
+		}
+
+		glb.File.clear();
+	}
+
+	Mesh<VertexWithPositionNormalTexture> ImportPrimitive(GlbFile& glb, const JsonValue& primitive, JobSystem& jobSystem)
+	{
+		if (primitive.GetIndex("mode", PrimitiveModeTriangles) != PrimitiveModeTriangles)
+			throw Direct3dException("Only glTF triangle list primitives are supported");
+
+		const auto attributes = primitive.Find("attributes");
+
+		if (attributes == nullptr || attributes->GetIndex("POSITION", MissingIndex) == MissingIndex)
+			throw Direct3dException("glTF primitive has no positions");
+
+		const auto positions = ReadAccessor(glb, attributes->GetIndex("POSITION", 0));
+		const auto normalAccessor = attributes->GetIndex("NORMAL", MissingIndex);
+		const auto texCoordAccessor = attributes->GetIndex("TEXCOORD_0", MissingIndex);
+
+		AccessorData normals = {};
+		AccessorData texCoords = {};
+
+		if (normalAccessor != MissingIndex)
+			normals = ReadAccessor(glb, normalAccessor);
+
+		if (texCoordAccessor != MissingIndex)
+			texCoords = ReadAccessor(glb, texCoordAccessor);
+
+		// Vertex attributes are never 32-bit integers, so ReadComponent can't fail inside the parallel loop below
+		if (positions.ComponentCount != 3
+			|| positions.ComponentType == ComponentTypeUnsignedInt
+			|| normals.ComponentType == ComponentTypeUnsignedInt
+			|| texCoords.ComponentType == ComponentTypeUnsignedInt
+			|| (normalAccessor != MissingIndex && (normals.ComponentCount != 3 || normals.Count != positions.Count))
+			|| (texCoordAccessor != MissingIndex && (texCoords.ComponentCount != 2 || texCoords.Count != positions.Count)))
+			throw Direct3dException("glTF primitive has inconsistent vertex attributes");
+
+		Mesh<VertexWithPositionNormalTexture> mesh;
+		mesh.Vertices.resize(positions.Count);
+
+		jobSystem.ParallelFor(positions.Count, 16 * 1024, [&](size_t first, size_t last)
+		{
+			for (auto i = first; i < last; i++)
+			{
+				auto& vertex = mesh.Vertices[i];
+				vertex.Position = XMFLOAT3(ReadComponent(positions, i, 0), ReadComponent(positions, i, 1), -ReadComponent(positions, i, 2));
+				vertex.Normal = normalAccessor != MissingIndex
+					? XMFLOAT3(ReadComponent(normals, i, 0), ReadComponent(normals, i, 1), -ReadComponent(normals, i, 2))
+					: XMFLOAT3(0.0f, 0.0f, 0.0f);
+				vertex.TexCoord = texCoordAccessor != MissingIndex
+					? XMFLOAT2(ReadComponent(texCoords, i, 0), ReadComponent(texCoords, i, 1))
+					: XMFLOAT2(0.0f, 0.0f);
+			}
+		});
+
+		const auto indexAccessor = primitive.GetIndex("indices", MissingIndex);
+
+		if (indexAccessor != MissingIndex)
+		{
+			const auto indices = ReadAccessor(glb, indexAccessor);
+
+			if (indices.ComponentCount != 1 || indices.Count % 3 != 0)
+				throw Direct3dException("glTF primitive has an invalid index accessor");
+
+			mesh.Indices.resize(indices.Count);
+
+			for (size_t i = 0; i < indices.Count; i++)
+			{
+				mesh.Indices[i] = ReadIndex(indices, i);
+
+				if (mesh.Indices[i] >= positions.Count)
+					throw Direct3dException("glTF primitive has an index that is out of range");
+			}
+		}
+		else
+		{
+			mesh.Indices.resize(positions.Count / 3 * 3);
+
+			for (size_t i = 0; i < mesh.Indices.size(); i++)
+				mesh.Indices[i] = static_cast<uint32_t>(i);
+		}
+
+		// Reversed, so the counter-clockwise glTF front faces become clockwise
+		for (size_t i = 0; i < mesh.Indices.size(); i += 3)
+			std::swap(mesh.Indices[i + 1], mesh.Indices[i + 2]);
+
+		if (normalAccessor == MissingIndex)
+			GenerateSmoothNormals(mesh);
+
+		return mesh;
+	}
+}
+
+Mesh<VertexWithPositionNormalTexture> ImportGlbFile(const std::wstring& fileName, JobSystem& jobSystem)
+{
+	GlbFile glb;
+	OpenGlbFile(fileName, glb);
+
+	const auto meshes = glb.Document.Find("meshes");
+
+	if (meshes == nullptr || meshes->GetSize() == 0)
+		throw Direct3dException("glTF file contains no meshes");
+
+	Mesh<VertexWithPositionNormalTexture> result;
+
+	for (size_t meshIndex = 0; meshIndex < meshes->GetSize(); meshIndex++)
+	{
+		const auto primitives = (*meshes)[meshIndex].Find("primitives");
+
+		if (primitives == nullptr)
+			continue;
+
+		for (size_t primitiveIndex = 0; primitiveIndex < primitives->GetSize(); primitiveIndex++)
+		{
+			const auto primitive = ImportPrimitive(glb, (*primitives)[primitiveIndex], jobSystem);
+			const auto baseVertex = static_cast<uint32_t>(result.Vertices.size());
+
+			result.Vertices.insert(result.Vertices.end(), primitive.Vertices.begin(), primitive.Vertices.end());
+
+			for (const auto index : primitive.Indices)
+				result.Indices.push_back(baseVertex + index);
+		}
+	}
+
+	if (result.Indices.empty())
+		throw Direct3dException("glTF file contains no triangles");
+
+	return result;
+}
@@ -0,0 +1,24 @@
+﻿#pragma once
+
+#include "Mesh/Mesh.h"
+#include "Rendering/VertexDefinitions.h"
+#include "Threading/JobSystem.h"
+
+#include <string>
+
+/*
+ * Imports the triangles of all meshes in a binary glTF 2.0 file (.glb) as one triangle mesh.
+ * Used by the offline asset converter.
+ *
+ * The POSITION, NORMAL and TEXCOORD_0 attributes of every primitive are read, as floats or normalized integers.
+ * Primitives must be triangle lists, and sparse accessors aren't supported. The node hierarchy is ignored,
+ * So every mesh is imported in its own coordinate space. glTF vertices are already indexed, so unlike OBJ
+ * Corners there is nothing to deduplicate.
+ *
+ * Only the JSON chunk is read up front. The binary chunk is never loaded as a whole: the bytes of each accessor are
+ * Read with their own seek, and converted to vertices in parallel.
+ *
+ * glTF is right-handed with counter-clockwise front faces, like OBJ, so the z axis is mirrored and the triangle
+ * Winding is reversed. Its texture coordinates already have their origin at the top left.
+ */
+Mesh<VertexWithPositionNormalTexture> ImportGlbFile(const std::wstring& fileName, JobSystem& jobSystem);
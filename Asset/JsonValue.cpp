@@ -0,0 +1,361 @@
+﻿#include "JsonValue.h"
+
+#include "CustomExceptions/Direct3dException.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+// A recursive descent parser over a text that isn't necessarily zero terminated
+class JsonParser
+{
+public:
+	JsonParser(const char* text, size_t length)
+		: m_cursor(text), m_end(text + length), m_depth(0)
+	{
+	}
+
+	JsonValue ParseDocument()
+	{
+		auto value = ParseValue();
+		SkipWhitespace();
+
+		if (m_cursor != m_end)
+			Fail("unexpected text after the document");
+
+		return value;
+	}
+
+private:
+	// Protects the stack from maliciously deep nesting
+	static const int MaxDepth = 256;
+
+	void Fail(const char* reason) const
+	{
+		throw Direct3dException(std::string("Invalid JSON: ") + reason);
+	}
+
+	void SkipWhitespace()
+	{
+		while (m_cursor != m_end && (*m_cursor == ' ' || *m_cursor == '\t' || *m_cursor == '\n' || *m_cursor == '\r'))
+			m_cursor++;
+	}
+
+	char Peek()
+	{
+		SkipWhitespace();
+
+		if (m_cursor == m_end)
+			Fail("unexpected end of text");
+
+		return *m_cursor;
+	}
+
+	void Expect(char character)
+	{
+		if (Peek() != character)
+			Fail("unexpected character");
+
+		m_cursor++;
+	}
+
+	bool ConsumeLiteral(const char* literal)
+	{
+		const auto length = strlen(literal);
+
+		if (static_cast<size_t>(m_end - m_cursor) < length || memcmp(m_cursor, literal, length) != 0)
+			return false;
+
+		m_cursor += length;
+		return true;
+	}
+
+	JsonValue ParseValue()
+	{
+		if (++m_depth > MaxDepth)
+			Fail("nested too deeply");
+
+		JsonValue value;
+		const auto first = Peek();
+
+		if (first == '{')
+		{
+			value.m_type = JsonValue::Type::Object;
+			m_cursor++;
+
+			if (Peek() == '}')
+				m_cursor++;
+			else
+			{
+				do
+				{
+					if (Peek() != '"')
+						Fail("expected a member name");
+
+					auto name = ParseString();
+					Expect(':');
+					value.m_members.emplace_back(std::move(name), ParseValue());
+				} while (TryConsume(','));
+
+				Expect('}');
+			}
+		}
+		else if (first == '[')
+		{
+			value.m_type = JsonValue::Type::Array;
+			m_cursor++;
+
+			if (Peek() == ']')
+				m_cursor++;
+			else
+			{
+				do
+				{
+					value.m_elements.push_back(ParseValue());
+				} while (TryConsume(','));
+
+				Expect(']');
+			}
+		}
+		else if (first == '"')
+		{
+			value.m_type = JsonValue::Type::String;
+			value.m_string = ParseString();
+		}
+		else if (ConsumeLiteral("true"))
+		{
+			value.m_type = JsonValue::Type::Bool;
+			value.m_bool = true;
+		}
+		else if (ConsumeLiteral("false"))
+		{
+			value.m_type = JsonValue::Type::Bool;
+			value.m_bool = false;
+		}
+		else if (ConsumeLiteral("null"))
+		{
+			value.m_type = JsonValue::Type::Null;
+		}
+		else
+		{
+			value.m_type = JsonValue::Type::Number;
+			value.m_number = ParseNumber();
+		}
+
+		m_depth--;
+		return value;
+	}
+
+	bool TryConsume(char character)
+	{
+		if (Peek() != character)
+			return false;
+
+		m_cursor++;
+		return true;
+	}
+
+	double ParseNumber()
+	{
+		// strtod needs a zero terminated string. JSON numbers are short, so copy the characters a number can consist of.
+		char number[64];
+		size_t length = 0;
+
+		while (m_cursor != m_end && *m_cursor != '\0' && length < sizeof(number) - 1 && strchr("+-0123456789.eE", *m_cursor) != nullptr)
+			number[length++] = *m_cursor++;
+
+		number[length] = '\0';
+
+		char* numberEnd;
+		const auto value = strtod(number, &numberEnd);
+
+		if (length == 0 || numberEnd != number + length)
+			Fail("invalid number");
+
+		return value;
+	}
+
+	void AppendUtf8(std::string& text, unsigned int codePoint)
+	{
+		if (codePoint < 0x80)
+			text += static_cast<char>(codePoint);
+		else if (codePoint < 0x800)
+		{
+			text += static_cast<char>(0xC0 | codePoint >> 6);
+			text += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+		else if (codePoint < 0x10000)
+		{
+			text += static_cast<char>(0xE0 | codePoint >> 12);
+			text += static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+			text += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+		else
+		{
+			text += static_cast<char>(0xF0 | codePoint >> 18);
+			text += static_cast<char>(0x80 | (codePoint >> 12 & 0x3F));
+			text += static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+			text += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+	}
+
+	unsigned int ParseHexQuad()
+	{
+		if (m_end - m_cursor < 4)
+			Fail("truncated escape sequence");
+
+		unsigned int value = 0;
+
+		for (int i = 0; i < 4; i++)
+		{
+			const auto character = *m_cursor++;
+			value <<= 4;
+
+			if (character >= '0' && character <= '9')
+				value |= character - '0';
+			else if (character >= 'a' && character <= 'f')
+				value |= character - 'a' + 10;
+			else if (character >= 'A' && character <= 'F')
+				value |= character - 'A' + 10;
+			else
+				Fail("invalid escape sequence");
+		}
+
+		return value;
+	}
+
+	std::string ParseString()
+	{
+		Expect('"');
+		std::string text;
+
+		for (;;)
+		{
+			if (m_cursor == m_end)
+				Fail("unterminated string");
+
+			const auto character = *m_cursor++;
+
+			if (character == '"')
+				return text;
+
+			if (character != '\\')
+			{
+				text += character;
+				continue;
+			}
+
+			if (m_cursor == m_end)
+				Fail("unterminated string");
+
+			switch (*m_cursor++)
+			{
+			case '"': text += '"'; break;
+			case '\\': text += '\\'; break;
+			case '/': text += '/'; break;
+			case 'b': text += '\b'; break;
+			case 'f': text += '\f'; break;
+			case 'n': text += '\n'; break;
+			case 'r': text += '\r'; break;
+			case 't': text += '\t'; break;
+			case 'u':
+			{
+				auto codePoint = ParseHexQuad();
+
+				// Characters outside the basic multilingual plane are escaped as surrogate pairs
+				if (codePoint >= 0xD800 && codePoint < 0xDC00 && ConsumeLiteral("\\u"))
+					codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (ParseHexQuad() - 0xDC00);
+
+				AppendUtf8(text, codePoint);
+				break;
+			}
+			default:
+				Fail("invalid escape sequence");
+			}
+		}
+	}
+
+	const char* m_cursor;
+	const char* m_end;
+	int m_depth;
+};
+
+JsonValue::JsonValue()
+	: m_type(Type::Null), m_bool(false), m_number(0.0)
+{
+}
+
+JsonValue::Type JsonValue::GetType() const
+{
+	return m_type;
+}
+
+bool JsonValue::GetBool() const
+{
+	return m_bool;
+}
+
+double JsonValue::GetNumber() const
+{
+	return m_number;
+}
+
+const std::string& JsonValue::GetString() const
+{
+	return m_string;
+}
+
+size_t JsonValue::GetSize() const
+{
+	return m_elements.size();
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+	if (index >= m_elements.size())
+		throw Direct3dException("JSON array index " + std::to_string(index) + " is out of range");
+
+	return m_elements[index];
+}
+
+const JsonValue* JsonValue::Find(const std::string& name) const
+{
+	for (const auto& member : m_members)
+	{
+		if (member.first == name)
+			return &member.second;
+	}
+
+	return nullptr;
+}
+
+double JsonValue::GetNumber(const std::string& name, double defaultValue) const
+{
+	const auto member = Find(name);
+	return member != nullptr && member->m_type == Type::Number ? member->m_number : defaultValue;
+}
+
+size_t JsonValue::GetIndex(const std::string& name, size_t defaultValue) const
+{
+	const auto member = Find(name);
+
+	if (member == nullptr || member->m_type != Type::Number)
+		return defaultValue;
+
+	// Written so that NaN fails the check as well. 2^digits is the first value past the range of size_t.
+	const auto number = member->m_number;
+	const auto isIndex = number >= 0.0
+		&& number < std::ldexp(1.0, std::numeric_limits<size_t>::digits)
+		&& std::floor(number) == number;
+
+	if (!isIndex)
+		throw Direct3dException("JSON member " + name + " is not a valid index or count");
+
+	return static_cast<size_t>(number);
+}
+
+JsonValue ParseJson(const char* text, size_t length)
+{
+	return JsonParser(text, length).ParseDocument();
+}
@@ -0,0 +1,59 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * A parsed JSON document, as much of JSON as the glTF importer needs.
+ * Objects keep their members in file order and are searched linearly, which is fast enough for the few
+ * Dozen members a glTF object has.
+ */
+class JsonValue
+{
+public:
+	enum class Type
+	{
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object
+	};
+
+	JsonValue();
+
+	Type GetType() const;
+
+	bool GetBool() const;
+	double GetNumber() const;
+	const std::string& GetString() const;
+
+	// Array elements
+	size_t GetSize() const;
+	const JsonValue& operator[](size_t index) const;
+
+	// Returns the member with the given name, or nullptr if this isn't an object or there is no such member
+	const JsonValue* Find(const std::string& name) const;
+
+	// Shorthands for optional numeric members, as glTF uses them everywhere
+	double GetNumber(const std::string& name, double defaultValue) const;
+
+	// Throws if the member is a number that isn't a whole number in the range of size_t
+	size_t GetIndex(const std::string& name, size_t defaultValue) const;
+
+private:
+	friend class JsonParser;
+
+	Type m_type;
+	bool m_bool;
+	double m_number;
+	std::string m_string;
+	std::vector<JsonValue> m_elements;
+	std::vector<std::pair<std::string, JsonValue>> m_members;
+};
+
+// Parses a complete JSON document. Throws if the text isn't valid JSON.
+JsonValue ParseJson(const char* text, size_t length);
@@ -0,0 +1,79 @@
+﻿#include "MappedFile.h"
+
+#include "CustomExceptions/Direct3dException.h"
+
+#include <Windows.h>
+
+namespace
+{
+	std::string ToNarrowString(const std::wstring& text)
+	{
+		return std::string(text.begin(), text.end());
+	}
+}
+
+MappedFile::MappedFile(const std::wstring& fileName)
+	: m_fileHandle(INVALID_HANDLE_VALUE), m_mappingHandle(nullptr), m_data(nullptr), m_size(0)
+{
+	// Sequential scan would make the cache manager read ahead aggressively and evict pages right behind us,
+	// Which is wrong for assets that are accessed in any order and kept around
+	m_fileHandle = CreateFileW(
+		fileName.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS,
+		nullptr);
+
+	if (m_fileHandle == INVALID_HANDLE_VALUE)
+		throw Direct3dException("Failed to open " + ToNarrowString(fileName) + ". Error code: "
+			+ std::to_string(GetLastError()));
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(m_fileHandle);
+		throw Direct3dException("Failed to map " + ToNarrowString(fileName) + ", the file is empty or its size is unknown");
+	}
+
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+
+	m_mappingHandle = CreateFileMappingW(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	if (m_mappingHandle == nullptr)
+	{
+		const auto error = GetLastError();
+		CloseHandle(m_fileHandle);
+		throw Direct3dException("Failed to create a file mapping of " + ToNarrowString(fileName) + ". Error code: "
+			+ std::to_string(error));
+	}
+
+	m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+
+	if (m_data == nullptr)
+	{
+		const auto error = GetLastError();
+		CloseHandle(m_mappingHandle);
+		CloseHandle(m_fileHandle);
+		throw Direct3dException("Failed to map a view of " + ToNarrowString(fileName) + ". Error code: "
+			+ std::to_string(error));
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	UnmapViewOfFile(m_data);
+	CloseHandle(m_mappingHandle);
+	CloseHandle(m_fileHandle);
+}
+
+const uint8_t* MappedFile::GetData() const
+{
+	return m_data;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return m_size;
+}
@@ -0,0 +1,31 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * A file mapped read-only into the address space of the process.
+ *
+ * Nothing is read when the file is opened. The pages are faulted in from the file system cache
+ * The first time they are touched, and the OS is free to drop them again under memory pressure
+ * Since they are backed by the file itself rather than the page file.
+ */
+class MappedFile
+{
+public:
+	MappedFile(const std::wstring& fileName);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const uint8_t* GetData() const;
+	size_t GetSize() const;
+
+private:
+	void* m_fileHandle;
+	void* m_mappingHandle;
+	const uint8_t* m_data;
+	size_t m_size;
+};
@@ -0,0 +1,162 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+
+/*
+ * Number parsing for the text based importers, which spend most of their time turning digits into numbers.
+ *
+ * strtof has to handle locales, hexadecimal floats and arbitrarily long inputs, and is several times slower than
+ * Needed for the short decimal numbers asset files contain. ParseFloat reads up to 19 significant digits into an integer
+ * And scales it by an exact power of ten. Whenever the digits and the power of ten both fit a double exactly
+ * (Clinger's fast path), the double result is correctly rounded, and only the final conversion to float can differ
+ * From strtof - by one unit in the last place, for values exactly halfway between two floats. Everything else,
+ * Including infinities, NaNs and very long mantissas, falls back to strtof.
+ *
+ * Neither function skips leading whitespace. If there is no number at the cursor, 0 is returned and the cursor doesn't move.
+ */
+
+namespace NumberParser
+{
+	const double ExactPowersOfTen[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	// Every integer up to 2^53 converts to a double exactly
+	const uint64_t MaxExactMantissa = 1ull << 53;
+
+	inline bool IsDigit(char character)
+	{
+		return static_cast<unsigned int>(character - '0') < 10;
+	}
+}
+
+inline float ParseFloat(const char*& text)
+{
+	using namespace NumberParser;
+
+	auto cursor = text;
+	const bool negative = *cursor == '-';
+
+	if (*cursor == '-' || *cursor == '+')
+		cursor++;
+
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int significantDigits = 0;
+	bool hasDigits = false;
+
+	// Digits beyond the 19th can't be held in the mantissa. They only increase the exponent before the decimal point.
+	for (; IsDigit(*cursor); cursor++)
+	{
+		hasDigits = true;
+
+		if (significantDigits < 19)
+		{
+			mantissa = mantissa * 10 + static_cast<unsigned int>(*cursor - '0');
+			significantDigits += mantissa != 0;
+		}
+		else
+		{
+			exponent++;
+		}
+	}
+
+	if (*cursor == '.')
+	{
+		cursor++;
+
+		for (; IsDigit(*cursor); cursor++)
+		{
+			hasDigits = true;
+
+			if (significantDigits < 19)
+			{
+				mantissa = mantissa * 10 + static_cast<unsigned int>(*cursor - '0');
+				significantDigits += mantissa != 0;
+				exponent--;
+			}
+		}
+	}
+
+	if (!hasDigits)
+	{
+		// Infinity and NaN are rare enough that the slow path is fine for them
+		const auto first = text[negative || *text == '+' ? 1 : 0];
+
+		if (first != 'i' && first != 'I' && first != 'n' && first != 'N')
+			return 0.0f;
+
+		char* end;
+		const auto value = strtof(text, &end);
+		text = end;
+		return value;
+	}
+
+	// Only consume the exponent marker if an exponent actually follows it
+	if (*cursor == 'e' || *cursor == 'E')
+	{
+		auto exponentCursor = cursor + 1;
+		const bool negativeExponent = *exponentCursor == '-';
+
+		if (*exponentCursor == '-' || *exponentCursor == '+')
+			exponentCursor++;
+
+		if (IsDigit(*exponentCursor))
+		{
+			int explicitExponent = 0;
+
+			for (; IsDigit(*exponentCursor); exponentCursor++)
+			{
+				if (explicitExponent < 10000)
+					explicitExponent = explicitExponent * 10 + (*exponentCursor - '0');
+			}
+
+			exponent += negativeExponent ? -explicitExponent : explicitExponent;
+			cursor = exponentCursor;
+		}
+	}
+
+	if (mantissa > MaxExactMantissa || exponent < -22 || exponent > 22)
+	{
+		char* end;
+		const auto value = strtof(text, &end);
+		text = end;
+		return value;
+	}
+
+	auto value = static_cast<double>(mantissa);
+	value = exponent < 0 ? value / ExactPowersOfTen[-exponent] : value * ExactPowersOfTen[exponent];
+
+	text = cursor;
+	return static_cast<float>(negative ? -value : value);
+}
+
+// Parses a decimal integer with an optional sign. Sets valid to false if there are no digits at the cursor.
+inline int64_t ParseInteger(const char*& text, bool& valid)
+{
+	using namespace NumberParser;
+
+	auto cursor = text;
+	const bool negative = *cursor == '-';
+
+	if (*cursor == '-' || *cursor == '+')
+		cursor++;
+
+	valid = IsDigit(*cursor);
+
+	if (!valid)
+		return 0;
+
+	int64_t value = 0;
+
+	for (; IsDigit(*cursor); cursor++)
+	{
+		if (value < 1000000000000ll)
+			value = value * 10 + (*cursor - '0');
+	}
+
+	text = cursor;
+	return negative ? -value : value;
+}
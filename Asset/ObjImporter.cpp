@@ -0,0 +1,759 @@
+﻿#include "ObjImporter.h"
+
+#include "Asset/NumberParser.h"
+#include "CustomExceptions/Direct3dException.h"
+#include "Mesh/MeshGenerator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// The file is read in blocks of this size, and every block is split into chunks of about this size that are parsed in parallel
+	const size_t ObjBlockSize = 32 * 1024 * 1024;
+	const size_t ObjChunkSize = 1024 * 1024;
+
+	// Corners are deduplicated in 2^8 partitions, selected by the top bits of their hash
+	const int DeduplicationPartitionBits = 8;
+	const size_t DeduplicationPartitionCount = size_t(1) << DeduplicationPartitionBits;
+
+	// Zero based indices into the position, texture coordinate and normal lists. -1 if the corner has none.
+	struct ObjCorner
+	{
+		int Position;
+		int TexCoord;
+		int Normal;
+
+		bool operator==(const ObjCorner& other) const
+		{
+			return Position == other.Position && TexCoord == other.TexCoord && Normal == other.Normal;
+		}
+	};
+
+	struct ObjCornerHash
+	{
+		size_t operator()(const ObjCorner& corner) const
+		{
+			auto hash = static_cast<size_t>(corner.Position) * 73856093u;
+			hash ^= static_cast<size_t>(corner.TexCoord) * 19349663u;
+			hash ^= static_cast<size_t>(corner.Normal) * 83492791u;
+			return hash;
+		}
+	};
+
+	// A well mixed 32-bit hash. The top bits select the partition and the bottom bits the hash table slot.
+	uint32_t HashCorner(const ObjCorner& corner)
+	{
+		auto hash = static_cast<uint64_t>(static_cast<uint32_t>(corner.Position)) * 0x9E3779B97F4A7C15ull;
+		hash ^= static_cast<uint64_t>(static_cast<uint32_t>(corner.TexCoord)) * 0xC2B2AE3D27D4EB4Full;
+		hash ^= static_cast<uint64_t>(static_cast<uint32_t>(corner.Normal)) * 0x165667B19E3779F9ull;
+		hash ^= hash >> 29;
+		hash *= 0xBF58476D1CE4E5B9ull;
+		hash ^= hash >> 32;
+		return static_cast<uint32_t>(hash);
+	}
+
+	/*
+	 * A corner as a chunk parses it, before the chunk knows how many elements the chunks before it contain.
+	 * Positive OBJ indices are absolute and stored zero based. Negative indices are relative to the elements
+	 * Read so far, so they are stored relative to the start of the chunk and flagged in RelativeMask.
+	 */
+	struct ObjChunkCorner
+	{
+		int Position;
+		int TexCoord;
+		int Normal;
+		uint32_t RelativeMask;
+	};
+
+	const int MissingIndex = std::numeric_limits<int>::min();
+	const uint32_t RelativePosition = 1;
+	const uint32_t RelativeTexCoord = 2;
+	const uint32_t RelativeNormal = 4;
+
+	struct ObjChunk
+	{
+		const char* Begin;
+		const char* End;
+		std::vector<XMFLOAT3> Positions;
+		std::vector<XMFLOAT2> TexCoords;
+		std::vector<XMFLOAT3> Normals;
+		// Three corners per triangle
+		std::vector<ObjChunkCorner> Corners;
+		std::vector<ObjChunkCorner> Polygon;
+		std::string Error;
+	};
+
+	// A block of the file. Data holds the incomplete last line of the previous block followed by the newly read bytes.
+	struct ObjBlock
+	{
+		std::vector<char> Data;
+		size_t Size;
+		// Bytes up to and including the last complete line. The rest is carried over to the next block.
+		size_t ParseSize;
+		bool IsLast;
+		std::string Error;
+	};
+
+	bool IsSpace(char character)
+	{
+		return character == ' ' || character == '\t' || character == '\r';
+	}
+
+	const char* SkipSpaces(const char* text)
+	{
+		while (IsSpace(*text))
+			text++;
+
+		return text;
+	}
+
+	// Parses one index of a face corner. Returns false if there is no valid index at the cursor.
+	bool ParseChunkIndex(const char*& text, size_t localElementCount, uint32_t relativeFlag, int& index, uint32_t& relativeMask)
+	{
+		bool valid;
+		const auto value = ParseInteger(text, valid);
+
+		if (!valid || value == 0 || value > std::numeric_limits<int>::max() || value < -std::numeric_limits<int>::max())
+			return false;
+
+		if (value > 0)
+		{
+			index = static_cast<int>(value - 1);
+		}
+		else
+		{
+			index = static_cast<int>(static_cast<int64_t>(localElementCount) + value);
+			relativeMask |= relativeFlag;
+		}
+
+		return true;
+	}
+
+	void ParseChunk(ObjChunk& chunk)
+	{
+		chunk.Positions.clear();
+		chunk.TexCoords.clear();
+		chunk.Normals.clear();
+		chunk.Corners.clear();
+		chunk.Error.clear();
+
+		// Every line of a chunk ends with a line feed, so nothing is ever read beyond the end of the chunk
+		auto cursor = chunk.Begin;
+
+		while (cursor < chunk.End)
+		{
+			const auto line = cursor;
+			cursor = SkipSpaces(cursor);
+
+			if (cursor[0] == 'v' && IsSpace(cursor[1]))
+			{
+				XMFLOAT3 position;
+				cursor = SkipSpaces(cursor + 2);
+				position.x = ParseFloat(cursor);
+				cursor = SkipSpaces(cursor);
+				position.y = ParseFloat(cursor);
+				cursor = SkipSpaces(cursor);
+				position.z = -ParseFloat(cursor);
+				chunk.Positions.push_back(position);
+			}
+			else if (cursor[0] == 'v' && cursor[1] == 't' && IsSpace(cursor[2]))
+			{
+				XMFLOAT2 texCoord;
+				cursor = SkipSpaces(cursor + 3);
+				texCoord.x = ParseFloat(cursor);
+				cursor = SkipSpaces(cursor);
+				texCoord.y = 1.0f - ParseFloat(cursor);
+				chunk.TexCoords.push_back(texCoord);
+			}
+			else if (cursor[0] == 'v' && cursor[1] == 'n' && IsSpace(cursor[2]))
+			{
+				XMFLOAT3 normal;
+				cursor = SkipSpaces(cursor + 3);
+				normal.x = ParseFloat(cursor);
+				cursor = SkipSpaces(cursor);
+				normal.y = ParseFloat(cursor);
+				cursor = SkipSpaces(cursor);
+				normal.z = -ParseFloat(cursor);
+				chunk.Normals.push_back(normal);
+			}
+			else if (cursor[0] == 'f' && IsSpace(cursor[1]))
+			{
+				cursor = SkipSpaces(cursor + 1);
+				chunk.Polygon.clear();
+
+				// Each corner is p, p/t, p//n or p/t/n
+				while (*cursor != '\n')
+				{
+					ObjChunkCorner corner = { MissingIndex, MissingIndex, MissingIndex, 0 };
+					bool valid = ParseChunkIndex(cursor, chunk.Positions.size(), RelativePosition, corner.Position, corner.RelativeMask);
+
+					if (valid && *cursor == '/')
+					{
+						cursor++;
+
+						if (*cursor != '/')
+							valid = ParseChunkIndex(cursor, chunk.TexCoords.size(), RelativeTexCoord, corner.TexCoord, corner.RelativeMask);
+
+						if (valid && *cursor == '/')
+						{
+							cursor++;
+							valid = ParseChunkIndex(cursor, chunk.Normals.size(), RelativeNormal, corner.Normal, corner.RelativeMask);
+						}
+					}
+
+					if (!valid)
+					{
+						chunk.Error = "Invalid face in OBJ file: " + std::string(line, std::find(cursor, chunk.End, '\n'));
+						return;
+					}
+
+					chunk.Polygon.push_back(corner);
+					cursor = SkipSpaces(cursor);
+				}
+
+				// Reversed, so the counter-clockwise OBJ front faces become clockwise
+				for (size_t i = 2; i < chunk.Polygon.size(); i++)
+				{
+					chunk.Corners.push_back(chunk.Polygon[0]);
+					chunk.Corners.push_back(chunk.Polygon[i]);
+					chunk.Corners.push_back(chunk.Polygon[i - 1]);
+				}
+			}
+
+			// Move on to the next line
+			cursor = static_cast<const char*>(memchr(cursor, '\n', chunk.End - cursor)) + 1;
+		}
+	}
+
+	// Reads the next block of the file, after the incomplete line left over from the previous block
+	void ReadBlock(std::ifstream& file, ObjBlock& block, const char* carry, size_t carrySize)
+	{
+		block.Error.clear();
+
+		// One extra byte for the line feed appended to a last line that doesn't have one
+		block.Data.resize(carrySize + ObjBlockSize + 1);
+		if (carrySize > 0)
+			memcpy(block.Data.data(), carry, carrySize);
+
+		file.read(block.Data.data() + carrySize, ObjBlockSize);
+		const auto readSize = static_cast<size_t>(file.gcount());
+
+		block.Size = carrySize + readSize;
+		block.IsLast = readSize < ObjBlockSize;
+
+		if (block.IsLast)
+		{
+			if (block.Size > 0 && block.Data[block.Size - 1] != '\n')
+				block.Data[block.Size++] = '\n';
+
+			block.ParseSize = block.Size;
+			return;
+		}
+
+		const auto lastLine = std::find(
+			std::reverse_iterator<const char*>(block.Data.data() + block.Size),
+			std::reverse_iterator<const char*>(block.Data.data()),
+			'\n');
+
+		if (lastLine.base() == block.Data.data())
+		{
+			block.Error = "OBJ file has a line longer than " + std::to_string(ObjBlockSize) + " bytes";
+			block.ParseSize = 0;
+			block.IsLast = true;
+			return;
+		}
+
+		block.ParseSize = static_cast<size_t>(lastLine.base() - block.Data.data());
+	}
+
+	struct ObjAttributes
+	{
+		std::vector<XMFLOAT3> Positions;
+		std::vector<XMFLOAT2> TexCoords;
+		std::vector<XMFLOAT3> Normals;
+		std::vector<ObjCorner> Corners;
+	};
+
+	int ResolveIndex(int index, bool relative, size_t base)
+	{
+		if (index == MissingIndex)
+			return -1;
+
+		if (!relative)
+			return index;
+
+		// A relative index that resolves to before the first element is invalid. It is mapped to an index
+		// That is always out of range, so the validation catches it.
+		const auto resolvedIndex = static_cast<int64_t>(base) + index;
+		return resolvedIndex < 0 ? std::numeric_limits<int>::max() : static_cast<int>(resolvedIndex);
+	}
+
+	// Splits a block into chunks, parses them in parallel and appends the results to the attributes
+	void ParseBlock(const ObjBlock& block, std::vector<ObjChunk>& chunks, ObjAttributes& attributes, JobSystem& jobSystem)
+	{
+		const auto begin = block.Data.data();
+		const auto end = begin + block.ParseSize;
+		const auto chunkCount = std::max<size_t>(block.ParseSize / ObjChunkSize, 1);
+
+		if (chunks.size() < chunkCount)
+			chunks.resize(chunkCount);
+
+		// Chunk boundaries are moved forward to the next line start
+		auto chunkBegin = begin;
+
+		for (size_t i = 0; i < chunkCount; i++)
+		{
+			auto chunkEnd = end;
+
+			if (i + 1 < chunkCount)
+			{
+				const auto searchStart = std::max(chunkBegin, begin + (i + 1) * ObjChunkSize);
+				chunkEnd = std::find(searchStart, end, '\n');
+				chunkEnd = chunkEnd == end ? end : chunkEnd + 1;
+			}
+
+			chunks[i].Begin = chunkBegin;
+			chunks[i].End = chunkEnd;
+			chunkBegin = chunkEnd;
+		}
+
+		jobSystem.ParallelFor(chunkCount, 1, [&](size_t first, size_t last)
+		{
+			for (auto i = first; i < last; i++)
+				ParseChunk(chunks[i]);
+		});
+
+		// The element counts of the chunks before each chunk resolve its relative indices
+		std::vector<size_t> positionBases(chunkCount);
+		std::vector<size_t> texCoordBases(chunkCount);
+		std::vector<size_t> normalBases(chunkCount);
+		std::vector<size_t> cornerBases(chunkCount);
+
+		for (size_t i = 0; i < chunkCount; i++)
+		{
+			if (!chunks[i].Error.empty())
+				throw Direct3dException(chunks[i].Error);
+
+			positionBases[i] = attributes.Positions.size();
+			texCoordBases[i] = attributes.TexCoords.size();
+			normalBases[i] = attributes.Normals.size();
+			cornerBases[i] = attributes.Corners.size();
+
+			attributes.Positions.resize(attributes.Positions.size() + chunks[i].Positions.size());
+			attributes.TexCoords.resize(attributes.TexCoords.size() + chunks[i].TexCoords.size());
+			attributes.Normals.resize(attributes.Normals.size() + chunks[i].Normals.size());
+			attributes.Corners.resize(attributes.Corners.size() + chunks[i].Corners.size());
+		}
+
+		if (attributes.Positions.size() > static_cast<size_t>(std::numeric_limits<int>::max())
+			|| attributes.Corners.size() > static_cast<size_t>(std::numeric_limits<uint32_t>::max()))
+			throw Direct3dException("OBJ file is too large");
+
+		jobSystem.ParallelFor(chunkCount, 1, [&](size_t first, size_t last)
+		{
+			for (auto i = first; i < last; i++)
+			{
+				const auto& chunk = chunks[i];
+
+				std::copy(chunk.Positions.begin(), chunk.Positions.end(), attributes.Positions.begin() + positionBases[i]);
+				std::copy(chunk.TexCoords.begin(), chunk.TexCoords.end(), attributes.TexCoords.begin() + texCoordBases[i]);
+				std::copy(chunk.Normals.begin(), chunk.Normals.end(), attributes.Normals.begin() + normalBases[i]);
+
+				auto destination = attributes.Corners.begin() + cornerBases[i];
+
+				for (const auto& chunkCorner : chunk.Corners)
+				{
+					ObjCorner& corner = *destination++;
+					corner.Position = ResolveIndex(chunkCorner.Position, (chunkCorner.RelativeMask & RelativePosition) != 0, positionBases[i]);
+					corner.TexCoord = ResolveIndex(chunkCorner.TexCoord, (chunkCorner.RelativeMask & RelativeTexCoord) != 0, texCoordBases[i]);
+					corner.Normal = ResolveIndex(chunkCorner.Normal, (chunkCorner.RelativeMask & RelativeNormal) != 0, normalBases[i]);
+				}
+			}
+		});
+	}
+
+	// Turns the corners into vertices and indices, merging corners that reference the same attributes
+	void DeduplicateVertices(const ObjAttributes& attributes, JobSystem& jobSystem, Mesh<VertexWithPositionNormalTexture>& mesh)
+	{
+		const auto& corners = attributes.Corners;
+		const auto cornerCount = corners.size();
+		const size_t batchSize = 64 * 1024;
+
+		// Hash every corner, validating its indices on the way. Absolute indices may point forward, so they can only be checked now.
+		std::vector<uint32_t> hashes(cornerCount);
+		std::atomic<bool> hasInvalidIndex(false);
+
+		jobSystem.ParallelFor(cornerCount, batchSize, [&](size_t first, size_t last)
+		{
+			for (auto i = first; i < last; i++)
+			{
+				const auto& corner = corners[i];
+
+				if (corner.Position < 0 || static_cast<size_t>(corner.Position) >= attributes.Positions.size()
+					|| (corner.TexCoord >= 0 && static_cast<size_t>(corner.TexCoord) >= attributes.TexCoords.size())
+					|| (corner.Normal >= 0 && static_cast<size_t>(corner.Normal) >= attributes.Normals.size()))
+					hasInvalidIndex = true;
+
+				hashes[i] = HashCorner(corner);
+			}
+		});
+
+		if (hasInvalidIndex)
+			throw Direct3dException("OBJ file contains an index that is out of range");
+
+		// Sort the corner indices by partition with a parallel counting sort. Each batch counts its corners per partition,
+		// And the prefix sum over partitions and batches gives every batch its own range to scatter to.
+		const auto sortBatchCount = (cornerCount + batchSize - 1) / batchSize;
+		std::vector<uint32_t> batchOffsets(sortBatchCount * DeduplicationPartitionCount);
+
+		jobSystem.ParallelFor(sortBatchCount, 1, [&](size_t first, size_t last)
+		{
+			for (auto batch = first; batch < last; batch++)
+			{
+				const auto counts = &batchOffsets[batch * DeduplicationPartitionCount];
+
+				for (auto i = batch * batchSize; i < std::min(cornerCount, (batch + 1) * batchSize); i++)
+					counts[hashes[i] >> (32 - DeduplicationPartitionBits)]++;
+			}
+		});
+
+		std::vector<uint32_t> partitionStarts(DeduplicationPartitionCount + 1);
+		uint32_t offset = 0;
+
+		for (size_t partition = 0; partition < DeduplicationPartitionCount; partition++)
+		{
+			partitionStarts[partition] = offset;
+
+			for (size_t batch = 0; batch < sortBatchCount; batch++)
+			{
+				const auto count = batchOffsets[batch * DeduplicationPartitionCount + partition];
+				batchOffsets[batch * DeduplicationPartitionCount + partition] = offset;
+				offset += count;
+			}
+		}
+
+		partitionStarts[DeduplicationPartitionCount] = offset;
+
+		std::vector<uint32_t> sortedCorners(cornerCount);
+
+		jobSystem.ParallelFor(sortBatchCount, 1, [&](size_t first, size_t last)
+		{
+			for (auto batch = first; batch < last; batch++)
+			{
+				const auto offsets = &batchOffsets[batch * DeduplicationPartitionCount];
+
+				for (auto i = batch * batchSize; i < std::min(cornerCount, (batch + 1) * batchSize); i++)
+					sortedCorners[offsets[hashes[i] >> (32 - DeduplicationPartitionBits)]++] = static_cast<uint32_t>(i);
+			}
+		});
+
+		// Deduplicate every partition with an open addressing hash table. Within a partition the corners are in file order,
+		// So the result doesn't depend on the thread count.
+		std::vector<uint32_t> cornerVertices(cornerCount);
+		std::vector<std::vector<uint32_t>> partitionVertices(DeduplicationPartitionCount);
+
+		jobSystem.ParallelFor(DeduplicationPartitionCount, 1, [&](size_t first, size_t last)
+		{
+			const uint32_t emptySlot = 0xFFFFFFFF;
+			std::vector<uint32_t> table;
+
+			for (auto partition = first; partition < last; partition++)
+			{
+				const auto partitionSize = partitionStarts[partition + 1] - partitionStarts[partition];
+				auto& uniqueCorners = partitionVertices[partition];
+
+				size_t tableSize = 16;
+				while (tableSize < partitionSize * 2)
+					tableSize *= 2;
+
+				table.assign(tableSize, emptySlot);
+
+				for (auto k = partitionStarts[partition]; k < partitionStarts[partition + 1]; k++)
+				{
+					const auto cornerIndex = sortedCorners[k];
+					const auto& corner = corners[cornerIndex];
+					auto slot = hashes[cornerIndex] & (tableSize - 1);
+
+					for (;;)
+					{
+						if (table[slot] == emptySlot)
+						{
+							table[slot] = static_cast<uint32_t>(uniqueCorners.size());
+							uniqueCorners.push_back(cornerIndex);
+							break;
+						}
+
+						if (corners[uniqueCorners[table[slot]]] == corner)
+							break;
+
+						slot = (slot + 1) & (tableSize - 1);
+					}
+
+					cornerVertices[cornerIndex] = table[slot];
+				}
+			}
+		});
+
+		std::vector<uint32_t> partitionVertexBases(DeduplicationPartitionCount);
+		uint32_t vertexCount = 0;
+
+		for (size_t partition = 0; partition < DeduplicationPartitionCount; partition++)
+		{
+			partitionVertexBases[partition] = vertexCount;
+			vertexCount += static_cast<uint32_t>(partitionVertices[partition].size());
+		}
+
+		mesh.Vertices.resize(vertexCount);
+		mesh.Indices.resize(cornerCount);
+
+		jobSystem.ParallelFor(DeduplicationPartitionCount, 1, [&](size_t first, size_t last)
+		{
+			for (auto partition = first; partition < last; partition++)
+			{
+				auto vertex = mesh.Vertices.begin() + partitionVertexBases[partition];
+
+				for (const auto cornerIndex : partitionVertices[partition])
+				{
+					const auto& corner = corners[cornerIndex];
+					vertex->Position = attributes.Positions[corner.Position];
+					vertex->TexCoord = corner.TexCoord >= 0 ? attributes.TexCoords[corner.TexCoord] : XMFLOAT2(0.0f, 0.0f);
+					vertex->Normal = corner.Normal >= 0 ? attributes.Normals[corner.Normal] : XMFLOAT3(0.0f, 0.0f, 0.0f);
+					++vertex;
+				}
+			}
+		});
+
+		jobSystem.ParallelFor(cornerCount, batchSize, [&](size_t first, size_t last)
+		{
+			for (auto i = first; i < last; i++)
+				mesh.Indices[i] = partitionVertexBases[hashes[i] >> (32 - DeduplicationPartitionBits)] + cornerVertices[i];
+		});
+	}
+
+	float ParseFloatWithStrtof(const char*& text)
+	{
+		char* end;
+		const auto value = strtof(text, &end);
+		text = end;
+		return value;
+	}
+
+	// OBJ indices are one based, and negative indices count backwards from the last element read so far
+	int ParseIndexWithStrtol(const char*& text, size_t elementCount, int lineNumber)
+	{
+		char* end;
+		const auto index = strtol(text, &end, 10);
+
+		if (end == text || index == 0 || (index > 0 && static_cast<size_t>(index) > elementCount)
+			|| (index < 0 && static_cast<size_t>(-index) > elementCount))
+			throw Direct3dException("Invalid index in OBJ file on line " + std::to_string(lineNumber));
+
+		text = end;
+		return index > 0 ? index - 1 : static_cast<int>(elementCount) + index;
+	}
+}
+
+Mesh<VertexWithPositionNormalTexture> ImportObjFile(const std::wstring& fileName, JobSystem& jobSystem)
+{
+	std::ifstream file(fileName, std::ios::binary);
+
+	if (!file)
+		throw Direct3dException("Failed to open OBJ file");
+
+	ObjAttributes attributes;
+	std::vector<ObjChunk> chunks;
+	ObjBlock blocks[2];
+
+	ReadBlock(file, blocks[0], nullptr, 0);
+
+	for (int current = 0;; current = 1 - current)
+	{
+		const auto& block = blocks[current];
+		auto& nextBlock = blocks[1 - current];
+
+		if (!block.Error.empty())
+			throw Direct3dException(block.Error);
+
+		// Read the next block while this one is parsed. The reading job must have finished before anything
+		// It references goes out of scope, so errors are only rethrown after waiting for it.
+		JobCounter readCounter;
+
+		if (!block.IsLast)
+		{
+			jobSystem.Schedule([&]()
+			{
+				ReadBlock(file, nextBlock, block.Data.data() + block.ParseSize, block.Size - block.ParseSize);
+			}, &readCounter);
+		}
+
+		std::exception_ptr parseError;
+
+		try
+		{
+			ParseBlock(block, chunks, attributes, jobSystem);
+		}
+		catch (...)
+		{
+			parseError = std::current_exception();
+		}
+
+		jobSystem.Wait(readCounter);
+
+		if (parseError)
+			std::rethrow_exception(parseError);
+
+		if (block.IsLast)
+			break;
+	}
+
+	if (attributes.Corners.empty())
+		throw Direct3dException("OBJ file contains no faces");
+
+	Mesh<VertexWithPositionNormalTexture> mesh;
+	DeduplicateVertices(attributes, jobSystem, mesh);
+
+	if (attributes.Normals.empty())
+		GenerateSmoothNormals(mesh);
+
+	return mesh;
+}
+
+Mesh<VertexWithPositionNormalTexture> ImportObjFileReference(const std::wstring& fileName)
+{
+	std::ifstream file(fileName, std::ios::binary);
+
+	if (!file)
+		throw Direct3dException("Failed to open OBJ file");
+
+	// The text is kept zero terminated, so the parse functions always stop at the end
+	const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT2> texCoords;
+	std::vector<XMFLOAT3> normals;
+
+	Mesh<VertexWithPositionNormalTexture> mesh;
+	std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> vertexIndices;
+	std::vector<uint32_t> polygon;
+
+	const char* line = text.c_str();
+	int lineNumber = 1;
+
+	while (*line != '\0')
+	{
+		auto cursor = SkipSpaces(line);
+
+		if (cursor[0] == 'v' && IsSpace(cursor[1]))
+		{
+			cursor += 2;
+			XMFLOAT3 position;
+			position.x = ParseFloatWithStrtof(cursor);
+			position.y = ParseFloatWithStrtof(cursor);
+			position.z = -ParseFloatWithStrtof(cursor);
+			positions.push_back(position);
+		}
+		else if (cursor[0] == 'v' && cursor[1] == 't' && IsSpace(cursor[2]))
+		{
+			cursor += 3;
+			XMFLOAT2 texCoord;
+			texCoord.x = ParseFloatWithStrtof(cursor);
+			texCoord.y = 1.0f - ParseFloatWithStrtof(cursor);
+			texCoords.push_back(texCoord);
+		}
+		else if (cursor[0] == 'v' && cursor[1] == 'n' && IsSpace(cursor[2]))
+		{
+			cursor += 3;
+			XMFLOAT3 normal;
+			normal.x = ParseFloatWithStrtof(cursor);
+			normal.y = ParseFloatWithStrtof(cursor);
+			normal.z = -ParseFloatWithStrtof(cursor);
+			normals.push_back(normal);
+		}
+		else if (cursor[0] == 'f' && IsSpace(cursor[1]))
+		{
+			cursor = SkipSpaces(cursor + 1);
+			polygon.clear();
+
+			// Each corner is p, p/t, p//n or p/t/n
+			while (*cursor != '\n' && *cursor != '\0')
+			{
+				ObjCorner corner = { -1, -1, -1 };
+				corner.Position = ParseIndexWithStrtol(cursor, positions.size(), lineNumber);
+
+				if (*cursor == '/')
+				{
+					cursor++;
+
+					if (*cursor != '/')
+						corner.TexCoord = ParseIndexWithStrtol(cursor, texCoords.size(), lineNumber);
+
+					if (*cursor == '/')
+					{
+						cursor++;
+						corner.Normal = ParseIndexWithStrtol(cursor, normals.size(), lineNumber);
+					}
+				}
+
+				const auto existingVertex = vertexIndices.find(corner);
+
+				if (existingVertex != vertexIndices.end())
+				{
+					polygon.push_back(existingVertex->second);
+				}
+				else
+				{
+					VertexWithPositionNormalTexture vertex;
+					vertex.Position = positions[corner.Position];
+					vertex.TexCoord = corner.TexCoord >= 0 ? texCoords[corner.TexCoord] : XMFLOAT2(0.0f, 0.0f);
+					vertex.Normal = corner.Normal >= 0 ? normals[corner.Normal] : XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+					const auto vertexIndex = static_cast<uint32_t>(mesh.Vertices.size());
+					mesh.Vertices.push_back(vertex);
+					vertexIndices.emplace(corner, vertexIndex);
+					polygon.push_back(vertexIndex);
+				}
+
+				cursor = SkipSpaces(cursor);
+			}
+
+			// Reversed, so the counter-clockwise OBJ front faces become clockwise
+			for (size_t i = 2; i < polygon.size(); i++)
+			{
+				mesh.Indices.push_back(polygon[0]);
+				mesh.Indices.push_back(polygon[i]);
+				mesh.Indices.push_back(polygon[i - 1]);
+			}
+		}
+
+		// Move on to the next line
+		while (*cursor != '\n' && *cursor != '\0')
+			cursor++;
+
+		if (*cursor == '\n')
+		{
+			cursor++;
+			lineNumber++;
+		}
+
+		line = cursor;
+	}
+
+	if (mesh.Indices.empty())
+		throw Direct3dException("OBJ file contains no faces");
+
+	if (normals.empty())
+		GenerateSmoothNormals(mesh);
+
+	return mesh;
+}
@@ -0,0 +1,29 @@
+﻿#pragma once
+
+#include "Mesh/Mesh.h"
+#include "Rendering/VertexDefinitions.h"
+#include "Threading/JobSystem.h"
+
+#include <string>
+
+/*
+ * Imports the geometry of a Wavefront OBJ file as one triangle mesh. Used by the offline asset converter.
+ *
+ * Positions, texture coordinates and normals are read from v, vt and vn statements, and polygons are
+ * Triangulated as fans. Corners that share the same position, texture coordinate and normal become one vertex.
+ * Groups, materials and everything else are ignored. If the file has no normals, smooth normals are generated.
+ *
+ * OBJ files are right-handed with counter-clockwise front faces. The z axis is mirrored and the triangle winding
+ * Is reversed on import, and the v texture coordinate is flipped to Direct3D's top-down convention.
+ *
+ * The file is streamed in blocks of a few megabytes, so the text is never held in memory as a whole. While one block
+ * Is read from disk, the previous one is split into chunks at line boundaries that are parsed in parallel.
+ * Vertices are then deduplicated in parallel as well: corners are partitioned by their hash, and every partition
+ * Is deduplicated with its own hash table. The vertices end up ordered by partition, so the mesh should be optimized
+ * For vertex fetch afterwards, which the asset converter does anyway.
+ */
+Mesh<VertexWithPositionNormalTexture> ImportObjFile(const std::wstring& fileName, JobSystem& jobSystem);
+
+// A straightforward single threaded importer that reads the whole file and parses it with strtof and strtol.
+// Produces the same triangles and vertices as ImportObjFile, in a different vertex order. Kept to benchmark and verify against.
+Mesh<VertexWithPositionNormalTexture> ImportObjFileReference(const std::wstring& fileName);
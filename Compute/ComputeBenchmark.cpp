@@ -0,0 +1,209 @@
+﻿#include "ComputeBenchmark.h"
+
+#include "Compute/ComputeDispatcher.h"
+#include "Externals/SDL/Include/SDL.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// [numthreads(256, 1, 1)], a power of two so the reduction can halve the active threads every step
+	const unsigned int ReductionGroupSize = 256;
+
+	const unsigned int BlurGroupSize = 64;
+	const unsigned int BlurRadius = 4;
+	const unsigned int BlurRowLength = 1024;
+
+	// Both sides add the same values in the same order, so only rounding differences of the division remain
+	const float BlurTolerance = 1e-5f;
+
+	struct ReductionGroupShared
+	{
+		uint32_t Sums[ReductionGroupSize];
+	};
+
+	struct BlurGroupShared
+	{
+		// The group's pixels plus BlurRadius pixels on either side
+		float Row[BlurGroupSize + 2 * BlurRadius];
+	};
+
+	double GetSecondsSince(Uint64 startCounter)
+	{
+		return static_cast<double>(SDL_GetPerformanceCounter() - startCounter) / SDL_GetPerformanceFrequency();
+	}
+
+	// Sums the values of every thread group with a tree reduction in group shared memory. Integer sums are exact, so
+	// The results don't depend on the order of the additions and can be compared with the plain loop bit for bit.
+	ComputeKernel<ReductionGroupShared> CreateReductionKernel(
+		const std::vector<uint32_t>& values,
+		std::vector<uint32_t>& groupSums)
+	{
+		ComputeKernel<ReductionGroupShared> kernel;
+		kernel.ThreadGroupSize = DirectX::XMUINT3(ReductionGroupSize, 1, 1);
+
+		kernel.Phases.push_back([&values](const ComputeThreadId& threadId, auto& groupShared, auto&)
+		{
+			const auto index = threadId.DispatchThreadId.x;
+			groupShared.Sums[threadId.GroupIndex] = index < values.size() ? values[index] : 0;
+		});
+
+		// One phase per step, since every step reads sums that other threads wrote in the step before
+		for (unsigned int activeThreads = ReductionGroupSize / 2; activeThreads > 0; activeThreads /= 2)
+		{
+			kernel.Phases.push_back([activeThreads](const ComputeThreadId& threadId, auto& groupShared, auto&)
+			{
+				if (threadId.GroupIndex < activeThreads)
+					groupShared.Sums[threadId.GroupIndex] += groupShared.Sums[threadId.GroupIndex + activeThreads];
+			});
+		}
+
+		kernel.Phases.push_back([&groupSums](const ComputeThreadId& threadId, auto& groupShared, auto&)
+		{
+			if (threadId.GroupIndex == 0)
+				groupSums[threadId.GroupId.x] = groupShared.Sums[0];
+		});
+
+		return kernel;
+	}
+
+	// Averages every pixel with the BlurRadius pixels on either side, clamping at the ends of its row. A thread group
+	// Covers part of one row: its threads first load the pixels they need into group shared memory, then each thread
+	// Averages from there, so every pixel is read from the image once per group instead of once per neighbour.
+	ComputeKernel<BlurGroupShared> CreateBlurKernel(const std::vector<float>& image, std::vector<float>& blurredImage)
+	{
+		ComputeKernel<BlurGroupShared> kernel;
+		kernel.ThreadGroupSize = DirectX::XMUINT3(BlurGroupSize, 1, 1);
+
+		kernel.Phases.push_back([&image](const ComputeThreadId& threadId, auto& groupShared, auto&)
+		{
+			const auto rowStart = static_cast<size_t>(threadId.DispatchThreadId.y) * BlurRowLength;
+			const auto groupStart = static_cast<int>(threadId.GroupId.x * BlurGroupSize);
+
+			for (auto i = threadId.GroupIndex; i < BlurGroupSize + 2 * BlurRadius; i += BlurGroupSize)
+			{
+				auto x = groupStart + static_cast<int>(i) - static_cast<int>(BlurRadius);
+				x = std::min(std::max(x, 0), static_cast<int>(BlurRowLength) - 1);
+
+				groupShared.Row[i] = image[rowStart + x];
+			}
+		});
+
+		kernel.Phases.push_back([&blurredImage](const ComputeThreadId& threadId, auto& groupShared, auto&)
+		{
+			auto sum = 0.0f;
+			for (unsigned int i = 0; i <= 2 * BlurRadius; i++)
+				sum += groupShared.Row[threadId.GroupIndex + i];
+
+			const auto rowStart = static_cast<size_t>(threadId.DispatchThreadId.y) * BlurRowLength;
+			blurredImage[rowStart + threadId.DispatchThreadId.x] = sum / (2 * BlurRadius + 1);
+		});
+
+		return kernel;
+	}
+
+	void BenchmarkReduction(size_t elementCount, JobSystem& jobSystem, std::mt19937& random)
+	{
+		std::uniform_int_distribution<uint32_t> valueDistribution(0, 1000);
+
+		std::vector<uint32_t> values(elementCount);
+		for (auto& value : values)
+			value = valueDistribution(random);
+
+		const auto groupCount = static_cast<unsigned int>((elementCount + ReductionGroupSize - 1) / ReductionGroupSize);
+
+		auto startCounter = SDL_GetPerformanceCounter();
+
+		std::vector<uint32_t> expectedSums(groupCount, 0);
+		for (size_t i = 0; i < elementCount; i++)
+			expectedSums[i / ReductionGroupSize] += values[i];
+
+		const auto loopTime = GetSecondsSince(startCounter);
+
+		std::vector<uint32_t> groupSums(groupCount);
+		const auto kernel = CreateReductionKernel(values, groupSums);
+
+		startCounter = SDL_GetPerformanceCounter();
+		Dispatch(jobSystem, kernel, groupCount, 1, 1);
+		const auto dispatchTime = GetSecondsSince(startCounter);
+
+		unsigned int mismatches = 0;
+		for (unsigned int group = 0; group < groupCount; group++)
+		{
+			if (groupSums[group] != expectedSums[group])
+				mismatches++;
+		}
+
+		SDL_Log("Reduction: %u groups of %u, dispatch %.2f ms, plain loop %.2f ms, %u of %u group sums mismatched",
+			groupCount, ReductionGroupSize, dispatchTime * 1000.0, loopTime * 1000.0, mismatches, groupCount);
+	}
+
+	void BenchmarkBlur(size_t elementCount, JobSystem& jobSystem, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> pixelDistribution(0.0f, 1.0f);
+
+		// Whole rows, so every row is a whole number of thread groups
+		const auto rowCount = static_cast<unsigned int>(
+			std::max<size_t>((elementCount + BlurRowLength - 1) / BlurRowLength, 1));
+		const auto pixelCount = static_cast<size_t>(rowCount) * BlurRowLength;
+
+		std::vector<float> image(pixelCount);
+		for (auto& pixel : image)
+			pixel = pixelDistribution(random);
+
+		auto startCounter = SDL_GetPerformanceCounter();
+
+		std::vector<float> expectedImage(pixelCount);
+		for (size_t row = 0; row < rowCount; row++)
+		{
+			const auto rowStart = row * BlurRowLength;
+
+			for (int x = 0; x < static_cast<int>(BlurRowLength); x++)
+			{
+				auto sum = 0.0f;
+				for (int offset = -static_cast<int>(BlurRadius); offset <= static_cast<int>(BlurRadius); offset++)
+				{
+					const auto sampleX = std::min(std::max(x + offset, 0), static_cast<int>(BlurRowLength) - 1);
+					sum += image[rowStart + sampleX];
+				}
+
+				expectedImage[rowStart + x] = sum / (2 * BlurRadius + 1);
+			}
+		}
+
+		const auto loopTime = GetSecondsSince(startCounter);
+
+		std::vector<float> blurredImage(pixelCount);
+		const auto kernel = CreateBlurKernel(image, blurredImage);
+
+		startCounter = SDL_GetPerformanceCounter();
+		Dispatch(jobSystem, kernel, BlurRowLength / BlurGroupSize, rowCount, 1);
+		const auto dispatchTime = GetSecondsSince(startCounter);
+
+		size_t mismatches = 0;
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			if (!(std::abs(blurredImage[i] - expectedImage[i]) <= BlurTolerance))
+				mismatches++;
+		}
+
+		SDL_Log("Blur: %u rows of %u, radius %u, dispatch %.2f ms, plain loop %.2f ms, %llu of %llu pixels mismatched",
+			rowCount, BlurRowLength, BlurRadius, dispatchTime * 1000.0, loopTime * 1000.0,
+			static_cast<unsigned long long>(mismatches), static_cast<unsigned long long>(pixelCount));
+	}
+}
+
+void BenchmarkComputeKernels(size_t elementCount, JobSystem& jobSystem)
+{
+	std::mt19937 random(42);
+
+	SDL_Log("Compute kernels: %llu elements on %u threads",
+		static_cast<unsigned long long>(elementCount), jobSystem.GetThreadCount());
+
+	BenchmarkReduction(elementCount, jobSystem, random);
+	BenchmarkBlur(elementCount, jobSystem, random);
+}
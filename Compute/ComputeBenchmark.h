@@ -0,0 +1,12 @@
+﻿#pragma once
+
+#include "Threading/JobSystem.h"
+
+#include <cstddef>
+
+/*
+ * Runs two kernels through the compute dispatch emulation on elementCount values, a groupshared sum reduction and a
+ * Horizontal box blur that loads its rows into groupshared memory, and logs their times next to the times of the
+ * Same work done by plain loops. Every output value is checked against the plain loops, and mismatches are logged.
+ */
+void BenchmarkComputeKernels(size_t elementCount, JobSystem& jobSystem);
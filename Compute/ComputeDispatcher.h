@@ -0,0 +1,117 @@
+﻿#pragma once
+
+#include "Threading/JobSystem.h"
+
+#include <DirectXMath.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+/*
+ * CPU emulation of compute shader dispatches.
+ *
+ * A kernel has the same structure as a compute shader: a dispatch is a grid of thread groups, every thread group
+ * Consists of ThreadGroupSize threads which share a block of group shared memory, and threads synchronize
+ * With group barriers (GroupMemoryBarrierWithGroupSync in HLSL).
+ *
+ * Barriers are expressed by splitting the kernel into phases. Every thread of a group runs phase N before
+ * Any thread runs phase N + 1, which is exactly the guarantee a group barrier gives. Each thread group runs as a
+ * Plain loop over its threads on one worker of the job system, and different thread groups run in parallel.
+ *
+ * Since local variables don't survive from one phase to the next, values a thread needs after a barrier
+ * Must be kept in its TThreadState (the equivalent of registers) or in group shared memory.
+ */
+
+// The system values a compute shader thread receives
+struct ComputeThreadId
+{
+	// SV_GroupID
+	DirectX::XMUINT3 GroupId;
+	// SV_GroupThreadID
+	DirectX::XMUINT3 GroupThreadId;
+	// SV_DispatchThreadID
+	DirectX::XMUINT3 DispatchThreadId;
+	// SV_GroupIndex - the flattened group thread id
+	unsigned int GroupIndex;
+};
+
+struct NoThreadState
+{
+};
+
+template<typename TGroupShared, typename TThreadState = NoThreadState>
+struct ComputeKernel
+{
+	using Phase = std::function<void(const ComputeThreadId& threadId, TGroupShared& groupShared, TThreadState& threadState)>;
+
+	// [numthreads(x, y, z)]
+	DirectX::XMUINT3 ThreadGroupSize;
+
+	// The kernel body, split at its group barriers
+	std::vector<Phase> Phases;
+};
+
+// Runs a kernel for threadGroupCountX * threadGroupCountY * threadGroupCountZ thread groups and waits for it to finish
+template<typename TGroupShared, typename TThreadState>
+void Dispatch(
+	JobSystem& jobSystem,
+	const ComputeKernel<TGroupShared, TThreadState>& kernel,
+	unsigned int threadGroupCountX,
+	unsigned int threadGroupCountY,
+	unsigned int threadGroupCountZ)
+{
+	const auto groupSize = kernel.ThreadGroupSize;
+	const size_t threadsPerGroup = static_cast<size_t>(groupSize.x) * groupSize.y * groupSize.z;
+	const size_t groupCount = static_cast<size_t>(threadGroupCountX) * threadGroupCountY * threadGroupCountZ;
+
+	if (threadsPerGroup == 0 || groupCount == 0)
+		return;
+
+	// A few batches per worker keep the workers busy when groups take uneven time, while every batch still
+	// Covers enough groups to reuse its memory
+	const size_t batchCount = static_cast<size_t>(jobSystem.GetThreadCount()) * 4;
+	const size_t groupsPerBatch = (groupCount + batchCount - 1) / batchCount;
+
+	jobSystem.ParallelFor(groupCount, groupsPerBatch, [&](size_t firstGroup, size_t endGroup)
+	{
+		// Group shared memory and thread state are allocated once per batch of groups and reused.
+		// Like on the GPU, group shared memory is not cleared between groups.
+		auto groupShared = std::make_unique<TGroupShared>();
+		std::vector<TThreadState> threadStates(threadsPerGroup);
+
+		for (size_t group = firstGroup; group < endGroup; group++)
+		{
+			const DirectX::XMUINT3 groupId(
+				static_cast<unsigned int>(group % threadGroupCountX),
+				static_cast<unsigned int>(group / threadGroupCountX % threadGroupCountY),
+				static_cast<unsigned int>(group / (static_cast<size_t>(threadGroupCountX) * threadGroupCountY)));
+
+			for (auto& threadState : threadStates)
+				threadState = TThreadState();
+
+			for (const auto& phase : kernel.Phases)
+			{
+				unsigned int groupIndex = 0;
+
+				for (unsigned int z = 0; z < groupSize.z; z++)
+				for (unsigned int y = 0; y < groupSize.y; y++)
+				for (unsigned int x = 0; x < groupSize.x; x++)
+				{
+					ComputeThreadId threadId;
+					threadId.GroupId = groupId;
+					threadId.GroupThreadId = DirectX::XMUINT3(x, y, z);
+					threadId.DispatchThreadId = DirectX::XMUINT3(
+						groupId.x * groupSize.x + x,
+						groupId.y * groupSize.y + y,
+						groupId.z * groupSize.z + z);
+					threadId.GroupIndex = groupIndex;
+
+					phase(threadId, *groupShared, threadStates[groupIndex]);
+
+					groupIndex++;
+				}
+			}
+		}
+	});
+}
@@ -0,0 +1,83 @@
+﻿#include "GpuTimer.h"
+
+#include "CustomExceptions/Direct3dException.h"
+
+namespace
+{
+	Microsoft::WRL::ComPtr<ID3D11Query> CreateQuery(ID3D11Device* device, D3D11_QUERY queryType)
+	{
+		D3D11_QUERY_DESC queryDesc;
+		queryDesc.Query = queryType;
+		queryDesc.MiscFlags = 0;
+
+		Microsoft::WRL::ComPtr<ID3D11Query> query;
+		const auto queryCreationResult = device->CreateQuery(&queryDesc, query.GetAddressOf());
+
+		if (queryCreationResult != S_OK)
+			throw Direct3dException("Failed to create timestamp query. Error code: "
+				+ std::to_string(queryCreationResult));
+
+		return query;
+	}
+}
+
+GpuTimer::GpuTimer(ID3D11Device* device)
+{
+	for (int i = 0; i < QueryCount; i++)
+	{
+		m_disjointQueries[i] = CreateQuery(device, D3D11_QUERY_TIMESTAMP_DISJOINT);
+		m_beginQueries[i] = CreateQuery(device, D3D11_QUERY_TIMESTAMP);
+		m_endQueries[i] = CreateQuery(device, D3D11_QUERY_TIMESTAMP);
+		m_queryIssued[i] = false;
+	}
+
+	m_currentQuery = 0;
+}
+
+void GpuTimer::Begin(ID3D11DeviceContext* deviceContext)
+{
+	deviceContext->Begin(m_disjointQueries[m_currentQuery].Get());
+
+	// Timestamp queries only have an end, which records the time stamp
+	deviceContext->End(m_beginQueries[m_currentQuery].Get());
+}
+
+void GpuTimer::End(ID3D11DeviceContext* deviceContext)
+{
+	deviceContext->End(m_endQueries[m_currentQuery].Get());
+	deviceContext->End(m_disjointQueries[m_currentQuery].Get());
+	m_queryIssued[m_currentQuery] = true;
+
+	m_currentQuery = (m_currentQuery + 1) % QueryCount;
+}
+
+bool GpuTimer::TryGetElapsedMilliseconds(ID3D11DeviceContext* deviceContext, double& elapsedMilliseconds)
+{
+	const int oldestQuery = m_currentQuery;
+
+	if (!m_queryIssued[oldestQuery])
+		return false;
+
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjointData;
+	if (deviceContext->GetData(m_disjointQueries[oldestQuery].Get(), &disjointData, sizeof(disjointData), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		return false;
+
+	UINT64 beginTimestamp;
+	UINT64 endTimestamp;
+
+	if (deviceContext->GetData(m_beginQueries[oldestQuery].Get(), &beginTimestamp, sizeof(beginTimestamp), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		return false;
+
+	if (deviceContext->GetData(m_endQueries[oldestQuery].Get(), &endTimestamp, sizeof(endTimestamp), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		return false;
+
+	m_queryIssued[oldestQuery] = false;
+
+	// If the GPU clock changed frequency during the frame (for instance because of power saving), the timestamps are useless
+	if (disjointData.Disjoint)
+		return false;
+
+	elapsedMilliseconds = static_cast<double>(endTimestamp - beginTimestamp) * 1000.0 / static_cast<double>(disjointData.Frequency);
+
+	return true;
+}
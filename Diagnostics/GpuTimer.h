@@ -0,0 +1,32 @@
+﻿#pragma once
+
+#include <wrl/client.h>
+#include <d3d11.h>
+
+/*
+ * Measures how long the GPU spends on a section of a frame, using timestamp queries.
+ *
+ * Like PipelineStatistics, the queries are kept in a small ring and read back a few frames later,
+ * So measuring never stalls the CPU.
+ */
+class GpuTimer
+{
+public:
+	GpuTimer(ID3D11Device* device);
+
+	void Begin(ID3D11DeviceContext* deviceContext);
+	void End(ID3D11DeviceContext* deviceContext);
+
+	// Returns true and fills out the elapsed time if the results of an earlier frame have become available
+	bool TryGetElapsedMilliseconds(ID3D11DeviceContext* deviceContext, double& elapsedMilliseconds);
+
+private:
+	static const int QueryCount = 4;
+
+	// Timestamps are only meaningful together with the frequency reported by a disjoint query
+	Microsoft::WRL::ComPtr<ID3D11Query> m_disjointQueries[QueryCount];
+	Microsoft::WRL::ComPtr<ID3D11Query> m_beginQueries[QueryCount];
+	Microsoft::WRL::ComPtr<ID3D11Query> m_endQueries[QueryCount];
+	bool m_queryIssued[QueryCount];
+	int m_currentQuery;
+};
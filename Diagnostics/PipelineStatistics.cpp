@@ -0,0 +1,71 @@
+﻿#include "PipelineStatistics.h"
+
+#include "CustomExceptions/Direct3dException.h"
+
+PipelineStatistics::PipelineStatistics(ID3D11Device* device)
+{
+	D3D11_QUERY_DESC queryDesc;
+	queryDesc.Query = D3D11_QUERY_PIPELINE_STATISTICS;
+	queryDesc.MiscFlags = 0;
+
+	for (int i = 0; i < QueryCount; i++)
+	{
+		const auto queryCreationResult = device->CreateQuery(&queryDesc, m_queries[i].GetAddressOf());
+
+		if (queryCreationResult != S_OK)
+			throw Direct3dException("Failed to create pipeline statistics query. Error code: "
+				+ std::to_string(queryCreationResult));
+
+		m_queryIssued[i] = false;
+	}
+
+	m_currentQuery = 0;
+}
+
+void PipelineStatistics::BeginFrame(ID3D11DeviceContext* deviceContext)
+{
+	deviceContext->Begin(m_queries[m_currentQuery].Get());
+}
+
+void PipelineStatistics::EndFrame(ID3D11DeviceContext* deviceContext)
+{
+	deviceContext->End(m_queries[m_currentQuery].Get());
+	m_queryIssued[m_currentQuery] = true;
+
+	m_currentQuery = (m_currentQuery + 1) % QueryCount;
+}
+
+bool PipelineStatistics::TryGetFrameStatistics(ID3D11DeviceContext* deviceContext, TriangleStatistics& statistics)
+{
+	// The query we are about to reuse next frame is the oldest one in the ring
+	const int oldestQuery = m_currentQuery;
+
+	if (!m_queryIssued[oldestQuery])
+		return false;
+
+	D3D11_QUERY_DATA_PIPELINE_STATISTICS queryData;
+
+	// D3D11_ASYNC_GETDATA_DONOTFLUSH makes sure that we don't force a flush of the command buffer
+	// Just to poll the query. S_FALSE is returned if the data isn't ready yet.
+	const auto getDataResult = deviceContext->GetData(
+		m_queries[oldestQuery].Get(),
+		&queryData,
+		sizeof(queryData),
+		D3D11_ASYNC_GETDATA_DONOTFLUSH
+	);
+
+	if (getDataResult != S_OK)
+		return false;
+
+	m_queryIssued[oldestQuery] = false;
+
+	// IAPrimitives = Primitives read by the input assembler
+	// CInvocations = Primitives sent to the clipper
+	// CPrimitives = Primitives output by the clipper. These are the driver's own counts: culling may happen on
+	// Either side of the clipper, and clipping can split a triangle into several.
+	statistics.InputTriangles = queryData.IAPrimitives;
+	statistics.ClipperInputTriangles = queryData.CInvocations;
+	statistics.ClipperOutputTriangles = queryData.CPrimitives;
+
+	return true;
+}
@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include <wrl/client.h>
+#include <d3d11.h>
+
+/*
+ * Triangle counts for a single frame, as reported by the hardware.
+ *
+ * D3D11 counts the last two at the clipper. Whether backfacing triangles and triangles that cover no samples are
+ * Removed before or after it is up to the driver, and clipping may split a triangle into several, so the difference
+ * To the input count is not an exact count of culled triangles.
+ */
+struct TriangleStatistics
+{
+	// Triangles read by the input assembler
+	UINT64 InputTriangles;
+	// Triangles that reached the clipper
+	UINT64 ClipperInputTriangles;
+	// Triangles the clipper passed on to the rasterizer
+	UINT64 ClipperOutputTriangles;
+};
+
+/*
+ * Measures how many triangles enter the pipeline and how many the clipper passes on,
+ * Using D3D11_QUERY_PIPELINE_STATISTICS queries.
+ *
+ * Query results are only available once the GPU has finished the frame, so we keep a small
+ * Ring of queries and read the results of an older frame. This way we never stall the CPU
+ * Waiting for the GPU.
+ */
+class PipelineStatistics
+{
+public:
+	PipelineStatistics(ID3D11Device* device);
+
+	void BeginFrame(ID3D11DeviceContext* deviceContext);
+	void EndFrame(ID3D11DeviceContext* deviceContext);
+
+	// Returns true and fills out the statistics if the results of an earlier frame have become available
+	bool TryGetFrameStatistics(ID3D11DeviceContext* deviceContext, TriangleStatistics& statistics);
+
+private:
+	static const int QueryCount = 4;
+
+	Microsoft::WRL::ComPtr<ID3D11Query> m_queries[QueryCount];
+	bool m_queryIssued[QueryCount];
+	int m_currentQuery;
+};
@@ -0,0 +1,54 @@
+﻿#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+
+// Placement of an entity in the world, or relative to its parent if it has a transform node.
+// The rotation is a unit quaternion, and the scale is uniform.
+struct TransformComponent
+{
+	DirectX::XMFLOAT3 Position;
+	float Scale;
+	DirectX::XMFLOAT4 Rotation;
+};
+
+// Units per second, in the same space as the transform: the world, or the parent for entities with a transform node
+struct VelocityComponent
+{
+	DirectX::XMFLOAT3 Linear;
+};
+
+// The rotation axis, scaled by the rotation speed in radians per second. Like the velocity, it is in the same space as
+// The transform, so the cubes in a layer of the cube field spin around axes that turn along with the layer.
+struct AngularVelocityComponent
+{
+	DirectX::XMFLOAT3 Angular;
+};
+
+struct RenderMeshComponent
+{
+	// Identifies the mesh the entity is drawn with
+	uint32_t Mesh;
+	// The level of detail selected for the current frame
+	uint32_t Lod;
+};
+
+// World space bounding sphere, centered on the entity's position
+struct BoundsComponent
+{
+	DirectX::XMFLOAT3 Center;
+	float Radius;
+};
+
+// The entity's node in a transform hierarchy, which computes its world matrix
+struct TransformNodeComponent
+{
+	uint32_t Node;
+};
+
+// The entity's body in a rigid body world, which moves it while physics is simulated
+struct RigidBodyComponent
+{
+	uint32_t Body;
+};
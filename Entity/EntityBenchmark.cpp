@@ -0,0 +1,318 @@
+﻿#include "EntityBenchmark.h"
+
+#include "Entity/Components.h"
+#include "Entity/EntityManager.h"
+#include "Entity/RotatingInstances.h"
+#include "Entity/TransformSystems.h"
+#include "Externals/SDL/Include/SDL.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const int UpdateCount = 20;
+	const float DeltaTime = 1.0f / 60.0f;
+
+	// Small enough for the instances and their matrices to stay in the L2 cache, so the kernel isn't waiting for memory
+	const size_t CacheResidentInstanceCount = 2048;
+	const int CacheResidentUpdateCount = 2000;
+
+	const int DriftStepCount = 1000000;
+
+	// A cube as a classic game object. Every update goes through a pointer and a virtual call, and the rotation shares
+	// Its cache lines with all the other state of the object.
+	class CubeObject
+	{
+	public:
+		virtual ~CubeObject()
+		{
+		}
+
+		virtual void Update(float deltaTime)
+		{
+			const auto rotation = XMLoadFloat4(&Transform.Rotation);
+			const auto angularVelocity = XMLoadFloat3(&AngularVelocity.Angular);
+
+			XMStoreFloat4(&Transform.Rotation, IntegrateRotation(rotation, angularVelocity, deltaTime));
+		}
+
+		TransformComponent Transform;
+		VelocityComponent Velocity;
+		AngularVelocityComponent AngularVelocity;
+		RenderMeshComponent RenderMesh;
+		BoundsComponent Bounds;
+	};
+
+	XMFLOAT3 GetAngularVelocity(size_t index)
+	{
+		return XMFLOAT3(0.5f, 1.0f + (index % 7) * 0.1f, 0.0f);
+	}
+
+	double GetSecondsSince(Uint64 startCounter)
+	{
+		return static_cast<double>(SDL_GetPerformanceCounter() - startCounter) / SDL_GetPerformanceFrequency();
+	}
+
+	std::vector<RotatingInstanceBlock> CreateBenchmarkInstances(size_t instanceCount)
+	{
+		auto blocks = CreateRotatingInstanceBlocks(instanceCount);
+
+		for (size_t i = 0; i < instanceCount; i++)
+		{
+			auto& block = blocks[i / RotatingInstanceBlockSize];
+			const auto lane = i % RotatingInstanceBlockSize;
+			const auto angularVelocity = GetAngularVelocity(i);
+
+			block.PositionX[lane] = static_cast<float>(i % 1000);
+			block.PositionZ[lane] = static_cast<float>(i / 1000);
+			block.AngularVelocityX[lane] = angularVelocity.x;
+			block.AngularVelocityY[lane] = angularVelocity.y;
+			block.AngularVelocityZ[lane] = angularVelocity.z;
+		}
+
+		return blocks;
+	}
+
+	// Returns the seconds per update. Runs on the calling thread if jobSystem is null.
+	double TimeRotatingInstanceUpdates(
+		std::vector<RotatingInstanceBlock>& blocks,
+		std::vector<XMFLOAT3X4>& worldMatrices,
+		int updateCount,
+		JobSystem* jobSystem)
+	{
+		const auto startCounter = SDL_GetPerformanceCounter();
+
+		for (int update = 0; update < updateCount; update++)
+		{
+			if (jobSystem)
+				IntegrateRotatingInstances(blocks.data(), blocks.size(), DeltaTime, worldMatrices.data(), *jobSystem);
+			else
+				IntegrateRotatingInstances(blocks.data(), blocks.size(), DeltaTime, worldMatrices.data());
+		}
+
+		return GetSecondsSince(startCounter) / updateCount;
+	}
+
+	// Angle between two rotations, in radians
+	double GetAngleBetween(const double a[4], const double b[4])
+	{
+		const auto dot = std::abs(a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3]);
+
+		return 2.0 * std::acos(std::min(dot, 1.0));
+	}
+}
+
+void BenchmarkEntityUpdate(size_t entityCount, JobSystem& jobSystem)
+{
+	const auto identity = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+
+	// Objects allocated one by one end up wherever the heap puts them. Visiting them in a shuffled order stands in
+	// For a heap that has been in use for a while.
+	std::vector<std::unique_ptr<CubeObject>> objects;
+	objects.reserve(entityCount);
+
+	for (size_t i = 0; i < entityCount; i++)
+	{
+		objects.push_back(std::make_unique<CubeObject>());
+		objects.back()->Transform.Rotation = identity;
+		objects.back()->AngularVelocity.Angular = GetAngularVelocity(i);
+	}
+
+	std::shuffle(objects.begin(), objects.end(), std::mt19937(42));
+
+	auto startCounter = SDL_GetPerformanceCounter();
+
+	for (int update = 0; update < UpdateCount; update++)
+	{
+		for (const auto& object : objects)
+			object->Update(DeltaTime);
+	}
+
+	const auto objectSeconds = GetSecondsSince(startCounter) / UpdateCount;
+
+	objects.clear();
+	objects.shrink_to_fit();
+
+	EntityManager entities;
+	entities.CreateEntities<
+		TransformComponent,
+		VelocityComponent,
+		AngularVelocityComponent,
+		RenderMeshComponent,
+		BoundsComponent>(entityCount);
+
+	entities.ForEachChunk<TransformComponent, AngularVelocityComponent>(
+		[&](size_t firstIndex, size_t count, TransformComponent* transforms, AngularVelocityComponent* angularVelocities)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			transforms[i].Rotation = identity;
+			angularVelocities[i].Angular = GetAngularVelocity(firstIndex + i);
+		}
+	});
+
+	startCounter = SDL_GetPerformanceCounter();
+
+	for (int update = 0; update < UpdateCount; update++)
+	{
+		entities.ForEachChunk<TransformComponent, AngularVelocityComponent>(
+			[](size_t, size_t count, TransformComponent* transforms, AngularVelocityComponent* angularVelocities)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				const auto rotation = XMLoadFloat4(&transforms[i].Rotation);
+				const auto angularVelocity = XMLoadFloat3(&angularVelocities[i].Angular);
+
+				XMStoreFloat4(&transforms[i].Rotation, IntegrateRotation(rotation, angularVelocity, DeltaTime));
+			}
+		});
+	}
+
+	const auto sweepSeconds = GetSecondsSince(startCounter) / UpdateCount;
+
+	startCounter = SDL_GetPerformanceCounter();
+
+	for (int update = 0; update < UpdateCount; update++)
+		IntegrateAngularVelocities(entities, jobSystem, DeltaTime);
+
+	const auto parallelSeconds = GetSecondsSince(startCounter) / UpdateCount;
+
+	SDL_Log("Rotation update of %u entities. Objects: %.3f ms, component sweep: %.3f ms (%.1fx), parallel sweep: %.3f ms (%.1fx) on %u threads",
+		static_cast<unsigned int>(entityCount),
+		objectSeconds * 1000.0,
+		sweepSeconds * 1000.0,
+		objectSeconds / sweepSeconds,
+		parallelSeconds * 1000.0,
+		objectSeconds / parallelSeconds,
+		jobSystem.GetThreadCount());
+}
+
+void BenchmarkRotatingInstances(size_t instanceCount, JobSystem& jobSystem)
+{
+	auto blocks = CreateBenchmarkInstances(instanceCount);
+	std::vector<XMFLOAT3X4> worldMatrices(blocks.size() * RotatingInstanceBlockSize);
+
+	// The first update is the first to touch the matrices
+	TimeRotatingInstanceUpdates(blocks, worldMatrices, 1, nullptr);
+
+	const auto serialSeconds = TimeRotatingInstanceUpdates(blocks, worldMatrices, UpdateCount, nullptr);
+	const auto parallelSeconds = TimeRotatingInstanceUpdates(blocks, worldMatrices, UpdateCount, &jobSystem);
+
+	SDL_Log("Rotation kernel on %u instances. One thread: %.3f ms, %.3f instances/ns. %u threads: %.3f ms, %.3f instances/ns per core",
+		static_cast<unsigned int>(instanceCount),
+		serialSeconds * 1000.0,
+		instanceCount / (serialSeconds * 1e9),
+		jobSystem.GetThreadCount(),
+		parallelSeconds * 1000.0,
+		instanceCount / (parallelSeconds * 1e9) / jobSystem.GetThreadCount());
+
+	// Large instance counts mostly measure the memory bandwidth, so the kernel is also timed on data that fits in the cache
+	blocks = CreateBenchmarkInstances(CacheResidentInstanceCount);
+	worldMatrices.resize(blocks.size() * RotatingInstanceBlockSize);
+
+	TimeRotatingInstanceUpdates(blocks, worldMatrices, 1, nullptr);
+	const auto cacheResidentSeconds = TimeRotatingInstanceUpdates(blocks, worldMatrices, CacheResidentUpdateCount, nullptr);
+
+	SDL_Log("Rotation kernel on %u instances in the cache. One thread: %.3f instances/ns",
+		static_cast<unsigned int>(CacheResidentInstanceCount),
+		CacheResidentInstanceCount / (cacheResidentSeconds * 1e9));
+}
+
+void CheckRotationDrift()
+{
+	auto blocks = CreateRotatingInstanceBlocks(RotatingInstanceBlockSize);
+	std::vector<XMFLOAT3X4> worldMatrices(RotatingInstanceBlockSize);
+	auto& block = blocks[0];
+
+	// Slow and fast spins around axes that don't line up with the coordinate axes
+	for (size_t lane = 0; lane < RotatingInstanceBlockSize; lane++)
+	{
+		const auto speed = 0.5f * (lane + 1);
+		const auto axis = XMVector3Normalize(XMVectorSet(std::sin(lane * 1.0f), std::cos(lane * 1.0f), 0.5f, 0.0f));
+
+		XMFLOAT3 angularVelocity;
+		XMStoreFloat3(&angularVelocity, XMVectorScale(axis, speed));
+
+		block.AngularVelocityX[lane] = angularVelocity.x;
+		block.AngularVelocityY[lane] = angularVelocity.y;
+		block.AngularVelocityZ[lane] = angularVelocity.z;
+	}
+
+	double largestLengthError = 0.0;
+
+	for (int step = 0; step < DriftStepCount; step++)
+	{
+		IntegrateRotatingInstances(blocks.data(), 1, DeltaTime, worldMatrices.data());
+
+		for (size_t lane = 0; lane < RotatingInstanceBlockSize; lane++)
+		{
+			const double x = block.RotationX[lane];
+			const double y = block.RotationY[lane];
+			const double z = block.RotationZ[lane];
+			const double w = block.RotationW[lane];
+
+			largestLengthError = std::max(largestLengthError, std::abs(std::sqrt(x * x + y * y + z * z + w * w) - 1.0));
+		}
+	}
+
+	double largestIntegratorAngleError = 0.0;
+	double largestTrueAngleError = 0.0;
+	double largestOrthonormalityError = 0.0;
+
+	for (size_t lane = 0; lane < RotatingInstanceBlockSize; lane++)
+	{
+		const double angularVelocity[3] = { block.AngularVelocityX[lane], block.AngularVelocityY[lane], block.AngularVelocityZ[lane] };
+		const auto speed = std::sqrt(angularVelocity[0] * angularVelocity[0]
+			+ angularVelocity[1] * angularVelocity[1]
+			+ angularVelocity[2] * angularVelocity[2]);
+
+		const double deltaTime = DeltaTime;
+		const auto integratorAngle = DriftStepCount * 2.0 * std::atan(0.5 * speed * deltaTime);
+		const auto trueAngle = DriftStepCount * speed * deltaTime;
+
+		const double rotation[4] = { block.RotationX[lane], block.RotationY[lane], block.RotationZ[lane], block.RotationW[lane] };
+
+		double integratorRotation[4];
+		double trueRotation[4];
+
+		for (int i = 0; i < 3; i++)
+		{
+			integratorRotation[i] = angularVelocity[i] / speed * std::sin(0.5 * integratorAngle);
+			trueRotation[i] = angularVelocity[i] / speed * std::sin(0.5 * trueAngle);
+		}
+
+		integratorRotation[3] = std::cos(0.5 * integratorAngle);
+		trueRotation[3] = std::cos(0.5 * trueAngle);
+
+		largestIntegratorAngleError = std::max(largestIntegratorAngleError, GetAngleBetween(rotation, integratorRotation));
+		largestTrueAngleError = std::max(largestTrueAngleError, GetAngleBetween(rotation, trueRotation));
+
+		// The scale is 1, so the rotation part of the matrix should be orthonormal
+		const auto& matrix = worldMatrices[lane];
+
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				const auto dot = static_cast<double>(matrix.m[0][i]) * matrix.m[0][j]
+					+ static_cast<double>(matrix.m[1][i]) * matrix.m[1][j]
+					+ static_cast<double>(matrix.m[2][i]) * matrix.m[2][j];
+
+				largestOrthonormalityError = std::max(largestOrthonormalityError, std::abs(dot - (i == j ? 1.0 : 0.0)));
+			}
+		}
+	}
+
+	SDL_Log("Rotation drift after %d steps. Largest quaternion length error: %.2e, angle error against the integrator: %.2e rad, against the true rotation: %.2e rad, matrix orthonormality error: %.2e",
+		DriftStepCount,
+		largestLengthError,
+		largestIntegratorAngleError,
+		largestTrueAngleError,
+		largestOrthonormalityError);
+}
@@ -0,0 +1,26 @@
+﻿#pragma once
+
+#include "Threading/JobSystem.h"
+
+#include <cstddef>
+
+/*
+ * Measures updating the rotations of entityCount cubes three ways and logs the results:
+ * One heap allocated object per cube, updated through a pointer each, the same update as a linear sweep over the
+ * Packed component arrays of the entity manager, and the sweep spread over the job system's threads.
+ */
+void BenchmarkEntityUpdate(size_t entityCount, JobSystem& jobSystem);
+
+/*
+ * Measures the SIMD rotation kernel on instanceCount instances, on one thread and on all of the job system's threads,
+ * And logs the throughput in instances per nanosecond per core.
+ */
+void BenchmarkRotatingInstances(size_t instanceCount, JobSystem& jobSystem);
+
+/*
+ * Runs the rotation kernel for a million steps on a block of instances with constant angular velocities and logs how
+ * Far the rotations drifted. Explicit Euler with renormalization turns by 2 * atan(|w| * dt / 2) instead of |w| * dt
+ * Per step, so the rotations are compared both with that exact rotation of the integrator, which leaves only the
+ * Rounding error, and with the true rotation.
+ */
+void CheckRotationDrift();
@@ -0,0 +1,286 @@
+﻿#include "EntityManager.h"
+
+#include "CustomExceptions/Direct3dException.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+
+namespace
+{
+	// Archetype index of destroyed entities
+	const uint32_t NoArchetype = 0xFFFFFFFF;
+
+	size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+namespace EntityDetail
+{
+	ComponentTypeId AllocateComponentTypeId()
+	{
+		static std::atomic<uint32_t> nextComponentTypeId(0);
+
+		const auto id = nextComponentTypeId++;
+
+		if (id >= MaxComponentTypes)
+			throw Direct3dException("Too many component types. At most " + std::to_string(MaxComponentTypes)
+				+ " are supported");
+
+		return id;
+	}
+}
+
+/*
+ * Every chunk starts with the array of entity handles, followed by one array per component type. All arrays have room
+ * For ChunkCapacity entities. Only the last chunk may be partially filled.
+ */
+struct EntityManager::Archetype
+{
+	ComponentMask Mask;
+	// Indexed by component type id
+	size_t ComponentOffsets[MaxComponentTypes];
+	size_t ComponentSizes[MaxComponentTypes];
+	uint32_t ChunkCapacity;
+	uint32_t EntityCount;
+	std::vector<std::unique_ptr<uint8_t[]>> Chunks;
+};
+
+EntityManager::EntityManager()
+	: m_entityCount(0)
+{
+}
+
+EntityManager::~EntityManager()
+{
+}
+
+void EntityManager::DestroyEntity(Entity entity)
+{
+	if (!IsAlive(entity))
+		return;
+
+	auto& record = m_entityRecords[entity.Index];
+	auto& archetype = *m_archetypes[record.ArchetypeIndex];
+
+	// The last entity of the archetype fills the hole, so the chunks stay packed
+	const auto lastIndex = archetype.EntityCount - 1;
+	const auto lastChunkIndex = lastIndex / archetype.ChunkCapacity;
+	const auto lastRow = lastIndex % archetype.ChunkCapacity;
+
+	if (lastChunkIndex != record.ChunkIndex || lastRow != record.Row)
+	{
+		const auto chunk = archetype.Chunks[record.ChunkIndex].get();
+		const auto lastChunk = archetype.Chunks[lastChunkIndex].get();
+
+		const auto movedEntity = reinterpret_cast<Entity*>(lastChunk)[lastRow];
+		reinterpret_cast<Entity*>(chunk)[record.Row] = movedEntity;
+
+		for (ComponentTypeId id = 0; id < MaxComponentTypes; id++)
+		{
+			if ((archetype.Mask & (1u << id)) == 0)
+				continue;
+
+			const auto size = archetype.ComponentSizes[id];
+			const auto offset = archetype.ComponentOffsets[id];
+			std::memcpy(chunk + offset + record.Row * size, lastChunk + offset + lastRow * size, size);
+		}
+
+		auto& movedRecord = m_entityRecords[movedEntity.Index];
+		movedRecord.ChunkIndex = record.ChunkIndex;
+		movedRecord.Row = record.Row;
+	}
+
+	archetype.EntityCount--;
+
+	if (lastRow == 0)
+		archetype.Chunks.pop_back();
+
+	record.ArchetypeIndex = NoArchetype;
+	record.Generation++;
+	m_freeEntityIndices.push_back(entity.Index);
+	m_entityCount--;
+}
+
+bool EntityManager::IsAlive(Entity entity) const
+{
+	return entity.Index < m_entityRecords.size()
+		&& m_entityRecords[entity.Index].Generation == entity.Generation
+		&& m_entityRecords[entity.Index].ArchetypeIndex != NoArchetype;
+}
+
+size_t EntityManager::GetEntityCount() const
+{
+	return m_entityCount;
+}
+
+size_t EntityManager::GetComponentOffset(const Archetype& archetype, ComponentTypeId componentType)
+{
+	return archetype.ComponentOffsets[componentType];
+}
+
+std::vector<Entity> EntityManager::CreateEntities(
+	const ComponentTypeInfo* componentTypes,
+	size_t componentTypeCount,
+	size_t count)
+{
+	const auto archetypeIndex = FindOrCreateArchetype(componentTypes, componentTypeCount);
+	auto& archetype = *m_archetypes[archetypeIndex];
+
+	std::vector<Entity> entities;
+	entities.reserve(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const auto chunkIndex = archetype.EntityCount / archetype.ChunkCapacity;
+		const auto row = archetype.EntityCount % archetype.ChunkCapacity;
+
+		if (chunkIndex == archetype.Chunks.size())
+			archetype.Chunks.emplace_back(new uint8_t[ArchetypeChunkSize]);
+
+		const auto chunk = archetype.Chunks[chunkIndex].get();
+		const auto entity = AllocateEntity();
+
+		reinterpret_cast<Entity*>(chunk)[row] = entity;
+
+		for (size_t j = 0; j < componentTypeCount; j++)
+		{
+			const auto& componentType = componentTypes[j];
+			std::memset(chunk + archetype.ComponentOffsets[componentType.Id] + row * componentType.Size, 0, componentType.Size);
+		}
+
+		m_entityRecords[entity.Index] = EntityRecord{ entity.Generation, archetypeIndex, chunkIndex, row };
+		archetype.EntityCount++;
+
+		entities.push_back(entity);
+	}
+
+	m_entityCount += count;
+
+	return entities;
+}
+
+uint32_t EntityManager::FindOrCreateArchetype(const ComponentTypeInfo* componentTypes, size_t componentTypeCount)
+{
+	ComponentMask mask = 0;
+	for (size_t i = 0; i < componentTypeCount; i++)
+		mask |= 1u << componentTypes[i].Id;
+
+	for (size_t i = 0; i < m_archetypes.size(); i++)
+	{
+		if (m_archetypes[i]->Mask == mask)
+			return static_cast<uint32_t>(i);
+	}
+
+	auto archetype = std::make_unique<Archetype>();
+	archetype->Mask = mask;
+	archetype->EntityCount = 0;
+	std::fill(std::begin(archetype->ComponentOffsets), std::end(archetype->ComponentOffsets), 0);
+	std::fill(std::begin(archetype->ComponentSizes), std::end(archetype->ComponentSizes), 0);
+
+	// Lays the arrays out for the given capacity and returns the bytes they need, including alignment padding
+	const auto layOut = [&](size_t capacity)
+	{
+		auto offset = sizeof(Entity) * capacity;
+
+		for (size_t i = 0; i < componentTypeCount; i++)
+		{
+			const auto& componentType = componentTypes[i];
+
+			offset = AlignUp(offset, componentType.Alignment);
+			archetype->ComponentOffsets[componentType.Id] = offset;
+			archetype->ComponentSizes[componentType.Id] = componentType.Size;
+			offset += componentType.Size * capacity;
+		}
+
+		return offset;
+	};
+
+	auto bytesPerEntity = sizeof(Entity);
+	for (size_t i = 0; i < componentTypeCount; i++)
+		bytesPerEntity += componentTypes[i].Size;
+
+	// The padding between the arrays may cost an entity or two
+	auto capacity = ArchetypeChunkSize / bytesPerEntity;
+	while (capacity > 0 && layOut(capacity) > ArchetypeChunkSize)
+		capacity--;
+
+	if (capacity == 0)
+		throw Direct3dException("The components of an archetype need more than "
+			+ std::to_string(ArchetypeChunkSize) + " bytes per entity");
+
+	layOut(capacity);
+	archetype->ChunkCapacity = static_cast<uint32_t>(capacity);
+
+	m_archetypes.push_back(std::move(archetype));
+
+	return static_cast<uint32_t>(m_archetypes.size() - 1);
+}
+
+Entity EntityManager::AllocateEntity()
+{
+	if (!m_freeEntityIndices.empty())
+	{
+		const auto index = m_freeEntityIndices.back();
+		m_freeEntityIndices.pop_back();
+
+		return Entity{ index, m_entityRecords[index].Generation };
+	}
+
+	m_entityRecords.push_back(EntityRecord{ 0, NoArchetype, 0, 0 });
+
+	return Entity{ static_cast<uint32_t>(m_entityRecords.size() - 1), 0 };
+}
+
+void* EntityManager::GetComponentData(Entity entity, ComponentTypeId componentType)
+{
+	const auto& record = m_entityRecords[entity.Index];
+	const auto& archetype = *m_archetypes[record.ArchetypeIndex];
+
+	return archetype.Chunks[record.ChunkIndex].get()
+		+ archetype.ComponentOffsets[componentType]
+		+ record.Row * archetype.ComponentSizes[componentType];
+}
+
+ComponentMask EntityManager::GetArchetypeMask(Entity entity) const
+{
+	return IsAlive(entity) ? m_archetypes[m_entityRecords[entity.Index].ArchetypeIndex]->Mask : 0;
+}
+
+std::vector<EntityManager::QueryChunk> EntityManager::GatherChunks(ComponentMask mask) const
+{
+	std::vector<QueryChunk> chunks;
+	size_t firstIndex = 0;
+
+	for (const auto& archetype : m_archetypes)
+	{
+		if ((archetype->Mask & mask) != mask)
+			continue;
+
+		for (size_t i = 0; i < archetype->Chunks.size(); i++)
+		{
+			const auto count = std::min<size_t>(archetype->ChunkCapacity, archetype->EntityCount - i * archetype->ChunkCapacity);
+
+			chunks.push_back(QueryChunk{ archetype.get(), archetype->Chunks[i].get(), firstIndex, count });
+			firstIndex += count;
+		}
+	}
+
+	return chunks;
+}
+
+size_t EntityManager::CountEntities(ComponentMask mask) const
+{
+	size_t count = 0;
+
+	for (const auto& archetype : m_archetypes)
+	{
+		if ((archetype->Mask & mask) == mask)
+			count += archetype->EntityCount;
+	}
+
+	return count;
+}
@@ -0,0 +1,195 @@
+﻿#pragma once
+
+#include "Threading/JobSystem.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+struct Entity
+{
+	uint32_t Index;
+	// Incremented whenever an index is reused, so handles to destroyed entities can be told apart from live ones
+	uint32_t Generation;
+};
+
+typedef uint32_t ComponentTypeId;
+
+// One bit per component type
+typedef uint32_t ComponentMask;
+
+const uint32_t MaxComponentTypes = 32;
+
+// Entities are stored in chunks of this many bytes
+const size_t ArchetypeChunkSize = 16 * 1024;
+
+struct ComponentTypeInfo
+{
+	ComponentTypeId Id;
+	size_t Size;
+	size_t Alignment;
+};
+
+namespace EntityDetail
+{
+	ComponentTypeId AllocateComponentTypeId();
+}
+
+// Component types are numbered the first time they are used
+template<typename TComponent>
+ComponentTypeId GetComponentTypeId()
+{
+	static const auto id = EntityDetail::AllocateComponentTypeId();
+	return id;
+}
+
+template<typename TComponent>
+ComponentTypeInfo GetComponentTypeInfo()
+{
+	// Components are moved between chunks with memcpy and are never constructed or destroyed
+	static_assert(std::is_trivially_copyable<TComponent>::value, "Components must be trivially copyable");
+	static_assert(alignof(TComponent) <= alignof(std::max_align_t), "Components can't be over-aligned");
+
+	return ComponentTypeInfo{ GetComponentTypeId<TComponent>(), sizeof(TComponent), alignof(TComponent) };
+}
+
+template<typename... TComponents>
+ComponentMask GetComponentMask()
+{
+	const ComponentTypeId ids[] = { GetComponentTypeId<TComponents>()... };
+
+	ComponentMask mask = 0;
+	for (const auto id : ids)
+		mask |= 1u << id;
+
+	return mask;
+}
+
+/*
+ * Stores entities and their components by archetype - the set of component types an entity has.
+ *
+ * Every archetype stores its entities in chunks of ArchetypeChunkSize bytes. Within a chunk, every component type
+ * Has its own tightly packed array (structure of arrays), so a system that only reads transforms and angular
+ * Velocities streams through exactly those two arrays, and every cache line it loads is full of data it uses.
+ * Entities of an archetype are kept packed at the front of its chunks: destroying an entity moves the last entity
+ * Of the archetype into the hole.
+ *
+ * Systems iterate with ForEachChunk, which hands whole chunks to the job system's threads. Creating and destroying
+ * Entities invalidates component pointers, and must not happen while systems are running.
+ */
+class EntityManager
+{
+public:
+	EntityManager();
+	~EntityManager();
+
+	EntityManager(const EntityManager&) = delete;
+	EntityManager& operator=(const EntityManager&) = delete;
+
+	// Creates entities with the given components, which start out zeroed
+	template<typename... TComponents>
+	std::vector<Entity> CreateEntities(size_t count)
+	{
+		const ComponentTypeInfo componentTypes[] = { GetComponentTypeInfo<TComponents>()... };
+		return CreateEntities(componentTypes, sizeof...(TComponents), count);
+	}
+
+	void DestroyEntity(Entity entity);
+	bool IsAlive(Entity entity) const;
+
+	size_t GetEntityCount() const;
+
+	// The entity must be alive and have the component
+	template<typename TComponent>
+	TComponent& GetComponent(Entity entity)
+	{
+		return *static_cast<TComponent*>(GetComponentData(entity, GetComponentTypeId<TComponent>()));
+	}
+
+	template<typename TComponent>
+	bool HasComponent(Entity entity) const
+	{
+		return (GetArchetypeMask(entity) & (1u << GetComponentTypeId<TComponent>())) != 0;
+	}
+
+	/*
+	 * Calls function(firstIndex, count, TComponents*...) for every chunk of every archetype that has all of the given
+	 * Components, with the component arrays of the chunk's count entities.
+	 *
+	 * firstIndex numbers the entities of the query consecutively, chunk after chunk, so systems can write per entity
+	 * Results into a flat array. The numbering stays the same as long as no entities are created or destroyed.
+	 * Chunks are spread over the job system's threads, so the function may only write to the chunk it was given.
+	 */
+	template<typename... TComponents, typename TFunction>
+	void ForEachChunk(JobSystem& jobSystem, TFunction function)
+	{
+		const auto chunks = GatherChunks(GetComponentMask<TComponents...>());
+
+		jobSystem.ParallelFor(chunks.size(), 1, [&](size_t begin, size_t end)
+		{
+			for (auto i = begin; i < end; i++)
+				function(chunks[i].FirstIndex, chunks[i].Count, GetComponentArray<TComponents>(chunks[i])...);
+		});
+	}
+
+	// Iterates the chunks on the calling thread, in the same order
+	template<typename... TComponents, typename TFunction>
+	void ForEachChunk(TFunction function)
+	{
+		for (const auto& chunk : GatherChunks(GetComponentMask<TComponents...>()))
+			function(chunk.FirstIndex, chunk.Count, GetComponentArray<TComponents>(chunk)...);
+	}
+
+	// Number of entities that have all of the given components
+	template<typename... TComponents>
+	size_t CountEntities() const
+	{
+		return CountEntities(GetComponentMask<TComponents...>());
+	}
+
+private:
+	struct Archetype;
+
+	// A chunk of an archetype as seen by a query
+	struct QueryChunk
+	{
+		const Archetype* Owner;
+		uint8_t* Data;
+		size_t FirstIndex;
+		size_t Count;
+	};
+
+	struct EntityRecord
+	{
+		uint32_t Generation;
+		uint32_t ArchetypeIndex;
+		uint32_t ChunkIndex;
+		uint32_t Row;
+	};
+
+	template<typename TComponent>
+	static TComponent* GetComponentArray(const QueryChunk& chunk)
+	{
+		return reinterpret_cast<TComponent*>(chunk.Data + GetComponentOffset(*chunk.Owner, GetComponentTypeId<TComponent>()));
+	}
+
+	static size_t GetComponentOffset(const Archetype& archetype, ComponentTypeId componentType);
+
+	std::vector<Entity> CreateEntities(const ComponentTypeInfo* componentTypes, size_t componentTypeCount, size_t count);
+	uint32_t FindOrCreateArchetype(const ComponentTypeInfo* componentTypes, size_t componentTypeCount);
+	Entity AllocateEntity();
+
+	void* GetComponentData(Entity entity, ComponentTypeId componentType);
+	ComponentMask GetArchetypeMask(Entity entity) const;
+
+	std::vector<QueryChunk> GatherChunks(ComponentMask mask) const;
+	size_t CountEntities(ComponentMask mask) const;
+
+	std::vector<std::unique_ptr<Archetype>> m_archetypes;
+	std::vector<EntityRecord> m_entityRecords;
+	// Indices of destroyed entities, reused before new indices are added
+	std::vector<uint32_t> m_freeEntityIndices;
+	size_t m_entityCount;
+};
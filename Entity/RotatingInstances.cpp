@@ -0,0 +1,143 @@
+﻿#include "RotatingInstances.h"
+
+#include <algorithm>
+
+// SSE is available on every CPU that can run Direct3D 11. The project isn't built for AVX, so a block of eight
+// Instances is two SSE vectors of four.
+#include <xmmintrin.h>
+
+using namespace DirectX;
+
+std::vector<RotatingInstanceBlock> CreateRotatingInstanceBlocks(size_t instanceCount)
+{
+	const auto blockCount = (instanceCount + RotatingInstanceBlockSize - 1) / RotatingInstanceBlockSize;
+
+	RotatingInstanceBlock identity = {};
+	std::fill(std::begin(identity.Scale), std::end(identity.Scale), 1.0f);
+	std::fill(std::begin(identity.RotationW), std::end(identity.RotationW), 1.0f);
+
+	return std::vector<RotatingInstanceBlock>(blockCount, identity);
+}
+
+void IntegrateRotatingInstances(
+	RotatingInstanceBlock* blocks,
+	size_t blockCount,
+	float deltaTime,
+	XMFLOAT3X4* worldMatrices)
+{
+	const auto halfDeltaTime = _mm_set1_ps(0.5f * deltaTime);
+	const auto half = _mm_set1_ps(0.5f);
+	const auto three = _mm_set1_ps(3.0f);
+
+	for (size_t blockIndex = 0; blockIndex < blockCount; blockIndex++)
+	{
+		auto& block = blocks[blockIndex];
+
+		// The two halves don't depend on each other, so the compiler can interleave their instructions and hide the
+		// Latency of the multiplications
+		for (size_t lane = 0; lane < RotatingInstanceBlockSize; lane += 4)
+		{
+			auto x = _mm_loadu_ps(block.RotationX + lane);
+			auto y = _mm_loadu_ps(block.RotationY + lane);
+			auto z = _mm_loadu_ps(block.RotationZ + lane);
+			auto w = _mm_loadu_ps(block.RotationW + lane);
+
+			const auto halfAngleX = _mm_mul_ps(_mm_loadu_ps(block.AngularVelocityX + lane), halfDeltaTime);
+			const auto halfAngleY = _mm_mul_ps(_mm_loadu_ps(block.AngularVelocityY + lane), halfDeltaTime);
+			const auto halfAngleZ = _mm_mul_ps(_mm_loadu_ps(block.AngularVelocityZ + lane), halfDeltaTime);
+
+			// q += 0.5 * dt * (w, 0) * q, written out component by component
+			const auto deltaX = _mm_add_ps(_mm_mul_ps(w, halfAngleX), _mm_sub_ps(_mm_mul_ps(halfAngleY, z), _mm_mul_ps(halfAngleZ, y)));
+			const auto deltaY = _mm_add_ps(_mm_mul_ps(w, halfAngleY), _mm_sub_ps(_mm_mul_ps(halfAngleZ, x), _mm_mul_ps(halfAngleX, z)));
+			const auto deltaZ = _mm_add_ps(_mm_mul_ps(w, halfAngleZ), _mm_sub_ps(_mm_mul_ps(halfAngleX, y), _mm_mul_ps(halfAngleY, x)));
+			const auto deltaW = _mm_add_ps(_mm_mul_ps(halfAngleX, x), _mm_add_ps(_mm_mul_ps(halfAngleY, y), _mm_mul_ps(halfAngleZ, z)));
+
+			x = _mm_add_ps(x, deltaX);
+			y = _mm_add_ps(y, deltaY);
+			z = _mm_add_ps(z, deltaZ);
+			w = _mm_sub_ps(w, deltaW);
+
+			// The reciprocal square root estimate is only good to 12 bits. One Newton-Raphson step brings it close to
+			// Full precision, which is still cheaper than a square root and a division.
+			const auto lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+			const auto estimate = _mm_rsqrt_ps(lengthSquared);
+			const auto inverseLength = _mm_mul_ps(_mm_mul_ps(half, estimate),
+				_mm_sub_ps(three, _mm_mul_ps(_mm_mul_ps(lengthSquared, estimate), estimate)));
+
+			x = _mm_mul_ps(x, inverseLength);
+			y = _mm_mul_ps(y, inverseLength);
+			z = _mm_mul_ps(z, inverseLength);
+			w = _mm_mul_ps(w, inverseLength);
+
+			_mm_storeu_ps(block.RotationX + lane, x);
+			_mm_storeu_ps(block.RotationY + lane, y);
+			_mm_storeu_ps(block.RotationZ + lane, z);
+			_mm_storeu_ps(block.RotationW + lane, w);
+
+			// The rotation matrix of a unit quaternion, scaled, as XMMatrixRotationQuaternion builds it but transposed
+			const auto scale = _mm_loadu_ps(block.Scale + lane);
+			const auto twiceScale = _mm_add_ps(scale, scale);
+
+			const auto xx = _mm_mul_ps(x, x);
+			const auto yy = _mm_mul_ps(y, y);
+			const auto zz = _mm_mul_ps(z, z);
+			const auto xy = _mm_mul_ps(x, y);
+			const auto xz = _mm_mul_ps(x, z);
+			const auto yz = _mm_mul_ps(y, z);
+			const auto xw = _mm_mul_ps(x, w);
+			const auto yw = _mm_mul_ps(y, w);
+			const auto zw = _mm_mul_ps(z, w);
+
+			auto m00 = _mm_sub_ps(scale, _mm_mul_ps(twiceScale, _mm_add_ps(yy, zz)));
+			auto m01 = _mm_mul_ps(twiceScale, _mm_sub_ps(xy, zw));
+			auto m02 = _mm_mul_ps(twiceScale, _mm_add_ps(xz, yw));
+			auto m03 = _mm_loadu_ps(block.PositionX + lane);
+
+			auto m10 = _mm_mul_ps(twiceScale, _mm_add_ps(xy, zw));
+			auto m11 = _mm_sub_ps(scale, _mm_mul_ps(twiceScale, _mm_add_ps(xx, zz)));
+			auto m12 = _mm_mul_ps(twiceScale, _mm_sub_ps(yz, xw));
+			auto m13 = _mm_loadu_ps(block.PositionY + lane);
+
+			auto m20 = _mm_mul_ps(twiceScale, _mm_sub_ps(xz, yw));
+			auto m21 = _mm_mul_ps(twiceScale, _mm_add_ps(yz, xw));
+			auto m22 = _mm_sub_ps(scale, _mm_mul_ps(twiceScale, _mm_add_ps(xx, yy)));
+			auto m23 = _mm_loadu_ps(block.PositionZ + lane);
+
+			// Every register holds one element of four matrices. Transposing four registers turns them into one row
+			// Of each matrix.
+			_MM_TRANSPOSE4_PS(m00, m01, m02, m03);
+			_MM_TRANSPOSE4_PS(m10, m11, m12, m13);
+			_MM_TRANSPOSE4_PS(m20, m21, m22, m23);
+
+			const auto matrices = worldMatrices + blockIndex * RotatingInstanceBlockSize + lane;
+
+			_mm_storeu_ps(matrices[0].m[0], m00);
+			_mm_storeu_ps(matrices[0].m[1], m10);
+			_mm_storeu_ps(matrices[0].m[2], m20);
+			_mm_storeu_ps(matrices[1].m[0], m01);
+			_mm_storeu_ps(matrices[1].m[1], m11);
+			_mm_storeu_ps(matrices[1].m[2], m21);
+			_mm_storeu_ps(matrices[2].m[0], m02);
+			_mm_storeu_ps(matrices[2].m[1], m12);
+			_mm_storeu_ps(matrices[2].m[2], m22);
+			_mm_storeu_ps(matrices[3].m[0], m03);
+			_mm_storeu_ps(matrices[3].m[1], m13);
+			_mm_storeu_ps(matrices[3].m[2], m23);
+		}
+	}
+}
+
+void IntegrateRotatingInstances(
+	RotatingInstanceBlock* blocks,
+	size_t blockCount,
+	float deltaTime,
+	XMFLOAT3X4* worldMatrices,
+	JobSystem& jobSystem)
+{
+	const auto blocksPerJob = std::max<size_t>(1, blockCount / (jobSystem.GetThreadCount() * 4));
+
+	jobSystem.ParallelFor(blockCount, blocksPerJob, [=](size_t begin, size_t end)
+	{
+		IntegrateRotatingInstances(blocks + begin, end - begin, deltaTime, worldMatrices + begin * RotatingInstanceBlockSize);
+	});
+}
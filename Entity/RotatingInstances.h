@@ -0,0 +1,57 @@
+﻿#pragma once
+
+#include "Threading/JobSystem.h"
+
+#include <DirectXMath.h>
+
+#include <cstddef>
+#include <vector>
+
+// Instances per block, which is also how many instances the kernel works on at once
+const size_t RotatingInstanceBlockSize = 8;
+
+/*
+ * Eight instances that spin around their own origin, stored component by component (structure of arrays), so a SIMD
+ * Register holds the same component of several instances and every instruction works on all of them.
+ * Unused instances of the last block keep an identity rotation and a zero angular velocity.
+ */
+struct RotatingInstanceBlock
+{
+	float PositionX[RotatingInstanceBlockSize];
+	float PositionY[RotatingInstanceBlockSize];
+	float PositionZ[RotatingInstanceBlockSize];
+	float Scale[RotatingInstanceBlockSize];
+	float RotationX[RotatingInstanceBlockSize];
+	float RotationY[RotatingInstanceBlockSize];
+	float RotationZ[RotatingInstanceBlockSize];
+	float RotationW[RotatingInstanceBlockSize];
+	// In radians per second, in the same space as the rotation, which is world space since the instances have no parent
+	float AngularVelocityX[RotatingInstanceBlockSize];
+	float AngularVelocityY[RotatingInstanceBlockSize];
+	float AngularVelocityZ[RotatingInstanceBlockSize];
+};
+
+// Enough blocks for instanceCount instances, all at the origin with scale 1, an identity rotation and no angular velocity
+std::vector<RotatingInstanceBlock> CreateRotatingInstanceBlocks(size_t instanceCount);
+
+/*
+ * Does what IntegrateRotation does for every instance, renormalizes the rotations and writes the transposed world
+ * Matrices (scale, then rotation, then translation) of the instances, eight per block, so worldMatrices needs room
+ * For blockCount * RotatingInstanceBlockSize matrices.
+ *
+ * The bottom row of a transposed world matrix is always (0, 0, 0, 1), so it is left out. The shaders can read
+ * The matrices as float3x4.
+ */
+void IntegrateRotatingInstances(
+	RotatingInstanceBlock* blocks,
+	size_t blockCount,
+	float deltaTime,
+	DirectX::XMFLOAT3X4* worldMatrices);
+
+// Same as above, with the blocks spread over the job system's threads
+void IntegrateRotatingInstances(
+	RotatingInstanceBlock* blocks,
+	size_t blockCount,
+	float deltaTime,
+	DirectX::XMFLOAT3X4* worldMatrices,
+	JobSystem& jobSystem);
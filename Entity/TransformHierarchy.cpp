@@ -0,0 +1,179 @@
+﻿#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace DirectX;
+
+namespace
+{
+	// Parent index of roots
+	const uint32_t NoParent = 0xFFFFFFFF;
+
+	XMMATRIX XM_CALLCONV ComputeLocalMatrix(const TransformComponent& transform)
+	{
+		return XMMatrixScaling(transform.Scale, transform.Scale, transform.Scale)
+			* XMMatrixRotationQuaternion(XMLoadFloat4(&transform.Rotation))
+			* XMMatrixTranslationFromVector(XMLoadFloat3(&transform.Position));
+	}
+}
+
+TransformHierarchy::TransformHierarchy()
+	: m_nodesAdded(false),
+	m_updatedNodeCount(0)
+{
+}
+
+TransformNode TransformHierarchy::AddNode(TransformNode parent, const TransformComponent& localTransform)
+{
+	const auto node = static_cast<TransformNode>(m_parentNodes.size());
+
+	// Appending keeps parents in front of their children. Only the grouping by root has to wait for SortNodes.
+	m_parentNodes.push_back(parent);
+	m_nodeIndices.push_back(static_cast<uint32_t>(m_localTransforms.size()));
+	m_parentIndices.push_back(parent != NoTransformNode ? m_nodeIndices[parent] : NoParent);
+	m_localTransforms.push_back(localTransform);
+	m_worldMatrices.emplace_back();
+	m_dirtyFlags.push_back(1);
+
+	m_nodesAdded = true;
+
+	return node;
+}
+
+void TransformHierarchy::SetLocalTransform(TransformNode node, const TransformComponent& localTransform)
+{
+	const auto index = m_nodeIndices[node];
+
+	m_localTransforms[index] = localTransform;
+	m_dirtyFlags[index] = 1;
+}
+
+const TransformComponent& TransformHierarchy::GetLocalTransform(TransformNode node) const
+{
+	return m_localTransforms[m_nodeIndices[node]];
+}
+
+const XMFLOAT4X4& TransformHierarchy::GetWorldMatrix(TransformNode node) const
+{
+	return m_worldMatrices[m_nodeIndices[node]];
+}
+
+void TransformHierarchy::UpdateWorldMatrices(JobSystem& jobSystem)
+{
+	if (m_nodesAdded)
+	{
+		SortNodes();
+		m_nodesAdded = false;
+	}
+
+	m_updatedNodeCount = 0;
+
+	// Hierarchies are often many small trees, so every job takes a few of them
+	const auto subtreesPerJob = std::max<size_t>(1, m_subtrees.size() / (jobSystem.GetThreadCount() * 4));
+
+	jobSystem.ParallelFor(m_subtrees.size(), subtreesPerJob, [this](size_t begin, size_t end)
+	{
+		uint32_t updatedNodeCount = 0;
+
+		for (auto subtreeIndex = begin; subtreeIndex < end; subtreeIndex++)
+		{
+			const auto& subtree = m_subtrees[subtreeIndex];
+			const auto subtreeStartCount = updatedNodeCount;
+
+			for (auto i = subtree.Begin; i < subtree.End; i++)
+			{
+				const auto parent = m_parentIndices[i];
+
+				if (parent != NoParent && m_dirtyFlags[parent])
+					m_dirtyFlags[i] = 1;
+
+				if (!m_dirtyFlags[i])
+					continue;
+
+				auto world = ComputeLocalMatrix(m_localTransforms[i]);
+
+				if (parent != NoParent)
+					world = world * XMLoadFloat4x4(&m_worldMatrices[parent]);
+
+				XMStoreFloat4x4(&m_worldMatrices[i], world);
+				updatedNodeCount++;
+			}
+
+			// The children have to see their parent's flag, so the flags are only cleared once the subtree is done
+			if (updatedNodeCount != subtreeStartCount)
+				std::fill(m_dirtyFlags.begin() + subtree.Begin, m_dirtyFlags.begin() + subtree.End, 0);
+		}
+
+		m_updatedNodeCount += updatedNodeCount;
+	});
+}
+
+size_t TransformHierarchy::GetNodeCount() const
+{
+	return m_parentNodes.size();
+}
+
+uint32_t TransformHierarchy::GetUpdatedNodeCount() const
+{
+	return m_updatedNodeCount;
+}
+
+void TransformHierarchy::SortNodes()
+{
+	const auto nodeCount = m_parentNodes.size();
+
+	// Parents are added before their children, so one pass in handle order finds the root and depth of every node
+	std::vector<TransformNode> roots(nodeCount);
+	std::vector<uint32_t> depths(nodeCount);
+
+	for (TransformNode node = 0; node < nodeCount; node++)
+	{
+		const auto parent = m_parentNodes[node];
+
+		roots[node] = parent != NoTransformNode ? roots[parent] : node;
+		depths[node] = parent != NoTransformNode ? depths[parent] + 1 : 0;
+	}
+
+	std::vector<TransformNode> order(nodeCount);
+	std::iota(order.begin(), order.end(), 0);
+
+	std::stable_sort(order.begin(), order.end(), [&](TransformNode a, TransformNode b)
+	{
+		return roots[a] != roots[b] ? roots[a] < roots[b] : depths[a] < depths[b];
+	});
+
+	std::vector<uint32_t> nodeIndices(nodeCount);
+	for (uint32_t i = 0; i < nodeCount; i++)
+		nodeIndices[order[i]] = i;
+
+	std::vector<uint32_t> parentIndices(nodeCount);
+	std::vector<TransformComponent> localTransforms(nodeCount);
+	std::vector<XMFLOAT4X4> worldMatrices(nodeCount);
+	std::vector<uint8_t> dirtyFlags(nodeCount);
+
+	m_subtrees.clear();
+
+	for (uint32_t i = 0; i < nodeCount; i++)
+	{
+		const auto node = order[i];
+		const auto oldIndex = m_nodeIndices[node];
+		const auto parent = m_parentNodes[node];
+
+		parentIndices[i] = parent != NoTransformNode ? nodeIndices[parent] : NoParent;
+		localTransforms[i] = m_localTransforms[oldIndex];
+		worldMatrices[i] = m_worldMatrices[oldIndex];
+		dirtyFlags[i] = m_dirtyFlags[oldIndex];
+
+		if (parent == NoTransformNode)
+			m_subtrees.push_back(Subtree{ i, i });
+
+		m_subtrees.back().End = i + 1;
+	}
+
+	m_nodeIndices.swap(nodeIndices);
+	m_parentIndices.swap(parentIndices);
+	m_localTransforms.swap(localTransforms);
+	m_worldMatrices.swap(worldMatrices);
+	m_dirtyFlags.swap(dirtyFlags);
+}
@@ -0,0 +1,75 @@
+﻿#pragma once
+
+#include "Entity/Components.h"
+#include "Threading/JobSystem.h"
+
+#include <DirectXMath.h>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Identifies a node of a transform hierarchy. Handles stay valid when the hierarchy reorders its nodes.
+typedef uint32_t TransformNode;
+
+const TransformNode NoTransformNode = 0xFFFFFFFF;
+
+/*
+ * A forest of transforms, where the world matrix of every node is its local transform followed by the world matrix
+ * Of its parent.
+ *
+ * Nodes are stored in flat arrays, grouped by root: every root's subtree is a contiguous range, and within the range
+ * Nodes are sorted by depth, so a parent always comes before its children. Updating a subtree is a single forward
+ * Sweep in which every parent's world matrix is already final when its children need it, and different subtrees
+ * Don't share any data, so they are updated in parallel.
+ *
+ * Changing a local transform marks the node dirty. The sweep passes the flag on from parents to children, and only
+ * Recomputes the world matrices of dirty nodes, so subtrees where nothing moved cost one flag test per node.
+ */
+class TransformHierarchy
+{
+public:
+	TransformHierarchy();
+
+	// Adds a root if parent is NoTransformNode. The parent must already exist.
+	TransformNode AddNode(TransformNode parent, const TransformComponent& localTransform);
+
+	// May be called for different nodes from several threads at once, but not during UpdateWorldMatrices
+	void SetLocalTransform(TransformNode node, const TransformComponent& localTransform);
+	const TransformComponent& GetLocalTransform(TransformNode node) const;
+
+	// Valid after the next UpdateWorldMatrices call
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(TransformNode node) const;
+
+	// Recomputes the world matrices of all dirty nodes and their descendants, one root subtree per job
+	void UpdateWorldMatrices(JobSystem& jobSystem);
+
+	size_t GetNodeCount() const;
+
+	// World matrices recomputed by the last UpdateWorldMatrices call
+	uint32_t GetUpdatedNodeCount() const;
+
+private:
+	struct Subtree
+	{
+		uint32_t Begin;
+		uint32_t End;
+	};
+
+	// Sorts the nodes by root and depth after nodes have been added
+	void SortNodes();
+
+	// Indexed by handle
+	std::vector<TransformNode> m_parentNodes;
+	std::vector<uint32_t> m_nodeIndices;
+
+	// Indexed by position in the sorted order
+	std::vector<uint32_t> m_parentIndices;
+	std::vector<TransformComponent> m_localTransforms;
+	std::vector<DirectX::XMFLOAT4X4> m_worldMatrices;
+	std::vector<uint8_t> m_dirtyFlags;
+
+	std::vector<Subtree> m_subtrees;
+	bool m_nodesAdded;
+	std::atomic<uint32_t> m_updatedNodeCount;
+};
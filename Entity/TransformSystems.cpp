@@ -0,0 +1,30 @@
+﻿#include "TransformSystems.h"
+
+#include "Entity/Components.h"
+
+using namespace DirectX;
+
+void IntegrateAngularVelocities(EntityManager& entities, JobSystem& jobSystem, float deltaTime)
+{
+	entities.ForEachChunk<TransformComponent, AngularVelocityComponent>(jobSystem,
+		[=](size_t, size_t count, TransformComponent* transforms, AngularVelocityComponent* angularVelocities)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			const auto rotation = XMLoadFloat4(&transforms[i].Rotation);
+			const auto angularVelocity = XMLoadFloat3(&angularVelocities[i].Angular);
+
+			XMStoreFloat4(&transforms[i].Rotation, IntegrateRotation(rotation, angularVelocity, deltaTime));
+		}
+	});
+}
+
+void CopyTransformsToHierarchy(EntityManager& entities, JobSystem& jobSystem, TransformHierarchy& hierarchy)
+{
+	entities.ForEachChunk<TransformComponent, TransformNodeComponent>(jobSystem,
+		[&](size_t, size_t count, TransformComponent* transforms, TransformNodeComponent* nodes)
+	{
+		for (size_t i = 0; i < count; i++)
+			hierarchy.SetLocalTransform(nodes[i].Node, transforms[i]);
+	});
+}
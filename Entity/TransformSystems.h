@@ -0,0 +1,31 @@
+﻿#pragma once
+
+#include "Entity/EntityManager.h"
+#include "Entity/TransformHierarchy.h"
+#include "Threading/JobSystem.h"
+
+#include <DirectXMath.h>
+
+/*
+ * Advances a rotation by an angular velocity, integrating dq/dt = 0.5 * w * q with one explicit Euler step.
+ * The result is renormalized, and stays accurate as long as the rotation per step is small.
+ */
+inline DirectX::XMVECTOR XM_CALLCONV IntegrateRotation(
+	DirectX::FXMVECTOR rotation,
+	DirectX::FXMVECTOR angularVelocity,
+	float deltaTime)
+{
+	using namespace DirectX;
+
+	// XMQuaternionMultiply(q1, q2) is q2 * q1, so this is the angular velocity times the rotation, which makes the
+	// Angular velocity relative to the space the rotation is in rather than to the rotated object
+	const auto spin = XMQuaternionMultiply(rotation, XMVectorAndInt(angularVelocity, g_XMMask3));
+
+	return XMQuaternionNormalize(XMVectorMultiplyAdd(spin, XMVectorReplicate(0.5f * deltaTime), rotation));
+}
+
+// Rotates every entity that has an angular velocity
+void IntegrateAngularVelocities(EntityManager& entities, JobSystem& jobSystem, float deltaTime);
+
+// Hands the transforms of the entities that have a transform node to the hierarchy, which marks those nodes dirty
+void CopyTransformsToHierarchy(EntityManager& entities, JobSystem& jobSystem, TransformHierarchy& hierarchy);
@@ -0,0 +1,234 @@
+﻿#include "GpuMesh.h"
+
+#include "CustomExceptions/Direct3dException.h"
+
+namespace
+{
+	// The byte width must be a multiple of 4, since raw views address the buffer in 32-bit words
+	Microsoft::WRL::ComPtr<ID3D11Buffer> CreateImmutableBuffer(
+		ID3D11Device* device,
+		const void* data,
+		UINT byteWidth,
+		UINT bindFlags)
+	{
+		D3D11_BUFFER_DESC bufferDesc;
+		bufferDesc.ByteWidth = byteWidth;
+		// The mesh never changes after it has been uploaded, which lets the driver
+		// Place it in the fastest memory available to the GPU
+		bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		bufferDesc.BindFlags = bindFlags | D3D11_BIND_SHADER_RESOURCE;
+		bufferDesc.CPUAccessFlags = 0;
+		bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		bufferDesc.StructureByteStride = 0;
+
+		D3D11_SUBRESOURCE_DATA initialData;
+		initialData.pSysMem = data;
+		initialData.SysMemPitch = 0;
+		initialData.SysMemSlicePitch = 0;
+
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+		const auto bufferCreationResult = device->CreateBuffer(&bufferDesc, &initialData, buffer.GetAddressOf());
+
+		if (bufferCreationResult != S_OK)
+			throw Direct3dException("Failed to create mesh buffer. Error code: "
+				+ std::to_string(bufferCreationResult));
+
+		return buffer;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateRawBufferView(ID3D11Device* device, ID3D11Buffer* buffer)
+	{
+		D3D11_BUFFER_DESC bufferDesc;
+		buffer->GetDesc(&bufferDesc);
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+		viewDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+		viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFEREX;
+		viewDesc.BufferEx.FirstElement = 0;
+		viewDesc.BufferEx.NumElements = bufferDesc.ByteWidth / 4;
+		viewDesc.BufferEx.Flags = D3D11_BUFFEREX_SRV_FLAG_RAW;
+
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> view;
+		const auto viewCreationResult = device->CreateShaderResourceView(buffer, &viewDesc, view.GetAddressOf());
+
+		if (viewCreationResult != S_OK)
+			throw Direct3dException("Failed to create raw mesh buffer view. Error code: "
+				+ std::to_string(viewCreationResult));
+
+		return view;
+	}
+}
+
+GpuMesh::GpuMesh(
+	ID3D11Device* device,
+	const void* vertices,
+	UINT vertexCount,
+	UINT vertexStride,
+	const void* indices,
+	UINT indexCount,
+	DXGI_FORMAT indexFormat,
+	const MeshLod* lods,
+	UINT lodCount)
+{
+	CreateBuffers(device, vertices, vertexCount, vertexStride, indices, indexCount, indexFormat);
+	SetLods(lods, lodCount);
+}
+
+void GpuMesh::SetLods(const MeshLod* lods, UINT lodCount)
+{
+	if (lodCount > 0)
+		m_lods.assign(lods, lods + lodCount);
+	else
+		m_lods.assign(1, MeshLod{ 0, m_indexCount, 0.0f });
+}
+
+void GpuMesh::CreateBuffers(
+	ID3D11Device* device,
+	const void* vertices,
+	UINT vertexCount,
+	UINT vertexStride,
+	const std::vector<uint32_t>& indices)
+{
+	if (vertexCount <= 0xFFFF)
+	{
+		std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+
+		// Pad to a whole number of 32-bit words. The padding index is never drawn.
+		if (shortIndices.size() % 2 != 0)
+			shortIndices.push_back(0);
+
+		CreateBuffers(
+			device,
+			vertices,
+			vertexCount,
+			vertexStride,
+			shortIndices.data(),
+			static_cast<UINT>(indices.size()),
+			DXGI_FORMAT_R16_UINT);
+	}
+	else
+	{
+		CreateBuffers(
+			device,
+			vertices,
+			vertexCount,
+			vertexStride,
+			indices.data(),
+			static_cast<UINT>(indices.size()),
+			DXGI_FORMAT_R32_UINT);
+	}
+}
+
+void GpuMesh::CreateBuffers(
+	ID3D11Device* device,
+	const void* vertices,
+	UINT vertexCount,
+	UINT vertexStride,
+	const void* indices,
+	UINT indexCount,
+	DXGI_FORMAT indexFormat)
+{
+	m_vertexStride = vertexStride;
+	m_indexCount = indexCount;
+	m_indexFormat = indexFormat;
+
+	// Vertex strides are multiples of 4 for every vertex definition, so no padding is needed
+	m_vertexBuffer = CreateImmutableBuffer(device, vertices, vertexCount * vertexStride, D3D11_BIND_VERTEX_BUFFER);
+
+	// 16-bit indices are rounded up to the padding the caller provides
+	const auto indexBufferSize = indexFormat == DXGI_FORMAT_R16_UINT
+		? (indexCount + 1) / 2 * 4
+		: indexCount * 4;
+
+	m_indexBuffer = CreateImmutableBuffer(device, indices, indexBufferSize, D3D11_BIND_INDEX_BUFFER);
+
+	m_vertexBufferView = CreateRawBufferView(device, m_vertexBuffer.Get());
+	m_indexBufferView = CreateRawBufferView(device, m_indexBuffer.Get());
+
+	D3D11_BUFFER_DESC constantBufferDesc = {};
+	constantBufferDesc.ByteWidth = sizeof(PerDrawConstants);
+	constantBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	constantBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+	const auto constantBufferCreationResult =
+		device->CreateBuffer(&constantBufferDesc, nullptr, m_perDrawConstantBuffer.GetAddressOf());
+
+	if (constantBufferCreationResult != S_OK)
+		throw Direct3dException("Failed to create per draw constant buffer. Error code: "
+			+ std::to_string(constantBufferCreationResult));
+}
+
+void GpuMesh::Bind(ID3D11DeviceContext* deviceContext) const
+{
+	const UINT offset = 0;
+	deviceContext->IASetVertexBuffers(0, 1, m_vertexBuffer.GetAddressOf(), &m_vertexStride, &offset);
+	deviceContext->IASetIndexBuffer(m_indexBuffer.Get(), m_indexFormat, 0);
+	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+void GpuMesh::Draw(ID3D11DeviceContext* deviceContext) const
+{
+	DrawLodInstanced(deviceContext, 0, 0, 1);
+}
+
+void GpuMesh::DrawInstanced(ID3D11DeviceContext* deviceContext, UINT instanceCount) const
+{
+	DrawLodInstanced(deviceContext, 0, 0, instanceCount);
+}
+
+void GpuMesh::DrawLodInstanced(ID3D11DeviceContext* deviceContext, UINT lod, UINT firstInstance, UINT instanceCount) const
+{
+	const auto& level = m_lods[lod];
+
+	PerDrawConstants perDrawConstants = {};
+	perDrawConstants.FirstInstance = firstInstance;
+	perDrawConstants.FirstTriangle = level.FirstIndex / 3;
+
+	deviceContext->UpdateSubresource(m_perDrawConstantBuffer.Get(), 0, nullptr, &perDrawConstants, 0, 0);
+	deviceContext->VSSetConstantBuffers(3, 1, m_perDrawConstantBuffer.GetAddressOf());
+	deviceContext->PSSetConstantBuffers(3, 1, m_perDrawConstantBuffer.GetAddressOf());
+
+	Bind(deviceContext);
+
+	// The start instance only offsets per-instance vertex data, which the shaders don't use. They add FirstInstance instead.
+	deviceContext->DrawIndexedInstanced(level.IndexCount, instanceCount, level.FirstIndex, 0, 0);
+}
+
+void GpuMesh::DrawLodBatches(ID3D11DeviceContext* deviceContext, const std::vector<MeshLodBatch>& batches) const
+{
+	for (const auto& batch : batches)
+	{
+		if (batch.InstanceCount > 0)
+			DrawLodInstanced(deviceContext, batch.Lod, batch.FirstInstance, batch.InstanceCount);
+	}
+}
+
+UINT GpuMesh::GetLodCount() const
+{
+	return static_cast<UINT>(m_lods.size());
+}
+
+const MeshLod* GpuMesh::GetLods() const
+{
+	return m_lods.data();
+}
+
+UINT GpuMesh::GetIndexCount() const
+{
+	return m_indexCount;
+}
+
+DXGI_FORMAT GpuMesh::GetIndexFormat() const
+{
+	return m_indexFormat;
+}
+
+ID3D11ShaderResourceView* GpuMesh::GetVertexBufferView() const
+{
+	return m_vertexBufferView.Get();
+}
+
+ID3D11ShaderResourceView* GpuMesh::GetIndexBufferView() const
+{
+	return m_indexBufferView.Get();
+}
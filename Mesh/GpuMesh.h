@@ -0,0 +1,105 @@
+﻿#pragma once
+
+#include "Mesh/Mesh.h"
+#include "Mesh/MeshLod.h"
+
+#include <wrl/client.h>
+#include <d3d11.h>
+
+#include <vector>
+
+/*
+ * A mesh whose vertices and indices have been uploaded to immutable GPU buffers.
+ * If the mesh has few enough vertices, the indices are stored with 16 bits.
+ *
+ * Besides being bound to the input assembler, both buffers can be read by shaders as raw buffers
+ * (ByteAddressBuffer), which passes that fetch triangles themselves - like visibility buffer shading - rely on.
+ *
+ * A mesh may have several levels of detail, stored one after the other in its index buffer (see MeshLod.h).
+ * Without any, the whole index buffer is level 0. Every draw sets the PerDraw constant buffer (b3), since
+ * SV_InstanceID and SV_PrimitiveID don't include the first instance and index of a draw.
+ */
+class GpuMesh
+{
+public:
+	template<typename TVertex>
+	GpuMesh(ID3D11Device* device, const Mesh<TVertex>& mesh, const std::vector<MeshLod>& lods = std::vector<MeshLod>())
+	{
+		CreateBuffers(
+			device,
+			mesh.Vertices.data(),
+			static_cast<UINT>(mesh.Vertices.size()),
+			sizeof(TVertex),
+			mesh.Indices);
+		SetLods(lods.data(), static_cast<UINT>(lods.size()));
+	}
+
+	// Creates the buffers from vertices and indices that are already in their GPU layout, e.g. inside a memory mapped
+	// Asset container. The data is handed to Direct3D as it is. 16-bit index data must be padded to a multiple of 4 bytes.
+	GpuMesh(
+		ID3D11Device* device,
+		const void* vertices,
+		UINT vertexCount,
+		UINT vertexStride,
+		const void* indices,
+		UINT indexCount,
+		DXGI_FORMAT indexFormat,
+		const MeshLod* lods = nullptr,
+		UINT lodCount = 0);
+
+	// Binds the vertex and index buffers to the input assembler stage
+	void Bind(ID3D11DeviceContext* deviceContext) const;
+
+	// Draw level 0 of the mesh
+	void Draw(ID3D11DeviceContext* deviceContext) const;
+	void DrawInstanced(ID3D11DeviceContext* deviceContext, UINT instanceCount) const;
+
+	// Draws instances [firstInstance, firstInstance + instanceCount) of the bound instance buffer with the given level
+	void DrawLodInstanced(ID3D11DeviceContext* deviceContext, UINT lod, UINT firstInstance, UINT instanceCount) const;
+	void DrawLodBatches(ID3D11DeviceContext* deviceContext, const std::vector<MeshLodBatch>& batches) const;
+
+	UINT GetLodCount() const;
+	const MeshLod* GetLods() const;
+
+	UINT GetIndexCount() const;
+	DXGI_FORMAT GetIndexFormat() const;
+
+	ID3D11ShaderResourceView* GetVertexBufferView() const;
+	ID3D11ShaderResourceView* GetIndexBufferView() const;
+
+private:
+	struct PerDrawConstants
+	{
+		UINT FirstInstance;
+		UINT FirstTriangle;
+		UINT Padding[2];
+	};
+
+	void SetLods(const MeshLod* lods, UINT lodCount);
+
+	void CreateBuffers(
+		ID3D11Device* device,
+		const void* vertices,
+		UINT vertexCount,
+		UINT vertexStride,
+		const std::vector<uint32_t>& indices);
+
+	void CreateBuffers(
+		ID3D11Device* device,
+		const void* vertices,
+		UINT vertexCount,
+		UINT vertexStride,
+		const void* indices,
+		UINT indexCount,
+		DXGI_FORMAT indexFormat);
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_vertexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_indexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_vertexBufferView;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_indexBufferView;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_perDrawConstantBuffer;
+	std::vector<MeshLod> m_lods;
+	UINT m_vertexStride;
+	UINT m_indexCount;
+	DXGI_FORMAT m_indexFormat;
+};
@@ -0,0 +1,31 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/*
+ * An indexed triangle list.
+ * Every three consecutive indices form a triangle, with vertices ordered clockwise
+ * When looking at the front face of the triangle.
+ *
+ * Indices are stored with 32 bits on the CPU side. When the mesh is uploaded to the GPU,
+ * 16-bit indices are used whenever the vertex count allows it, which halves index fetch bandwidth.
+ */
+template<typename TVertex>
+struct Mesh
+{
+	std::vector<TVertex> Vertices;
+	std::vector<uint32_t> Indices;
+
+	size_t GetTriangleCount() const
+	{
+		return Indices.size() / 3;
+	}
+
+	bool CanUse16BitIndices() const
+	{
+		return Vertices.size() <= std::numeric_limits<uint16_t>::max();
+	}
+};
@@ -0,0 +1,134 @@
+﻿#include "MeshGenerator.h"
+
+using namespace DirectX;
+
+Mesh<VertexWithPosition> CreateCubeMesh(float halfExtent)
+{
+	Mesh<VertexWithPosition> cube;
+
+	const float e = halfExtent;
+
+	cube.Vertices = {
+		{ XMFLOAT3(-e, -e, -e) },
+		{ XMFLOAT3(-e, +e, -e) },
+		{ XMFLOAT3(+e, +e, -e) },
+		{ XMFLOAT3(+e, -e, -e) },
+		{ XMFLOAT3(-e, -e, +e) },
+		{ XMFLOAT3(-e, +e, +e) },
+		{ XMFLOAT3(+e, +e, +e) },
+		{ XMFLOAT3(+e, -e, +e) }
+	};
+
+	// Triangles are wound clockwise when seen from outside the cube,
+	// Which is what the rasterizer state considers front facing.
+	cube.Indices = {
+		// Front face
+		0, 1, 2,
+		0, 2, 3,
+		// Back face
+		4, 6, 5,
+		4, 7, 6,
+		// Left face
+		4, 5, 1,
+		4, 1, 0,
+		// Right face
+		3, 2, 6,
+		3, 6, 7,
+		// Top face
+		1, 5, 6,
+		1, 6, 2,
+		// Bottom face
+		4, 0, 3,
+		4, 3, 7
+	};
+
+	return cube;
+}
+
+Mesh<VertexWithPositionNormalTexture> CreateCubeMeshWithNormals(float halfExtent, uint32_t subdivisions)
+{
+	Mesh<VertexWithPositionNormalTexture> cube;
+
+	// Outwards facing normal and the "up" direction of the face when looking at it from outside
+	const XMFLOAT3 faces[6][2] = {
+		{ XMFLOAT3(0.0f, 0.0f, -1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
+		{ XMFLOAT3(0.0f, 0.0f, +1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
+		{ XMFLOAT3(-1.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
+		{ XMFLOAT3(+1.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
+		{ XMFLOAT3(0.0f, +1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 1.0f) },
+		{ XMFLOAT3(0.0f, -1.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, -1.0f) }
+	};
+
+	const auto rowLength = subdivisions + 1;
+
+	for (const auto& face : faces)
+	{
+		const auto normal = XMLoadFloat3(&face[0]);
+		const auto up = XMVectorScale(XMLoadFloat3(&face[1]), halfExtent);
+		const auto right = XMVector3Cross(normal, up);
+		const auto center = XMVectorScale(normal, halfExtent);
+
+		const auto firstVertex = static_cast<uint32_t>(cube.Vertices.size());
+
+		// A grid of vertices from the top left to the bottom right corner. The texture covers the whole face.
+		for (uint32_t row = 0; row < rowLength; row++)
+		{
+			for (uint32_t column = 0; column < rowLength; column++)
+			{
+				const auto u = static_cast<float>(column) / static_cast<float>(subdivisions);
+				const auto v = static_cast<float>(row) / static_cast<float>(subdivisions);
+
+				VertexWithPositionNormalTexture vertex;
+				XMStoreFloat3(&vertex.Position, XMVectorAdd(
+					center,
+					XMVectorAdd(XMVectorScale(right, u * 2.0f - 1.0f), XMVectorScale(up, 1.0f - v * 2.0f))));
+				vertex.Normal = face[0];
+				vertex.TexCoord = XMFLOAT2(u, v);
+
+				cube.Vertices.push_back(vertex);
+			}
+		}
+
+		for (uint32_t row = 0; row < subdivisions; row++)
+		{
+			for (uint32_t column = 0; column < subdivisions; column++)
+			{
+				const auto topLeft = firstVertex + row * rowLength + column;
+				const auto bottomLeft = topLeft + rowLength;
+
+				// Clockwise when seen from outside
+				cube.Indices.insert(cube.Indices.end(), {
+					bottomLeft, topLeft, topLeft + 1,
+					bottomLeft, topLeft + 1, bottomLeft + 1
+				});
+			}
+		}
+	}
+
+	return cube;
+}
+
+void GenerateSmoothNormals(Mesh<VertexWithPositionNormalTexture>& mesh)
+{
+	for (auto& vertex : mesh.Vertices)
+		vertex.Normal = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	// The cross product is proportional to the triangle area, so larger triangles have more influence
+	for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3)
+	{
+		auto& vertex0 = mesh.Vertices[mesh.Indices[i]];
+		auto& vertex1 = mesh.Vertices[mesh.Indices[i + 1]];
+		auto& vertex2 = mesh.Vertices[mesh.Indices[i + 2]];
+
+		const auto position0 = XMLoadFloat3(&vertex0.Position);
+		const auto faceNormal = XMVector3Cross(
+			XMVectorSubtract(XMLoadFloat3(&vertex1.Position), position0),
+			XMVectorSubtract(XMLoadFloat3(&vertex2.Position), position0));
+
+		for (auto vertex : { &vertex0, &vertex1, &vertex2 })
+			XMStoreFloat3(&vertex->Normal, XMVectorAdd(XMLoadFloat3(&vertex->Normal), faceNormal));
+	}
+
+	for (auto& vertex : mesh.Vertices)
+		XMStoreFloat3(&vertex.Normal, XMVector3Normalize(XMLoadFloat3(&vertex.Normal)));
+}
@@ -0,0 +1,15 @@
+﻿#pragma once
+
+#include "Mesh/Mesh.h"
+#include "Rendering/VertexDefinitions.h"
+
+// Creates an axis aligned cube centered at the origin, with 8 shared vertices and 12 triangles
+Mesh<VertexWithPosition> CreateCubeMesh(float halfExtent);
+
+// Creates an axis aligned cube centered at the origin with per-face normals and texture coordinates.
+// Each face is a grid of subdivisions x subdivisions quads with its own vertices, since the edges don't share normals.
+Mesh<VertexWithPositionNormalTexture> CreateCubeMeshWithNormals(float halfExtent, uint32_t subdivisions = 1);
+
+// Replaces the normals of a mesh with the area weighted average of the normals of the triangles sharing each vertex.
+// Vertices are only smoothed across triangles they are shared by, so split vertices keep a hard edge.
+void GenerateSmoothNormals(Mesh<VertexWithPositionNormalTexture>& mesh);
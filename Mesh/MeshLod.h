@@ -0,0 +1,52 @@
+﻿#pragma once
+
+#include <cstdint>
+
+/*
+ * One level of detail of a mesh.
+ * All levels share the mesh's vertices and are stored one after the other in its index buffer,
+ * The full detail level first, so switching levels is only a matter of drawing a different index range.
+ */
+struct MeshLod
+{
+	uint32_t FirstIndex;
+	uint32_t IndexCount;
+	// How far the level's surface may be from the full detail surface, in mesh space units. 0 for the full detail level.
+	float Error;
+};
+
+static_assert(sizeof(MeshLod) == 12, "The mesh LOD must match the asset container layout");
+
+// Instances [FirstInstance, FirstInstance + InstanceCount) of an instance buffer, all drawn with the same level of detail
+struct MeshLodBatch
+{
+	uint32_t Lod;
+	uint32_t FirstInstance;
+	uint32_t InstanceCount;
+};
+
+/*
+ * Returns the coarsest level whose error, projected onto the screen at the given distance, stays within maxPixelError.
+ *
+ * projectionScale is the number of pixels a length of 1 covers at distance 1, which for a perspective projection is
+ * ViewportHeight / (2 * tan(verticalFieldOfView / 2)). The distance should be measured to the closest point of the
+ * Instance's bounds, and in mesh space units, so scaled instances must scale it accordingly.
+ */
+inline uint32_t SelectMeshLod(
+	const MeshLod* lods,
+	uint32_t lodCount,
+	float distance,
+	float projectionScale,
+	float maxPixelError = 1.0f)
+{
+	// The error of the levels only grows, so the first acceptable level from the coarse end is the coarsest one
+	const auto maxError = maxPixelError * (distance > 0.0f ? distance : 0.0f) / projectionScale;
+
+	for (auto lod = lodCount; lod > 1; lod--)
+	{
+		if (lods[lod - 1].Error <= maxError)
+			return lod - 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,274 @@
+﻿#include "MeshOptimizer.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+float ComputeAcmr(const std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize)
+{
+	const size_t triangleCount = indices.size() / 3;
+
+	if (triangleCount == 0)
+		return 0.0f;
+
+	// For every vertex we store the value of the miss counter at the time it entered the cache.
+	// A vertex is in a FIFO cache of size N exactly when fewer than N misses have happened since it entered.
+	std::vector<int64_t> cacheEntryTime(vertexCount, -static_cast<int64_t>(cacheSize) - 1);
+	int64_t misses = 0;
+
+	for (const auto index : indices)
+	{
+		if (misses - cacheEntryTime[index] > cacheSize)
+		{
+			cacheEntryTime[index] = misses;
+			misses++;
+		}
+	}
+
+	return static_cast<float>(misses) / static_cast<float>(triangleCount);
+}
+
+namespace
+{
+	// Vertex -> triangle adjacency stored in compressed form
+	struct TriangleAdjacency
+	{
+		std::vector<uint32_t> Offsets;
+		std::vector<uint32_t> Triangles;
+	};
+
+	TriangleAdjacency BuildTriangleAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		TriangleAdjacency adjacency;
+		adjacency.Offsets.assign(vertexCount + 1, 0);
+
+		for (const auto index : indices)
+			adjacency.Offsets[index + 1]++;
+
+		for (size_t i = 0; i < vertexCount; i++)
+			adjacency.Offsets[i + 1] += adjacency.Offsets[i];
+
+		adjacency.Triangles.resize(indices.size());
+
+		std::vector<uint32_t> fill(adjacency.Offsets.begin(), adjacency.Offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			adjacency.Triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+		return adjacency;
+	}
+
+	struct Cluster
+	{
+		size_t FirstIndex;
+		size_t IndexCount;
+		float SortKey;
+	};
+
+	void SortClustersForOverdraw(
+		std::vector<uint32_t>& indices,
+		const std::vector<size_t>& clusterStarts,
+		const std::vector<XMFLOAT3>& positions)
+	{
+		if (clusterStarts.size() < 2 || positions.empty())
+			return;
+
+		// Mesh centroid
+		auto meshCentroid = XMVectorZero();
+		for (const auto& position : positions)
+			meshCentroid = XMVectorAdd(meshCentroid, XMLoadFloat3(&position));
+		meshCentroid = XMVectorScale(meshCentroid, 1.0f / static_cast<float>(positions.size()));
+
+		std::vector<Cluster> clusters;
+		clusters.reserve(clusterStarts.size());
+
+		for (size_t c = 0; c < clusterStarts.size(); c++)
+		{
+			Cluster cluster;
+			cluster.FirstIndex = clusterStarts[c];
+			cluster.IndexCount = (c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : indices.size()) - cluster.FirstIndex;
+
+			// Area weighted normal and centroid of the cluster
+			auto clusterNormal = XMVectorZero();
+			auto clusterCentroid = XMVectorZero();
+			float clusterArea = 0.0f;
+
+			for (size_t i = cluster.FirstIndex; i < cluster.FirstIndex + cluster.IndexCount; i += 3)
+			{
+				const auto p0 = XMLoadFloat3(&positions[indices[i]]);
+				const auto p1 = XMLoadFloat3(&positions[indices[i + 1]]);
+				const auto p2 = XMLoadFloat3(&positions[indices[i + 2]]);
+
+				// Clockwise winding in a left handed coordinate system gives an outwards facing normal
+				const auto normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+				const float area = XMVectorGetX(XMVector3Length(normal));
+
+				clusterNormal = XMVectorAdd(clusterNormal, normal);
+				clusterCentroid = XMVectorAdd(clusterCentroid, XMVectorScale(XMVectorAdd(XMVectorAdd(p0, p1), p2), area / 3.0f));
+				clusterArea += area;
+			}
+
+			if (clusterArea > 0.0f)
+				clusterCentroid = XMVectorScale(clusterCentroid, 1.0f / clusterArea);
+
+			// Clusters that face away from the mesh center occlude the rest of the mesh from most view points
+			cluster.SortKey = XMVectorGetX(XMVector3Dot(
+				XMVectorSubtract(clusterCentroid, meshCentroid),
+				XMVector3Normalize(clusterNormal)));
+
+			clusters.push_back(cluster);
+		}
+
+		std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b)
+		{
+			return a.SortKey > b.SortKey;
+		});
+
+		std::vector<uint32_t> sortedIndices;
+		sortedIndices.reserve(indices.size());
+
+		for (const auto& cluster : clusters)
+			sortedIndices.insert(
+				sortedIndices.end(),
+				indices.begin() + cluster.FirstIndex,
+				indices.begin() + cluster.FirstIndex + cluster.IndexCount);
+
+		indices.swap(sortedIndices);
+	}
+}
+
+void OptimizeTriangleOrder(std::vector<uint32_t>& indices, const std::vector<XMFLOAT3>& positions, int cacheSize)
+{
+	const size_t triangleCount = indices.size() / 3;
+	const size_t vertexCount = positions.size();
+
+	if (triangleCount == 0)
+		return;
+
+	const auto adjacency = BuildTriangleAdjacency(indices, vertexCount);
+
+	// Number of triangles not yet emitted that use each vertex
+	std::vector<uint32_t> liveTriangles(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		liveTriangles[v] = adjacency.Offsets[v + 1] - adjacency.Offsets[v];
+
+	std::vector<int64_t> cacheTimeStamps(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+
+	// Vertices of recently emitted triangles, used to escape dead ends without scanning the whole mesh
+	std::vector<uint32_t> deadEndStack;
+	std::vector<uint32_t> candidates;
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	std::vector<size_t> clusterStarts;
+	clusterStarts.push_back(0);
+
+	int64_t timeStamp = cacheSize + 1;
+	size_t scanCursor = 0;
+	int64_t fanningVertex = 0;
+
+	while (fanningVertex >= 0)
+	{
+		candidates.clear();
+
+		// Emit every remaining triangle around the fanning vertex
+		const auto f = static_cast<uint32_t>(fanningVertex);
+		for (auto a = adjacency.Offsets[f]; a < adjacency.Offsets[f + 1]; a++)
+		{
+			const auto triangle = adjacency.Triangles[a];
+
+			if (emitted[triangle])
+				continue;
+
+			for (int corner = 0; corner < 3; corner++)
+			{
+				const auto v = indices[triangle * 3 + corner];
+
+				output.push_back(v);
+				deadEndStack.push_back(v);
+				candidates.push_back(v);
+
+				liveTriangles[v]--;
+
+				if (timeStamp - cacheTimeStamps[v] > cacheSize)
+					cacheTimeStamps[v] = timeStamp++;
+			}
+
+			emitted[triangle] = true;
+		}
+
+		// Pick the next fanning vertex among the candidates. We prefer vertices that are still in the cache
+		// And will stay in the cache while their remaining triangles are emitted, preferring the oldest one.
+		int64_t nextVertex = -1;
+		int64_t bestPriority = -1;
+
+		for (const auto v : candidates)
+		{
+			if (liveTriangles[v] == 0)
+				continue;
+
+			int64_t priority = 0;
+			if (timeStamp - cacheTimeStamps[v] + 2 * static_cast<int64_t>(liveTriangles[v]) <= cacheSize)
+				priority = timeStamp - cacheTimeStamps[v];
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				nextVertex = v;
+			}
+		}
+
+		if (nextVertex == -1)
+		{
+			// Dead end. First try recently used vertices, then scan the remaining vertices in order.
+			while (!deadEndStack.empty() && nextVertex == -1)
+			{
+				const auto v = deadEndStack.back();
+				deadEndStack.pop_back();
+
+				if (liveTriangles[v] > 0)
+					nextVertex = v;
+			}
+
+			while (nextVertex == -1 && scanCursor < vertexCount)
+			{
+				if (liveTriangles[scanCursor] > 0)
+					nextVertex = static_cast<int64_t>(scanCursor);
+				else
+					scanCursor++;
+			}
+
+			// Jumping to a vertex that is likely not in the cache anymore starts a new cluster
+			if (nextVertex != -1 && output.size() > clusterStarts.back())
+				clusterStarts.push_back(output.size());
+		}
+
+		fanningVertex = nextVertex;
+	}
+
+	SortClustersForOverdraw(output, clusterStarts, positions);
+
+	indices.swap(output);
+}
+
+std::vector<uint32_t> GenerateVertexFetchRemap(const std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	const uint32_t unassigned = ~0u;
+	std::vector<uint32_t> remap(vertexCount, unassigned);
+	uint32_t nextVertex = 0;
+
+	for (const auto index : indices)
+	{
+		if (remap[index] == unassigned)
+			remap[index] = nextVertex++;
+	}
+
+	for (auto& entry : remap)
+	{
+		if (entry == unassigned)
+			entry = nextVertex++;
+	}
+
+	return remap;
+}
@@ -0,0 +1,86 @@
+﻿#pragma once
+
+#include "Mesh/Mesh.h"
+#include "Rendering/VertexLayout.h"
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+// The post-transform vertex cache size we optimize for.
+// Real hardware doesn't use a strict FIFO cache anymore, but 16 entries is a good
+// Approximation of the reuse window of current GPUs.
+const int DefaultVertexCacheSize = 16;
+
+struct MeshOptimizationReport
+{
+	// Average cache miss ratio (transformed vertices per triangle) before and after optimization.
+	// The best possible value for a regular grid is 0.5, the worst possible value is 3.0
+	float AcmrBefore;
+	float AcmrAfter;
+};
+
+// Simulates a FIFO post-transform vertex cache and returns the average number of cache misses per triangle
+float ComputeAcmr(const std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize = DefaultVertexCacheSize);
+
+/*
+ * Reorders triangles for post-transform vertex cache efficiency and reduced overdraw.
+ *
+ * Implements "Tipsify" from Sander, Nehab and Barczak - "Fast Triangle Reordering for Vertex Locality
+ * And Reduced Overdraw" (2007). Triangles are emitted as fans around vertices that are still in the cache,
+ * Which runs in linear time. Whenever the algorithm has to jump to a vertex that is no longer in the cache,
+ * A new cluster begins. The clusters are then sorted so that outwards facing clusters far from the center
+ * Of the mesh are drawn first, which lets the depth test reject more of the pixels drawn later.
+ *
+ * The winding order of each triangle is preserved.
+ */
+void OptimizeTriangleOrder(
+	std::vector<uint32_t>& indices,
+	const std::vector<DirectX::XMFLOAT3>& positions,
+	int cacheSize = DefaultVertexCacheSize);
+
+// Returns a remap table (old vertex index -> new vertex index) that orders vertices by first use in the index buffer.
+// Vertices that aren't referenced at all are moved to the end.
+std::vector<uint32_t> GenerateVertexFetchRemap(const std::vector<uint32_t>& indices, size_t vertexCount);
+
+// Reorders vertices for fetch locality, so vertices are read from memory in the same order they are used
+template<typename TVertex>
+void OptimizeVertexFetch(Mesh<TVertex>& mesh)
+{
+	const auto remap = GenerateVertexFetchRemap(mesh.Indices, mesh.Vertices.size());
+
+	std::vector<TVertex> remappedVertices(mesh.Vertices.size());
+	for (size_t i = 0; i < mesh.Vertices.size(); i++)
+		remappedVertices[remap[i]] = mesh.Vertices[i];
+
+	for (auto& index : mesh.Indices)
+		index = remap[index];
+
+	mesh.Vertices.swap(remappedVertices);
+}
+
+// Runs the full optimization pipeline on a mesh: triangle order first, then vertex order.
+// Works for any vertex type with a VertexLayout that has a position attribute.
+template<typename TVertex>
+MeshOptimizationReport OptimizeMesh(Mesh<TVertex>& mesh, int cacheSize = DefaultVertexCacheSize)
+{
+	MeshOptimizationReport report;
+	report.AcmrBefore = ComputeAcmr(mesh.Indices, mesh.Vertices.size(), cacheSize);
+
+	std::vector<DirectX::XMFLOAT3> positions;
+	positions.reserve(mesh.Vertices.size());
+	for (const auto& vertex : mesh.Vertices)
+	{
+		DirectX::XMFLOAT3 position;
+		DirectX::XMStoreFloat3(&position, FetchVertexAttribute<VertexSemantic::Position>(vertex));
+		positions.push_back(position);
+	}
+
+	OptimizeTriangleOrder(mesh.Indices, positions, cacheSize);
+	OptimizeVertexFetch(mesh);
+
+	report.AcmrAfter = ComputeAcmr(mesh.Indices, mesh.Vertices.size(), cacheSize);
+
+	return report;
+}
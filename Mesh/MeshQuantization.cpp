@@ -0,0 +1,126 @@
+﻿#include "MeshQuantization.h"
+
+#include "Rendering/VertexLayout.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	float SignNotZero(float value)
+	{
+		return value >= 0.0f ? 1.0f : -1.0f;
+	}
+}
+
+XMFLOAT2 EncodeOctahedralNormal(const XMFLOAT3& normal)
+{
+	// Project onto the octahedron |x| + |y| + |z| = 1
+	const float l1Norm = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+
+	// Degenerate faces and missing normals leave zero normals, which have no direction to encode. The center of the
+	// Square decodes to +Z. The comparison is also false for NaN, and infinite components can't be projected either.
+	if (!(l1Norm > 0.0f) || !std::isfinite(l1Norm))
+		return XMFLOAT2(0.0f, 0.0f);
+
+	float x = normal.x / l1Norm;
+	float y = normal.y / l1Norm;
+
+	// Fold the lower hemisphere over the diagonals
+	if (normal.z < 0.0f)
+	{
+		const float foldedX = (1.0f - std::abs(y)) * SignNotZero(x);
+		const float foldedY = (1.0f - std::abs(x)) * SignNotZero(y);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	return XMFLOAT2(x, y);
+}
+
+XMFLOAT3 DecodeOctahedralNormal(const XMFLOAT2& encodedNormal)
+{
+	float x = encodedNormal.x;
+	float y = encodedNormal.y;
+	const float z = 1.0f - std::abs(x) - std::abs(y);
+
+	// Unfold the lower hemisphere
+	const float t = std::max(-z, 0.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	XMFLOAT3 normal;
+	XMStoreFloat3(&normal, XMVector3Normalize(XMVectorSet(x, y, z, 0.0f)));
+
+	return normal;
+}
+
+QuantizedMesh QuantizeMesh(const Mesh<VertexWithPositionNormalTexture>& mesh)
+{
+	QuantizedMesh quantizedMesh;
+	quantizedMesh.Geometry.Indices = mesh.Indices;
+	quantizedMesh.Geometry.Vertices.resize(mesh.Vertices.size());
+
+	if (mesh.Vertices.empty())
+	{
+		quantizedMesh.PositionScale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+		quantizedMesh.PositionOffset = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		return quantizedMesh;
+	}
+
+	// Bounding box of the mesh
+	auto minimum = XMLoadFloat3(&mesh.Vertices[0].Position);
+	auto maximum = minimum;
+
+	for (const auto& vertex : mesh.Vertices)
+	{
+		const auto position = XMLoadFloat3(&vertex.Position);
+		minimum = XMVectorMin(minimum, position);
+		maximum = XMVectorMax(maximum, position);
+	}
+
+	// Map the bounding box to [-1, 1]. Flat meshes get a non-zero scale on the flat axis to avoid dividing by zero.
+	const auto offset = XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f);
+	const auto scale = XMVectorMax(
+		XMVectorScale(XMVectorSubtract(maximum, minimum), 0.5f),
+		XMVectorReplicate(1e-6f));
+	const auto inverseScale = XMVectorReciprocal(scale);
+
+	XMStoreFloat3(&quantizedMesh.PositionScale, scale);
+	XMStoreFloat3(&quantizedMesh.PositionOffset, offset);
+
+	for (size_t i = 0; i < mesh.Vertices.size(); i++)
+	{
+		const auto& vertex = mesh.Vertices[i];
+		auto& quantizedVertex = quantizedMesh.Geometry.Vertices[i];
+
+		// XMStoreShortN4 clamps to [-1, 1] and rounds to the nearest representable value
+		const auto normalizedPosition = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&vertex.Position), offset), inverseScale);
+		XMStoreShortN4(&quantizedVertex.Position, XMVectorSetW(normalizedPosition, 1.0f));
+
+		const auto encodedNormal = EncodeOctahedralNormal(vertex.Normal);
+		XMStoreShortN2(&quantizedVertex.Normal, XMLoadFloat2(&encodedNormal));
+
+		XMStoreHalf2(&quantizedVertex.TexCoord, XMLoadFloat2(&vertex.TexCoord));
+	}
+
+	return quantizedMesh;
+}
+
+void DecodeQuantizedPositions(const QuantizedMesh& mesh, std::vector<XMFLOAT3>& positions)
+{
+	const auto scale = XMLoadFloat3(&mesh.PositionScale);
+	const auto offset = XMLoadFloat3(&mesh.PositionOffset);
+
+	positions.resize(mesh.Geometry.Vertices.size());
+
+	for (size_t i = 0; i < mesh.Geometry.Vertices.size(); i++)
+	{
+		// Loads and converts all four 16-bit components to floats in one go
+		const auto normalizedPosition = FetchVertexAttribute<VertexSemantic::Position>(mesh.Geometry.Vertices[i]);
+		XMStoreFloat3(&positions[i], XMVectorMultiplyAdd(normalizedPosition, scale, offset));
+	}
+}
@@ -0,0 +1,35 @@
+﻿#pragma once
+
+#include "Mesh/Mesh.h"
+#include "Rendering/VertexDefinitions.h"
+
+#include <vector>
+
+/*
+ * A mesh stored with QuantizedVertex vertices.
+ * Positions are stored relative to the bounding box of the mesh, so the full 16 bits of precision
+ * Are spent on the space the mesh actually occupies:
+ *
+ *     position = quantizedPosition * PositionScale + PositionOffset
+ */
+struct QuantizedMesh
+{
+	Mesh<QuantizedVertex> Geometry;
+	DirectX::XMFLOAT3 PositionScale;
+	DirectX::XMFLOAT3 PositionOffset;
+};
+
+QuantizedMesh QuantizeMesh(const Mesh<VertexWithPositionNormalTexture>& mesh);
+
+// Decodes all positions of a quantized mesh, one vertex per SIMD operation
+void DecodeQuantizedPositions(const QuantizedMesh& mesh, std::vector<DirectX::XMFLOAT3>& positions);
+
+/*
+ * Octahedral normal encoding, as described in Cigolle et al. - "A Survey of Efficient Representations
+ * For Independent Unit Vectors" (2014).
+ * The unit sphere is projected onto an octahedron, which is then unfolded into the [-1, 1] square.
+ * This distributes precision much more evenly over the sphere than storing x and y and reconstructing z.
+ * Zero and non-finite normals are encoded as +Z.
+ */
+DirectX::XMFLOAT2 EncodeOctahedralNormal(const DirectX::XMFLOAT3& normal);
+DirectX::XMFLOAT3 DecodeOctahedralNormal(const DirectX::XMFLOAT2& encodedNormal);
@@ -0,0 +1,771 @@
+﻿#include "MeshSimplifier.h"
+
+#include "Mesh/MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t InvalidVertex = UINT32_MAX;
+
+	// Planes through open edges count this much more than the surface, so the outline of the mesh changes last
+	const double BorderPlaneWeight = 10.0;
+
+	// A collapse may turn a remaining triangle by up to about 75 degrees. More means the surface folds over.
+	const float MinNormalAgreement = 0.25f;
+
+	// Every pass considers only the cheapest candidates, twice as many as it needs
+	const size_t CandidateSurplus = 2;
+
+	enum class VertexKind : uint8_t
+	{
+		// Surrounded by triangles, can move anywhere
+		Manifold,
+		// On an open border, moves along the border
+		Border,
+		// One of the two split vertices on an attribute seam, moves along the seam together with its twin
+		Seam,
+		// Never moves
+		Locked
+	};
+
+	// The symmetric 4x4 matrix sum of plane * plane^T, with the sum of the weights of the planes
+	struct Quadric
+	{
+		double A00, A11, A22, A01, A02, A12;
+		double B0, B1, B2;
+		double C;
+		double Weight;
+	};
+
+	struct Collapse
+	{
+		uint32_t From;
+		uint32_t To;
+		// Squared distance
+		double Error;
+	};
+
+	// Vertex -> triangle adjacency stored in compressed form
+	struct TriangleAdjacency
+	{
+		std::vector<uint32_t> Offsets;
+		std::vector<uint32_t> Triangles;
+	};
+
+	TriangleAdjacency BuildTriangleAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		TriangleAdjacency adjacency;
+		adjacency.Offsets.assign(vertexCount + 1, 0);
+
+		for (const auto index : indices)
+			adjacency.Offsets[index + 1]++;
+
+		for (size_t i = 0; i < vertexCount; i++)
+			adjacency.Offsets[i + 1] += adjacency.Offsets[i];
+
+		adjacency.Triangles.resize(indices.size());
+
+		std::vector<uint32_t> fill(adjacency.Offsets.begin(), adjacency.Offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			adjacency.Triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+		return adjacency;
+	}
+
+	Quadric CreatePlaneQuadric(FXMVECTOR normal, FXMVECTOR pointOnPlane, double weight)
+	{
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, normal);
+		const double d = -XMVectorGetX(XMVector3Dot(normal, pointOnPlane));
+
+		Quadric quadric;
+		quadric.A00 = weight * n.x * n.x;
+		quadric.A11 = weight * n.y * n.y;
+		quadric.A22 = weight * n.z * n.z;
+		quadric.A01 = weight * n.x * n.y;
+		quadric.A02 = weight * n.x * n.z;
+		quadric.A12 = weight * n.y * n.z;
+		quadric.B0 = weight * n.x * d;
+		quadric.B1 = weight * n.y * d;
+		quadric.B2 = weight * n.z * d;
+		quadric.C = weight * d * d;
+		quadric.Weight = weight;
+
+		return quadric;
+	}
+
+	void AddQuadric(Quadric& quadric, const Quadric& other)
+	{
+		quadric.A00 += other.A00;
+		quadric.A11 += other.A11;
+		quadric.A22 += other.A22;
+		quadric.A01 += other.A01;
+		quadric.A02 += other.A02;
+		quadric.A12 += other.A12;
+		quadric.B0 += other.B0;
+		quadric.B1 += other.B1;
+		quadric.B2 += other.B2;
+		quadric.C += other.C;
+		quadric.Weight += other.Weight;
+	}
+
+	// The weighted mean of the squared distances of a point to the planes of a quadric
+	double GetQuadricError(const Quadric& quadric, const XMFLOAT3& point)
+	{
+		const double x = point.x;
+		const double y = point.y;
+		const double z = point.z;
+
+		const auto error = quadric.A00 * x * x + quadric.A11 * y * y + quadric.A22 * z * z
+			+ 2.0 * (quadric.A01 * x * y + quadric.A02 * x * z + quadric.A12 * y * z)
+			+ 2.0 * (quadric.B0 * x + quadric.B1 * y + quadric.B2 * z)
+			+ quadric.C;
+
+		return quadric.Weight > 0.0 ? std::max(error, 0.0) / quadric.Weight : 0.0;
+	}
+
+	bool HasHalfEdge(
+		const std::vector<uint32_t>& indices,
+		const TriangleAdjacency& adjacency,
+		uint32_t from,
+		uint32_t to)
+	{
+		for (auto i = adjacency.Offsets[from]; i < adjacency.Offsets[from + 1]; i++)
+		{
+			const auto triangle = adjacency.Triangles[i];
+
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				if (indices[triangle * 3 + corner] == from && indices[triangle * 3 + (corner + 1) % 3] == to)
+					return true;
+			}
+		}
+
+		return false;
+	}
+
+	/*
+	 * Links the vertices that share a position in a ring (nextWedge), and maps each of them to the first one of the
+	 * Ring (positionVertex). Vertices that no triangle uses aren't linked with anything, so they never lock a seam.
+	 */
+	void LinkPositionWedges(
+		const std::vector<uint32_t>& indices,
+		const std::vector<XMFLOAT3>& positions,
+		std::vector<uint32_t>& positionVertex,
+		std::vector<uint32_t>& nextWedge)
+	{
+		positionVertex.resize(positions.size());
+		nextWedge.resize(positions.size());
+		std::iota(positionVertex.begin(), positionVertex.end(), 0);
+		std::iota(nextWedge.begin(), nextWedge.end(), 0);
+
+		std::vector<bool> used(positions.size(), false);
+		for (const auto index : indices)
+			used[index] = true;
+
+		std::vector<uint32_t> order;
+		for (uint32_t i = 0; i < positions.size(); i++)
+		{
+			if (used[i])
+				order.push_back(i);
+		}
+
+		std::sort(order.begin(), order.end(), [&positions](uint32_t a, uint32_t b)
+		{
+			const auto& pa = positions[a];
+			const auto& pb = positions[b];
+
+			if (pa.x != pb.x)
+				return pa.x < pb.x;
+			if (pa.y != pb.y)
+				return pa.y < pb.y;
+			if (pa.z != pb.z)
+				return pa.z < pb.z;
+
+			return a < b;
+		});
+
+		for (size_t begin = 0; begin < order.size();)
+		{
+			const auto& position = positions[order[begin]];
+			auto end = begin + 1;
+
+			while (end < order.size()
+				&& positions[order[end]].x == position.x
+				&& positions[order[end]].y == position.y
+				&& positions[order[end]].z == position.z)
+				end++;
+
+			for (auto i = begin; i < end; i++)
+			{
+				positionVertex[order[i]] = order[begin];
+				nextWedge[order[i]] = order[i + 1 < end ? i + 1 : begin];
+			}
+
+			begin = end;
+		}
+	}
+
+	// For every vertex, the other end of the open edge leaving it (loop) and of the one arriving at it (loopBack)
+	void FindOpenEdges(
+		const std::vector<uint32_t>& indices,
+		const TriangleAdjacency& adjacency,
+		std::vector<uint32_t>& loop,
+		std::vector<uint32_t>& loopBack)
+	{
+		std::fill(loop.begin(), loop.end(), InvalidVertex);
+		std::fill(loopBack.begin(), loopBack.end(), InvalidVertex);
+
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const auto a = indices[i + corner];
+				const auto b = indices[i + (corner + 1) % 3];
+
+				if (!HasHalfEdge(indices, adjacency, b, a))
+				{
+					loop[a] = b;
+					loopBack[b] = a;
+				}
+			}
+		}
+	}
+
+	std::vector<VertexKind> ClassifyVertices(
+		const std::vector<uint32_t>& indices,
+		const TriangleAdjacency& adjacency,
+		const std::vector<uint32_t>& positionVertex,
+		const std::vector<uint32_t>& nextWedge,
+		const std::vector<uint32_t>& loop,
+		const std::vector<uint32_t>& loopBack)
+	{
+		const auto vertexCount = positionVertex.size();
+
+		std::vector<VertexKind> kinds(vertexCount, VertexKind::Manifold);
+		std::vector<uint32_t> openEdgesOut(vertexCount, 0);
+		std::vector<uint32_t> openEdgesIn(vertexCount, 0);
+
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const auto a = indices[i + corner];
+				const auto b = indices[i + (corner + 1) % 3];
+
+				if (!HasHalfEdge(indices, adjacency, b, a))
+				{
+					openEdgesOut[a]++;
+					openEdgesIn[b]++;
+				}
+
+				// An edge used twice in the same direction belongs to more than two triangles, which no collapse may touch
+				uint32_t edgeUses = 0;
+				for (auto j = adjacency.Offsets[a]; j < adjacency.Offsets[a + 1]; j++)
+				{
+					const auto triangle = adjacency.Triangles[j];
+
+					for (uint32_t k = 0; k < 3; k++)
+						edgeUses += indices[triangle * 3 + k] == a && indices[triangle * 3 + (k + 1) % 3] == b ? 1 : 0;
+				}
+
+				if (edgeUses > 1)
+				{
+					kinds[a] = VertexKind::Locked;
+					kinds[b] = VertexKind::Locked;
+				}
+			}
+		}
+
+		for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+		{
+			if (kinds[vertex] == VertexKind::Locked)
+				continue;
+
+			uint32_t wedgeCount = 1;
+			for (auto wedge = nextWedge[vertex]; wedge != vertex; wedge = nextWedge[wedge])
+				wedgeCount++;
+
+			const auto isOpen = openEdgesOut[vertex] != 0 || openEdgesIn[vertex] != 0;
+
+			// Several borders meeting in one vertex
+			if (openEdgesOut[vertex] > 1 || openEdgesIn[vertex] > 1 || openEdgesOut[vertex] != openEdgesIn[vertex])
+			{
+				kinds[vertex] = VertexKind::Locked;
+			}
+			else if (wedgeCount == 1)
+			{
+				kinds[vertex] = isOpen ? VertexKind::Border : VertexKind::Manifold;
+			}
+			else if (wedgeCount == 2 && isOpen)
+			{
+				// The twin's open edges must run along the same seam, in the other direction
+				const auto twin = nextWedge[vertex];
+				const auto isSeam = openEdgesOut[twin] == 1
+					&& openEdgesIn[twin] == 1
+					&& positionVertex[loop[vertex]] == positionVertex[loopBack[twin]]
+					&& positionVertex[loopBack[vertex]] == positionVertex[loop[twin]];
+
+				kinds[vertex] = isSeam ? VertexKind::Seam : VertexKind::Locked;
+			}
+			else
+			{
+				kinds[vertex] = VertexKind::Locked;
+			}
+		}
+
+		// Twins only move together
+		for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+		{
+			if (kinds[vertex] == VertexKind::Seam && kinds[nextWedge[vertex]] != VertexKind::Seam)
+				kinds[vertex] = VertexKind::Locked;
+		}
+
+		return kinds;
+	}
+
+	// The planes of all triangles, weighted by area, and the planes standing on all open edges.
+	// Vertices with the same position share one quadric.
+	std::vector<Quadric> ComputeQuadrics(
+		const std::vector<uint32_t>& indices,
+		const std::vector<XMFLOAT3>& positions,
+		const TriangleAdjacency& adjacency,
+		const std::vector<uint32_t>& positionVertex)
+	{
+		std::vector<Quadric> quadrics(positions.size(), Quadric{});
+
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			const XMVECTOR corners[3] = {
+				XMLoadFloat3(&positions[indices[i]]),
+				XMLoadFloat3(&positions[indices[i + 1]]),
+				XMLoadFloat3(&positions[indices[i + 2]])
+			};
+
+			const auto normal = XMVector3Cross(
+				XMVectorSubtract(corners[1], corners[0]),
+				XMVectorSubtract(corners[2], corners[0]));
+			const auto doubleArea = XMVectorGetX(XMVector3Length(normal));
+
+			if (doubleArea == 0.0f)
+				continue;
+
+			const auto unitNormal = XMVectorScale(normal, 1.0f / doubleArea);
+			const auto planeQuadric = CreatePlaneQuadric(unitNormal, corners[0], doubleArea * 0.5);
+
+			for (uint32_t corner = 0; corner < 3; corner++)
+				AddQuadric(quadrics[positionVertex[indices[i + corner]]], planeQuadric);
+
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const auto a = indices[i + corner];
+				const auto b = indices[i + (corner + 1) % 3];
+
+				if (HasHalfEdge(indices, adjacency, b, a))
+					continue;
+
+				// The plane through the edge, perpendicular to the triangle
+				const auto edge = XMVectorSubtract(corners[(corner + 1) % 3], corners[corner]);
+				const auto edgeLengthSquared = XMVectorGetX(XMVector3LengthSq(edge));
+
+				if (edgeLengthSquared == 0.0f)
+					continue;
+
+				const auto borderQuadric = CreatePlaneQuadric(
+					XMVector3Normalize(XMVector3Cross(edge, unitNormal)),
+					corners[corner],
+					edgeLengthSquared * BorderPlaneWeight);
+
+				AddQuadric(quadrics[positionVertex[a]], borderQuadric);
+				AddQuadric(quadrics[positionVertex[b]], borderQuadric);
+			}
+		}
+
+		return quadrics;
+	}
+
+	class EdgeCollapser
+	{
+	public:
+		EdgeCollapser(const std::vector<uint32_t>& indices, const std::vector<XMFLOAT3>& positions)
+			: m_indices(indices),
+			m_positions(positions),
+			m_loop(positions.size()),
+			m_loopBack(positions.size()),
+			m_neighbourMarks(positions.size(), 0),
+			m_touched(positions.size()),
+			m_remap(positions.size()),
+			m_maxError(0.0)
+		{
+			LinkPositionWedges(m_indices, m_positions, m_positionVertex, m_nextWedge);
+
+			m_adjacency = BuildTriangleAdjacency(m_indices, m_positions.size());
+			FindOpenEdges(m_indices, m_adjacency, m_loop, m_loopBack);
+
+			m_kinds = ClassifyVertices(m_indices, m_adjacency, m_positionVertex, m_nextWedge, m_loop, m_loopBack);
+			m_quadrics = ComputeQuadrics(m_indices, m_positions, m_adjacency, m_positionVertex);
+		}
+
+		void Simplify(size_t targetIndexCount)
+		{
+			while (m_indices.size() > targetIndexCount)
+			{
+				if (!RunPass((m_indices.size() - targetIndexCount + 2) / 3))
+					break;
+
+				m_adjacency = BuildTriangleAdjacency(m_indices, m_positions.size());
+				FindOpenEdges(m_indices, m_adjacency, m_loop, m_loopBack);
+			}
+		}
+
+		std::vector<uint32_t>& GetIndices()
+		{
+			return m_indices;
+		}
+
+		float GetError() const
+		{
+			return static_cast<float>(std::sqrt(m_maxError));
+		}
+
+	private:
+		// Collapses the cheapest edges that don't influence each other, until about the given number of triangles is gone.
+		// Returns false if no edge could be collapsed.
+		bool RunPass(size_t triangleGoal)
+		{
+			auto collapses = FindCollapses();
+
+			if (collapses.empty())
+				return false;
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+			{
+				return a.Error < b.Error;
+			});
+
+			// Most collapses remove two triangles. Taking edges far beyond the cheapest ones would only hurt quality,
+			// Since the next pass reconsiders the remaining edges anyway. Edges that can't be collapsed at all don't count,
+			// Or they would keep blocking the cheap end of the list pass after pass.
+			const auto candidateLimit = std::max<size_t>(triangleGoal / 2 * CandidateSurplus, 1);
+			size_t candidateCount = 0;
+
+			std::fill(m_touched.begin(), m_touched.end(), false);
+			std::iota(m_remap.begin(), m_remap.end(), 0);
+
+			size_t removedTriangles = 0;
+
+			for (const auto& collapse : collapses)
+			{
+				if (removedTriangles >= triangleGoal || candidateCount >= candidateLimit)
+					break;
+
+				auto twinFrom = InvalidVertex;
+				auto twinTo = InvalidVertex;
+
+				if (m_kinds[collapse.From] == VertexKind::Seam)
+				{
+					twinFrom = m_nextWedge[collapse.From];
+					twinTo = GetTwinTarget(collapse.From, collapse.To);
+				}
+
+				if (m_touched[collapse.From] || m_touched[collapse.To]
+					|| (twinFrom != InvalidVertex && (m_touched[twinFrom] || m_touched[twinTo])))
+				{
+					candidateCount++;
+					continue;
+				}
+
+				if (!IsCollapseValid(collapse.From, collapse.To)
+					|| (twinFrom != InvalidVertex && !IsCollapseValid(twinFrom, twinTo)))
+					continue;
+
+				candidateCount++;
+
+				removedTriangles += ApplyCollapse(collapse.From, collapse.To);
+
+				if (twinFrom != InvalidVertex)
+					removedTriangles += ApplyCollapse(twinFrom, twinTo);
+
+				// Twins share their quadric, so it is only merged once
+				AddQuadric(m_quadrics[m_positionVertex[collapse.To]], m_quadrics[m_positionVertex[collapse.From]]);
+				m_maxError = std::max(m_maxError, collapse.Error);
+			}
+
+			if (removedTriangles == 0)
+				return false;
+
+			// Drop the triangles that lost an edge
+			size_t writeIndex = 0;
+			for (size_t i = 0; i < m_indices.size(); i += 3)
+			{
+				const auto a = m_remap[m_indices[i]];
+				const auto b = m_remap[m_indices[i + 1]];
+				const auto c = m_remap[m_indices[i + 2]];
+
+				if (a == b || b == c || c == a)
+					continue;
+
+				m_indices[writeIndex++] = a;
+				m_indices[writeIndex++] = b;
+				m_indices[writeIndex++] = c;
+			}
+
+			m_indices.resize(writeIndex);
+
+			return true;
+		}
+
+		std::vector<Collapse> FindCollapses() const
+		{
+			std::vector<Collapse> collapses;
+
+			for (size_t i = 0; i < m_indices.size(); i += 3)
+			{
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					const auto a = m_indices[i + corner];
+					const auto b = m_indices[i + (corner + 1) % 3];
+
+					// Interior edges are seen from both of their triangles, open edges only once
+					if (a > b && HasHalfEdge(m_indices, m_adjacency, b, a))
+						continue;
+
+					const auto canCollapseAB = CanCollapse(a, b);
+					const auto canCollapseBA = CanCollapse(b, a);
+
+					if (!canCollapseAB && !canCollapseBA)
+						continue;
+
+					const auto errorAB = canCollapseAB ? GetCollapseError(a, b) : 0.0;
+					const auto errorBA = canCollapseBA ? GetCollapseError(b, a) : 0.0;
+
+					if (canCollapseAB && (!canCollapseBA || errorAB <= errorBA))
+						collapses.push_back({ a, b, errorAB });
+					else
+						collapses.push_back({ b, a, errorBA });
+				}
+			}
+
+			return collapses;
+		}
+
+		bool CanCollapse(uint32_t from, uint32_t to) const
+		{
+			const auto isOpenEdge = m_loop[from] == to || m_loopBack[from] == to;
+
+			switch (m_kinds[from])
+			{
+			case VertexKind::Manifold:
+				return true;
+			case VertexKind::Border:
+				return isOpenEdge && (m_kinds[to] == VertexKind::Border || m_kinds[to] == VertexKind::Locked);
+			case VertexKind::Seam:
+				return isOpenEdge
+					&& (m_kinds[to] == VertexKind::Seam || m_kinds[to] == VertexKind::Locked)
+					&& GetTwinTarget(from, to) != InvalidVertex;
+			default:
+				return false;
+			}
+		}
+
+		// The vertex the twin of a seam vertex moves to, on the other side of the seam
+		uint32_t GetTwinTarget(uint32_t from, uint32_t to) const
+		{
+			const auto twin = m_nextWedge[from];
+			const auto target = m_loop[from] == to ? m_loopBack[twin] : m_loop[twin];
+
+			if (target == InvalidVertex || m_positionVertex[target] != m_positionVertex[to])
+				return InvalidVertex;
+
+			return target;
+		}
+
+		double GetCollapseError(uint32_t from, uint32_t to) const
+		{
+			auto quadric = m_quadrics[m_positionVertex[from]];
+			AddQuadric(quadric, m_quadrics[m_positionVertex[to]]);
+
+			return GetQuadricError(quadric, m_positions[to]);
+		}
+
+		bool IsCollapseValid(uint32_t from, uint32_t to)
+		{
+			// The vertices both end points are connected to must be exactly the ones opposite the edge,
+			// Otherwise the collapse would join two separate parts of the surface into a non-manifold edge
+			uint32_t sharedTriangles = 0;
+
+			for (auto i = m_adjacency.Offsets[from]; i < m_adjacency.Offsets[from + 1]; i++)
+			{
+				const auto* triangle = &m_indices[m_adjacency.Triangles[i] * 3];
+				sharedTriangles += triangle[0] == to || triangle[1] == to || triangle[2] == to ? 1 : 0;
+
+				for (uint32_t corner = 0; corner < 3; corner++)
+					m_neighbourMarks[triangle[corner]] = 1;
+			}
+
+			uint32_t sharedNeighbours = 0;
+
+			for (auto i = m_adjacency.Offsets[to]; i < m_adjacency.Offsets[to + 1]; i++)
+			{
+				const auto* triangle = &m_indices[m_adjacency.Triangles[i] * 3];
+
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					const auto vertex = triangle[corner];
+
+					if (vertex != from && vertex != to && m_neighbourMarks[vertex] == 1)
+					{
+						sharedNeighbours++;
+						m_neighbourMarks[vertex] = 2;
+					}
+				}
+			}
+
+			for (auto i = m_adjacency.Offsets[from]; i < m_adjacency.Offsets[from + 1]; i++)
+			{
+				const auto* triangle = &m_indices[m_adjacency.Triangles[i] * 3];
+
+				for (uint32_t corner = 0; corner < 3; corner++)
+					m_neighbourMarks[triangle[corner]] = 0;
+			}
+
+			if (sharedTriangles == 0 || sharedNeighbours != sharedTriangles)
+				return false;
+
+			// The remaining triangles around the moving vertex must not flip or become degenerate
+			const auto target = XMLoadFloat3(&m_positions[to]);
+
+			for (auto i = m_adjacency.Offsets[from]; i < m_adjacency.Offsets[from + 1]; i++)
+			{
+				const auto* triangle = &m_indices[m_adjacency.Triangles[i] * 3];
+
+				if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+					continue;
+
+				XMVECTOR corners[3];
+				XMVECTOR movedCorners[3];
+
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					corners[corner] = XMLoadFloat3(&m_positions[triangle[corner]]);
+					movedCorners[corner] = triangle[corner] == from ? target : corners[corner];
+				}
+
+				const auto normal = XMVector3Cross(
+					XMVectorSubtract(corners[1], corners[0]),
+					XMVectorSubtract(corners[2], corners[0]));
+				const auto movedNormal = XMVector3Cross(
+					XMVectorSubtract(movedCorners[1], movedCorners[0]),
+					XMVectorSubtract(movedCorners[2], movedCorners[0]));
+
+				const auto normalLengths = XMVectorGetX(XMVector3Length(normal)) * XMVectorGetX(XMVector3Length(movedNormal));
+
+				// Triangles that already were degenerate can't get any worse
+				if (XMVectorGetX(XMVector3LengthSq(normal)) == 0.0f)
+					continue;
+
+				if (XMVectorGetX(XMVector3Dot(normal, movedNormal)) <= MinNormalAgreement * normalLengths)
+					return false;
+			}
+
+			return true;
+		}
+
+		// Returns the number of triangles the collapse removes
+		size_t ApplyCollapse(uint32_t from, uint32_t to)
+		{
+			m_remap[from] = to;
+
+			size_t removedTriangles = 0;
+
+			for (auto i = m_adjacency.Offsets[from]; i < m_adjacency.Offsets[from + 1]; i++)
+			{
+				const auto* triangle = &m_indices[m_adjacency.Triangles[i] * 3];
+				removedTriangles += triangle[0] == to || triangle[1] == to || triangle[2] == to ? 1 : 0;
+
+				// A later collapse in this pass touching these triangles would be checked against stale geometry
+				for (uint32_t corner = 0; corner < 3; corner++)
+					m_touched[triangle[corner]] = true;
+			}
+
+			return removedTriangles;
+		}
+
+		std::vector<uint32_t> m_indices;
+		const std::vector<XMFLOAT3>& m_positions;
+
+		std::vector<uint32_t> m_positionVertex;
+		std::vector<uint32_t> m_nextWedge;
+		std::vector<VertexKind> m_kinds;
+		std::vector<Quadric> m_quadrics;
+
+		// Rebuilt after every pass
+		TriangleAdjacency m_adjacency;
+		std::vector<uint32_t> m_loop;
+		std::vector<uint32_t> m_loopBack;
+
+		std::vector<uint8_t> m_neighbourMarks;
+		std::vector<bool> m_touched;
+		std::vector<uint32_t> m_remap;
+		double m_maxError;
+	};
+}
+
+std::vector<uint32_t> SimplifyMesh(
+	const std::vector<uint32_t>& indices,
+	const std::vector<XMFLOAT3>& positions,
+	size_t targetIndexCount,
+	float* resultError)
+{
+	EdgeCollapser collapser(indices, positions);
+	collapser.Simplify(targetIndexCount);
+
+	if (resultError)
+		*resultError = collapser.GetError();
+
+	return std::move(collapser.GetIndices());
+}
+
+std::vector<MeshLod> GenerateMeshLods(
+	std::vector<uint32_t>& indices,
+	const std::vector<XMFLOAT3>& positions,
+	uint32_t maxLodCount)
+{
+	std::vector<MeshLod> lods;
+	lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0.0f });
+
+	// Every level is simplified from the previous one, which is much faster than starting over from the full mesh
+	std::vector<uint32_t> previousLevel(indices);
+	auto error = 0.0f;
+
+	while (lods.size() < maxLodCount)
+	{
+		const auto targetTriangleCount = static_cast<size_t>(previousLevel.size() / 3 * MeshLodReduction);
+
+		if (targetTriangleCount < MinMeshLodTriangles)
+			break;
+
+		auto levelError = 0.0f;
+		auto level = SimplifyMesh(previousLevel, positions, targetTriangleCount * 3, &levelError);
+
+		// A level that saves only a few triangles isn't worth its memory
+		if (level.size() > previousLevel.size() * 9 / 10)
+			break;
+
+		// The level's distance to the previous level adds to that level's distance to the full mesh
+		error += levelError;
+
+		OptimizeTriangleOrder(level, positions);
+
+		lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(level.size()), error });
+		indices.insert(indices.end(), level.begin(), level.end());
+		previousLevel.swap(level);
+	}
+
+	return lods;
+}
@@ -0,0 +1,69 @@
+﻿#pragma once
+
+#include "Mesh/Mesh.h"
+#include "Mesh/MeshLod.h"
+#include "Rendering/VertexLayout.h"
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+// Every generated level has at most half the triangles of the previous one
+const float MeshLodReduction = 0.5f;
+
+// Levels with fewer triangles than this aren't worth an extra draw
+const uint32_t MinMeshLodTriangles = 8;
+
+const uint32_t MaxMeshLods = 8;
+
+/*
+ * Simplifies a triangle list to at most targetIndexCount indices, if that is possible without breaking the mesh.
+ * Returns the new triangle list, which only uses the existing vertices. The error of the result, in the units of the
+ * Positions, is stored in resultError.
+ *
+ * Implements edge collapse with the quadric error metric from Garland and Heckbert - "Surface Simplification Using
+ * Quadric Error Metrics" (1997). Every vertex accumulates the planes of the triangles around it, and the cheapest edges
+ * Are collapsed into one of their end points. Since no new vertices are created, all levels of detail of a mesh can
+ * Share its vertex buffer.
+ *
+ * The outline of the mesh is preserved: vertices on open borders only move along the border, and vertices on attribute
+ * Seams (split vertices with the same position, e.g. at texture or normal discontinuities) only move along the seam,
+ * Together with their twin on the other side. Corners where more than two seams meet never move. Collapses that would
+ * Fold over a triangle or make the mesh non-manifold are skipped.
+ */
+std::vector<uint32_t> SimplifyMesh(
+	const std::vector<uint32_t>& indices,
+	const std::vector<DirectX::XMFLOAT3>& positions,
+	size_t targetIndexCount,
+	float* resultError);
+
+/*
+ * Appends a chain of simplified levels of detail to the index buffer, each with at most MeshLodReduction of the
+ * Triangles of the previous level, and returns all levels including the original one as level 0.
+ * The chain ends when a level would have fewer than MinMeshLodTriangles triangles, or when the mesh can't be
+ * Simplified any further. Every level is optimized for the post-transform vertex cache.
+ *
+ * Level 0 keeps its position in the index buffer, so meshlets built before the levels were generated stay valid.
+ */
+std::vector<MeshLod> GenerateMeshLods(
+	std::vector<uint32_t>& indices,
+	const std::vector<DirectX::XMFLOAT3>& positions,
+	uint32_t maxLodCount = MaxMeshLods);
+
+// Works for any vertex type with a VertexLayout that has a position attribute.
+// Best called after OptimizeMesh, since the levels are appended to the optimized index buffer.
+template<typename TVertex>
+std::vector<MeshLod> GenerateMeshLods(Mesh<TVertex>& mesh, uint32_t maxLodCount = MaxMeshLods)
+{
+	std::vector<DirectX::XMFLOAT3> positions;
+	positions.reserve(mesh.Vertices.size());
+	for (const auto& vertex : mesh.Vertices)
+	{
+		DirectX::XMFLOAT3 position;
+		DirectX::XMStoreFloat3(&position, FetchVertexAttribute<VertexSemantic::Position>(vertex));
+		positions.push_back(position);
+	}
+
+	return GenerateMeshLods(mesh.Indices, positions, maxLodCount);
+}
@@ -0,0 +1,219 @@
+﻿#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// Vertex -> triangle adjacency stored in compressed form
+	struct TriangleAdjacency
+	{
+		std::vector<uint32_t> Offsets;
+		std::vector<uint32_t> Triangles;
+	};
+
+	TriangleAdjacency BuildTriangleAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		TriangleAdjacency adjacency;
+		adjacency.Offsets.assign(vertexCount + 1, 0);
+
+		for (const auto index : indices)
+			adjacency.Offsets[index + 1]++;
+
+		for (size_t i = 0; i < vertexCount; i++)
+			adjacency.Offsets[i + 1] += adjacency.Offsets[i];
+
+		adjacency.Triangles.resize(indices.size());
+
+		std::vector<uint32_t> fill(adjacency.Offsets.begin(), adjacency.Offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			adjacency.Triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+		return adjacency;
+	}
+
+	// Computes the bounding sphere and normal cone of a meshlet whose indices start at the given pointer
+	void ComputeMeshletBounds(
+		Meshlet& meshlet,
+		const uint32_t* indices,
+		const std::vector<XMFLOAT3>& positions)
+	{
+		// The sphere is centered on the bounding box. Not the smallest sphere, but close for compact clusters.
+		auto boundsMin = XMLoadFloat3(&positions[indices[0]]);
+		auto boundsMax = boundsMin;
+
+		for (uint32_t i = 1; i < meshlet.TriangleCount * 3; i++)
+		{
+			const auto position = XMLoadFloat3(&positions[indices[i]]);
+			boundsMin = XMVectorMin(boundsMin, position);
+			boundsMax = XMVectorMax(boundsMax, position);
+		}
+
+		const auto center = XMVectorScale(XMVectorAdd(boundsMin, boundsMax), 0.5f);
+		auto radius = XMVectorZero();
+
+		for (uint32_t i = 0; i < meshlet.TriangleCount * 3; i++)
+			radius = XMVectorMax(radius, XMVector3Length(XMVectorSubtract(XMLoadFloat3(&positions[indices[i]]), center)));
+
+		XMStoreFloat3(&meshlet.Center, center);
+		meshlet.Radius = XMVectorGetX(radius);
+
+		// Front faces are clockwise in a left-handed space, so (b - a) x (c - a) points out of the front face
+		std::vector<XMVECTOR> normals;
+		normals.reserve(meshlet.TriangleCount);
+		auto normalSum = XMVectorZero();
+
+		for (uint32_t triangle = 0; triangle < meshlet.TriangleCount; triangle++)
+		{
+			const auto a = XMLoadFloat3(&positions[indices[triangle * 3 + 0]]);
+			const auto b = XMLoadFloat3(&positions[indices[triangle * 3 + 1]]);
+			const auto c = XMLoadFloat3(&positions[indices[triangle * 3 + 2]]);
+			const auto normal = XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(c, a));
+
+			// Degenerate triangles are never rasterized, so they don't constrain the cone
+			if (XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f)
+			{
+				normals.push_back(XMVector3Normalize(normal));
+				normalSum = XMVectorAdd(normalSum, normals.back());
+			}
+		}
+
+		meshlet.ConeAxis = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		meshlet.ConeCutoff = 1.0f;
+
+		if (normals.empty() || XMVectorGetX(XMVector3LengthSq(normalSum)) == 0.0f)
+			return;
+
+		const auto axis = XMVector3Normalize(normalSum);
+		auto minimumDot = 1.0f;
+
+		for (const auto& normal : normals)
+			minimumDot = std::min(minimumDot, XMVectorGetX(XMVector3Dot(axis, normal)));
+
+		XMStoreFloat3(&meshlet.ConeAxis, axis);
+
+		// The cone of eye directions that see only back faces is the normal cone widened by 90 degrees on every side
+		// And flipped. It is empty once the normals spread over a hemisphere or more.
+		if (minimumDot > 0.0f)
+			meshlet.ConeCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+	}
+}
+
+std::vector<Meshlet> BuildMeshlets(std::vector<uint32_t>& indices, const std::vector<XMFLOAT3>& positions)
+{
+	const auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	const auto adjacency = BuildTriangleAdjacency(indices, positions.size());
+
+	std::vector<bool> emitted(triangleCount, false);
+	// For every vertex, the meshlet it was last added to. Tells in constant time whether a vertex is new to a meshlet.
+	std::vector<uint32_t> vertexMeshlet(positions.size(), UINT32_MAX);
+
+	std::vector<uint32_t> meshletIndices;
+	meshletIndices.reserve(indices.size());
+
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	uint32_t nextSeed = 0;
+
+	auto countNewVertices = [&](uint32_t triangle, uint32_t meshletIndex)
+	{
+		uint32_t newVertices = 0;
+		for (uint32_t corner = 0; corner < 3; corner++)
+			newVertices += vertexMeshlet[indices[triangle * 3 + corner]] != meshletIndex ? 1 : 0;
+
+		return newVertices;
+	};
+
+	while (true)
+	{
+		while (nextSeed < triangleCount && emitted[nextSeed])
+			nextSeed++;
+
+		if (nextSeed == triangleCount)
+			break;
+
+		const auto meshletIndex = static_cast<uint32_t>(meshlets.size());
+
+		Meshlet meshlet = {};
+		meshlet.FirstTriangle = static_cast<uint32_t>(meshletIndices.size() / 3);
+		meshletVertices.clear();
+
+		auto candidate = nextSeed;
+
+		while (true)
+		{
+			emitted[candidate] = true;
+			meshlet.TriangleCount++;
+
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const auto vertex = indices[candidate * 3 + corner];
+				meshletIndices.push_back(vertex);
+
+				if (vertexMeshlet[vertex] != meshletIndex)
+				{
+					vertexMeshlet[vertex] = meshletIndex;
+					meshletVertices.push_back(vertex);
+				}
+			}
+
+			if (meshlet.TriangleCount == MaxMeshletTriangles)
+				break;
+
+			// The neighbour adding the fewest vertices keeps the meshlet compact and its vertex count low
+			auto bestTriangle = UINT32_MAX;
+			auto bestNewVertices = UINT32_MAX;
+
+			for (size_t i = 0; i < meshletVertices.size() && bestNewVertices > 0; i++)
+			{
+				const auto vertex = meshletVertices[i];
+
+				for (auto j = adjacency.Offsets[vertex]; j < adjacency.Offsets[vertex + 1]; j++)
+				{
+					const auto triangle = adjacency.Triangles[j];
+
+					if (emitted[triangle])
+						continue;
+
+					const auto newVertices = countNewVertices(triangle, meshletIndex);
+
+					if (newVertices < bestNewVertices || (newVertices == bestNewVertices && triangle < bestTriangle))
+					{
+						bestTriangle = triangle;
+						bestNewVertices = newVertices;
+					}
+				}
+			}
+
+			// Without a neighbour, the meshlet continues with the next triangle in index buffer order.
+			// Meshes made of many small disconnected parts would otherwise end up with tiny meshlets.
+			if (bestTriangle == UINT32_MAX)
+			{
+				while (nextSeed < triangleCount && emitted[nextSeed])
+					nextSeed++;
+
+				if (nextSeed == triangleCount)
+					break;
+
+				bestTriangle = nextSeed;
+				bestNewVertices = countNewVertices(bestTriangle, meshletIndex);
+			}
+
+			if (meshletVertices.size() + bestNewVertices > MaxMeshletVertices)
+				break;
+
+			candidate = bestTriangle;
+		}
+
+		meshlet.VertexCount = static_cast<uint32_t>(meshletVertices.size());
+		ComputeMeshletBounds(meshlet, meshletIndices.data() + meshlet.FirstTriangle * 3, positions);
+
+		meshlets.push_back(meshlet);
+	}
+
+	indices.swap(meshletIndices);
+
+	return meshlets;
+}
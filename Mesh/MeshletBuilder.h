@@ -0,0 +1,70 @@
+﻿#pragma once
+
+#include "Mesh/Mesh.h"
+#include "Rendering/VertexLayout.h"
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+// Meshlet limits. 64 vertices and 124 triangles are what mesh shader hardware handles best,
+// And small enough that a meshlet's bounds stay tight.
+const uint32_t MaxMeshletVertices = 64;
+const uint32_t MaxMeshletTriangles = 124;
+
+/*
+ * A cluster of neighbouring triangles with its bounds, which can be culled as a whole.
+ * Matches the Meshlet struct in Common.hlsli, and is stored like this in asset containers.
+ */
+struct Meshlet
+{
+	// Bounding sphere in mesh space
+	DirectX::XMFLOAT3 Center;
+	float Radius;
+
+	/*
+	 * Normal cone: the normals of all triangles lie within the cone around ConeAxis. ConeCutoff is the sine of
+	 * The cone's half angle, so the meshlet faces away from every eye position for which
+	 *
+	 *     dot(Center - eye, ConeAxis) >= ConeCutoff * length(Center - eye) + Radius
+	 *
+	 * A cutoff of 1 never culls. It is used when the normals spread over more than a hemisphere.
+	 */
+	DirectX::XMFLOAT3 ConeAxis;
+	float ConeCutoff;
+
+	// The meshlet's triangles are [FirstTriangle, FirstTriangle + TriangleCount) of the mesh's index buffer
+	uint32_t FirstTriangle;
+	uint32_t TriangleCount;
+	uint32_t VertexCount;
+	uint32_t Padding;
+};
+
+static_assert(sizeof(Meshlet) == 48, "The meshlet must match the shader and asset container layout");
+
+/*
+ * Splits a triangle list into meshlets and reorders the triangles so that every meshlet is a contiguous range.
+ *
+ * Meshlets are grown greedily: starting from the first triangle that isn't in a meshlet yet, the neighbouring
+ * Triangle that adds the fewest new vertices is added, until a limit is reached. Seeds are taken in index buffer
+ * Order, so the triangle order of an optimized mesh is mostly preserved. The winding of every triangle is preserved.
+ */
+std::vector<Meshlet> BuildMeshlets(std::vector<uint32_t>& indices, const std::vector<DirectX::XMFLOAT3>& positions);
+
+// Works for any vertex type with a VertexLayout that has a position attribute.
+// Best called after OptimizeMesh, since it changes the triangle order but not the vertices.
+template<typename TVertex>
+std::vector<Meshlet> BuildMeshlets(Mesh<TVertex>& mesh)
+{
+	std::vector<DirectX::XMFLOAT3> positions;
+	positions.reserve(mesh.Vertices.size());
+	for (const auto& vertex : mesh.Vertices)
+	{
+		DirectX::XMFLOAT3 position;
+		DirectX::XMStoreFloat3(&position, FetchVertexAttribute<VertexSemantic::Position>(vertex));
+		positions.push_back(position);
+	}
+
+	return BuildMeshlets(mesh.Indices, positions);
+}
@@ -0,0 +1,427 @@
+﻿#include "BoxCollision.h"
+
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// The second box's faces only win over the first box's if they overlap clearly less. Boxes resting face to face
+	// Would otherwise swap reference faces from step to step, and with them the contact points.
+	const float FaceAxisRelativeTolerance = 0.98f;
+	const float FaceAxisAbsoluteTolerance = 0.001f;
+
+	// Same for the edge axes, which give a single contact point, so near ties go to the faces and their full manifold
+	const float EdgeAxisRelativeTolerance = 0.95f;
+	const float EdgeAxisAbsoluteTolerance = 0.001f;
+
+	// The cross product of nearly parallel edges is too short to be a meaningful axis
+	const float MinEdgeAxisLength = 1e-3f;
+
+	// Clipping a quad against four planes adds at most one point per plane
+	const int MaxClippedPoints = 8;
+
+	struct Box
+	{
+		XMVECTOR Center;
+		XMVECTOR HalfExtents;
+		// The rows are the axes of the box in world space
+		XMMATRIX Axes;
+	};
+
+	Box LoadBox(const OrientedBox& box)
+	{
+		return Box{
+			XMLoadFloat3(&box.Center),
+			XMLoadFloat3(&box.HalfExtents),
+			XMMatrixRotationQuaternion(XMLoadFloat4(&box.Rotation)) };
+	}
+
+	float Dot(FXMVECTOR a, FXMVECTOR b)
+	{
+		return XMVectorGetX(XMVector3Dot(a, b));
+	}
+
+	float Clamp(float value, float limit)
+	{
+		return value < -limit ? -limit : (value > limit ? limit : value);
+	}
+
+	// Keeps the part of a convex polygon where dot(normal, point) <= offset (Sutherland-Hodgman)
+	int ClipPolygon(const XMVECTOR* points, int pointCount, FXMVECTOR normal, float offset, XMVECTOR* clipped)
+	{
+		int clippedCount = 0;
+
+		for (int i = 0; i < pointCount; i++)
+		{
+			const auto start = points[i];
+			const auto end = points[(i + 1) % pointCount];
+			const auto startDistance = Dot(normal, start) - offset;
+			const auto endDistance = Dot(normal, end) - offset;
+
+			if (startDistance <= 0.0f)
+				clipped[clippedCount++] = start;
+
+			if ((startDistance <= 0.0f) != (endDistance <= 0.0f))
+				clipped[clippedCount++] = XMVectorLerp(start, end, startDistance / (startDistance - endDistance));
+		}
+
+		return clippedCount;
+	}
+
+	// Keeps the deepest point, the point farthest from it, and the points on either side of the line through those two
+	// That span the largest triangles with it
+	uint32_t ReduceContactPoints(const ContactPoint* points, uint32_t pointCount, FXMVECTOR normal, ContactPoint* reduced)
+	{
+		if (pointCount <= MaxContactPoints)
+		{
+			for (uint32_t i = 0; i < pointCount; i++)
+				reduced[i] = points[i];
+
+			return pointCount;
+		}
+
+		uint32_t deepest = 0;
+		for (uint32_t i = 1; i < pointCount; i++)
+		{
+			if (points[i].Depth > points[deepest].Depth)
+				deepest = i;
+		}
+
+		const auto first = XMLoadFloat3(&points[deepest].Position);
+
+		uint32_t farthest = deepest;
+		float farthestDistanceSquared = 0.0f;
+
+		for (uint32_t i = 0; i < pointCount; i++)
+		{
+			const auto distanceSquared = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&points[i].Position), first)));
+
+			if (distanceSquared > farthestDistanceSquared)
+			{
+				farthest = i;
+				farthestDistanceSquared = distanceSquared;
+			}
+		}
+
+		const auto edge = XMVectorSubtract(XMLoadFloat3(&points[farthest].Position), first);
+
+		uint32_t left = deepest;
+		uint32_t right = deepest;
+		float largestArea = 0.0f;
+		float smallestArea = 0.0f;
+
+		for (uint32_t i = 0; i < pointCount; i++)
+		{
+			const auto area = Dot(XMVector3Cross(edge, XMVectorSubtract(XMLoadFloat3(&points[i].Position), first)), normal);
+
+			if (area > largestArea)
+			{
+				left = i;
+				largestArea = area;
+			}
+			else if (area < smallestArea)
+			{
+				right = i;
+				smallestArea = area;
+			}
+		}
+
+		uint32_t reducedCount = 0;
+		reduced[reducedCount++] = points[deepest];
+
+		if (farthest != deepest)
+			reduced[reducedCount++] = points[farthest];
+		if (left != deepest)
+			reduced[reducedCount++] = points[left];
+		if (right != deepest)
+			reduced[reducedCount++] = points[right];
+
+		return reducedCount;
+	}
+
+	/*
+	 * Clips the face of the incident box that points most against the reference normal to the sides of the reference
+	 * Face, and keeps the points that lie below the reference face. The reference normal is an axis of the reference
+	 * Box, pointing towards the incident box.
+	 */
+	uint32_t ClipFaceContacts(
+		const Box& reference,
+		int referenceAxis,
+		FXMVECTOR referenceNormal,
+		const Box& incident,
+		ContactPoint* points)
+	{
+		// The cosines between the reference normal and the incident box's axes
+		const auto incidentCosines = XMVector3TransformNormal(referenceNormal, XMMatrixTranspose(incident.Axes));
+
+		int incidentAxis = 0;
+		for (int axis = 1; axis < 3; axis++)
+		{
+			if (std::abs(XMVectorGetByIndex(incidentCosines, axis)) > std::abs(XMVectorGetByIndex(incidentCosines, incidentAxis)))
+				incidentAxis = axis;
+		}
+
+		const auto incidentSign = XMVectorGetByIndex(incidentCosines, incidentAxis) > 0.0f ? -1.0f : 1.0f;
+		const auto incidentCenter = XMVectorMultiplyAdd(
+			incident.Axes.r[incidentAxis],
+			XMVectorReplicate(incidentSign * XMVectorGetByIndex(incident.HalfExtents, incidentAxis)),
+			incident.Center);
+
+		const auto incidentU = XMVectorScale(incident.Axes.r[(incidentAxis + 1) % 3],
+			XMVectorGetByIndex(incident.HalfExtents, (incidentAxis + 1) % 3));
+		const auto incidentV = XMVectorScale(incident.Axes.r[(incidentAxis + 2) % 3],
+			XMVectorGetByIndex(incident.HalfExtents, (incidentAxis + 2) % 3));
+
+		XMVECTOR polygon[MaxClippedPoints] = {
+			XMVectorAdd(XMVectorAdd(incidentCenter, incidentU), incidentV),
+			XMVectorAdd(XMVectorSubtract(incidentCenter, incidentU), incidentV),
+			XMVectorSubtract(XMVectorSubtract(incidentCenter, incidentU), incidentV),
+			XMVectorSubtract(XMVectorAdd(incidentCenter, incidentU), incidentV) };
+		XMVECTOR clipped[MaxClippedPoints];
+		int pointCount = 4;
+
+		// The four side planes of the reference face
+		for (int side = 1; side <= 2 && pointCount > 0; side++)
+		{
+			const auto axis = (referenceAxis + side) % 3;
+			const auto sideNormal = reference.Axes.r[axis];
+			const auto centerDistance = Dot(sideNormal, reference.Center);
+			const auto extent = XMVectorGetByIndex(reference.HalfExtents, axis);
+
+			pointCount = ClipPolygon(polygon, pointCount, sideNormal, centerDistance + extent, clipped);
+			pointCount = ClipPolygon(clipped, pointCount, XMVectorNegate(sideNormal), extent - centerDistance, polygon);
+		}
+
+		const auto faceDistance = Dot(referenceNormal, reference.Center) + XMVectorGetByIndex(reference.HalfExtents, referenceAxis);
+
+		ContactPoint candidates[MaxClippedPoints];
+		uint32_t candidateCount = 0;
+
+		for (int i = 0; i < pointCount; i++)
+		{
+			const auto separation = Dot(referenceNormal, polygon[i]) - faceDistance;
+
+			if (separation > 0.0f)
+				continue;
+
+			auto& candidate = candidates[candidateCount++];
+			XMStoreFloat3(&candidate.Position, XMVectorMultiplyAdd(referenceNormal, XMVectorReplicate(-0.5f * separation), polygon[i]));
+			candidate.Depth = -separation;
+		}
+
+		return ReduceContactPoints(candidates, candidateCount, referenceNormal, points);
+	}
+
+	// The point where an edge of a along edgeAxisA comes closest to an edge of b along edgeAxisB. The normal points from a to b.
+	ContactPoint FindEdgeContact(const Box& a, int edgeAxisA, const Box& b, int edgeAxisB, FXMVECTOR normal, float depth)
+	{
+		// The edges that lie farthest towards the other box
+		auto pointA = a.Center;
+		auto pointB = b.Center;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (axis != edgeAxisA)
+			{
+				const auto extent = XMVectorGetByIndex(a.HalfExtents, axis);
+				pointA = XMVectorMultiplyAdd(a.Axes.r[axis], XMVectorReplicate(Dot(a.Axes.r[axis], normal) > 0.0f ? extent : -extent), pointA);
+			}
+
+			if (axis != edgeAxisB)
+			{
+				const auto extent = XMVectorGetByIndex(b.HalfExtents, axis);
+				pointB = XMVectorMultiplyAdd(b.Axes.r[axis], XMVectorReplicate(Dot(b.Axes.r[axis], normal) > 0.0f ? -extent : extent), pointB);
+			}
+		}
+
+		const auto directionA = a.Axes.r[edgeAxisA];
+		const auto directionB = b.Axes.r[edgeAxisB];
+		const auto halfLengthA = XMVectorGetByIndex(a.HalfExtents, edgeAxisA);
+		const auto halfLengthB = XMVectorGetByIndex(b.HalfExtents, edgeAxisB);
+
+		// Closest points of two segments, where the lines aren't parallel, or the edge axis wouldn't have been chosen
+		const auto offset = XMVectorSubtract(pointA, pointB);
+		const auto cosine = Dot(directionA, directionB);
+		const auto offsetAlongA = Dot(directionA, offset);
+		const auto offsetAlongB = Dot(directionB, offset);
+
+		auto s = Clamp((cosine * offsetAlongB - offsetAlongA) / (1.0f - cosine * cosine), halfLengthA);
+		const auto t = Clamp(cosine * s + offsetAlongB, halfLengthB);
+		s = Clamp(cosine * t - offsetAlongA, halfLengthA);
+
+		const auto closestA = XMVectorMultiplyAdd(directionA, XMVectorReplicate(s), pointA);
+		const auto closestB = XMVectorMultiplyAdd(directionB, XMVectorReplicate(t), pointB);
+
+		ContactPoint point;
+		XMStoreFloat3(&point.Position, XMVectorScale(XMVectorAdd(closestA, closestB), 0.5f));
+		point.Depth = depth;
+
+		return point;
+	}
+}
+
+bool CollideBoxes(const OrientedBox& boxA, const OrientedBox& boxB, ContactManifold& manifold)
+{
+	const auto a = LoadBox(boxA);
+	const auto b = LoadBox(boxB);
+	const auto zero = XMVectorZero();
+
+	const auto offset = XMVectorSubtract(b.Center, a.Center);
+
+	// Row i holds the cosines between axis i of A and the three axes of B, which is B's rotation in A's frame
+	const auto rotation = XMMatrixMultiply(a.Axes, XMMatrixTranspose(b.Axes));
+
+	// The epsilon keeps the radii along the cross products of nearly parallel edges from collapsing to zero, where
+	// Rounding could make them look like separating axes
+	const auto epsilon = XMVectorReplicate(1e-6f);
+
+	XMMATRIX absRotation;
+	absRotation.r[0] = XMVectorAdd(XMVectorAbs(rotation.r[0]), epsilon);
+	absRotation.r[1] = XMVectorAdd(XMVectorAbs(rotation.r[1]), epsilon);
+	absRotation.r[2] = XMVectorAdd(XMVectorAbs(rotation.r[2]), epsilon);
+	absRotation.r[3] = zero;
+
+	// The offset in A's frame
+	const auto offsetInA = XMVector3TransformNormal(offset, XMMatrixTranspose(a.Axes));
+
+	// The overlap along each axis is the sum of the projected radii minus the projected distance of the centers.
+	// A negative overlap separates the boxes.
+	const auto faceOverlapsA = XMVectorSubtract(
+		XMVectorAdd(a.HalfExtents, XMVector3TransformNormal(b.HalfExtents, XMMatrixTranspose(absRotation))),
+		XMVectorAbs(offsetInA));
+
+	if (!XMVector3GreaterOrEqual(faceOverlapsA, zero))
+		return false;
+
+	const auto offsetInB = XMVector3TransformNormal(offsetInA, rotation);
+	const auto faceOverlapsB = XMVectorSubtract(
+		XMVectorAdd(XMVector3TransformNormal(a.HalfExtents, absRotation), b.HalfExtents),
+		XMVectorAbs(offsetInB));
+
+	if (!XMVector3GreaterOrEqual(faceOverlapsB, zero))
+		return false;
+
+	// Axis i of A crossed with each axis of B. The lanes are the axes of B.
+	XMVECTOR edgeOverlaps[3];
+
+	for (int i = 0; i < 3; i++)
+	{
+		const auto i1 = (i + 1) % 3;
+		const auto i2 = (i + 2) % 3;
+
+		const auto radiusA = XMVectorAdd(
+			XMVectorScale(absRotation.r[i2], XMVectorGetByIndex(a.HalfExtents, i1)),
+			XMVectorScale(absRotation.r[i1], XMVectorGetByIndex(a.HalfExtents, i2)));
+		const auto radiusB = XMVectorAdd(
+			XMVectorMultiply(XMVectorSwizzle<1, 2, 0, 3>(b.HalfExtents), XMVectorSwizzle<2, 0, 1, 3>(absRotation.r[i])),
+			XMVectorMultiply(XMVectorSwizzle<2, 0, 1, 3>(b.HalfExtents), XMVectorSwizzle<1, 2, 0, 3>(absRotation.r[i])));
+		const auto distance = XMVectorAbs(XMVectorSubtract(
+			XMVectorScale(rotation.r[i1], XMVectorGetByIndex(offsetInA, i2)),
+			XMVectorScale(rotation.r[i2], XMVectorGetByIndex(offsetInA, i1))));
+
+		const auto overlaps = XMVectorSubtract(XMVectorAdd(radiusA, radiusB), distance);
+
+		// The axes aren't unit length. Dividing by their length makes the overlaps comparable with the face axes.
+		const auto axisLengths = XMVectorSqrt(XMVectorMax(
+			XMVectorSubtract(XMVectorReplicate(1.0f), XMVectorMultiply(rotation.r[i], rotation.r[i])),
+			zero));
+		const auto longEnough = XMVectorGreater(axisLengths, XMVectorReplicate(MinEdgeAxisLength));
+
+		edgeOverlaps[i] = XMVectorSelect(
+			XMVectorReplicate(FLT_MAX),
+			XMVectorDivide(overlaps, XMVectorMax(axisLengths, XMVectorReplicate(MinEdgeAxisLength))),
+			longEnough);
+
+		if (!XMVector3GreaterOrEqual(edgeOverlaps[i], zero))
+			return false;
+	}
+
+	// No axis separates the boxes. The axis of least overlap becomes the contact normal.
+	int faceAxisA = 0;
+	int faceAxisB = 0;
+
+	for (int i = 1; i < 3; i++)
+	{
+		if (XMVectorGetByIndex(faceOverlapsA, i) < XMVectorGetByIndex(faceOverlapsA, faceAxisA))
+			faceAxisA = i;
+		if (XMVectorGetByIndex(faceOverlapsB, i) < XMVectorGetByIndex(faceOverlapsB, faceAxisB))
+			faceAxisB = i;
+	}
+
+	auto faceOverlap = XMVectorGetByIndex(faceOverlapsA, faceAxisA);
+	auto useFaceOfB = false;
+
+	if (XMVectorGetByIndex(faceOverlapsB, faceAxisB)
+		< faceOverlap * FaceAxisRelativeTolerance - FaceAxisAbsoluteTolerance)
+	{
+		faceOverlap = XMVectorGetByIndex(faceOverlapsB, faceAxisB);
+		useFaceOfB = true;
+	}
+
+	auto edgeAxisA = -1;
+	auto edgeAxisB = -1;
+	auto edgeOverlap = faceOverlap * EdgeAxisRelativeTolerance - EdgeAxisAbsoluteTolerance;
+
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			if (XMVectorGetByIndex(edgeOverlaps[i], j) < edgeOverlap)
+			{
+				edgeAxisA = i;
+				edgeAxisB = j;
+				edgeOverlap = XMVectorGetByIndex(edgeOverlaps[i], j);
+			}
+		}
+	}
+
+	if (edgeAxisA >= 0)
+	{
+		auto normal = XMVector3Normalize(XMVector3Cross(a.Axes.r[edgeAxisA], b.Axes.r[edgeAxisB]));
+		if (Dot(normal, offset) < 0.0f)
+			normal = XMVectorNegate(normal);
+
+		XMStoreFloat3(&manifold.Normal, normal);
+		manifold.Points[0] = FindEdgeContact(a, edgeAxisA, b, edgeAxisB, normal, edgeOverlap);
+		manifold.PointCount = 1;
+
+		return true;
+	}
+
+	ContactPoint points[MaxContactPoints];
+	uint32_t pointCount;
+	XMVECTOR normal;
+
+	if (useFaceOfB)
+	{
+		// B's face points towards A, so the normal from A to B is its opposite
+		const auto referenceNormal = XMVectorGetByIndex(offsetInB, faceAxisB) > 0.0f
+			? XMVectorNegate(b.Axes.r[faceAxisB])
+			: b.Axes.r[faceAxisB];
+
+		pointCount = ClipFaceContacts(b, faceAxisB, referenceNormal, a, points);
+		normal = XMVectorNegate(referenceNormal);
+	}
+	else
+	{
+		normal = XMVectorGetByIndex(offsetInA, faceAxisA) < 0.0f
+			? XMVectorNegate(a.Axes.r[faceAxisA])
+			: a.Axes.r[faceAxisA];
+
+		pointCount = ClipFaceContacts(a, faceAxisA, normal, b, points);
+	}
+
+	// Rounding can clip away every point of a barely touching face
+	if (pointCount == 0)
+		return false;
+
+	XMStoreFloat3(&manifold.Normal, normal);
+	manifold.PointCount = pointCount;
+
+	for (uint32_t i = 0; i < pointCount; i++)
+		manifold.Points[i] = points[i];
+
+	return true;
+}
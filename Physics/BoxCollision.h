@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+
+// Most points a box-box contact needs to rest stably on a face
+const uint32_t MaxContactPoints = 4;
+
+struct OrientedBox
+{
+	DirectX::XMFLOAT3 Center;
+	DirectX::XMFLOAT3 HalfExtents;
+	// Unit quaternion
+	DirectX::XMFLOAT4 Rotation;
+};
+
+struct ContactPoint
+{
+	// World space, halfway between the two surfaces
+	DirectX::XMFLOAT3 Position;
+	// How far the boxes overlap along the normal
+	float Depth;
+};
+
+struct ContactManifold
+{
+	// Points from the first box to the second
+	DirectX::XMFLOAT3 Normal;
+	uint32_t PointCount;
+	ContactPoint Points[MaxContactPoints];
+};
+
+/*
+ * Tests two oriented boxes against the 15 potential separating axes: the three face normals of each box and the
+ * Nine cross products of their edge directions. Each group of three axes is tested at once, one axis per SIMD lane.
+ *
+ * If no axis separates the boxes, the axis of least overlap becomes the contact normal. For a face axis, the face of
+ * The other box that points against it is clipped to the reference face, which yields up to four points. For an edge
+ * Axis, the contact is the single point where the two edges come closest.
+ *
+ * Returns false, and leaves the manifold alone, if the boxes don't overlap.
+ */
+bool CollideBoxes(const OrientedBox& a, const OrientedBox& b, ContactManifold& manifold);
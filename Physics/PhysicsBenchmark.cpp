@@ -0,0 +1,119 @@
+﻿#include "PhysicsBenchmark.h"
+
+#include "Physics/RigidBodyWorld.h"
+#include "Externals/SDL/Include/SDL.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	const float StepTime = 1.0f / 60.0f;
+	const int StepsPerSecond = 60;
+	const int SimulatedSeconds = 10;
+
+	const int LayerCount = 10;
+	const float BoxHalfExtent = 0.25f;
+	// More than the diagonal of a box, so no two boxes start out overlapping, however they're rotated
+	const float BoxSpacing = 1.0f;
+	const float LayerSpacing = 1.0f;
+}
+
+void BenchmarkRigidBodies(size_t boxCount, JobSystem& jobSystem)
+{
+	RigidBodyWorld world;
+
+	const auto boxesPerLayer = (boxCount + LayerCount - 1) / LayerCount;
+	const auto rowLength = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(boxesPerLayer))));
+	const auto fieldHalfSize = rowLength * BoxSpacing * 0.5f;
+
+	RigidBodyDescription ground = {};
+	ground.Position = XMFLOAT3(0.0f, -1.0f, 0.0f);
+	ground.Rotation = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+	// Boxes that tumble off the edge of the pile slide a few meters, and would fall forever if the ground ended there
+	ground.HalfExtents = XMFLOAT3(fieldHalfSize * 2.0f, 1.0f, fieldHalfSize * 2.0f);
+	world.AddBox(ground);
+
+	for (size_t i = 0; i < boxCount; i++)
+	{
+		const auto layer = i / boxesPerLayer;
+		const auto x = i % boxesPerLayer % rowLength;
+		const auto z = i % boxesPerLayer / rowLength;
+
+		// Every other layer is offset by half a box, so the boxes land on edges and corners instead of stacking neatly
+		const auto offset = layer % 2 == 0 ? 0.0f : BoxSpacing * 0.5f;
+
+		RigidBodyDescription box = {};
+		box.Position = XMFLOAT3(
+			x * BoxSpacing - fieldHalfSize + offset,
+			BoxHalfExtent + 0.5f + layer * LayerSpacing,
+			z * BoxSpacing - fieldHalfSize + offset);
+		XMStoreFloat4(&box.Rotation, XMQuaternionRotationRollPitchYaw(i * 0.7f, i * 1.3f, 0.0f));
+		box.HalfExtents = XMFLOAT3(BoxHalfExtent, BoxHalfExtent, BoxHalfExtent);
+		box.Mass = 1.0f;
+
+		world.AddBox(box);
+	}
+
+	SDL_Log("Rigid bodies: %u boxes on %u threads, %d seconds at %d Hz",
+		static_cast<unsigned int>(boxCount),
+		jobSystem.GetThreadCount(),
+		SimulatedSeconds,
+		StepsPerSecond);
+
+	int stepsOverBudget = 0;
+
+	for (int second = 0; second < SimulatedSeconds; second++)
+	{
+		RigidBodyStepStatistics total = {};
+
+		for (int step = 0; step < StepsPerSecond; step++)
+		{
+			world.Step(StepTime, jobSystem);
+
+			const auto& statistics = world.GetLastStepStatistics();
+			total.VelocitySeconds += statistics.VelocitySeconds;
+			total.BroadphaseSeconds += statistics.BroadphaseSeconds;
+			total.NarrowphaseSeconds += statistics.NarrowphaseSeconds;
+			total.IslandSeconds += statistics.IslandSeconds;
+			total.SolverSeconds += statistics.SolverSeconds;
+			total.PositionSeconds += statistics.PositionSeconds;
+
+			const auto stepSeconds = statistics.VelocitySeconds
+				+ statistics.BroadphaseSeconds
+				+ statistics.NarrowphaseSeconds
+				+ statistics.IslandSeconds
+				+ statistics.SolverSeconds
+				+ statistics.PositionSeconds;
+
+			if (stepSeconds > StepTime)
+				stepsOverBudget++;
+		}
+
+		const auto& last = world.GetLastStepStatistics();
+		const auto toMilliseconds = 1000.0 / StepsPerSecond;
+
+		SDL_Log("Second %d: %.2f ms per step - velocities %.2f, broadphase %.2f, narrowphase %.2f, islands %.2f, solver %.2f, positions %.2f. Pairs: %u, touching: %u, contacts: %u, islands: %u, largest: %u bodies, asleep: %u bodies",
+			second + 1,
+			(total.VelocitySeconds + total.BroadphaseSeconds + total.NarrowphaseSeconds
+				+ total.IslandSeconds + total.SolverSeconds + total.PositionSeconds) * toMilliseconds,
+			total.VelocitySeconds * toMilliseconds,
+			total.BroadphaseSeconds * toMilliseconds,
+			total.NarrowphaseSeconds * toMilliseconds,
+			total.IslandSeconds * toMilliseconds,
+			total.SolverSeconds * toMilliseconds,
+			total.PositionSeconds * toMilliseconds,
+			last.PairCount,
+			last.ManifoldCount,
+			last.ContactCount,
+			last.IslandCount,
+			last.LargestIslandBodyCount,
+			last.AsleepBodyCount);
+	}
+
+	SDL_Log("Rigid bodies: %d of %d steps took longer than %.1f ms",
+		stepsOverBudget,
+		SimulatedSeconds * StepsPerSecond,
+		StepTime * 1000.0f);
+}
@@ -0,0 +1,11 @@
+﻿#pragma once
+
+#include "Threading/JobSystem.h"
+
+#include <cstddef>
+
+/*
+ * Drops boxCount boxes in layers onto a static ground box, simulates ten seconds at 60 Hz while they fall, collide
+ * And settle, and logs the average time of every stage of the step for each simulated second.
+ */
+void BenchmarkRigidBodies(size_t boxCount, JobSystem& jobSystem);
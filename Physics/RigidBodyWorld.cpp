@@ -0,0 +1,783 @@
+﻿#include "RigidBodyWorld.h"
+
+#include "Entity/TransformSystems.h"
+#include "Externals/SDL/Include/SDL.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace DirectX;
+
+namespace
+{
+	const XMFLOAT3 Gravity(0.0f, -9.81f, 0.0f);
+
+	const int SolverIterationCount = 8;
+
+	// Fraction of the overlap that is pushed apart per step. Removing all of it at once makes bodies jump apart.
+	const float PositionCorrectionFactor = 0.2f;
+	// Overlap that is left alone, so resting bodies stay in contact instead of bouncing between touching and not
+	const float AllowedPenetration = 0.005f;
+	// Deep overlaps, like those of bodies created inside each other, are pushed apart no faster than this
+	const float MaxCorrectionSpeed = 2.0f;
+
+	const float Friction = 0.5f;
+
+	// Contact points of consecutive steps that are closer than this are taken to be the same point
+	const float WarmStartDistance = 0.02f;
+
+	// Bodies slower than this are still, and islands whose bodies have all been still long enough fall asleep
+	const float StillLinearSpeed = 0.05f;
+	const float StillAngularSpeed = 0.05f;
+	const float TimeToSleep = 0.5f;
+
+	const size_t BodiesPerJob = 1024;
+	const size_t PairsPerJob = 256;
+	// Most islands are a few bodies, so every job takes a bunch of them
+	const size_t IslandJobsPerThread = 16;
+
+	// Islands with more manifolds than this are too much for one thread, so their manifolds are colored and spread over
+	// All threads instead
+	const uint32_t LargeIslandManifoldCount = 1024;
+	const size_t ManifoldsPerJob = 64;
+	// One bit per color in a 64 bit mask
+	const uint32_t MaxColorCount = 64;
+
+	const uint32_t NoIsland = 0xFFFFFFFF;
+
+	double GetSecondsSince(Uint64 startCounter)
+	{
+		return static_cast<double>(SDL_GetPerformanceCounter() - startCounter) / SDL_GetPerformanceFrequency();
+	}
+
+	float Dot(FXMVECTOR a, FXMVECTOR b)
+	{
+		return XMVectorGetX(XMVector3Dot(a, b));
+	}
+
+	// The rotational part of the impulse it takes to change the relative speed at a contact along a direction
+	float GetAngularMass(FXMVECTOR offset, FXMVECTOR direction, CXMMATRIX inverseInertia)
+	{
+		const auto angularImpulse = XMVector3TransformNormal(XMVector3Cross(offset, direction), inverseInertia);
+
+		return Dot(XMVector3Cross(angularImpulse, offset), direction);
+	}
+
+	uint32_t FindIslandRoot(std::vector<uint32_t>& parents, uint32_t body)
+	{
+		// Path halving keeps the trees flat
+		while (parents[body] != body)
+		{
+			parents[body] = parents[parents[body]];
+			body = parents[body];
+		}
+
+		return body;
+	}
+}
+
+RigidBodyWorld::RigidBodyWorld()
+	: m_statistics()
+{
+}
+
+RigidBody RigidBodyWorld::AddBox(const RigidBodyDescription& description)
+{
+	Body body = {};
+	body.Position = description.Position;
+	body.Rotation = description.Rotation;
+	body.HalfExtents = description.HalfExtents;
+
+	if (description.Mass > 0.0f)
+	{
+		const auto& halfExtents = description.HalfExtents;
+
+		body.InverseMass = 1.0f / description.Mass;
+		body.LinearVelocity = description.LinearVelocity;
+		body.AngularVelocity = description.AngularVelocity;
+
+		// A solid box of size 2h has the moment of inertia m/3 * (h1^2 + h2^2) about each axis
+		body.LocalInverseInertia = XMFLOAT3(
+			3.0f / (description.Mass * (halfExtents.y * halfExtents.y + halfExtents.z * halfExtents.z)),
+			3.0f / (description.Mass * (halfExtents.x * halfExtents.x + halfExtents.z * halfExtents.z)),
+			3.0f / (description.Mass * (halfExtents.x * halfExtents.x + halfExtents.y * halfExtents.y)));
+	}
+
+	m_bodies.push_back(body);
+	m_boundsMinimums.emplace_back();
+	m_boundsMaximums.emplace_back();
+	m_staticFlags.push_back(description.Mass > 0.0f ? 0 : 1);
+
+	return static_cast<RigidBody>(m_bodies.size() - 1);
+}
+
+void RigidBodyWorld::Step(float deltaTime, JobSystem& jobSystem)
+{
+	m_statistics = RigidBodyStepStatistics();
+
+	auto startCounter = SDL_GetPerformanceCounter();
+	UpdateVelocitiesAndBounds(deltaTime, jobSystem);
+	m_statistics.VelocitySeconds = GetSecondsSince(startCounter);
+
+	startCounter = SDL_GetPerformanceCounter();
+	m_broadphase.FindPairs(m_boundsMinimums, m_boundsMaximums, m_staticFlags, jobSystem, m_pairs);
+	m_statistics.BroadphaseSeconds = GetSecondsSince(startCounter);
+
+	startCounter = SDL_GetPerformanceCounter();
+	FindContacts(jobSystem);
+	m_statistics.NarrowphaseSeconds = GetSecondsSince(startCounter);
+
+	startCounter = SDL_GetPerformanceCounter();
+	BuildIslands();
+	m_statistics.IslandSeconds = GetSecondsSince(startCounter);
+
+	startCounter = SDL_GetPerformanceCounter();
+
+	const auto isLarge = [](const Island& island)
+	{
+		return island.End - island.Begin > LargeIslandManifoldCount;
+	};
+
+	for (const auto& island : m_islands)
+	{
+		if (!island.Asleep && isLarge(island))
+			SolveLargeIsland(island, deltaTime, jobSystem);
+	}
+
+	const auto islandsPerJob = std::max<size_t>(1, m_islands.size() / (jobSystem.GetThreadCount() * IslandJobsPerThread));
+
+	jobSystem.ParallelFor(m_islands.size(), islandsPerJob, [=](size_t begin, size_t end)
+	{
+		for (auto i = begin; i < end; i++)
+		{
+			if (!m_islands[i].Asleep && !isLarge(m_islands[i]))
+				SolveIsland(m_islands[i], deltaTime);
+		}
+	});
+
+	KeepManifoldsForWarmStarting();
+	m_statistics.SolverSeconds = GetSecondsSince(startCounter);
+
+	startCounter = SDL_GetPerformanceCounter();
+	IntegratePositions(deltaTime, jobSystem);
+	m_statistics.PositionSeconds = GetSecondsSince(startCounter);
+}
+
+XMFLOAT3 RigidBodyWorld::GetPosition(RigidBody body) const
+{
+	return m_bodies[body].Position;
+}
+
+XMFLOAT4 RigidBodyWorld::GetRotation(RigidBody body) const
+{
+	return m_bodies[body].Rotation;
+}
+
+XMMATRIX XM_CALLCONV RigidBodyWorld::GetWorldMatrix(RigidBody body) const
+{
+	return XMMatrixRotationQuaternion(XMLoadFloat4(&m_bodies[body].Rotation))
+		* XMMatrixTranslationFromVector(XMLoadFloat3(&m_bodies[body].Position));
+}
+
+size_t RigidBodyWorld::GetBodyCount() const
+{
+	return m_bodies.size();
+}
+
+const RigidBodyStepStatistics& RigidBodyWorld::GetLastStepStatistics() const
+{
+	return m_statistics;
+}
+
+void RigidBodyWorld::UpdateVelocitiesAndBounds(float deltaTime, JobSystem& jobSystem)
+{
+	jobSystem.ParallelFor(m_bodies.size(), BodiesPerJob, [=](size_t begin, size_t end)
+	{
+		const auto velocityChange = XMVectorScale(XMLoadFloat3(&Gravity), deltaTime);
+
+		for (auto i = begin; i < end; i++)
+		{
+			auto& body = m_bodies[i];
+
+			if (body.Asleep)
+				continue;
+
+			// The rows are the axes of the box in world space
+			const auto axes = XMMatrixRotationQuaternion(XMLoadFloat4(&body.Rotation));
+
+			if (!m_staticFlags[i])
+			{
+				XMStoreFloat3(&body.LinearVelocity, XMVectorAdd(XMLoadFloat3(&body.LinearVelocity), velocityChange));
+
+				// Into the box's frame, scaled by the local inverse inertia, and back
+				XMStoreFloat3x3(&body.InverseInertia,
+					XMMatrixTranspose(axes) * XMMatrixScalingFromVector(XMLoadFloat3(&body.LocalInverseInertia)) * axes);
+			}
+
+			// Along every world axis, the bounds reach as far as the box's extents projected onto it
+			XMMATRIX absoluteAxes;
+			absoluteAxes.r[0] = XMVectorAbs(axes.r[0]);
+			absoluteAxes.r[1] = XMVectorAbs(axes.r[1]);
+			absoluteAxes.r[2] = XMVectorAbs(axes.r[2]);
+			absoluteAxes.r[3] = XMVectorZero();
+
+			const auto center = XMLoadFloat3(&body.Position);
+			const auto extents = XMVector3TransformNormal(XMLoadFloat3(&body.HalfExtents), absoluteAxes);
+
+			XMStoreFloat4(&m_boundsMinimums[i], XMVectorSubtract(center, extents));
+			XMStoreFloat4(&m_boundsMaximums[i], XMVectorAdd(center, extents));
+		}
+	});
+}
+
+void RigidBodyWorld::FindContacts(JobSystem& jobSystem)
+{
+	m_manifolds.resize(m_pairs.size());
+	m_touching.resize(m_pairs.size());
+
+	jobSystem.ParallelFor(m_pairs.size(), PairsPerJob, [=](size_t begin, size_t end)
+	{
+		for (auto i = begin; i < end; i++)
+		{
+			const auto& pair = m_pairs[i];
+			const auto& bodyA = m_bodies[pair.First];
+			const auto& bodyB = m_bodies[pair.Second];
+
+			// Neither body has moved since the last step, so neither have the contacts
+			if ((bodyA.Asleep || m_staticFlags[pair.First]) && (bodyB.Asleep || m_staticFlags[pair.Second]))
+			{
+				const auto previous = FindPreviousManifold(pair.First, pair.Second);
+
+				m_touching[i] = previous ? 1 : 0;
+				if (previous)
+					m_manifolds[i] = *previous;
+
+				continue;
+			}
+
+			const OrientedBox boxA = { bodyA.Position, bodyA.HalfExtents, bodyA.Rotation };
+			const OrientedBox boxB = { bodyB.Position, bodyB.HalfExtents, bodyB.Rotation };
+
+			ContactManifold contacts;
+			m_touching[i] = CollideBoxes(boxA, boxB, contacts) ? 1 : 0;
+
+			if (!m_touching[i])
+				continue;
+
+			auto& manifold = m_manifolds[i];
+			manifold.BodyA = pair.First;
+			manifold.BodyB = pair.Second;
+			manifold.Normal = contacts.Normal;
+			manifold.ContactCount = contacts.PointCount;
+			manifold.TangentImpulses[0] = 0.0f;
+			manifold.TangentImpulses[1] = 0.0f;
+			manifold.TwistImpulse = 0.0f;
+
+			for (uint32_t j = 0; j < contacts.PointCount; j++)
+			{
+				auto& contact = manifold.Contacts[j];
+				contact = Contact();
+				contact.Position = contacts.Points[j].Position;
+				contact.Depth = contacts.Points[j].Depth;
+			}
+
+			WarmStart(manifold);
+		}
+	});
+}
+
+void RigidBodyWorld::BuildIslands()
+{
+	const auto bodyCount = static_cast<uint32_t>(m_bodies.size());
+
+	m_islandParents.resize(bodyCount);
+	std::iota(m_islandParents.begin(), m_islandParents.end(), 0);
+
+	m_islandManifolds.clear();
+
+	for (uint32_t i = 0; i < m_pairs.size(); i++)
+	{
+		if (!m_touching[i])
+			continue;
+
+		m_islandManifolds.push_back(i);
+
+		const auto& manifold = m_manifolds[i];
+		m_statistics.ContactCount += manifold.ContactCount;
+
+		// Static bodies don't pass anything on from one body to another, so they don't join islands
+		if (m_staticFlags[manifold.BodyA] || m_staticFlags[manifold.BodyB])
+			continue;
+
+		const auto rootA = FindIslandRoot(m_islandParents, manifold.BodyA);
+		const auto rootB = FindIslandRoot(m_islandParents, manifold.BodyB);
+
+		if (rootA != rootB)
+			m_islandParents[rootA] = rootB;
+	}
+
+	// Islands are numbered in the order their first manifold comes up. Only bodies that touch something get one.
+	std::vector<uint32_t> islandIndices(bodyCount, NoIsland);
+	std::vector<uint32_t> manifoldIslands(m_islandManifolds.size());
+	m_islands.clear();
+
+	for (size_t i = 0; i < m_islandManifolds.size(); i++)
+	{
+		const auto& manifold = m_manifolds[m_islandManifolds[i]];
+		const auto body = m_staticFlags[manifold.BodyA] ? manifold.BodyB : manifold.BodyA;
+		const auto root = FindIslandRoot(m_islandParents, body);
+
+		if (islandIndices[root] == NoIsland)
+		{
+			islandIndices[root] = static_cast<uint32_t>(m_islands.size());
+			m_islands.push_back(Island{ 0, 0, 0, true });
+		}
+
+		manifoldIslands[i] = islandIndices[root];
+		m_islands[islandIndices[root]].End++;
+	}
+
+	for (uint32_t body = 0; body < bodyCount; body++)
+	{
+		if (m_staticFlags[body])
+			continue;
+
+		const auto island = islandIndices[FindIslandRoot(m_islandParents, body)];
+		if (island == NoIsland)
+			continue;
+
+		m_islands[island].BodyCount++;
+
+		if (m_bodies[body].StillSeconds < TimeToSleep)
+			m_islands[island].Asleep = false;
+	}
+
+	// Bodies of islands that just fell asleep stop where they are, and those of islands that an awake body touched
+	// Wake up
+	for (uint32_t i = 0; i < bodyCount; i++)
+	{
+		if (m_staticFlags[i])
+			continue;
+
+		const auto island = islandIndices[FindIslandRoot(m_islandParents, i)];
+		if (island == NoIsland)
+			continue;
+
+		auto& body = m_bodies[i];
+
+		if (m_islands[island].Asleep)
+		{
+			body.Asleep = true;
+			body.LinearVelocity = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			body.AngularVelocity = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			m_statistics.AsleepBodyCount++;
+		}
+		else if (body.Asleep)
+		{
+			body.Asleep = false;
+			body.StillSeconds = 0.0f;
+		}
+	}
+
+	// The manifolds are grouped by island with a counting sort. End counts the manifolds up to here, and is the
+	// Insertion point below.
+	uint32_t manifoldCount = 0;
+	for (auto& island : m_islands)
+	{
+		const auto islandManifoldCount = island.End;
+		island.Begin = manifoldCount;
+		island.End = manifoldCount;
+		manifoldCount += islandManifoldCount;
+	}
+
+	const auto manifoldIndices = m_islandManifolds;
+	for (size_t i = 0; i < manifoldIndices.size(); i++)
+		m_islandManifolds[m_islands[manifoldIslands[i]].End++] = manifoldIndices[i];
+
+	// The largest island that is awake takes longest to solve, so its job should start first
+	if (!m_islands.empty())
+	{
+		const auto largest = std::max_element(m_islands.begin(), m_islands.end(), [](const Island& a, const Island& b)
+		{
+			return (a.Asleep ? 0 : a.BodyCount) < (b.Asleep ? 0 : b.BodyCount);
+		});
+
+		if (!largest->Asleep)
+		{
+			std::iter_swap(m_islands.begin(), largest);
+			m_statistics.LargestIslandBodyCount = m_islands.front().BodyCount;
+		}
+	}
+
+	m_statistics.PairCount = static_cast<uint32_t>(m_pairs.size());
+	m_statistics.ManifoldCount = static_cast<uint32_t>(m_islandManifolds.size());
+	m_statistics.IslandCount = static_cast<uint32_t>(m_islands.size());
+}
+
+void RigidBodyWorld::SolveIsland(const Island& island, float deltaTime)
+{
+	for (auto i = island.Begin; i < island.End; i++)
+		PrepareManifold(m_manifolds[m_islandManifolds[i]], deltaTime);
+
+	for (int iteration = 0; iteration < SolverIterationCount; iteration++)
+	{
+		for (auto i = island.Begin; i < island.End; i++)
+			SolveManifold(m_manifolds[m_islandManifolds[i]]);
+	}
+}
+
+void RigidBodyWorld::SolveLargeIsland(const Island& island, float deltaTime, JobSystem& jobSystem)
+{
+	ColorManifolds(island);
+
+	const auto forEachColor = [&](bool prepare)
+	{
+		for (size_t color = 0; color + 1 < m_colorStarts.size(); color++)
+		{
+			const auto begin = m_colorStarts[color];
+			const auto count = m_colorStarts[color + 1] - begin;
+
+			// The manifolds that found no free color may share bodies, so they are solved on one thread
+			const auto manifoldsPerJob = color < MaxColorCount ? ManifoldsPerJob : count;
+
+			jobSystem.ParallelFor(count, manifoldsPerJob, [=](size_t first, size_t last)
+			{
+				for (auto i = first; i < last; i++)
+				{
+					auto& manifold = m_manifolds[m_coloredManifolds[begin + i]];
+
+					if (prepare)
+						PrepareManifold(manifold, deltaTime);
+					else
+						SolveManifold(manifold);
+				}
+			});
+		}
+	};
+
+	forEachColor(true);
+
+	for (int iteration = 0; iteration < SolverIterationCount; iteration++)
+		forEachColor(false);
+}
+
+void RigidBodyWorld::ColorManifolds(const Island& island)
+{
+	const auto manifoldCount = island.End - island.Begin;
+
+	m_bodyColors.resize(m_bodies.size());
+	m_manifoldColors.resize(manifoldCount);
+	m_coloredManifolds.resize(manifoldCount);
+	m_colorStarts.assign(MaxColorCount + 2, 0);
+
+	for (auto i = island.Begin; i < island.End; i++)
+	{
+		const auto& manifold = m_manifolds[m_islandManifolds[i]];
+		m_bodyColors[manifold.BodyA] = 0;
+		m_bodyColors[manifold.BodyB] = 0;
+	}
+
+	// Every manifold takes the first color that none of the other manifolds of its dynamic bodies has. Static bodies
+	// Aren't written, so they can be in any number of manifolds of a color. The manifolds that find every color taken
+	// Get the color after the last.
+	for (auto i = island.Begin; i < island.End; i++)
+	{
+		const auto& manifold = m_manifolds[m_islandManifolds[i]];
+		auto& colorsA = m_bodyColors[manifold.BodyA];
+		auto& colorsB = m_bodyColors[manifold.BodyB];
+		const auto taken = (m_staticFlags[manifold.BodyA] ? 0 : colorsA) | (m_staticFlags[manifold.BodyB] ? 0 : colorsB);
+
+		uint32_t color = 0;
+		while (color < MaxColorCount && (taken & (uint64_t(1) << color)))
+			color++;
+
+		if (color < MaxColorCount)
+		{
+			colorsA |= uint64_t(1) << color;
+			colorsB |= uint64_t(1) << color;
+		}
+
+		m_manifoldColors[i - island.Begin] = color;
+		m_colorStarts[color + 1]++;
+	}
+
+	// A counting sort by color
+	std::partial_sum(m_colorStarts.begin(), m_colorStarts.end(), m_colorStarts.begin());
+
+	auto insertionPoints = m_colorStarts;
+	for (uint32_t i = 0; i < manifoldCount; i++)
+		m_coloredManifolds[insertionPoints[m_manifoldColors[i]]++] = m_islandManifolds[island.Begin + i];
+}
+
+void RigidBodyWorld::PrepareManifold(Manifold& manifold, float deltaTime)
+{
+	auto& bodyA = m_bodies[manifold.BodyA];
+	auto& bodyB = m_bodies[manifold.BodyB];
+
+	const auto inverseInertiaA = XMLoadFloat3x3(&bodyA.InverseInertia);
+	const auto inverseInertiaB = XMLoadFloat3x3(&bodyB.InverseInertia);
+	const auto inverseMassSum = bodyA.InverseMass + bodyB.InverseMass;
+	const auto positionA = XMLoadFloat3(&bodyA.Position);
+	const auto positionB = XMLoadFloat3(&bodyB.Position);
+
+	// Any two directions perpendicular to the normal will do, as long as the same normal gives the same tangents,
+	// Or the warm started friction impulses would point elsewhere
+	const auto normal = XMLoadFloat3(&manifold.Normal);
+	const auto tangent = std::abs(manifold.Normal.x) >= 0.57735f
+		? XMVector3Normalize(XMVectorSet(manifold.Normal.y, -manifold.Normal.x, 0.0f, 0.0f))
+		: XMVector3Normalize(XMVectorSet(0.0f, manifold.Normal.z, -manifold.Normal.y, 0.0f));
+	const XMVECTOR tangents[] = { tangent, XMVector3Cross(normal, tangent) };
+
+	XMStoreFloat3(&manifold.Tangents[0], tangents[0]);
+	XMStoreFloat3(&manifold.Tangents[1], tangents[1]);
+
+	auto center = XMVectorZero();
+	for (uint32_t i = 0; i < manifold.ContactCount; i++)
+		center = XMVectorAdd(center, XMLoadFloat3(&manifold.Contacts[i].Position));
+
+	center = XMVectorScale(center, 1.0f / manifold.ContactCount);
+
+	auto twistRadius = 0.0f;
+
+	for (uint32_t i = 0; i < manifold.ContactCount; i++)
+	{
+		auto& contact = manifold.Contacts[i];
+		const auto position = XMLoadFloat3(&contact.Position);
+		const auto offsetA = XMVectorSubtract(position, positionA);
+		const auto offsetB = XMVectorSubtract(position, positionB);
+
+		XMStoreFloat3(&contact.OffsetA, offsetA);
+		XMStoreFloat3(&contact.OffsetB, offsetB);
+
+		contact.NormalMass = 1.0f / (inverseMassSum
+			+ GetAngularMass(offsetA, normal, inverseInertiaA)
+			+ GetAngularMass(offsetB, normal, inverseInertiaB));
+
+		contact.Bias = std::min(
+			PositionCorrectionFactor / deltaTime * std::max(contact.Depth - AllowedPenetration, 0.0f),
+			MaxCorrectionSpeed);
+
+		twistRadius += XMVectorGetX(XMVector3Length(XMVectorSubtract(position, center)));
+
+		// The impulse carried over from the previous step
+		const auto impulse = XMVectorScale(normal, contact.NormalImpulse);
+		ApplyImpulse(bodyA, XMVectorNegate(impulse), offsetA);
+		ApplyImpulse(bodyB, impulse, offsetB);
+	}
+
+	const auto frictionOffsetA = XMVectorSubtract(center, positionA);
+	const auto frictionOffsetB = XMVectorSubtract(center, positionB);
+
+	XMStoreFloat3(&manifold.FrictionOffsetA, frictionOffsetA);
+	XMStoreFloat3(&manifold.FrictionOffsetB, frictionOffsetB);
+	manifold.TwistRadius = twistRadius / manifold.ContactCount;
+
+	for (int i = 0; i < 2; i++)
+	{
+		manifold.TangentMasses[i] = 1.0f / (inverseMassSum
+			+ GetAngularMass(frictionOffsetA, tangents[i], inverseInertiaA)
+			+ GetAngularMass(frictionOffsetB, tangents[i], inverseInertiaB));
+	}
+
+	manifold.TwistMass = 1.0f / (Dot(XMVector3TransformNormal(normal, inverseInertiaA), normal)
+		+ Dot(XMVector3TransformNormal(normal, inverseInertiaB), normal));
+
+	const auto frictionImpulse = XMVectorAdd(
+		XMVectorScale(tangents[0], manifold.TangentImpulses[0]), XMVectorScale(tangents[1], manifold.TangentImpulses[1]));
+
+	ApplyImpulse(bodyA, XMVectorNegate(frictionImpulse), frictionOffsetA);
+	ApplyImpulse(bodyB, frictionImpulse, frictionOffsetB);
+
+	const auto twistImpulse = XMVectorScale(normal, manifold.TwistImpulse);
+	ApplyAngularImpulse(bodyA, XMVectorNegate(twistImpulse));
+	ApplyAngularImpulse(bodyB, twistImpulse);
+}
+
+void RigidBodyWorld::SolveManifold(Manifold& manifold)
+{
+	auto& bodyA = m_bodies[manifold.BodyA];
+	auto& bodyB = m_bodies[manifold.BodyB];
+
+	const auto normal = XMLoadFloat3(&manifold.Normal);
+
+	// Friction first, limited by the current normal impulses, so the normal impulses have the last word on penetration
+	auto normalImpulseSum = 0.0f;
+	for (uint32_t i = 0; i < manifold.ContactCount; i++)
+		normalImpulseSum += manifold.Contacts[i].NormalImpulse;
+
+	const auto maxFriction = Friction * normalImpulseSum;
+	const auto frictionOffsetA = XMLoadFloat3(&manifold.FrictionOffsetA);
+	const auto frictionOffsetB = XMLoadFloat3(&manifold.FrictionOffsetB);
+
+	for (int i = 0; i < 2; i++)
+	{
+		const auto tangent = XMLoadFloat3(&manifold.Tangents[i]);
+		const auto speed = Dot(GetRelativeVelocity(bodyA, bodyB, manifold.FrictionOffsetA, manifold.FrictionOffsetB), tangent);
+
+		const auto previousImpulse = manifold.TangentImpulses[i];
+		manifold.TangentImpulses[i] = std::max(-maxFriction, std::min(previousImpulse - speed * manifold.TangentMasses[i], maxFriction));
+
+		const auto impulse = XMVectorScale(tangent, manifold.TangentImpulses[i] - previousImpulse);
+		ApplyImpulse(bodyA, XMVectorNegate(impulse), frictionOffsetA);
+		ApplyImpulse(bodyB, impulse, frictionOffsetB);
+	}
+
+	{
+		const auto maxTwist = maxFriction * manifold.TwistRadius;
+		const auto twistSpeed = Dot(XMVectorSubtract(XMLoadFloat3(&bodyB.AngularVelocity), XMLoadFloat3(&bodyA.AngularVelocity)), normal);
+
+		const auto previousImpulse = manifold.TwistImpulse;
+		manifold.TwistImpulse = std::max(-maxTwist, std::min(previousImpulse - twistSpeed * manifold.TwistMass, maxTwist));
+
+		const auto impulse = XMVectorScale(normal, manifold.TwistImpulse - previousImpulse);
+		ApplyAngularImpulse(bodyA, XMVectorNegate(impulse));
+		ApplyAngularImpulse(bodyB, impulse);
+	}
+
+	// The accumulated normal impulse may only push, but a single iteration may take some of it back
+	for (uint32_t i = 0; i < manifold.ContactCount; i++)
+	{
+		auto& contact = manifold.Contacts[i];
+		const auto speed = Dot(GetRelativeVelocity(bodyA, bodyB, contact.OffsetA, contact.OffsetB), normal);
+
+		const auto previousImpulse = contact.NormalImpulse;
+		contact.NormalImpulse = std::max(previousImpulse + (contact.Bias - speed) * contact.NormalMass, 0.0f);
+
+		const auto impulse = XMVectorScale(normal, contact.NormalImpulse - previousImpulse);
+		ApplyImpulse(bodyA, XMVectorNegate(impulse), XMLoadFloat3(&contact.OffsetA));
+		ApplyImpulse(bodyB, impulse, XMLoadFloat3(&contact.OffsetB));
+	}
+}
+
+void XM_CALLCONV RigidBodyWorld::ApplyImpulse(Body& body, FXMVECTOR impulse, FXMVECTOR offset)
+{
+	// Static bodies are shared between islands, so only dynamic bodies are written
+	if (body.InverseMass == 0.0f)
+		return;
+
+	const auto inverseInertia = XMLoadFloat3x3(&body.InverseInertia);
+
+	XMStoreFloat3(&body.LinearVelocity,
+		XMVectorMultiplyAdd(impulse, XMVectorReplicate(body.InverseMass), XMLoadFloat3(&body.LinearVelocity)));
+	XMStoreFloat3(&body.AngularVelocity,
+		XMVectorAdd(XMLoadFloat3(&body.AngularVelocity), XMVector3TransformNormal(XMVector3Cross(offset, impulse), inverseInertia)));
+}
+
+void XM_CALLCONV RigidBodyWorld::ApplyAngularImpulse(Body& body, FXMVECTOR angularImpulse)
+{
+	if (body.InverseMass == 0.0f)
+		return;
+
+	XMStoreFloat3(&body.AngularVelocity, XMVectorAdd(XMLoadFloat3(&body.AngularVelocity),
+		XMVector3TransformNormal(angularImpulse, XMLoadFloat3x3(&body.InverseInertia))));
+}
+
+XMVECTOR RigidBodyWorld::GetRelativeVelocity(const Body& bodyA, const Body& bodyB, const XMFLOAT3& offsetA, const XMFLOAT3& offsetB)
+{
+	const auto velocityA = XMVectorAdd(XMLoadFloat3(&bodyA.LinearVelocity),
+		XMVector3Cross(XMLoadFloat3(&bodyA.AngularVelocity), XMLoadFloat3(&offsetA)));
+	const auto velocityB = XMVectorAdd(XMLoadFloat3(&bodyB.LinearVelocity),
+		XMVector3Cross(XMLoadFloat3(&bodyB.AngularVelocity), XMLoadFloat3(&offsetB)));
+
+	return XMVectorSubtract(velocityB, velocityA);
+}
+
+void RigidBodyWorld::IntegratePositions(float deltaTime, JobSystem& jobSystem)
+{
+	jobSystem.ParallelFor(m_bodies.size(), BodiesPerJob, [=](size_t begin, size_t end)
+	{
+		for (auto i = begin; i < end; i++)
+		{
+			auto& body = m_bodies[i];
+
+			if (m_staticFlags[i] || body.Asleep)
+				continue;
+
+			const auto linearVelocity = XMLoadFloat3(&body.LinearVelocity);
+			const auto angularVelocity = XMLoadFloat3(&body.AngularVelocity);
+
+			XMStoreFloat3(&body.Position, XMVectorMultiplyAdd(linearVelocity, XMVectorReplicate(deltaTime), XMLoadFloat3(&body.Position)));
+			XMStoreFloat4(&body.Rotation, IntegrateRotation(XMLoadFloat4(&body.Rotation), angularVelocity, deltaTime));
+
+			const auto still = XMVectorGetX(XMVector3LengthSq(linearVelocity)) < StillLinearSpeed * StillLinearSpeed
+				&& XMVectorGetX(XMVector3LengthSq(angularVelocity)) < StillAngularSpeed * StillAngularSpeed;
+
+			body.StillSeconds = still ? body.StillSeconds + deltaTime : 0.0f;
+		}
+	});
+}
+
+const RigidBodyWorld::Manifold* RigidBodyWorld::FindPreviousManifold(RigidBody bodyA, RigidBody bodyB) const
+{
+	// Every manifold is filed under its dynamic body, or under A if both are dynamic
+	const auto body = m_staticFlags[bodyA] ? bodyB : bodyA;
+
+	if (body + 1 >= m_previousManifoldStarts.size())
+		return nullptr;
+
+	for (auto i = m_previousManifoldStarts[body]; i < m_previousManifoldStarts[body + 1]; i++)
+	{
+		const auto& previous = m_previousManifolds[m_previousManifoldOrder[i]];
+
+		if (previous.BodyA == bodyA && previous.BodyB == bodyB)
+			return &previous;
+	}
+
+	return nullptr;
+}
+
+void RigidBodyWorld::WarmStart(Manifold& manifold) const
+{
+	const auto previous = FindPreviousManifold(manifold.BodyA, manifold.BodyB);
+
+	if (!previous)
+		return;
+
+	manifold.TangentImpulses[0] = previous->TangentImpulses[0];
+	manifold.TangentImpulses[1] = previous->TangentImpulses[1];
+	manifold.TwistImpulse = previous->TwistImpulse;
+
+	for (uint32_t j = 0; j < manifold.ContactCount; j++)
+	{
+		auto& contact = manifold.Contacts[j];
+		const auto position = XMLoadFloat3(&contact.Position);
+
+		for (uint32_t k = 0; k < previous->ContactCount; k++)
+		{
+			const auto& previousContact = previous->Contacts[k];
+			const auto distanceSquared = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&previousContact.Position), position)));
+
+			if (distanceSquared < WarmStartDistance * WarmStartDistance)
+			{
+				contact.NormalImpulse = previousContact.NormalImpulse;
+				break;
+			}
+		}
+	}
+}
+
+void RigidBodyWorld::KeepManifoldsForWarmStarting()
+{
+	// The manifold slots are reused, so the previous step's manifolds are swapped out instead of copied
+	m_previousManifolds.swap(m_manifolds);
+
+	const auto getBody = [this](const Manifold& manifold)
+	{
+		return m_staticFlags[manifold.BodyA] ? manifold.BodyB : manifold.BodyA;
+	};
+
+	// A counting sort by body
+	m_previousManifoldStarts.assign(m_bodies.size() + 1, 0);
+
+	for (const auto index : m_islandManifolds)
+		m_previousManifoldStarts[getBody(m_previousManifolds[index]) + 1]++;
+
+	std::partial_sum(m_previousManifoldStarts.begin(), m_previousManifoldStarts.end(), m_previousManifoldStarts.begin());
+
+	auto insertionPoints = m_previousManifoldStarts;
+	m_previousManifoldOrder.resize(m_islandManifolds.size());
+
+	for (const auto index : m_islandManifolds)
+		m_previousManifoldOrder[insertionPoints[getBody(m_previousManifolds[index])]++] = index;
+}
@@ -0,0 +1,221 @@
+﻿#pragma once
+
+#include "Physics/BoxCollision.h"
+#include "Physics/SweepAndPrune.h"
+#include "Threading/JobSystem.h"
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+// Identifies a body of a rigid body world
+typedef uint32_t RigidBody;
+
+struct RigidBodyDescription
+{
+	DirectX::XMFLOAT3 Position;
+	// Unit quaternion
+	DirectX::XMFLOAT4 Rotation;
+	DirectX::XMFLOAT3 HalfExtents;
+	// Bodies with a mass of 0 are static. Other bodies collide with them, but they never move.
+	float Mass;
+	DirectX::XMFLOAT3 LinearVelocity;
+	// World space, in radians per second
+	DirectX::XMFLOAT3 AngularVelocity;
+};
+
+// How long each stage of the last step took, and how much it had to do
+struct RigidBodyStepStatistics
+{
+	double VelocitySeconds;
+	double BroadphaseSeconds;
+	double NarrowphaseSeconds;
+	double IslandSeconds;
+	double SolverSeconds;
+	double PositionSeconds;
+	uint32_t PairCount;
+	uint32_t ManifoldCount;
+	uint32_t ContactCount;
+	uint32_t IslandCount;
+	// Bodies of the largest island that is awake, which limits how well the solver spreads over the threads
+	uint32_t LargestIslandBodyCount;
+	uint32_t AsleepBodyCount;
+};
+
+/*
+ * Simulates boxes that fall under gravity, collide and rest on each other. Every step runs these stages, each spread
+ * Over the job system:
+ *
+ * Velocities: gravity is applied and the bounds and world space inertia of the bodies are updated.
+ * Broadphase: sweep and prune finds the pairs of bodies whose bounds overlap.
+ * Narrowphase: the boxes of each pair are tested with the separating axis test, which produces the contact points.
+ * Islands: bodies that touch, directly or through other dynamic bodies, are grouped into islands. Static bodies don't
+ * Connect islands, since the solver never changes their velocity.
+ * Solver: the contacts are resolved with sequential impulses, with friction. Islands don't share dynamic bodies, so
+ * They are solved in parallel, with the largest one handed out first. A pile can join most bodies into one island,
+ * Though, so the manifolds of large islands are colored such that no two of a color share a dynamic body, and every
+ * Color is spread over all threads in turn. Impulses that match the previous step's contacts are applied up front
+ * (warm starting), which keeps stacks steady without many iterations.
+ * Positions: the velocities are integrated into positions and rotations.
+ *
+ * Islands whose bodies have all been still for half a second fall asleep. Their bodies skip every stage but the
+ * Broadphase, and keep their contacts from the step they fell asleep, until an awake body touches one of them. Piles
+ * At rest cost next to nothing, and the small errors of the solver can't add up to topple tall stacks over time.
+ */
+class RigidBodyWorld
+{
+public:
+	RigidBodyWorld();
+
+	RigidBody AddBox(const RigidBodyDescription& description);
+
+	void Step(float deltaTime, JobSystem& jobSystem);
+
+	DirectX::XMFLOAT3 GetPosition(RigidBody body) const;
+	DirectX::XMFLOAT4 GetRotation(RigidBody body) const;
+
+	// Rotation and translation, not transposed
+	DirectX::XMMATRIX XM_CALLCONV GetWorldMatrix(RigidBody body) const;
+
+	size_t GetBodyCount() const;
+
+	const RigidBodyStepStatistics& GetLastStepStatistics() const;
+
+private:
+	struct Body
+	{
+		DirectX::XMFLOAT3 Position;
+		float InverseMass;
+		DirectX::XMFLOAT4 Rotation;
+		DirectX::XMFLOAT3 LinearVelocity;
+		DirectX::XMFLOAT3 AngularVelocity;
+		DirectX::XMFLOAT3 HalfExtents;
+		// The inertia of a box is diagonal in its own frame, so this is the inverse of the diagonal
+		DirectX::XMFLOAT3 LocalInverseInertia;
+		// Rotated into world space at the start of every step
+		DirectX::XMFLOAT3X3 InverseInertia;
+		// How long the body has barely moved
+		float StillSeconds;
+		// Asleep bodies keep their place and contacts without being simulated, until something that is awake touches them
+		bool Asleep;
+	};
+
+	struct Contact
+	{
+		DirectX::XMFLOAT3 Position;
+		float Depth;
+		// From the body centers to the contact
+		DirectX::XMFLOAT3 OffsetA;
+		DirectX::XMFLOAT3 OffsetB;
+		// Effective mass along the normal
+		float NormalMass;
+		// Separating speed that pushes overlapping bodies apart
+		float Bias;
+		// Accumulated over the iterations, and carried over to the next step
+		float NormalImpulse;
+	};
+
+	struct Manifold
+	{
+		RigidBody BodyA;
+		RigidBody BodyB;
+		// Points from A to B
+		DirectX::XMFLOAT3 Normal;
+		DirectX::XMFLOAT3 Tangents[2];
+		uint32_t ContactCount;
+		Contact Contacts[MaxContactPoints];
+
+		/*
+		 * Friction acts once per manifold, at the middle of its contacts: along the two tangents, and as a twist
+		 * Around the normal. Per contact, the friction impulses of the contacts could work against each other in any
+		 * Of countless ways, and the ones the solver happens to settle on slowly twist and tip stacks over.
+		 */
+		DirectX::XMFLOAT3 FrictionOffsetA;
+		DirectX::XMFLOAT3 FrictionOffsetB;
+		float TangentMasses[2];
+		float TwistMass;
+		// Average distance of the contacts from the middle, which turns the friction limit into a twist limit
+		float TwistRadius;
+		float TangentImpulses[2];
+		float TwistImpulse;
+	};
+
+	struct Island
+	{
+		// Range of m_islandManifolds
+		uint32_t Begin;
+		uint32_t End;
+		uint32_t BodyCount;
+		// An island falls asleep once all of its bodies have been still for a while
+		bool Asleep;
+	};
+
+	void UpdateVelocitiesAndBounds(float deltaTime, JobSystem& jobSystem);
+	void FindContacts(JobSystem& jobSystem);
+	void BuildIslands();
+	void SolveIsland(const Island& island, float deltaTime);
+
+	// Solves the colors of the island one after another, each spread over the job system
+	void SolveLargeIsland(const Island& island, float deltaTime, JobSystem& jobSystem);
+
+	// Groups the island's manifolds into m_coloredManifolds by color, so no two manifolds of a color share a dynamic body
+	void ColorManifolds(const Island& island);
+
+	// Works out the masses of the contacts and friction, and applies the impulses carried over from the previous step
+	void PrepareManifold(Manifold& manifold, float deltaTime);
+
+	// One iteration of friction and contact impulses
+	void SolveManifold(Manifold& manifold);
+
+	static void XM_CALLCONV ApplyImpulse(Body& body, DirectX::FXMVECTOR impulse, DirectX::FXMVECTOR offset);
+	static void XM_CALLCONV ApplyAngularImpulse(Body& body, DirectX::FXMVECTOR angularImpulse);
+
+	// Velocity of B relative to A at the point the offsets lead to
+	static DirectX::XMVECTOR GetRelativeVelocity(
+		const Body& bodyA,
+		const Body& bodyB,
+		const DirectX::XMFLOAT3& offsetA,
+		const DirectX::XMFLOAT3& offsetB);
+	void IntegratePositions(float deltaTime, JobSystem& jobSystem);
+
+	// The previous step's manifold of the same two bodies, or null if they didn't touch
+	const Manifold* FindPreviousManifold(RigidBody bodyA, RigidBody bodyB) const;
+
+	// Copies the impulses of the previous step's matching contacts, if there are any
+	void WarmStart(Manifold& manifold) const;
+
+	// Indexes the manifolds by body, so the next step can find them
+	void KeepManifoldsForWarmStarting();
+
+	std::vector<Body> m_bodies;
+	std::vector<DirectX::XMFLOAT4> m_boundsMinimums;
+	std::vector<DirectX::XMFLOAT4> m_boundsMaximums;
+	std::vector<uint8_t> m_staticFlags;
+
+	SweepAndPrune m_broadphase;
+	std::vector<BroadphasePair> m_pairs;
+
+	// One slot per pair. Pairs that don't touch are removed after the narrowphase.
+	std::vector<Manifold> m_manifolds;
+	std::vector<uint8_t> m_touching;
+
+	// Union-find forest over the bodies
+	std::vector<uint32_t> m_islandParents;
+	std::vector<uint32_t> m_islandManifolds;
+	std::vector<Island> m_islands;
+
+	// While a large island is colored, the colors each body's manifolds have taken, one bit per color
+	std::vector<uint64_t> m_bodyColors;
+	std::vector<uint32_t> m_manifoldColors;
+	std::vector<uint32_t> m_coloredManifolds;
+	// Range of m_coloredManifolds of every color, and of the manifolds that found no free color after those
+	std::vector<uint32_t> m_colorStarts;
+
+	// The previous step's manifolds, and for every body the range of them it is the key body of
+	std::vector<Manifold> m_previousManifolds;
+	std::vector<uint32_t> m_previousManifoldOrder;
+	std::vector<uint32_t> m_previousManifoldStarts;
+
+	RigidBodyStepStatistics m_statistics;
+};
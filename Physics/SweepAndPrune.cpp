@@ -0,0 +1,104 @@
+﻿#include "SweepAndPrune.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace DirectX;
+
+namespace
+{
+	// Ranges per thread. The boxes are spread unevenly along x, so more ranges than threads even out the work.
+	const size_t RangesPerThread = 4;
+}
+
+void SweepAndPrune::FindPairs(
+	const std::vector<XMFLOAT4>& minimums,
+	const std::vector<XMFLOAT4>& maximums,
+	const std::vector<uint8_t>& fixedFlags,
+	JobSystem& jobSystem,
+	std::vector<BroadphasePair>& pairs)
+{
+	const auto objectCount = minimums.size();
+
+	if (m_order.size() != objectCount)
+	{
+		// Objects were added, so the old order is of no use
+		m_order.resize(objectCount);
+		std::iota(m_order.begin(), m_order.end(), 0);
+
+		std::sort(m_order.begin(), m_order.end(), [&](uint32_t a, uint32_t b)
+		{
+			return minimums[a].x < minimums[b].x;
+		});
+	}
+	else
+	{
+		for (size_t i = 1; i < objectCount; i++)
+		{
+			const auto object = m_order[i];
+			const auto x = minimums[object].x;
+
+			auto j = i;
+			for (; j > 0 && minimums[m_order[j - 1]].x > x; j--)
+				m_order[j] = m_order[j - 1];
+
+			m_order[j] = object;
+		}
+	}
+
+	m_sortedMinimums.resize(objectCount);
+	m_sortedMaximums.resize(objectCount);
+	m_sortedFixedFlags.resize(objectCount);
+
+	for (size_t i = 0; i < objectCount; i++)
+	{
+		m_sortedMinimums[i] = minimums[m_order[i]];
+		m_sortedMaximums[i] = maximums[m_order[i]];
+		m_sortedFixedFlags[i] = fixedFlags[m_order[i]];
+	}
+
+	const auto rangeCount = jobSystem.GetThreadCount() * RangesPerThread;
+	const auto rangeSize = (objectCount + rangeCount - 1) / rangeCount;
+	m_rangePairs.resize(rangeCount);
+
+	jobSystem.ParallelFor(rangeCount, 1, [&](size_t begin, size_t end)
+	{
+		for (auto range = begin; range < end; range++)
+		{
+			auto& rangePairs = m_rangePairs[range];
+			rangePairs.clear();
+
+			const auto rangeEnd = std::min(objectCount, (range + 1) * rangeSize);
+
+			for (auto i = range * rangeSize; i < rangeEnd; i++)
+			{
+				const auto minimum = XMLoadFloat4(&m_sortedMinimums[i]);
+				const auto maximum = XMLoadFloat4(&m_sortedMaximums[i]);
+				const auto maximumX = m_sortedMaximums[i].x;
+
+				for (auto j = i + 1; j < objectCount && m_sortedMinimums[j].x <= maximumX; j++)
+				{
+					if (m_sortedFixedFlags[i] && m_sortedFixedFlags[j])
+						continue;
+
+					// Separated if either box starts past the end of the other on any axis
+					const auto separated = XMVectorOrInt(
+						XMVectorGreater(XMLoadFloat4(&m_sortedMinimums[j]), maximum),
+						XMVectorGreater(minimum, XMLoadFloat4(&m_sortedMaximums[j])));
+
+					if (!XMVector3EqualInt(separated, XMVectorFalseInt()))
+						continue;
+
+					const auto a = m_order[i];
+					const auto b = m_order[j];
+					rangePairs.push_back(BroadphasePair{ std::min(a, b), std::max(a, b) });
+				}
+			}
+		}
+	});
+
+	pairs.clear();
+
+	for (const auto& rangePairs : m_rangePairs)
+		pairs.insert(pairs.end(), rangePairs.begin(), rangePairs.end());
+}
@@ -0,0 +1,50 @@
+﻿#pragma once
+
+#include "Threading/JobSystem.h"
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+// Two objects whose bounds overlap. First is the smaller index.
+struct BroadphasePair
+{
+	uint32_t First;
+	uint32_t Second;
+};
+
+/*
+ * Finds the pairs of overlapping axis aligned bounding boxes by sorting the boxes by their lower x bound and sweeping
+ * Along x. Every box is only tested against the boxes that start before it ends, with all three axes compared in a
+ * Single SIMD operation.
+ *
+ * The sorted order is kept from one call to the next. Objects move little per step, so the insertion sort that
+ * Restores the order does little more than one pass. The sweep is split into ranges of the sorted order, which are
+ * Processed in parallel and whose pairs are gathered in order, so the result doesn't depend on the thread count.
+ */
+class SweepAndPrune
+{
+public:
+	/*
+	 * Indexed by object. The w components of the bounds are ignored.
+	 * Pairs of two fixed objects aren't reported, since they can't collide with each other.
+	 */
+	void FindPairs(
+		const std::vector<DirectX::XMFLOAT4>& minimums,
+		const std::vector<DirectX::XMFLOAT4>& maximums,
+		const std::vector<uint8_t>& fixedFlags,
+		JobSystem& jobSystem,
+		std::vector<BroadphasePair>& pairs);
+
+private:
+	// Object indices, sorted by lower x bound
+	std::vector<uint32_t> m_order;
+
+	// Copies of the bounds in sorted order, so the sweep reads them front to back
+	std::vector<DirectX::XMFLOAT4> m_sortedMinimums;
+	std::vector<DirectX::XMFLOAT4> m_sortedMaximums;
+	std::vector<uint8_t> m_sortedFixedFlags;
+
+	std::vector<std::vector<BroadphasePair>> m_rangePairs;
+};
@@ -0,0 +1,377 @@
+﻿#include "ClusterCuller.h"
+
+#include "CustomExceptions/Direct3dException.h"
+
+#include <algorithm>
+#include <string>
+
+using namespace Microsoft::WRL;
+
+namespace
+{
+	// Must match the thread group size and CLUSTER_GROUPS_PER_ROW in ClusterCulling.hlsl.
+	// A dispatch has at most 65535 groups per dimension, so large cluster counts continue in the next row.
+	const UINT ClusterCullingGroupSize = 64;
+	const UINT ClusterGroupsPerRow = 65535;
+
+	// Must match the thread group size in DepthPyramid.hlsl
+	const UINT DepthPyramidGroupSize = 8;
+
+	ComPtr<ID3D11Buffer> CreateConstantBuffer(ID3D11Device* device, UINT byteWidth)
+	{
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.ByteWidth = byteWidth;
+		bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+		bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+		ComPtr<ID3D11Buffer> buffer;
+		const auto bufferCreationResult = device->CreateBuffer(&bufferDesc, nullptr, buffer.GetAddressOf());
+
+		if (bufferCreationResult != S_OK)
+			throw Direct3dException("Failed to create cluster culling constant buffer. Error code: "
+				+ std::to_string(bufferCreationResult));
+
+		return buffer;
+	}
+
+	ComPtr<ID3D11ComputeShader> CreateComputeShader(
+		ID3D11Device* device,
+		const ShaderCache& shaderCache,
+		const std::wstring& fileName,
+		const std::string& entryPoint)
+	{
+		const auto byteCode = shaderCache.Compile(fileName, entryPoint, "cs_5_0");
+
+		ComPtr<ID3D11ComputeShader> shader;
+		const auto shaderCreationResult = device->CreateComputeShader(
+			byteCode->GetBufferPointer(),
+			byteCode->GetBufferSize(),
+			nullptr,
+			shader.GetAddressOf());
+
+		if (shaderCreationResult != S_OK)
+			throw Direct3dException("Failed to create compute shader " + entryPoint + ". Error code: "
+				+ std::to_string(shaderCreationResult));
+
+		return shader;
+	}
+}
+
+ClusterCuller::ClusterCuller(
+	ID3D11Device* device,
+	const ShaderCache& shaderCache,
+	const Meshlet* meshlets,
+	UINT meshletCount,
+	UINT maxInstanceCount,
+	UINT width,
+	UINT height)
+	: m_meshletCount(meshletCount), m_maxInstanceCount(maxInstanceCount)
+{
+	if (meshletCount == 0 || maxInstanceCount == 0)
+		throw Direct3dException("Cluster culling needs at least one meshlet and one instance");
+
+	CreateClusterBuffers(device, meshlets, meshletCount * maxInstanceCount);
+	CreateDepthPyramid(device, width, height);
+	CreateShaders(device, shaderCache);
+
+	m_cullingConstants = CreateConstantBuffer(device, sizeof(CullingConstants));
+	m_depthPyramidConstants = CreateConstantBuffer(device, sizeof(DepthPyramidConstants));
+}
+
+void ClusterCuller::CreateClusterBuffers(ID3D11Device* device, const Meshlet* meshlets, UINT maxClusterCount)
+{
+	// Meshlets
+	D3D11_BUFFER_DESC meshletBufferDesc = {};
+	meshletBufferDesc.ByteWidth = m_meshletCount * sizeof(Meshlet);
+	meshletBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	meshletBufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	meshletBufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	meshletBufferDesc.StructureByteStride = sizeof(Meshlet);
+
+	D3D11_SUBRESOURCE_DATA meshletData = {};
+	meshletData.pSysMem = meshlets;
+
+	ComPtr<ID3D11Buffer> meshletBuffer;
+	const auto meshletBufferCreationResult =
+		device->CreateBuffer(&meshletBufferDesc, &meshletData, meshletBuffer.GetAddressOf());
+
+	if (meshletBufferCreationResult != S_OK)
+		throw Direct3dException("Failed to create meshlet buffer. Error code: "
+			+ std::to_string(meshletBufferCreationResult));
+
+	const auto meshletViewCreationResult =
+		device->CreateShaderResourceView(meshletBuffer.Get(), nullptr, m_meshletView.GetAddressOf());
+
+	if (meshletViewCreationResult != S_OK)
+		throw Direct3dException("Failed to create meshlet buffer view. Error code: "
+			+ std::to_string(meshletViewCreationResult));
+
+	// Cluster visibility. Starts out zeroed, so every cluster goes through the occlusion test in the first frame.
+	D3D11_BUFFER_DESC visibilityBufferDesc = {};
+	visibilityBufferDesc.ByteWidth = maxClusterCount * sizeof(UINT);
+	visibilityBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	visibilityBufferDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+	visibilityBufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	visibilityBufferDesc.StructureByteStride = sizeof(UINT);
+
+	const std::vector<UINT> initialVisibility(maxClusterCount, 0);
+	D3D11_SUBRESOURCE_DATA visibilityData = {};
+	visibilityData.pSysMem = initialVisibility.data();
+
+	ComPtr<ID3D11Buffer> visibilityBuffer;
+	const auto visibilityBufferCreationResult =
+		device->CreateBuffer(&visibilityBufferDesc, &visibilityData, visibilityBuffer.GetAddressOf());
+
+	if (visibilityBufferCreationResult != S_OK)
+		throw Direct3dException("Failed to create cluster visibility buffer. Error code: "
+			+ std::to_string(visibilityBufferCreationResult));
+
+	const auto visibilityViewCreationResult = device->CreateUnorderedAccessView(
+		visibilityBuffer.Get(),
+		nullptr,
+		m_clusterVisibilityView.GetAddressOf());
+
+	if (visibilityViewCreationResult != S_OK)
+		throw Direct3dException("Failed to create cluster visibility view. Error code: "
+			+ std::to_string(visibilityViewCreationResult));
+
+	// Visible clusters, appended by the culling shader and read by the vertex shader
+	D3D11_BUFFER_DESC visibleClusterBufferDesc = {};
+	visibleClusterBufferDesc.ByteWidth = maxClusterCount * 2 * sizeof(UINT);
+	visibleClusterBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	visibleClusterBufferDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
+	visibleClusterBufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	visibleClusterBufferDesc.StructureByteStride = 2 * sizeof(UINT);
+
+	ComPtr<ID3D11Buffer> visibleClusterBuffer;
+	const auto visibleClusterBufferCreationResult =
+		device->CreateBuffer(&visibleClusterBufferDesc, nullptr, visibleClusterBuffer.GetAddressOf());
+
+	if (visibleClusterBufferCreationResult != S_OK)
+		throw Direct3dException("Failed to create visible cluster buffer. Error code: "
+			+ std::to_string(visibleClusterBufferCreationResult));
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC appendViewDesc = {};
+	appendViewDesc.Format = DXGI_FORMAT_UNKNOWN;
+	appendViewDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	appendViewDesc.Buffer.FirstElement = 0;
+	appendViewDesc.Buffer.NumElements = maxClusterCount;
+	appendViewDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_APPEND;
+
+	const auto appendViewCreationResult = device->CreateUnorderedAccessView(
+		visibleClusterBuffer.Get(),
+		&appendViewDesc,
+		m_visibleClusterAppendView.GetAddressOf());
+
+	if (appendViewCreationResult != S_OK)
+		throw Direct3dException("Failed to create visible cluster append view. Error code: "
+			+ std::to_string(appendViewCreationResult));
+
+	const auto visibleClusterViewCreationResult = device->CreateShaderResourceView(
+		visibleClusterBuffer.Get(),
+		nullptr,
+		m_visibleClusterView.GetAddressOf());
+
+	if (visibleClusterViewCreationResult != S_OK)
+		throw Direct3dException("Failed to create visible cluster view. Error code: "
+			+ std::to_string(visibleClusterViewCreationResult));
+
+	// Draw arguments: vertex count per instance, instance count, start vertex, start instance.
+	// Only the instance count changes, it is copied from the append buffer's counter after every culling pass.
+	UINT largestMeshletTriangleCount = 0;
+	for (UINT i = 0; i < m_meshletCount; i++)
+		largestMeshletTriangleCount = std::max(largestMeshletTriangleCount, meshlets[i].TriangleCount);
+
+	const UINT drawArguments[] = { largestMeshletTriangleCount * 3, 0, 0, 0 };
+
+	D3D11_BUFFER_DESC argumentBufferDesc = {};
+	argumentBufferDesc.ByteWidth = sizeof(drawArguments);
+	argumentBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	argumentBufferDesc.MiscFlags = D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS;
+
+	D3D11_SUBRESOURCE_DATA argumentData = {};
+	argumentData.pSysMem = drawArguments;
+
+	const auto argumentBufferCreationResult =
+		device->CreateBuffer(&argumentBufferDesc, &argumentData, m_drawArguments.GetAddressOf());
+
+	if (argumentBufferCreationResult != S_OK)
+		throw Direct3dException("Failed to create cluster draw argument buffer. Error code: "
+			+ std::to_string(argumentBufferCreationResult));
+}
+
+void ClusterCuller::CreateDepthPyramid(ID3D11Device* device, UINT width, UINT height)
+{
+	m_depthBufferWidth = width;
+	m_depthBufferHeight = height;
+	m_depthPyramidWidth = std::max(width / 2, 1u);
+	m_depthPyramidHeight = std::max(height / 2, 1u);
+
+	UINT levelCount = 1;
+	while ((m_depthPyramidWidth >> levelCount) > 0 || (m_depthPyramidHeight >> levelCount) > 0)
+		levelCount++;
+
+	D3D11_TEXTURE2D_DESC pyramidDesc;
+	pyramidDesc.Width = m_depthPyramidWidth;
+	pyramidDesc.Height = m_depthPyramidHeight;
+	pyramidDesc.MipLevels = levelCount;
+	pyramidDesc.ArraySize = 1;
+	pyramidDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	pyramidDesc.SampleDesc.Count = 1;
+	pyramidDesc.SampleDesc.Quality = 0;
+	pyramidDesc.Usage = D3D11_USAGE_DEFAULT;
+	pyramidDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+	pyramidDesc.CPUAccessFlags = 0;
+	pyramidDesc.MiscFlags = 0;
+
+	ComPtr<ID3D11Texture2D> pyramid;
+	const auto pyramidCreationResult = device->CreateTexture2D(&pyramidDesc, nullptr, pyramid.GetAddressOf());
+
+	if (pyramidCreationResult != S_OK)
+		throw Direct3dException("Failed to create depth pyramid. Error code: " + std::to_string(pyramidCreationResult));
+
+	const auto pyramidViewCreationResult =
+		device->CreateShaderResourceView(pyramid.Get(), nullptr, m_depthPyramidView.GetAddressOf());
+
+	if (pyramidViewCreationResult != S_OK)
+		throw Direct3dException("Failed to create depth pyramid view. Error code: "
+			+ std::to_string(pyramidViewCreationResult));
+
+	// Every level is reduced from the one before it, which needs views of the individual levels
+	m_depthPyramidLevelViews.resize(levelCount);
+	m_depthPyramidLevelUnorderedViews.resize(levelCount);
+
+	for (UINT level = 0; level < levelCount; level++)
+	{
+		D3D11_SHADER_RESOURCE_VIEW_DESC levelViewDesc = {};
+		levelViewDesc.Format = DXGI_FORMAT_R32_FLOAT;
+		levelViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		levelViewDesc.Texture2D.MostDetailedMip = level;
+		levelViewDesc.Texture2D.MipLevels = 1;
+
+		const auto levelViewCreationResult = device->CreateShaderResourceView(
+			pyramid.Get(),
+			&levelViewDesc,
+			m_depthPyramidLevelViews[level].GetAddressOf());
+
+		if (levelViewCreationResult != S_OK)
+			throw Direct3dException("Failed to create depth pyramid level view. Error code: "
+				+ std::to_string(levelViewCreationResult));
+
+		D3D11_UNORDERED_ACCESS_VIEW_DESC levelUnorderedViewDesc = {};
+		levelUnorderedViewDesc.Format = DXGI_FORMAT_R32_FLOAT;
+		levelUnorderedViewDesc.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D;
+		levelUnorderedViewDesc.Texture2D.MipSlice = level;
+
+		const auto levelUnorderedViewCreationResult = device->CreateUnorderedAccessView(
+			pyramid.Get(),
+			&levelUnorderedViewDesc,
+			m_depthPyramidLevelUnorderedViews[level].GetAddressOf());
+
+		if (levelUnorderedViewCreationResult != S_OK)
+			throw Direct3dException("Failed to create depth pyramid level unordered access view. Error code: "
+				+ std::to_string(levelUnorderedViewCreationResult));
+	}
+}
+
+void ClusterCuller::CreateShaders(ID3D11Device* device, const ShaderCache& shaderCache)
+{
+	m_cullingShader = CreateComputeShader(device, shaderCache, L"Shaders/ClusterCulling.hlsl", "CullClustersCS");
+	m_depthPyramidShader = CreateComputeShader(device, shaderCache, L"Shaders/DepthPyramid.hlsl", "ReduceDepthCS");
+}
+
+void ClusterCuller::Cull(ID3D11DeviceContext* deviceContext, ClusterCullingPass pass, UINT instanceCount)
+{
+	if (instanceCount > m_maxInstanceCount)
+		throw Direct3dException("Too many instances for cluster culling: " + std::to_string(instanceCount));
+
+	CullingConstants constants = {};
+	constants.InstanceCount = instanceCount;
+	constants.MeshletCount = m_meshletCount;
+	constants.Pass = pass == ClusterCullingPass::VisibleLastFrame ? 0 : 1;
+	constants.DepthPyramidLevelCount = static_cast<UINT>(m_depthPyramidLevelViews.size());
+	constants.DepthPyramidSize = DirectX::XMFLOAT2(
+		static_cast<float>(m_depthPyramidWidth),
+		static_cast<float>(m_depthPyramidHeight));
+
+	deviceContext->UpdateSubresource(m_cullingConstants.Get(), 0, nullptr, &constants, 0, 0);
+
+	deviceContext->CSSetShader(m_cullingShader.Get(), nullptr, 0);
+	deviceContext->CSSetConstantBuffers(2, 1, m_cullingConstants.GetAddressOf());
+
+	ID3D11ShaderResourceView* shaderResourceViews[] = { m_meshletView.Get(), m_depthPyramidView.Get() };
+	deviceContext->CSSetShaderResources(5, 2, shaderResourceViews);
+
+	// The append counter is reset to 0, the visibility buffer keeps its contents
+	ID3D11UnorderedAccessView* unorderedViews[] = { m_clusterVisibilityView.Get(), m_visibleClusterAppendView.Get() };
+	const UINT initialCounts[] = { static_cast<UINT>(-1), 0 };
+	deviceContext->CSSetUnorderedAccessViews(0, 2, unorderedViews, initialCounts);
+
+	const auto groupCount = (instanceCount * m_meshletCount + ClusterCullingGroupSize - 1) / ClusterCullingGroupSize;
+	deviceContext->Dispatch(
+		std::min(groupCount, ClusterGroupsPerRow),
+		(groupCount + ClusterGroupsPerRow - 1) / ClusterGroupsPerRow,
+		1);
+
+	// Unbind everything, so the visible clusters can be read by the vertex shader and the pyramid can be rebuilt
+	ID3D11ShaderResourceView* nullShaderResourceViews[] = { nullptr, nullptr };
+	ID3D11UnorderedAccessView* nullUnorderedViews[] = { nullptr, nullptr };
+	deviceContext->CSSetShaderResources(5, 2, nullShaderResourceViews);
+	deviceContext->CSSetUnorderedAccessViews(0, 2, nullUnorderedViews, nullptr);
+
+	// The instance count of the draw is the number of clusters that were appended
+	deviceContext->CopyStructureCount(m_drawArguments.Get(), sizeof(UINT), m_visibleClusterAppendView.Get());
+}
+
+void ClusterCuller::BuildDepthPyramid(ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView* depthView)
+{
+	deviceContext->CSSetShader(m_depthPyramidShader.Get(), nullptr, 0);
+	deviceContext->CSSetConstantBuffers(2, 1, m_depthPyramidConstants.GetAddressOf());
+
+	UINT sourceWidth = m_depthBufferWidth;
+	UINT sourceHeight = m_depthBufferHeight;
+
+	for (UINT level = 0; level < m_depthPyramidLevelViews.size(); level++)
+	{
+		const auto width = std::max(m_depthPyramidWidth >> level, 1u);
+		const auto height = std::max(m_depthPyramidHeight >> level, 1u);
+
+		DepthPyramidConstants constants = { { sourceWidth, sourceHeight }, { width, height } };
+		deviceContext->UpdateSubresource(m_depthPyramidConstants.Get(), 0, nullptr, &constants, 0, 0);
+
+		ID3D11ShaderResourceView* sourceView = level == 0 ? depthView : m_depthPyramidLevelViews[level - 1].Get();
+		deviceContext->CSSetShaderResources(6, 1, &sourceView);
+		deviceContext->CSSetUnorderedAccessViews(0, 1, m_depthPyramidLevelUnorderedViews[level].GetAddressOf(), nullptr);
+
+		deviceContext->Dispatch(
+			(width + DepthPyramidGroupSize - 1) / DepthPyramidGroupSize,
+			(height + DepthPyramidGroupSize - 1) / DepthPyramidGroupSize,
+			1);
+
+		// The level just written is the source of the next one, and a resource can't be bound for input and output
+		ID3D11ShaderResourceView* nullShaderResourceView = nullptr;
+		ID3D11UnorderedAccessView* nullUnorderedView = nullptr;
+		deviceContext->CSSetShaderResources(6, 1, &nullShaderResourceView);
+		deviceContext->CSSetUnorderedAccessViews(0, 1, &nullUnorderedView, nullptr);
+
+		sourceWidth = width;
+		sourceHeight = height;
+	}
+}
+
+void ClusterCuller::DrawVisibleClusters(ID3D11DeviceContext* deviceContext)
+{
+	ID3D11ShaderResourceView* shaderResourceViews[] = { m_meshletView.Get(), m_visibleClusterView.Get() };
+	deviceContext->VSSetShaderResources(5, 2, shaderResourceViews);
+
+	deviceContext->DrawInstancedIndirect(m_drawArguments.Get(), 0);
+
+	// The visible cluster buffer is written again by the next culling pass
+	ID3D11ShaderResourceView* nullShaderResourceViews[] = { nullptr, nullptr };
+	deviceContext->VSSetShaderResources(5, 2, nullShaderResourceViews);
+}
+
+UINT ClusterCuller::GetMeshletCount() const
+{
+	return m_meshletCount;
+}
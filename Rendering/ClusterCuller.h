@@ -0,0 +1,110 @@
+﻿#pragma once
+
+#include "Mesh/MeshletBuilder.h"
+#include "Rendering/ShaderCache.h"
+
+#include <wrl/client.h>
+#include <d3d11.h>
+
+#include <vector>
+
+enum class ClusterCullingPass
+{
+	// Selects the clusters that were visible last frame and are still in the frustum and facing the camera
+	VisibleLastFrame,
+	// Tests all other clusters against the depth pyramid built from the first pass, selects the ones that became
+	// Visible, and remembers which clusters are visible for the next frame
+	Disoccluded
+};
+
+/*
+ * Culls the meshlets of every instance of a mesh on the GPU, so whole clusters are rejected before their
+ * Triangles reach the input assembler.
+ *
+ * A cluster (one meshlet of one instance) is culled when its bounding sphere is outside the frustum, when its
+ * Normal cone faces away from the camera, or when it is hidden behind what has already been drawn. Occlusion uses
+ * The two pass scheme from Haar and Aaltonen - "GPU-Driven Rendering Pipelines" (SIGGRAPH 2015): the clusters that
+ * Were visible last frame are drawn first, a depth pyramid is built from the result, and only then are the remaining
+ * Clusters tested against it. Nothing is ever culled against stale depth, so there is no popping when the camera
+ * Or the instances move.
+ *
+ * The surviving clusters are drawn with one indirect draw, one instance per cluster. Every instance has the vertex
+ * Count of the largest meshlet, and the vertex shader fetches its vertices from the mesh buffers itself.
+ *
+ * Culling expects the PerMesh and PerFrame constant buffers (b0, b1) and the instance buffer (t0) to be bound for
+ * The compute shader stage. The normal cone test assumes instances are scaled uniformly.
+ */
+class ClusterCuller
+{
+public:
+	// The depth pyramid is built for a depth buffer of the given size
+	ClusterCuller(
+		ID3D11Device* device,
+		const ShaderCache& shaderCache,
+		const Meshlet* meshlets,
+		UINT meshletCount,
+		UINT maxInstanceCount,
+		UINT width,
+		UINT height);
+
+	// Selects the visible clusters of the first instanceCount instances for the next DrawVisibleClusters call
+	void Cull(ID3D11DeviceContext* deviceContext, ClusterCullingPass pass, UINT instanceCount);
+
+	// Builds the depth pyramid that the Disoccluded pass tests against. The depth buffer must not be bound for output.
+	void BuildDepthPyramid(ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView* depthView);
+
+	/*
+	 * Draws the clusters selected by the last Cull call with the bound vertex and pixel shaders.
+	 * SV_InstanceID indexes the visible clusters (uint2: instance id, meshlet index, t6), and SV_VertexID is the corner
+	 * Within the meshlet. The meshlets themselves are bound to t5.
+	 */
+	void DrawVisibleClusters(ID3D11DeviceContext* deviceContext);
+
+	UINT GetMeshletCount() const;
+
+private:
+	struct CullingConstants
+	{
+		UINT InstanceCount;
+		UINT MeshletCount;
+		UINT Pass;
+		UINT DepthPyramidLevelCount;
+		DirectX::XMFLOAT2 DepthPyramidSize;
+		DirectX::XMFLOAT2 Padding;
+	};
+
+	struct DepthPyramidConstants
+	{
+		UINT SourceSize[2];
+		UINT DestinationSize[2];
+	};
+
+	void CreateClusterBuffers(ID3D11Device* device, const Meshlet* meshlets, UINT maxClusterCount);
+	void CreateDepthPyramid(ID3D11Device* device, UINT width, UINT height);
+	void CreateShaders(ID3D11Device* device, const ShaderCache& shaderCache);
+
+	UINT m_meshletCount;
+	UINT m_maxInstanceCount;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_meshletView;
+	// One uint per cluster, non-zero if the cluster was visible last frame
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> m_clusterVisibilityView;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> m_visibleClusterAppendView;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_visibleClusterView;
+	// The arguments of DrawInstancedIndirect. The instance count is the number of visible clusters.
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_drawArguments;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_cullingConstants;
+
+	// R32_FLOAT, half the size of the depth buffer. Every texel holds the farthest depth of the pixels it covers.
+	UINT m_depthPyramidWidth;
+	UINT m_depthPyramidHeight;
+	UINT m_depthBufferWidth;
+	UINT m_depthBufferHeight;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_depthPyramidView;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_depthPyramidLevelViews;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView>> m_depthPyramidLevelUnorderedViews;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_depthPyramidConstants;
+
+	Microsoft::WRL::ComPtr<ID3D11ComputeShader> m_cullingShader;
+	Microsoft::WRL::ComPtr<ID3D11ComputeShader> m_depthPyramidShader;
+};
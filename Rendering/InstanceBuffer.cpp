@@ -0,0 +1,67 @@
+﻿#include "InstanceBuffer.h"
+
+#include "CustomExceptions/Direct3dException.h"
+
+#include <cstring>
+#include <string>
+
+InstanceBuffer::InstanceBuffer(ID3D11Device* device, UINT maxInstanceCount)
+	: m_maxInstanceCount(maxInstanceCount)
+{
+	D3D11_BUFFER_DESC bufferDesc;
+	bufferDesc.ByteWidth = maxInstanceCount * sizeof(DirectX::XMFLOAT4X4);
+	// The matrices are rewritten by the CPU every frame
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	bufferDesc.StructureByteStride = sizeof(DirectX::XMFLOAT4X4);
+
+	const auto bufferCreationResult = device->CreateBuffer(&bufferDesc, nullptr, m_buffer.GetAddressOf());
+
+	if (bufferCreationResult != S_OK)
+		throw Direct3dException("Failed to create instance buffer. Error code: "
+			+ std::to_string(bufferCreationResult));
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+	viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+	viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	viewDesc.Buffer.FirstElement = 0;
+	viewDesc.Buffer.NumElements = maxInstanceCount;
+
+	const auto viewCreationResult = device->CreateShaderResourceView(m_buffer.Get(), &viewDesc, m_view.GetAddressOf());
+
+	if (viewCreationResult != S_OK)
+		throw Direct3dException("Failed to create instance buffer view. Error code: "
+			+ std::to_string(viewCreationResult));
+}
+
+void InstanceBuffer::Update(
+	ID3D11DeviceContext* deviceContext,
+	const DirectX::XMFLOAT4X4* worldMatrices,
+	UINT instanceCount)
+{
+	if (instanceCount > m_maxInstanceCount)
+		throw Direct3dException("Too many instances for instance buffer: " + std::to_string(instanceCount));
+
+	// Discarding gives us fresh memory, so we never wait for the GPU to finish reading last frame's matrices
+	D3D11_MAPPED_SUBRESOURCE mappedBuffer;
+	const auto mapResult = deviceContext->Map(m_buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedBuffer);
+
+	if (mapResult != S_OK)
+		throw Direct3dException("Failed to map instance buffer. Error code: " + std::to_string(mapResult));
+
+	memcpy(mappedBuffer.pData, worldMatrices, instanceCount * sizeof(DirectX::XMFLOAT4X4));
+
+	deviceContext->Unmap(m_buffer.Get(), 0);
+}
+
+ID3D11ShaderResourceView* InstanceBuffer::GetView() const
+{
+	return m_view.Get();
+}
+
+UINT InstanceBuffer::GetMaxInstanceCount() const
+{
+	return m_maxInstanceCount;
+}
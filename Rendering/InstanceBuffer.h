@@ -0,0 +1,28 @@
+﻿#pragma once
+
+#include <wrl/client.h>
+#include <d3d11.h>
+#include <DirectXMath.h>
+
+/*
+ * Per-instance world matrices in a dynamic structured buffer, read by shaders with SV_InstanceID.
+ *
+ * A structured buffer can hold far more instances than a constant buffer (which is limited to 64KB),
+ * And it can be read from any shader stage - the visibility buffer shading pass looks instances up by id.
+ */
+class InstanceBuffer
+{
+public:
+	InstanceBuffer(ID3D11Device* device, UINT maxInstanceCount);
+
+	// Uploads the world matrices, which must already be transposed for HLSL
+	void Update(ID3D11DeviceContext* deviceContext, const DirectX::XMFLOAT4X4* worldMatrices, UINT instanceCount);
+
+	ID3D11ShaderResourceView* GetView() const;
+	UINT GetMaxInstanceCount() const;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_buffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_view;
+	UINT m_maxInstanceCount;
+};
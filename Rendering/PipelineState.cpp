@@ -0,0 +1,280 @@
+﻿#include "PipelineState.h"
+
+#include "CustomExceptions/Direct3dException.h"
+#include "Externals/SDL/Include/SDL.h"
+#include "Rendering/VertexLayout.h"
+
+#include <vector>
+
+uint32_t PipelineStateDescription::GetKey() const
+{
+	return static_cast<uint32_t>(Depth)
+		| static_cast<uint32_t>(Blend) << 4
+		| (ShaderFeatures & 0xFFFF) << 8
+		| (Generic ? 1u : 0u) << 31;
+}
+
+void PipelineState::Bind(ID3D11DeviceContext* deviceContext) const
+{
+	deviceContext->IASetInputLayout(InputLayout.Get());
+	deviceContext->VSSetShader(VertexShader.Get(), nullptr, 0);
+	deviceContext->PSSetShader(PixelShader.Get(), nullptr, 0);
+	deviceContext->OMSetBlendState(BlendState.Get(), nullptr, 0xFFFFFFFF);
+	deviceContext->OMSetDepthStencilState(DepthStencilState.Get(), 0);
+}
+
+PipelineStateCache::PipelineStateCache(
+	ID3D11Device* device,
+	const std::wstring& shaderFileName,
+	const D3D11_INPUT_ELEMENT_DESC* inputElements,
+	UINT inputElementCount,
+	std::shared_ptr<ShaderCache> shaderCache,
+	JobSystem& jobSystem)
+	: m_device(device),
+	m_shaderFileName(shaderFileName),
+	m_inputElements(inputElements, inputElements + inputElementCount),
+	m_shaderCache(std::move(shaderCache)),
+	m_jobSystem(jobSystem)
+{
+}
+
+const PipelineState& PipelineStateCache::GetPipelineState(const PipelineStateDescription& description)
+{
+	const auto key = description.GetKey();
+	auto existingPipelineState = m_pipelineStates.find(key);
+
+	if (existingPipelineState != m_pipelineStates.end())
+		return *existingPipelineState->second;
+
+	// The generic permutation is the fallback for everything else, so it is always created right away
+	if (description.Generic)
+		return AddGenericPipelineState(description);
+
+	if (m_failedPipelineStates.count(key) == 0)
+	{
+		auto pendingPipelineState = m_pendingPipelineStates.find(key);
+
+		if (pendingPipelineState == m_pendingPipelineStates.end())
+		{
+			StartCompile(description, false);
+		}
+		else if (pendingPipelineState->second->Counter.IsDone())
+		{
+			const auto permutation = std::move(pendingPipelineState->second);
+			m_pendingPipelineStates.erase(pendingPipelineState);
+
+			const auto pipelineState = TryAddPendingPipelineState(description, *permutation);
+
+			if (pipelineState != nullptr)
+				return *pipelineState;
+		}
+	}
+
+	auto genericDescription = description;
+	genericDescription.Generic = true;
+
+	return GetPipelineState(genericDescription);
+}
+
+size_t PipelineStateCache::GetPermutationCount() const
+{
+	return m_pipelineStates.size();
+}
+
+size_t PipelineStateCache::GetPendingPermutationCount() const
+{
+	return m_pendingPipelineStates.size();
+}
+
+void PipelineStateCache::StartCompile(const PipelineStateDescription& description, bool evictCachedShaders)
+{
+	auto permutation = std::make_shared<PendingPermutation>();
+	permutation->EvictedCachedShaders = evictCachedShaders;
+
+	// Copies of everything the job needs, so it never touches this object
+	auto shaderCache = m_shaderCache;
+	auto shaderFileName = m_shaderFileName;
+
+	// Compiling takes tens of milliseconds, so it must never run on a thread that waits for the frame's own jobs
+	m_jobSystem.ScheduleBackground([permutation, shaderCache, shaderFileName, description, evictCachedShaders]()
+	{
+		permutation->Shaders = CompileShaders(*shaderCache, shaderFileName, description, evictCachedShaders);
+	}, &permutation->Counter);
+
+	m_pendingPipelineStates[description.GetKey()] = std::move(permutation);
+}
+
+const PipelineState* PipelineStateCache::TryAddPendingPipelineState(
+	const PipelineStateDescription& description,
+	PendingPermutation& permutation)
+{
+	const auto key = description.GetKey();
+
+	try
+	{
+		// Returns right away, since the job has finished, but rethrows its exception if it failed
+		m_jobSystem.Wait(permutation.Counter);
+	}
+	catch (const std::exception& ex)
+	{
+		SDL_Log("Failed to compile pipeline permutation %08x, using the generic permutation instead: %s", key, ex.what());
+		m_failedPipelineStates.insert(key);
+
+		return nullptr;
+	}
+
+	try
+	{
+		return &AddPipelineState(description, permutation.Shaders);
+	}
+	catch (const std::exception& ex)
+	{
+		// Byte code that compiled but that the driver rejects can only have come from a damaged cache file
+		if (!permutation.EvictedCachedShaders)
+		{
+			SDL_Log("Failed to create pipeline permutation %08x, compiling it again: %s", key, ex.what());
+			StartCompile(description, true);
+		}
+		else
+		{
+			SDL_Log("Failed to create pipeline permutation %08x, using the generic permutation instead: %s", key, ex.what());
+			m_failedPipelineStates.insert(key);
+		}
+
+		return nullptr;
+	}
+}
+
+const PipelineState& PipelineStateCache::AddGenericPipelineState(const PipelineStateDescription& description)
+{
+	try
+	{
+		return AddPipelineState(description, CompileShaders(*m_shaderCache, m_shaderFileName, description, false));
+	}
+	catch (const std::exception& ex)
+	{
+		SDL_Log("Failed to create pipeline permutation %08x, compiling it again: %s", description.GetKey(), ex.what());
+	}
+
+	// Any exception this time is the caller's, since there is no permutation to fall back to
+	return AddPipelineState(description, CompileShaders(*m_shaderCache, m_shaderFileName, description, true));
+}
+
+const PipelineState& PipelineStateCache::AddPipelineState(
+	const PipelineStateDescription& description,
+	const CompiledShaders& shaders)
+{
+	const auto key = description.GetKey();
+
+	auto pipelineState = CreatePipelineState(description, shaders);
+
+	SDL_Log("Created pipeline permutation %08x. Permutation count: %u",
+		key,
+		static_cast<unsigned int>(m_pipelineStates.size() + 1));
+
+	return *(m_pipelineStates[key] = std::move(pipelineState));
+}
+
+PipelineStateCache::CompiledShaders PipelineStateCache::CompileShaders(
+	const ShaderCache& shaderCache,
+	const std::wstring& shaderFileName,
+	const PipelineStateDescription& description,
+	bool evictCachedShaders)
+{
+	const auto shaderFeatures = std::to_string(description.ShaderFeatures);
+
+	std::vector<D3D_SHADER_MACRO> defines;
+	if (description.Generic)
+		defines.push_back({ "GENERIC_PIPELINE", "1" });
+	else
+		defines.push_back({ "SHADER_FEATURES", shaderFeatures.c_str() });
+	defines.push_back({ nullptr, nullptr });
+
+	if (evictCachedShaders)
+	{
+		shaderCache.Evict(shaderFileName, "VS", "vs_5_0", defines.data());
+		shaderCache.Evict(shaderFileName, "PS", "ps_5_0", defines.data());
+	}
+
+	CompiledShaders shaders;
+	shaders.VertexShader = shaderCache.Compile(shaderFileName, "VS", "vs_5_0", defines.data());
+	shaders.PixelShader = shaderCache.Compile(shaderFileName, "PS", "ps_5_0", defines.data());
+
+	return shaders;
+}
+
+std::unique_ptr<PipelineState> PipelineStateCache::CreatePipelineState(
+	const PipelineStateDescription& description,
+	const CompiledShaders& shaders)
+{
+	auto pipelineState = std::make_unique<PipelineState>();
+
+	// Shaders
+	const auto& vertexShaderByteCode = shaders.VertexShader;
+	const auto& pixelShaderByteCode = shaders.PixelShader;
+
+	const auto vertexShaderCreationResult = m_device->CreateVertexShader(
+		vertexShaderByteCode->GetBufferPointer(),
+		vertexShaderByteCode->GetBufferSize(),
+		nullptr,
+		pipelineState->VertexShader.GetAddressOf());
+
+	if (vertexShaderCreationResult != S_OK)
+		throw Direct3dException("Failed to create vertex shader. Error code: "
+			+ std::to_string(vertexShaderCreationResult));
+
+	const auto pixelShaderCreationResult = m_device->CreatePixelShader(
+		pixelShaderByteCode->GetBufferPointer(),
+		pixelShaderByteCode->GetBufferSize(),
+		nullptr,
+		pipelineState->PixelShader.GetAddressOf());
+
+	if (pixelShaderCreationResult != S_OK)
+		throw Direct3dException("Failed to create pixel shader. Error code: "
+			+ std::to_string(pixelShaderCreationResult));
+
+	pipelineState->InputLayout = CreateInputLayout(
+		m_device.Get(),
+		m_inputElements.data(),
+		static_cast<UINT>(m_inputElements.size()),
+		vertexShaderByteCode.Get());
+
+	// Blend state
+	D3D11_BLEND_DESC blendDesc = {};
+	blendDesc.AlphaToCoverageEnable = false;
+	blendDesc.IndependentBlendEnable = false;
+
+	auto& renderTargetBlend = blendDesc.RenderTarget[0];
+	renderTargetBlend.BlendEnable = description.Blend != BlendMode::Opaque;
+	renderTargetBlend.SrcBlend = description.Blend == BlendMode::AlphaBlend ? D3D11_BLEND_SRC_ALPHA : D3D11_BLEND_ONE;
+	renderTargetBlend.DestBlend = description.Blend == BlendMode::AlphaBlend ? D3D11_BLEND_INV_SRC_ALPHA : D3D11_BLEND_ONE;
+	renderTargetBlend.BlendOp = D3D11_BLEND_OP_ADD;
+	renderTargetBlend.SrcBlendAlpha = D3D11_BLEND_ONE;
+	renderTargetBlend.DestBlendAlpha = D3D11_BLEND_ZERO;
+	renderTargetBlend.BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	renderTargetBlend.RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+
+	const auto blendStateCreationResult = m_device->CreateBlendState(&blendDesc, pipelineState->BlendState.GetAddressOf());
+
+	if (blendStateCreationResult != S_OK)
+		throw Direct3dException("Failed to create blend state. Error code: "
+			+ std::to_string(blendStateCreationResult));
+
+	// Depth stencil state
+	D3D11_DEPTH_STENCIL_DESC depthStencilDesc = {};
+	depthStencilDesc.DepthEnable = description.Depth != DepthMode::Disabled;
+	depthStencilDesc.DepthWriteMask = description.Depth == DepthMode::ReadWrite
+		? D3D11_DEPTH_WRITE_MASK_ALL
+		: D3D11_DEPTH_WRITE_MASK_ZERO;
+	depthStencilDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+	depthStencilDesc.StencilEnable = false;
+
+	const auto depthStencilStateCreationResult =
+		m_device->CreateDepthStencilState(&depthStencilDesc, pipelineState->DepthStencilState.GetAddressOf());
+
+	if (depthStencilStateCreationResult != S_OK)
+		throw Direct3dException("Failed to create depth stencil state. Error code: "
+			+ std::to_string(depthStencilStateCreationResult));
+
+	return pipelineState;
+}
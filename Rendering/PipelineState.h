@@ -0,0 +1,153 @@
+﻿#pragma once
+
+#include <wrl/client.h>
+#include <d3d11.h>
+
+#include "Rendering/ShaderCache.h"
+#include "Threading/JobSystem.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+enum class DepthMode : uint8_t
+{
+	// Depth test and depth writes enabled
+	ReadWrite,
+	// Depth test enabled, depth writes disabled. Used for transparent geometry.
+	ReadOnly,
+	Disabled
+};
+
+enum class BlendMode : uint8_t
+{
+	Opaque,
+	AlphaBlend,
+	Additive
+};
+
+// Optional shading features. Each feature is a bit in PipelineStateDescription::ShaderFeatures.
+enum ShaderFeature : uint32_t
+{
+	ShaderFeatureLighting = 1 << 0,
+	// Requires the world space position to be interpolated in addition to the normal
+	ShaderFeatureSpecular = 1 << 1,
+	// Modulates the base color with the diffuse texture
+	ShaderFeatureTexture = 1 << 2
+};
+
+/*
+ * Everything that selects a pipeline permutation.
+ *
+ * By default, the shader features are baked into the shaders as preprocessor constants, so the compiler removes
+ * Every disabled feature - including the interpolants it would need - and the pixel shader has no feature branches.
+ * When Generic is set, a single uber shader is used instead that reads the features from a constant buffer
+ * And branches on them at runtime. That path only exists so the two can be benchmarked against each other.
+ */
+struct PipelineStateDescription
+{
+	DepthMode Depth;
+	BlendMode Blend;
+	uint32_t ShaderFeatures;
+	bool Generic;
+
+	uint32_t GetKey() const;
+};
+
+// A fully created pipeline permutation: shaders plus the fixed function state objects that go with them
+struct PipelineState
+{
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> VertexShader;
+	Microsoft::WRL::ComPtr<ID3D11PixelShader> PixelShader;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> InputLayout;
+	Microsoft::WRL::ComPtr<ID3D11BlendState> BlendState;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> DepthStencilState;
+
+	void Bind(ID3D11DeviceContext* deviceContext) const;
+};
+
+/*
+ * Creates pipeline permutations of a shader file on demand and caches them in a hash table keyed by their description.
+ * Compiling a permutation is expensive, looking it up afterwards is a single hash table lookup.
+ *
+ * Specialized permutations are compiled by background jobs (and stored in the persistent ShaderCache), so states
+ * That only become known at runtime never stall a frame. Until a permutation is ready, the generic permutation
+ * With the same fixed function state is returned in its place - it renders the same image, only slower.
+ *
+ * A specialized permutation that fails to compile is logged and keeps falling back to the generic permutation. If the
+ * Driver rejects its byte code, the cached byte code is thrown away and the permutation compiled once more. Only a
+ * Generic permutation that can't be created throws, since there is nothing left to fall back to.
+ */
+class PipelineStateCache
+{
+public:
+	PipelineStateCache(
+		ID3D11Device* device,
+		const std::wstring& shaderFileName,
+		const D3D11_INPUT_ELEMENT_DESC* inputElements,
+		UINT inputElementCount,
+		std::shared_ptr<ShaderCache> shaderCache,
+		JobSystem& jobSystem);
+
+	// Returns the requested permutation, or the generic fallback while the permutation is still compiling
+	const PipelineState& GetPipelineState(const PipelineStateDescription& description);
+
+	size_t GetPermutationCount() const;
+	size_t GetPendingPermutationCount() const;
+
+private:
+	struct CompiledShaders
+	{
+		Microsoft::WRL::ComPtr<ID3DBlob> VertexShader;
+		Microsoft::WRL::ComPtr<ID3DBlob> PixelShader;
+	};
+
+	// A specialized permutation being compiled. The job owns a reference too, so it may outlive the cache.
+	struct PendingPermutation
+	{
+		JobCounter Counter;
+		CompiledShaders Shaders;
+		// The cached byte code was thrown away before compiling, after the driver rejected it
+		bool EvictedCachedShaders;
+	};
+
+	// Only touches the shader cache, so it can run on any thread. Evicting the cached byte code first compiles the
+	// Shaders from source.
+	static CompiledShaders CompileShaders(
+		const ShaderCache& shaderCache,
+		const std::wstring& shaderFileName,
+		const PipelineStateDescription& description,
+		bool evictCachedShaders);
+
+	void StartCompile(const PipelineStateDescription& description, bool evictCachedShaders);
+
+	// Creates a permutation whose compile job has finished. Returns null, and logs why, if that failed.
+	const PipelineState* TryAddPendingPipelineState(
+		const PipelineStateDescription& description,
+		PendingPermutation& permutation);
+
+	// Compiles and creates the generic permutation right away
+	const PipelineState& AddGenericPipelineState(const PipelineStateDescription& description);
+
+	// Creates the Direct3D objects. Must run on the rendering thread, since the device is single threaded.
+	std::unique_ptr<PipelineState> CreatePipelineState(
+		const PipelineStateDescription& description,
+		const CompiledShaders& shaders);
+
+	const PipelineState& AddPipelineState(
+		const PipelineStateDescription& description,
+		const CompiledShaders& shaders);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> m_device;
+	std::wstring m_shaderFileName;
+	std::vector<D3D11_INPUT_ELEMENT_DESC> m_inputElements;
+	std::shared_ptr<ShaderCache> m_shaderCache;
+	JobSystem& m_jobSystem;
+	std::unordered_map<uint32_t, std::unique_ptr<PipelineState>> m_pipelineStates;
+	std::unordered_map<uint32_t, std::shared_ptr<PendingPermutation>> m_pendingPipelineStates;
+	// Keys of the specialized permutations that couldn't be compiled or created, which always fall back
+	std::unordered_set<uint32_t> m_failedPipelineStates;
+};
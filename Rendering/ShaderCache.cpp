@@ -0,0 +1,217 @@
+﻿#include "ShaderCache.h"
+
+#include "CustomExceptions/Direct3dException.h"
+#include "Rendering/ShaderCompiler.h"
+
+#include <Windows.h>
+#include <d3dcompiler.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using namespace Microsoft::WRL;
+
+namespace
+{
+	// 64-bit FNV-1a
+	const uint64_t FnvOffsetBasis = 14695981039346656037ull;
+
+	uint64_t HashBytes(const void* data, size_t size, uint64_t hash)
+	{
+		const auto bytes = static_cast<const unsigned char*>(data);
+
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+
+		return hash;
+	}
+
+	uint64_t HashString(const std::string& value, uint64_t hash)
+	{
+		// Include the terminator, so "ab" + "c" and "a" + "bc" hash differently
+		return HashBytes(value.c_str(), value.size() + 1, hash);
+	}
+
+	std::vector<char> ReadFile(const std::wstring& fileName)
+	{
+		std::ifstream file(fileName, std::ios::binary);
+
+		if (!file)
+			return std::vector<char>();
+
+		return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	// Hashes the contents of every file the source includes with #include "...", relative to the shader's directory
+	uint64_t HashIncludedFiles(const std::wstring& fileName, const std::vector<char>& source, uint64_t hash)
+	{
+		const auto directoryEnd = fileName.find_last_of(L"/\\");
+		const auto directory = directoryEnd == std::wstring::npos ? std::wstring() : fileName.substr(0, directoryEnd + 1);
+
+		const std::string text(source.begin(), source.end());
+		const std::string directive = "#include \"";
+
+		for (auto position = text.find(directive); position != std::string::npos; position = text.find(directive, position))
+		{
+			position += directive.size();
+			const auto nameEnd = text.find('"', position);
+
+			if (nameEnd == std::string::npos)
+				break;
+
+			const std::string includeName = text.substr(position, nameEnd - position);
+			const auto includedSource = ReadFile(directory + std::wstring(includeName.begin(), includeName.end()));
+
+			hash = HashString(includeName, hash);
+			hash = HashBytes(includedSource.data(), includedSource.size(), hash);
+		}
+
+		return hash;
+	}
+
+	/*
+	 * Compiled shaders are DXBC containers, which start with the magic "DXBC", a 16 byte checksum, a version and the
+	 * Size of the whole container. A file that is shorter or longer than that was not written completely.
+	 */
+	bool IsCompleteByteCode(const std::vector<char>& byteCode)
+	{
+		const size_t headerSize = 32;
+		const size_t totalSizeOffset = 24;
+
+		if (byteCode.size() < headerSize || memcmp(byteCode.data(), "DXBC", 4) != 0)
+			return false;
+
+		uint32_t totalSize;
+		memcpy(&totalSize, byteCode.data() + totalSizeOffset, sizeof(totalSize));
+
+		return totalSize == byteCode.size();
+	}
+
+	// Writes the file under a name of its own first and then renames it, so nobody ever reads it half written
+	void WriteFileAtomically(const std::wstring& fileName, const void* data, size_t size)
+	{
+		// Other processes may be writing the same file, so the temporary name is unique per process
+		const auto temporaryFileName = fileName + L"." + std::to_wstring(GetCurrentProcessId()) + L".tmp";
+
+		{
+			std::ofstream file(temporaryFileName, std::ios::binary);
+			file.write(static_cast<const char*>(data), size);
+
+			if (!file.flush())
+			{
+				file.close();
+				DeleteFileW(temporaryFileName.c_str());
+				return;
+			}
+		}
+
+		if (!MoveFileExW(temporaryFileName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING))
+			DeleteFileW(temporaryFileName.c_str());
+	}
+}
+
+ShaderCache::ShaderCache(const std::wstring& cacheDirectory)
+	: m_cacheDirectory(cacheDirectory)
+{
+	// Fails harmlessly if the directory already exists
+	CreateDirectoryW(m_cacheDirectory.c_str(), nullptr);
+}
+
+ComPtr<ID3DBlob> ShaderCache::Compile(
+	const std::wstring& fileName,
+	const std::string& entryPoint,
+	const std::string& target,
+	const D3D_SHADER_MACRO* defines) const
+{
+	const auto cachePath = GetCachePath(fileName, entryPoint, target, defines);
+
+	// Permutations that differ only in fixed function state share their shaders, and may ask for them at the same time
+	std::lock_guard<std::mutex> lock(GetFileMutex(cachePath));
+
+	const auto cachedByteCode = ReadFile(cachePath);
+
+	if (IsCompleteByteCode(cachedByteCode))
+	{
+		ComPtr<ID3DBlob> byteCode;
+		const auto blobCreationResult = D3DCreateBlob(cachedByteCode.size(), byteCode.GetAddressOf());
+
+		if (blobCreationResult != S_OK)
+			throw Direct3dException("Failed to create blob for cached shader. Error code: "
+				+ std::to_string(blobCreationResult));
+
+		memcpy(byteCode->GetBufferPointer(), cachedByteCode.data(), cachedByteCode.size());
+
+		return byteCode;
+	}
+
+	auto byteCode = CompileShaderFromFile(fileName, entryPoint, target, defines);
+
+	// A failed write only means we compile again next time
+	WriteFileAtomically(cachePath, byteCode->GetBufferPointer(), byteCode->GetBufferSize());
+
+	return byteCode;
+}
+
+void ShaderCache::Evict(
+	const std::wstring& fileName,
+	const std::string& entryPoint,
+	const std::string& target,
+	const D3D_SHADER_MACRO* defines) const
+{
+	const auto cachePath = GetCachePath(fileName, entryPoint, target, defines);
+
+	std::lock_guard<std::mutex> lock(GetFileMutex(cachePath));
+	DeleteFileW(cachePath.c_str());
+}
+
+std::wstring ShaderCache::GetCachePath(
+	const std::wstring& fileName,
+	const std::string& entryPoint,
+	const std::string& target,
+	const D3D_SHADER_MACRO* defines) const
+{
+	const auto source = ReadFile(fileName);
+
+	if (source.empty())
+		throw Direct3dException("Failed to read shader source file");
+
+	auto key = HashBytes(source.data(), source.size(), FnvOffsetBasis);
+	key = HashIncludedFiles(fileName, source, key);
+	key = HashString(entryPoint, key);
+	key = HashString(target, key);
+
+	for (auto define = defines; define != nullptr && define->Name != nullptr; define++)
+	{
+		key = HashString(define->Name, key);
+		key = HashString(define->Definition != nullptr ? define->Definition : "", key);
+	}
+
+	// Debug builds compile shaders with different flags
+#if defined(_DEBUG)
+	key = HashString("debug", key);
+#else
+	key = HashString("release", key);
+#endif
+
+	wchar_t cacheFileName[17];
+	swprintf_s(cacheFileName, L"%016llx", static_cast<unsigned long long>(key));
+
+	return m_cacheDirectory + L"/" + cacheFileName + L".cso";
+}
+
+std::mutex& ShaderCache::GetFileMutex(const std::wstring& cachePath) const
+{
+	std::lock_guard<std::mutex> lock(m_fileMutexesMutex);
+
+	// There is one entry per shader permutation, so the map never grows large enough to be worth pruning
+	auto& fileMutex = m_fileMutexes[cachePath];
+	if (!fileMutex)
+		fileMutex = std::make_unique<std::mutex>();
+
+	return *fileMutex;
+}
@@ -0,0 +1,62 @@
+﻿#pragma once
+
+#include <wrl/client.h>
+#include <d3dcommon.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * A persistent cache of compiled shader byte code.
+ *
+ * Compiling HLSL is by far the most expensive part of creating a pipeline permutation (tens of milliseconds),
+ * While the driver turns the byte code into GPU instructions quickly. The byte code of every permutation is therefore
+ * Written to the cache directory, keyed by a hash of the shader source, entry point, target, defines and build
+ * Configuration, so a permutation is only ever compiled once per machine.
+ *
+ * Files included with #include "..." directives directly from the shader are hashed as well. Includes nested
+ * Deeper than that are not part of the key, so the cache must be cleared when they change.
+ *
+ * Compile is safe to call from several threads at once. Calls for the same shader are serialized, so a permutation is
+ * Compiled once even if several threads ask for it together. Files are written under a temporary name and then
+ * Renamed, and files whose size doesn't match their header are compiled again, so a reader never takes a half
+ * Written file for byte code.
+ */
+class ShaderCache
+{
+public:
+	ShaderCache(const std::wstring& cacheDirectory);
+
+	// Loads the shader's byte code from the cache, or compiles it and adds it to the cache
+	Microsoft::WRL::ComPtr<ID3DBlob> Compile(
+		const std::wstring& fileName,
+		const std::string& entryPoint,
+		const std::string& target,
+		const D3D_SHADER_MACRO* defines = nullptr) const;
+
+	// Deletes the shader's cached byte code, so the next Compile compiles it again. For byte code the driver rejected,
+	// Which means the cache file was damaged in a way its header doesn't show.
+	void Evict(
+		const std::wstring& fileName,
+		const std::string& entryPoint,
+		const std::string& target,
+		const D3D_SHADER_MACRO* defines = nullptr) const;
+
+private:
+	std::wstring GetCachePath(
+		const std::wstring& fileName,
+		const std::string& entryPoint,
+		const std::string& target,
+		const D3D_SHADER_MACRO* defines) const;
+
+	// One mutex per cache file, which is held while the file is read, compiled or written
+	std::mutex& GetFileMutex(const std::wstring& cachePath) const;
+
+	std::wstring m_cacheDirectory;
+
+	mutable std::mutex m_fileMutexesMutex;
+	mutable std::unordered_map<std::wstring, std::unique_ptr<std::mutex>> m_fileMutexes;
+};
@@ -0,0 +1,49 @@
+﻿#include "ShaderCompiler.h"
+
+#include "CustomExceptions/Direct3dException.h"
+
+#include <d3dcompiler.h>
+
+using namespace Microsoft::WRL;
+
+ComPtr<ID3DBlob> CompileShaderFromFile(
+	const std::wstring& fileName,
+	const std::string& entryPoint,
+	const std::string& target,
+	const D3D_SHADER_MACRO* defines)
+{
+	UINT compileFlags = D3DCOMPILE_ENABLE_STRICTNESS;
+
+#if defined(_DEBUG)
+	// Include debug information and skip optimizations, so shaders can be stepped through in the graphics debugger
+	compileFlags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
+
+	ComPtr<ID3DBlob> byteCode;
+	ComPtr<ID3DBlob> errors;
+
+	const auto compileResult = D3DCompileFromFile(
+		fileName.c_str(),
+		defines,
+		// Allows #include directives relative to the shader file
+		D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		entryPoint.c_str(),
+		target.c_str(),
+		compileFlags,
+		0,
+		byteCode.GetAddressOf(),
+		errors.GetAddressOf()
+	);
+
+	if (compileResult != S_OK)
+	{
+		std::string errorMessage = "Failed to compile shader " + entryPoint + ". Error code: " + std::to_string(compileResult);
+
+		if (errors != nullptr)
+			errorMessage += "\n" + std::string(static_cast<const char*>(errors->GetBufferPointer()), errors->GetBufferSize());
+
+		throw Direct3dException(errorMessage);
+	}
+
+	return byteCode;
+}
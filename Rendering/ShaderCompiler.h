@@ -0,0 +1,15 @@
+﻿#pragma once
+
+#include <wrl/client.h>
+#include <d3dcommon.h>
+
+#include <string>
+
+// Compiles a shader from a HLSL source file.
+// The optional defines are a null-terminated array of preprocessor macros, used to compile shader permutations.
+// Throws a Direct3dException containing the compiler output if compilation fails.
+Microsoft::WRL::ComPtr<ID3DBlob> CompileShaderFromFile(
+	const std::wstring& fileName,
+	const std::string& entryPoint,
+	const std::string& target,
+	const D3D_SHADER_MACRO* defines = nullptr);
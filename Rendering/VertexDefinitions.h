@@ -0,0 +1,41 @@
+﻿#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+typedef struct VertexDefinition1
+{
+	DirectX::XMFLOAT3 Position;
+} VertexWithPosition;
+
+// Full precision vertex, 32 bytes.
+// This is the layout meshes are generated and processed in on the CPU.
+typedef struct VertexDefinition2
+{
+	DirectX::XMFLOAT3 Position;
+	DirectX::XMFLOAT3 Normal;
+	DirectX::XMFLOAT2 TexCoord;
+} VertexWithPositionNormalTexture;
+
+/*
+ * Quantized vertex, 16 bytes. This is the layout meshes are uploaded to the GPU in.
+ *
+ * Position: 16-bit signed normalized integers, relative to the bounding box of the mesh.
+ *           The per-mesh scale and offset needed to reconstruct the position is stored in QuantizedMesh.
+ *           The w component is unused padding.
+ * Normal:   Octahedral encoding stored as two 16-bit signed normalized integers.
+ * TexCoord: Two half precision floats.
+ *
+ * The input assembler converts the normalized integers and half floats to 32-bit floats for free
+ * While fetching the vertex, so only the octahedral decode and the position scale/offset cost
+ * Any instructions in the vertex shader.
+ */
+typedef struct VertexDefinition3
+{
+	DirectX::PackedVector::XMSHORTN4 Position;
+	DirectX::PackedVector::XMSHORTN2 Normal;
+	DirectX::PackedVector::XMHALF2 TexCoord;
+} QuantizedVertex;
+
+static_assert(sizeof(VertexDefinition2) == 32, "Unexpected padding in VertexDefinition2");
+static_assert(sizeof(VertexDefinition3) == 16, "Unexpected padding in VertexDefinition3");
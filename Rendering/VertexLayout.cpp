@@ -0,0 +1,25 @@
+﻿#include "VertexLayout.h"
+
+#include "CustomExceptions/Direct3dException.h"
+
+Microsoft::WRL::ComPtr<ID3D11InputLayout> CreateInputLayout(
+	ID3D11Device* device,
+	const D3D11_INPUT_ELEMENT_DESC* inputElements,
+	UINT inputElementCount,
+	ID3DBlob* vertexShaderByteCode)
+{
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+
+	const auto inputLayoutCreationResult = device->CreateInputLayout(
+		inputElements,
+		inputElementCount,
+		vertexShaderByteCode->GetBufferPointer(),
+		vertexShaderByteCode->GetBufferSize(),
+		inputLayout.GetAddressOf());
+
+	if (inputLayoutCreationResult != S_OK)
+		throw Direct3dException("Failed to create input layout. Error code: "
+			+ std::to_string(inputLayoutCreationResult));
+
+	return inputLayout;
+}
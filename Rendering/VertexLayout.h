@@ -0,0 +1,251 @@
+﻿#pragma once
+
+#include "Rendering/VertexDefinitions.h"
+
+#include <wrl/client.h>
+#include <d3d11.h>
+#include <d3dcommon.h>
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+
+/*
+ * Compile-time vertex layout reflection.
+ *
+ * Every vertex definition describes its members with a list of VertexAttributes (semantic, format and byte offset)
+ * By specializing VertexLayout. From that single description we generate both the D3D11 input layout
+ * And a CPU vertex fetch routine. Because the attributes are template parameters, the fetch routine is fully
+ * Unrolled at compile time - there is no switch over formats in the hot path.
+ *
+ * Adding a new vertex type only requires declaring the struct and its VertexLayout specialization.
+ */
+
+enum class VertexSemantic
+{
+	Position,
+	Normal,
+	TexCoord,
+	Color,
+	Count
+};
+
+enum class VertexFormat
+{
+	Float2,
+	Float3,
+	Float4,
+	ShortN2,
+	ShortN4,
+	Half2,
+	UByteN4
+};
+
+// Maps a vertex format to its DXGI format and the routine that loads it into a SIMD register
+template<VertexFormat TFormat>
+struct VertexFormatTraits;
+
+template<>
+struct VertexFormatTraits<VertexFormat::Float2>
+{
+	static constexpr DXGI_FORMAT DxgiFormat = DXGI_FORMAT_R32G32_FLOAT;
+	static DirectX::XMVECTOR XM_CALLCONV Load(const void* data) { return DirectX::XMLoadFloat2(static_cast<const DirectX::XMFLOAT2*>(data)); }
+};
+
+template<>
+struct VertexFormatTraits<VertexFormat::Float3>
+{
+	static constexpr DXGI_FORMAT DxgiFormat = DXGI_FORMAT_R32G32B32_FLOAT;
+	static DirectX::XMVECTOR XM_CALLCONV Load(const void* data) { return DirectX::XMLoadFloat3(static_cast<const DirectX::XMFLOAT3*>(data)); }
+};
+
+template<>
+struct VertexFormatTraits<VertexFormat::Float4>
+{
+	static constexpr DXGI_FORMAT DxgiFormat = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	static DirectX::XMVECTOR XM_CALLCONV Load(const void* data) { return DirectX::XMLoadFloat4(static_cast<const DirectX::XMFLOAT4*>(data)); }
+};
+
+template<>
+struct VertexFormatTraits<VertexFormat::ShortN2>
+{
+	static constexpr DXGI_FORMAT DxgiFormat = DXGI_FORMAT_R16G16_SNORM;
+	static DirectX::XMVECTOR XM_CALLCONV Load(const void* data) { return DirectX::PackedVector::XMLoadShortN2(static_cast<const DirectX::PackedVector::XMSHORTN2*>(data)); }
+};
+
+template<>
+struct VertexFormatTraits<VertexFormat::ShortN4>
+{
+	static constexpr DXGI_FORMAT DxgiFormat = DXGI_FORMAT_R16G16B16A16_SNORM;
+	static DirectX::XMVECTOR XM_CALLCONV Load(const void* data) { return DirectX::PackedVector::XMLoadShortN4(static_cast<const DirectX::PackedVector::XMSHORTN4*>(data)); }
+};
+
+template<>
+struct VertexFormatTraits<VertexFormat::Half2>
+{
+	static constexpr DXGI_FORMAT DxgiFormat = DXGI_FORMAT_R16G16_FLOAT;
+	static DirectX::XMVECTOR XM_CALLCONV Load(const void* data) { return DirectX::PackedVector::XMLoadHalf2(static_cast<const DirectX::PackedVector::XMHALF2*>(data)); }
+};
+
+template<>
+struct VertexFormatTraits<VertexFormat::UByteN4>
+{
+	static constexpr DXGI_FORMAT DxgiFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+	static DirectX::XMVECTOR XM_CALLCONV Load(const void* data) { return DirectX::PackedVector::XMLoadUByteN4(static_cast<const DirectX::PackedVector::XMUBYTEN4*>(data)); }
+};
+
+constexpr const char* GetSemanticName(VertexSemantic semantic)
+{
+	return semantic == VertexSemantic::Position ? "POSITION"
+		: semantic == VertexSemantic::Normal ? "NORMAL"
+		: semantic == VertexSemantic::TexCoord ? "TEXCOORD"
+		: "COLOR";
+}
+
+// A single member of a vertex definition
+template<VertexSemantic TSemantic, VertexFormat TFormat, size_t TOffset>
+struct VertexAttribute
+{
+	static constexpr VertexSemantic Semantic = TSemantic;
+	static constexpr VertexFormat Format = TFormat;
+	static constexpr size_t Offset = TOffset;
+
+	static constexpr D3D11_INPUT_ELEMENT_DESC GetInputElement()
+	{
+		return {
+			GetSemanticName(TSemantic),
+			0,
+			VertexFormatTraits<TFormat>::DxgiFormat,
+			0,
+			static_cast<UINT>(TOffset),
+			D3D11_INPUT_PER_VERTEX_DATA,
+			0
+		};
+	}
+};
+
+// The attributes of a vertex after fetching, indexed by VertexSemantic
+struct FetchedVertex
+{
+	DirectX::XMVECTOR Attributes[static_cast<size_t>(VertexSemantic::Count)];
+};
+
+// Finds the attribute with the given semantic in a list of attributes at compile time
+template<VertexSemantic TSemantic, typename... TAttributes>
+struct FindVertexAttribute;
+
+template<VertexSemantic TSemantic, typename TFirst, typename... TRest>
+struct FindVertexAttribute<TSemantic, TFirst, TRest...>
+{
+	using Type = typename std::conditional<
+		TFirst::Semantic == TSemantic,
+		TFirst,
+		typename FindVertexAttribute<TSemantic, TRest...>::Type>::type;
+};
+
+template<VertexSemantic TSemantic>
+struct FindVertexAttribute<TSemantic>
+{
+	// Reaching the end of the list means the vertex type doesn't have the requested attribute
+	using Type = void;
+};
+
+template<typename... TAttributes>
+struct VertexAttributeList
+{
+	static constexpr size_t Count = sizeof...(TAttributes);
+
+	static constexpr std::array<D3D11_INPUT_ELEMENT_DESC, sizeof...(TAttributes)> GetInputElements()
+	{
+		return { { TAttributes::GetInputElement()... } };
+	}
+
+	// Loads every attribute of the vertex. The pack expansion unrolls into one load per attribute.
+	static void Fetch(const void* vertex, FetchedVertex& fetchedVertex)
+	{
+		const auto bytes = static_cast<const unsigned char*>(vertex);
+
+		const int unroll[] = {
+			(fetchedVertex.Attributes[static_cast<size_t>(TAttributes::Semantic)] =
+				VertexFormatTraits<TAttributes::Format>::Load(bytes + TAttributes::Offset), 0)...
+		};
+		(void)unroll;
+	}
+
+	template<VertexSemantic TSemantic>
+	static DirectX::XMVECTOR XM_CALLCONV FetchAttribute(const void* vertex)
+	{
+		using Attribute = typename FindVertexAttribute<TSemantic, TAttributes...>::Type;
+		static_assert(!std::is_void<Attribute>::value, "The vertex type doesn't have an attribute with the requested semantic");
+
+		return VertexFormatTraits<Attribute::Format>::Load(static_cast<const unsigned char*>(vertex) + Attribute::Offset);
+	}
+};
+
+/*
+ * Describes how the members of a vertex type map to vertex shader inputs.
+ * Every vertex definition that is uploaded to the GPU or fetched on the CPU must specialize this template
+ * With an Attributes member type listing its members.
+ */
+template<typename TVertex>
+struct VertexLayout;
+
+template<>
+struct VertexLayout<VertexDefinition1>
+{
+	using Attributes = VertexAttributeList<
+		VertexAttribute<VertexSemantic::Position, VertexFormat::Float3, offsetof(VertexDefinition1, Position)>>;
+};
+
+template<>
+struct VertexLayout<VertexDefinition2>
+{
+	using Attributes = VertexAttributeList<
+		VertexAttribute<VertexSemantic::Position, VertexFormat::Float3, offsetof(VertexDefinition2, Position)>,
+		VertexAttribute<VertexSemantic::Normal, VertexFormat::Float3, offsetof(VertexDefinition2, Normal)>,
+		VertexAttribute<VertexSemantic::TexCoord, VertexFormat::Float2, offsetof(VertexDefinition2, TexCoord)>>;
+};
+
+template<>
+struct VertexLayout<VertexDefinition3>
+{
+	using Attributes = VertexAttributeList<
+		VertexAttribute<VertexSemantic::Position, VertexFormat::ShortN4, offsetof(VertexDefinition3, Position)>,
+		VertexAttribute<VertexSemantic::Normal, VertexFormat::ShortN2, offsetof(VertexDefinition3, Normal)>,
+		VertexAttribute<VertexSemantic::TexCoord, VertexFormat::Half2, offsetof(VertexDefinition3, TexCoord)>>;
+};
+
+// Loads all attributes of a vertex
+template<typename TVertex>
+void FetchVertex(const TVertex& vertex, FetchedVertex& fetchedVertex)
+{
+	VertexLayout<TVertex>::Attributes::Fetch(&vertex, fetchedVertex);
+}
+
+// Loads a single attribute of a vertex, selected at compile time
+template<VertexSemantic TSemantic, typename TVertex>
+DirectX::XMVECTOR XM_CALLCONV FetchVertexAttribute(const TVertex& vertex)
+{
+	return VertexLayout<TVertex>::Attributes::template FetchAttribute<TSemantic>(&vertex);
+}
+
+Microsoft::WRL::ComPtr<ID3D11InputLayout> CreateInputLayout(
+	ID3D11Device* device,
+	const D3D11_INPUT_ELEMENT_DESC* inputElements,
+	UINT inputElementCount,
+	ID3DBlob* vertexShaderByteCode);
+
+// Creates the input layout for a vertex type, validated against the input signature of the given vertex shader
+template<typename TVertex>
+Microsoft::WRL::ComPtr<ID3D11InputLayout> CreateInputLayout(ID3D11Device* device, ID3DBlob* vertexShaderByteCode)
+{
+	const auto inputElements = VertexLayout<TVertex>::Attributes::GetInputElements();
+
+	return CreateInputLayout(
+		device,
+		inputElements.data(),
+		static_cast<UINT>(inputElements.size()),
+		vertexShaderByteCode);
+}
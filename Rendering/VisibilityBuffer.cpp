@@ -0,0 +1,272 @@
+﻿#include "VisibilityBuffer.h"
+
+#include "CustomExceptions/Direct3dException.h"
+#include "Rendering/VertexDefinitions.h"
+#include "Rendering/VertexLayout.h"
+
+#include <string>
+
+using namespace Microsoft::WRL;
+
+VisibilityBuffer::VisibilityBuffer(ID3D11Device* device, const ShaderCache& shaderCache, UINT width, UINT height)
+{
+	CreateTargets(device, width, height);
+	CreateShaders(device, shaderCache);
+}
+
+void VisibilityBuffer::CreateTargets(ID3D11Device* device, UINT width, UINT height)
+{
+	D3D11_TEXTURE2D_DESC visibilityDesc;
+	visibilityDesc.Width = width;
+	visibilityDesc.Height = height;
+	visibilityDesc.MipLevels = 1;
+	visibilityDesc.ArraySize = 1;
+	visibilityDesc.Format = DXGI_FORMAT_R32G32_UINT;
+	visibilityDesc.SampleDesc.Count = 1;
+	visibilityDesc.SampleDesc.Quality = 0;
+	visibilityDesc.Usage = D3D11_USAGE_DEFAULT;
+	visibilityDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	visibilityDesc.CPUAccessFlags = 0;
+	visibilityDesc.MiscFlags = 0;
+
+	ComPtr<ID3D11Texture2D> visibilityTexture;
+	const auto visibilityTextureCreationResult =
+		device->CreateTexture2D(&visibilityDesc, nullptr, visibilityTexture.GetAddressOf());
+
+	if (visibilityTextureCreationResult != S_OK)
+		throw Direct3dException("Failed to create visibility buffer texture. Error code: "
+			+ std::to_string(visibilityTextureCreationResult));
+
+	const auto targetViewCreationResult =
+		device->CreateRenderTargetView(visibilityTexture.Get(), nullptr, m_visibilityTargetView.GetAddressOf());
+
+	if (targetViewCreationResult != S_OK)
+		throw Direct3dException("Failed to create visibility buffer render target view. Error code: "
+			+ std::to_string(targetViewCreationResult));
+
+	const auto textureViewCreationResult =
+		device->CreateShaderResourceView(visibilityTexture.Get(), nullptr, m_visibilityTextureView.GetAddressOf());
+
+	if (textureViewCreationResult != S_OK)
+		throw Direct3dException("Failed to create visibility buffer shader resource view. Error code: "
+			+ std::to_string(textureViewCreationResult));
+
+	// The depth buffer must match the sample count of the visibility target, so we can't share the back buffer's.
+	// It is typeless, so it can be viewed as a depth buffer for rendering and as a float texture for reading.
+	D3D11_TEXTURE2D_DESC depthDesc = visibilityDesc;
+	depthDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	depthDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+
+	ComPtr<ID3D11Texture2D> depthTexture;
+	const auto depthTextureCreationResult = device->CreateTexture2D(&depthDesc, nullptr, depthTexture.GetAddressOf());
+
+	if (depthTextureCreationResult != S_OK)
+		throw Direct3dException("Failed to create visibility buffer depth texture. Error code: "
+			+ std::to_string(depthTextureCreationResult));
+
+	D3D11_DEPTH_STENCIL_VIEW_DESC depthViewDesc = {};
+	depthViewDesc.Format = DXGI_FORMAT_D32_FLOAT;
+	depthViewDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+	depthViewDesc.Texture2D.MipSlice = 0;
+
+	const auto depthViewCreationResult =
+		device->CreateDepthStencilView(depthTexture.Get(), &depthViewDesc, m_depthStencilView.GetAddressOf());
+
+	if (depthViewCreationResult != S_OK)
+		throw Direct3dException("Failed to create visibility buffer depth stencil view. Error code: "
+			+ std::to_string(depthViewCreationResult));
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC depthTextureViewDesc = {};
+	depthTextureViewDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	depthTextureViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	depthTextureViewDesc.Texture2D.MostDetailedMip = 0;
+	depthTextureViewDesc.Texture2D.MipLevels = 1;
+
+	const auto depthTextureViewCreationResult =
+		device->CreateShaderResourceView(depthTexture.Get(), &depthTextureViewDesc, m_depthTextureView.GetAddressOf());
+
+	if (depthTextureViewCreationResult != S_OK)
+		throw Direct3dException("Failed to create visibility buffer depth shader resource view. Error code: "
+			+ std::to_string(depthTextureViewCreationResult));
+}
+
+void VisibilityBuffer::CreateShaders(ID3D11Device* device, const ShaderCache& shaderCache)
+{
+	const std::wstring shaderFileName = L"Shaders/VisibilityBuffer.hlsl";
+
+	const auto geometryVertexShaderByteCode = shaderCache.Compile(shaderFileName, "GeometryVS", "vs_5_0");
+	const auto geometryPixelShaderByteCode = shaderCache.Compile(shaderFileName, "GeometryPS", "ps_5_0");
+	const auto clusterVertexShaderByteCode = shaderCache.Compile(shaderFileName, "ClusterGeometryVS", "vs_5_0");
+	const auto clusterPixelShaderByteCode = shaderCache.Compile(shaderFileName, "ClusterGeometryPS", "ps_5_0");
+	const auto shadingVertexShaderByteCode = shaderCache.Compile(shaderFileName, "ShadingVS", "vs_5_0");
+	const auto shadingPixelShaderByteCode = shaderCache.Compile(shaderFileName, "ShadingPS", "ps_5_0");
+
+	const auto geometryVertexShaderCreationResult = device->CreateVertexShader(
+		geometryVertexShaderByteCode->GetBufferPointer(),
+		geometryVertexShaderByteCode->GetBufferSize(),
+		nullptr,
+		m_geometryVertexShader.GetAddressOf());
+
+	if (geometryVertexShaderCreationResult != S_OK)
+		throw Direct3dException("Failed to create visibility buffer geometry vertex shader. Error code: "
+			+ std::to_string(geometryVertexShaderCreationResult));
+
+	const auto geometryPixelShaderCreationResult = device->CreatePixelShader(
+		geometryPixelShaderByteCode->GetBufferPointer(),
+		geometryPixelShaderByteCode->GetBufferSize(),
+		nullptr,
+		m_geometryPixelShader.GetAddressOf());
+
+	if (geometryPixelShaderCreationResult != S_OK)
+		throw Direct3dException("Failed to create visibility buffer geometry pixel shader. Error code: "
+			+ std::to_string(geometryPixelShaderCreationResult));
+
+	const auto clusterVertexShaderCreationResult = device->CreateVertexShader(
+		clusterVertexShaderByteCode->GetBufferPointer(),
+		clusterVertexShaderByteCode->GetBufferSize(),
+		nullptr,
+		m_clusterVertexShader.GetAddressOf());
+
+	if (clusterVertexShaderCreationResult != S_OK)
+		throw Direct3dException("Failed to create visibility buffer cluster vertex shader. Error code: "
+			+ std::to_string(clusterVertexShaderCreationResult));
+
+	const auto clusterPixelShaderCreationResult = device->CreatePixelShader(
+		clusterPixelShaderByteCode->GetBufferPointer(),
+		clusterPixelShaderByteCode->GetBufferSize(),
+		nullptr,
+		m_clusterPixelShader.GetAddressOf());
+
+	if (clusterPixelShaderCreationResult != S_OK)
+		throw Direct3dException("Failed to create visibility buffer cluster pixel shader. Error code: "
+			+ std::to_string(clusterPixelShaderCreationResult));
+
+	const auto shadingVertexShaderCreationResult = device->CreateVertexShader(
+		shadingVertexShaderByteCode->GetBufferPointer(),
+		shadingVertexShaderByteCode->GetBufferSize(),
+		nullptr,
+		m_shadingVertexShader.GetAddressOf());
+
+	if (shadingVertexShaderCreationResult != S_OK)
+		throw Direct3dException("Failed to create visibility buffer shading vertex shader. Error code: "
+			+ std::to_string(shadingVertexShaderCreationResult));
+
+	const auto shadingPixelShaderCreationResult = device->CreatePixelShader(
+		shadingPixelShaderByteCode->GetBufferPointer(),
+		shadingPixelShaderByteCode->GetBufferSize(),
+		nullptr,
+		m_shadingPixelShader.GetAddressOf());
+
+	if (shadingPixelShaderCreationResult != S_OK)
+		throw Direct3dException("Failed to create visibility buffer shading pixel shader. Error code: "
+			+ std::to_string(shadingPixelShaderCreationResult));
+
+	// The geometry pass only reads positions, the other attributes are simply ignored
+	m_geometryInputLayout = CreateInputLayout<QuantizedVertex>(device, geometryVertexShaderByteCode.Get());
+
+	// The shading pass covers the whole screen and must not be depth tested against anything
+	D3D11_DEPTH_STENCIL_DESC depthStencilDesc = {};
+	depthStencilDesc.DepthEnable = false;
+	depthStencilDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+	depthStencilDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+	depthStencilDesc.StencilEnable = false;
+
+	const auto depthStencilStateCreationResult =
+		device->CreateDepthStencilState(&depthStencilDesc, m_depthDisabledState.GetAddressOf());
+
+	if (depthStencilStateCreationResult != S_OK)
+		throw Direct3dException("Failed to create visibility buffer depth stencil state. Error code: "
+			+ std::to_string(depthStencilStateCreationResult));
+}
+
+void VisibilityBuffer::RenderGeometry(
+	ID3D11DeviceContext* deviceContext,
+	const GpuMesh& mesh,
+	const std::vector<MeshLodBatch>& batches)
+{
+	// 0 marks pixels that no triangle covers
+	const float clearIds[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	deviceContext->ClearRenderTargetView(m_visibilityTargetView.Get(), clearIds);
+	deviceContext->ClearDepthStencilView(m_depthStencilView.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+	deviceContext->OMSetRenderTargets(1, m_visibilityTargetView.GetAddressOf(), m_depthStencilView.Get());
+
+	// Default blend and depth stencil states: no blending, depth test less with writes
+	deviceContext->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
+	deviceContext->OMSetDepthStencilState(nullptr, 0);
+
+	deviceContext->IASetInputLayout(m_geometryInputLayout.Get());
+	deviceContext->VSSetShader(m_geometryVertexShader.Get(), nullptr, 0);
+	deviceContext->PSSetShader(m_geometryPixelShader.Get(), nullptr, 0);
+
+	mesh.DrawLodBatches(deviceContext, batches);
+}
+
+void VisibilityBuffer::RenderClusters(
+	ID3D11DeviceContext* deviceContext,
+	const GpuMesh& mesh,
+	ClusterCuller& clusterCuller,
+	UINT instanceCount)
+{
+	const float clearIds[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	deviceContext->ClearRenderTargetView(m_visibilityTargetView.Get(), clearIds);
+	deviceContext->ClearDepthStencilView(m_depthStencilView.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+	deviceContext->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
+	deviceContext->OMSetDepthStencilState(nullptr, 0);
+
+	// Clusters fetch their vertices themselves, so nothing is bound to the input assembler
+	deviceContext->IASetInputLayout(nullptr);
+	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	deviceContext->VSSetShader(m_clusterVertexShader.Get(), nullptr, 0);
+	deviceContext->PSSetShader(m_clusterPixelShader.Get(), nullptr, 0);
+
+	ID3D11ShaderResourceView* meshViews[] = { mesh.GetIndexBufferView(), mesh.GetVertexBufferView() };
+	deviceContext->VSSetShaderResources(2, 2, meshViews);
+
+	// First pass: the clusters that were visible last frame
+	clusterCuller.Cull(deviceContext, ClusterCullingPass::VisibleLastFrame, instanceCount);
+	deviceContext->OMSetRenderTargets(1, m_visibilityTargetView.GetAddressOf(), m_depthStencilView.Get());
+	clusterCuller.DrawVisibleClusters(deviceContext);
+
+	// The depth buffer can only be read once it is no longer bound for output
+	deviceContext->OMSetRenderTargets(1, m_visibilityTargetView.GetAddressOf(), nullptr);
+	clusterCuller.BuildDepthPyramid(deviceContext, m_depthTextureView.Get());
+
+	// Second pass: the clusters that have become visible since last frame
+	clusterCuller.Cull(deviceContext, ClusterCullingPass::Disoccluded, instanceCount);
+	deviceContext->OMSetRenderTargets(1, m_visibilityTargetView.GetAddressOf(), m_depthStencilView.Get());
+	clusterCuller.DrawVisibleClusters(deviceContext);
+
+	ID3D11ShaderResourceView* nullShaderResourceViews[] = { nullptr, nullptr };
+	deviceContext->VSSetShaderResources(2, 2, nullShaderResourceViews);
+}
+
+void VisibilityBuffer::Shade(
+	ID3D11DeviceContext* deviceContext,
+	ID3D11RenderTargetView* renderTargetView,
+	const GpuMesh& mesh)
+{
+	// The visibility target can't be read while it is still bound for output
+	deviceContext->OMSetRenderTargets(1, &renderTargetView, nullptr);
+	deviceContext->OMSetDepthStencilState(m_depthDisabledState.Get(), 0);
+
+	ID3D11ShaderResourceView* shaderResourceViews[] = {
+		m_visibilityTextureView.Get(),
+		mesh.GetIndexBufferView(),
+		mesh.GetVertexBufferView()
+	};
+	deviceContext->PSSetShaderResources(1, 3, shaderResourceViews);
+
+	// The fullscreen triangle is generated from SV_VertexID, so no vertex buffers are needed
+	deviceContext->IASetInputLayout(nullptr);
+	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	deviceContext->VSSetShader(m_shadingVertexShader.Get(), nullptr, 0);
+	deviceContext->PSSetShader(m_shadingPixelShader.Get(), nullptr, 0);
+
+	deviceContext->Draw(3, 0);
+
+	// Unbind the visibility texture, so it can be bound as a render target again next frame
+	ID3D11ShaderResourceView* nullShaderResourceView = nullptr;
+	deviceContext->PSSetShaderResources(1, 1, &nullShaderResourceView);
+}
@@ -0,0 +1,70 @@
+﻿#pragma once
+
+#include "Mesh/GpuMesh.h"
+#include "Rendering/ClusterCuller.h"
+#include "Rendering/ShaderCache.h"
+
+#include <wrl/client.h>
+#include <d3d11.h>
+
+#include <vector>
+
+/*
+ * Renders a mesh in two decoupled passes instead of shading every rasterized pixel.
+ *
+ * The geometry pass rasterizes all instances with a trivial pixel shader that writes only the instance id and
+ * Triangle id of the closest surface (and depth). The shading pass then draws a single fullscreen triangle that,
+ * For every covered pixel, fetches that triangle from the raw mesh buffers, reconstructs its attributes and shades it.
+ * With many small overlapping instances, the forward path shades the same pixel once per overlapping triangle
+ * That passes the depth test, while here every pixel is shaded exactly once - the shading cost depends only on
+ * The number of pixels, not on overdraw or triangle count.
+ *
+ * The visibility targets are single sampled, since ids can't be resolved like colors. Edges are therefore
+ * Not anti-aliased in this mode.
+ *
+ * With a ClusterCuller, the geometry pass only draws the clusters that survive culling, in the two passes
+ * The culler's occlusion test needs. The shading pass is the same either way.
+ *
+ * Both passes expect the PerMesh and PerFrame constant buffers (b0, b1) and the instance buffer (t0) to be bound
+ * For the vertex and pixel shader stages. Only meshes of QuantizedVertex are supported.
+ */
+class VisibilityBuffer
+{
+public:
+	VisibilityBuffer(ID3D11Device* device, const ShaderCache& shaderCache, UINT width, UINT height);
+
+	// Writes the ids of the visible triangles of all instances, each batch drawn with its level of detail.
+	// Replaces the bound render targets.
+	void RenderGeometry(ID3D11DeviceContext* deviceContext, const GpuMesh& mesh, const std::vector<MeshLodBatch>& batches);
+
+	// Like RenderGeometry, but culls the clusters of the mesh first. The culler must have been created for the mesh
+	// And the size of the visibility buffer. Clusters are always drawn with level 0, which the meshlets were built from.
+	void RenderClusters(
+		ID3D11DeviceContext* deviceContext,
+		const GpuMesh& mesh,
+		ClusterCuller& clusterCuller,
+		UINT instanceCount);
+
+	// Shades every pixel covered in the geometry pass into the given render target. Uncovered pixels are left untouched.
+	void Shade(ID3D11DeviceContext* deviceContext, ID3D11RenderTargetView* renderTargetView, const GpuMesh& mesh);
+
+private:
+	void CreateTargets(ID3D11Device* device, UINT width, UINT height);
+	void CreateShaders(ID3D11Device* device, const ShaderCache& shaderCache);
+
+	// R32G32_UINT: instance id + 1 (0 = nothing drawn) and triangle id
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> m_visibilityTargetView;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_visibilityTextureView;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> m_depthStencilView;
+	// The depth buffer is read by the cluster culler to build its depth pyramid
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_depthTextureView;
+
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> m_geometryVertexShader;
+	Microsoft::WRL::ComPtr<ID3D11PixelShader> m_geometryPixelShader;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> m_geometryInputLayout;
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> m_clusterVertexShader;
+	Microsoft::WRL::ComPtr<ID3D11PixelShader> m_clusterPixelShader;
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> m_shadingVertexShader;
+	Microsoft::WRL::ComPtr<ID3D11PixelShader> m_shadingPixelShader;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> m_depthDisabledState;
+};
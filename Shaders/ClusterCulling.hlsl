@@ -0,0 +1,158 @@
+#include "Common.hlsli"
+
+/*
+ * Culls clusters - one meshlet of one instance each - by frustum, normal cone and occlusion.
+ *
+ * Occlusion culling runs in two passes. The first selects the clusters that were visible last frame, which are
+ * Drawn and turned into a depth pyramid. The second tests all other clusters against that pyramid, selects the
+ * Ones that have become visible and records the visibility of every cluster for the next frame.
+ */
+
+#define CULLING_PASS_VISIBLE_LAST_FRAME 0
+#define CULLING_PASS_DISOCCLUDED 1
+
+// Must match ClusterGroupsPerRow in ClusterCuller.cpp
+#define CLUSTER_GROUPS_PER_ROW 65535
+
+cbuffer ClusterCulling : register(b2)
+{
+	uint InstanceCount;
+	uint MeshletCount;
+	uint CullingPass;
+	uint DepthPyramidLevelCount;
+	// Size of the first pyramid level, which is half the size of the render target
+	float2 DepthPyramidSize;
+	float2 ClusterCullingPadding;
+};
+
+StructuredBuffer<Meshlet> Meshlets : register(t5);
+Texture2D<float> DepthPyramid : register(t6);
+
+// Non-zero for clusters that were visible last frame
+RWStructuredBuffer<uint> ClusterVisibility : register(u0);
+// Instance id and meshlet index of every cluster to draw
+AppendStructuredBuffer<uint2> VisibleClusters : register(u1);
+
+bool IsInFrustum(float3 center, float radius)
+{
+	// The frustum planes are sums and differences of the columns of the view projection matrix,
+	// As in Gribb and Hartmann - "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix"
+	float4x4 columns = transpose(ViewProjection);
+
+	float4 planes[6] = {
+		columns[3] + columns[0],
+		columns[3] - columns[0],
+		columns[3] + columns[1],
+		columns[3] - columns[1],
+		columns[2],
+		columns[3] - columns[2]
+	};
+
+	[unroll]
+	for (int i = 0; i < 6; i++)
+	{
+		if (dot(planes[i].xyz, center) + planes[i].w < -radius * length(planes[i].xyz))
+			return false;
+	}
+
+	return true;
+}
+
+bool IsBackFacing(float3 center, float radius, float3 coneAxis, float coneCutoff)
+{
+	float3 toCenter = center - EyePositionW;
+	return dot(toCenter, coneAxis) >= coneCutoff * length(toCenter) + radius;
+}
+
+bool IsOccluded(float3 center, float radius)
+{
+	// Project the corners of the sphere's bounding box. A cluster that reaches in front of the near plane
+	// Can't be projected reliably, and is right in front of the camera anyway, so it is never occluded.
+	float2 ndcMin = float2(1.0f, 1.0f);
+	float2 ndcMax = float2(-1.0f, -1.0f);
+	float nearestDepth = 1.0f;
+
+	[unroll]
+	for (uint corner = 0; corner < 8; corner++)
+	{
+		float3 offset = float3(
+			(corner & 1) != 0 ? radius : -radius,
+			(corner & 2) != 0 ? radius : -radius,
+			(corner & 4) != 0 ? radius : -radius);
+		float4 positionH = mul(float4(center + offset, 1.0f), ViewProjection);
+
+		if (positionH.z <= 0.0f)
+			return false;
+
+		float3 ndc = positionH.xyz / positionH.w;
+		ndcMin = min(ndcMin, ndc.xy);
+		ndcMax = max(ndcMax, ndc.xy);
+		nearestDepth = min(nearestDepth, ndc.z);
+	}
+
+	// The rectangle in render target pixels. y points down in pixels.
+	float2 pixelMin = saturate(float2(ndcMin.x, -ndcMax.y) * 0.5f + 0.5f) * RenderTargetSize;
+	float2 pixelMax = saturate(float2(ndcMax.x, -ndcMin.y) * 0.5f + 0.5f) * RenderTargetSize;
+
+	// A texel of pyramid level L covers 2^(L + 1) pixels. At the chosen level the rectangle spans at most 2x2 texels.
+	float extent = max(max(pixelMax.x - pixelMin.x, pixelMax.y - pixelMin.y), 1.0f);
+	uint level = min(uint(max(ceil(log2(extent)) - 1.0f, 0.0f)), DepthPyramidLevelCount - 1);
+
+	float texelSize = exp2(float(level + 1));
+	uint2 levelSize = max(uint2(DepthPyramidSize) >> level, uint2(1, 1));
+	uint2 texelMin = min(uint2(pixelMin / texelSize), levelSize - 1);
+	uint2 texelMax = min(uint2(pixelMax / texelSize), levelSize - 1);
+
+	float farthestDepth = max(
+		max(DepthPyramid.Load(int3(texelMin, level)), DepthPyramid.Load(int3(texelMax.x, texelMin.y, level))),
+		max(DepthPyramid.Load(int3(texelMin.x, texelMax.y, level)), DepthPyramid.Load(int3(texelMax, level))));
+
+	return nearestDepth > farthestDepth;
+}
+
+[numthreads(64, 1, 1)]
+void CullClustersCS(uint3 groupId : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+	uint clusterIndex = (groupId.y * CLUSTER_GROUPS_PER_ROW + groupId.x) * 64 + groupIndex;
+
+	if (clusterIndex >= InstanceCount * MeshletCount)
+		return;
+
+	uint instanceId = clusterIndex / MeshletCount;
+	uint meshletIndex = clusterIndex - instanceId * MeshletCount;
+
+	Meshlet meshlet = Meshlets[meshletIndex];
+	float4x4 world = InstanceWorlds[instanceId];
+
+	// Bounds to world space. The radius grows with the largest scale of the instance.
+	float3 center = mul(float4(meshlet.Center, 1.0f), world).xyz;
+	float scale = max(length(world[0].xyz), max(length(world[1].xyz), length(world[2].xyz)));
+	float radius = meshlet.Radius * scale;
+
+	bool visible = IsInFrustum(center, radius);
+
+	// A cutoff of 1 marks meshlets whose normals spread too far for a cone, and their axis may be zero
+	if (visible && meshlet.ConeCutoff < 1.0f)
+	{
+		float3 coneAxis = normalize(mul(meshlet.ConeAxis, (float3x3)world));
+		visible = !IsBackFacing(center, radius, coneAxis, meshlet.ConeCutoff);
+	}
+
+	bool visibleLastFrame = ClusterVisibility[clusterIndex] != 0;
+
+	if (CullingPass == CULLING_PASS_VISIBLE_LAST_FRAME)
+	{
+		if (visible && visibleLastFrame)
+			VisibleClusters.Append(uint2(instanceId, meshletIndex));
+
+		return;
+	}
+
+	// Everything drawn in the first pass is in the pyramid, so this also catches clusters that have become occluded
+	visible = visible && !IsOccluded(center, radius);
+
+	if (visible && !visibleLastFrame)
+		VisibleClusters.Append(uint2(instanceId, meshletIndex));
+
+	ClusterVisibility[clusterIndex] = visible ? 1 : 0;
+}
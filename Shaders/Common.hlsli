@@ -0,0 +1,101 @@
+#ifndef COMMON_HLSLI
+#define COMMON_HLSLI
+
+// Shader features, must match the ShaderFeature enum
+#define SHADER_FEATURE_LIGHTING 1
+#define SHADER_FEATURE_SPECULAR 2
+#define SHADER_FEATURE_TEXTURE 4
+
+cbuffer PerMesh : register(b0)
+{
+	// Reconstructs the mesh space position from the quantized position
+	float4 PositionScale;
+	float4 PositionOffset;
+	uint Use16BitIndices;
+	uint3 PerMeshPadding;
+};
+
+cbuffer PerFrame : register(b1)
+{
+	float4x4 ViewProjection;
+	float3 EyePositionW;
+	uint ShaderFeatures;
+	float2 RenderTargetSize;
+	float2 PerFramePadding;
+};
+
+// Set by GpuMesh for every draw. SV_InstanceID and SV_PrimitiveID start at 0 for every draw, so draws of a range of
+// Instances or of a level of detail other than the first add these themselves.
+cbuffer PerDraw : register(b3)
+{
+	uint DrawFirstInstance;
+	uint DrawFirstTriangle;
+	uint2 PerDrawPadding;
+};
+
+// World matrices of all instances. Draws index them with DrawFirstInstance + SV_InstanceID.
+StructuredBuffer<float4x4> InstanceWorlds : register(t0);
+
+// Matches the Meshlet struct in MeshletBuilder.h. The bounds are in mesh space.
+struct Meshlet
+{
+	float3 Center;
+	float Radius;
+	float3 ConeAxis;
+	float ConeCutoff;
+	uint FirstTriangle;
+	uint TriangleCount;
+	uint VertexCount;
+	uint Padding;
+};
+
+// Mip mapped, sampled with trilinear filtering
+Texture2D DiffuseTexture : register(t4);
+SamplerState TrilinearSampler : register(s0);
+
+float3 DecodeOctahedralNormal(float2 encodedNormal)
+{
+	float3 normal = float3(encodedNormal.x, encodedNormal.y, 1.0f - abs(encodedNormal.x) - abs(encodedNormal.y));
+	float t = saturate(-normal.z);
+	// The ternary operator is evaluated per component for vectors
+	normal.xy += (normal.xy >= 0.0f) ? -t : t;
+	return normalize(normal);
+}
+
+float3 DecodeQuantizedPosition(float3 quantizedPosition)
+{
+	return quantizedPosition * PositionScale.xyz + PositionOffset.xyz;
+}
+
+// Shades a surface point. When the features are a compile time constant, disabled features are compiled out.
+// The texture color is only used when texturing is enabled.
+float3 ShadeSurface(float3 normal, float3 positionW, float3 textureColor, uint features)
+{
+	// Color each face by its normal
+	float3 baseColor = normal * 0.5f + 0.5f;
+
+	if ((features & SHADER_FEATURE_TEXTURE) != 0)
+		baseColor *= textureColor;
+
+	float3 color = baseColor;
+
+	float3 lightDirection = normalize(float3(-0.5f, -1.0f, 0.75f));
+
+	if ((features & SHADER_FEATURE_LIGHTING) != 0)
+	{
+		// A single directional light
+		float diffuse = saturate(dot(normal, -lightDirection));
+		color = baseColor * (0.3f + 0.7f * diffuse);
+	}
+
+	if ((features & SHADER_FEATURE_SPECULAR) != 0)
+	{
+		float3 toEye = normalize(EyePositionW - positionW);
+		float3 halfVector = normalize(toEye - lightDirection);
+		color += pow(saturate(dot(normal, halfVector)), 32.0f) * 0.5f;
+	}
+
+	return color;
+}
+
+#endif
@@ -0,0 +1,70 @@
+#include "Common.hlsli"
+
+// Specialized permutations are compiled with SHADER_FEATURES defined to the enabled features,
+// Which turns every feature test into a compile time constant. The generic pipeline reads the
+// Features from the PerFrame constant buffer and has to branch on them.
+#ifndef SHADER_FEATURES
+#define SHADER_FEATURES 0
+#endif
+
+#if defined(GENERIC_PIPELINE)
+#define ENABLED_FEATURES ShaderFeatures
+#define INTERPOLATE_WORLD_POSITION 1
+#else
+#define ENABLED_FEATURES SHADER_FEATURES
+#define INTERPOLATE_WORLD_POSITION ((SHADER_FEATURES & SHADER_FEATURE_SPECULAR) != 0)
+#endif
+
+// Matches QuantizedVertex. The input assembler has already converted
+// The normalized integers and half floats to floats.
+struct VertexIn
+{
+	float4 Position : POSITION;
+	float2 Normal : NORMAL;
+	float2 TexCoord : TEXCOORD;
+};
+
+struct VertexOut
+{
+	float4 PositionH : SV_POSITION;
+	float3 NormalW : NORMAL;
+	float2 TexCoord : TEXCOORD;
+#if INTERPOLATE_WORLD_POSITION
+	float3 PositionW : POSITION;
+#endif
+};
+
+VertexOut VS(VertexIn vin, uint instanceId : SV_InstanceID)
+{
+	VertexOut vout;
+
+	float4x4 world = InstanceWorlds[DrawFirstInstance + instanceId];
+	float4 positionW = mul(float4(DecodeQuantizedPosition(vin.Position.xyz), 1.0f), world);
+
+	vout.PositionH = mul(positionW, ViewProjection);
+	vout.NormalW = mul(DecodeOctahedralNormal(vin.Normal), (float3x3)world);
+	vout.TexCoord = vin.TexCoord;
+#if INTERPOLATE_WORLD_POSITION
+	vout.PositionW = positionW.xyz;
+#endif
+
+	return vout;
+}
+
+float4 PS(VertexOut pin) : SV_Target
+{
+#if INTERPOLATE_WORLD_POSITION
+	float3 positionW = pin.PositionW;
+#else
+	float3 positionW = float3(0.0f, 0.0f, 0.0f);
+#endif
+
+	float3 textureColor = float3(1.0f, 1.0f, 1.0f);
+
+	// The branch is on a constant buffer value (or a compile time constant), so it is uniform
+	// And the derivatives needed to select the mip level remain valid inside it
+	if ((ENABLED_FEATURES & SHADER_FEATURE_TEXTURE) != 0)
+		textureColor = DiffuseTexture.Sample(TrilinearSampler, pin.TexCoord).rgb;
+
+	return float4(ShadeSurface(normalize(pin.NormalW), positionW, textureColor, ENABLED_FEATURES), 1.0f);
+}
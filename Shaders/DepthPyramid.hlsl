@@ -0,0 +1,40 @@
+/*
+ * Builds one level of a depth pyramid for occlusion culling.
+ *
+ * Every texel keeps the farthest depth of the source texels it covers, so a surface that is nearer than a
+ * Pyramid texel is in front of everything that was drawn there. Where the source has an odd size, the last
+ * Row or column of the level covers the leftover source texels as well, which keeps the pyramid conservative.
+ */
+
+cbuffer DepthPyramidLevel : register(b2)
+{
+	uint2 SourceSize;
+	uint2 DestinationSize;
+};
+
+// The depth buffer for the first level, the previous level for all others
+Texture2D<float> SourceDepth : register(t6);
+RWTexture2D<float> DestinationDepth : register(u0);
+
+[numthreads(8, 8, 1)]
+void ReduceDepthCS(uint3 dispatchThreadId : SV_DispatchThreadID)
+{
+	if (dispatchThreadId.x >= DestinationSize.x || dispatchThreadId.y >= DestinationSize.y)
+		return;
+
+	uint2 sourceBase = dispatchThreadId.xy * 2;
+	uint2 footprint = uint2(
+		dispatchThreadId.x == DestinationSize.x - 1 ? 2 + (SourceSize.x & 1) : 2,
+		dispatchThreadId.y == DestinationSize.y - 1 ? 2 + (SourceSize.y & 1) : 2);
+
+	// Loads outside the source return 0, which never wins against a real depth
+	float depth = 0.0f;
+
+	for (uint y = 0; y < footprint.y; y++)
+	{
+		for (uint x = 0; x < footprint.x; x++)
+			depth = max(depth, SourceDepth.Load(int3(sourceBase + uint2(x, y), 0)));
+	}
+
+	DestinationDepth[dispatchThreadId.xy] = depth;
+}
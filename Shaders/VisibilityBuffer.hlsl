@@ -0,0 +1,290 @@
+#include "Common.hlsli"
+
+/*
+ * Visibility buffer rendering.
+ *
+ * The geometry pass only writes the instance id and triangle id of the closest triangle to every pixel.
+ * The shading pass then runs once per pixel, fetches the triangle from the mesh buffers, reconstructs
+ * The attributes at the pixel and shades it. No matter how much overdraw the geometry pass has,
+ * Every pixel is shaded exactly once.
+ */
+
+// ------------------------------------------------------------------------------------------------
+// Mesh buffers
+// ------------------------------------------------------------------------------------------------
+
+// The triangles are fetched by hand by the shading pass and the cluster geometry pass
+ByteAddressBuffer MeshIndices : register(t2);
+ByteAddressBuffer MeshVertices : register(t3);
+
+struct DecodedVertex
+{
+	float3 Position;
+	float3 Normal;
+	float2 TexCoord;
+};
+
+uint LoadIndex(uint index)
+{
+	if (Use16BitIndices != 0)
+	{
+		// Two 16-bit indices share every 32-bit word
+		uint word = MeshIndices.Load((index * 2) & ~3u);
+		return (index & 1) != 0 ? word >> 16 : word & 0xFFFF;
+	}
+
+	return MeshIndices.Load(index * 4);
+}
+
+float SnormToFloat(uint bits)
+{
+	// Sign extend the 16-bit value
+	int value = int(bits << 16) >> 16;
+	return max(float(value) / 32767.0f, -1.0f);
+}
+
+// Decodes a QuantizedVertex (16 bytes) by hand, since the input assembler isn't involved
+DecodedVertex LoadVertex(uint index)
+{
+	uint4 raw = MeshVertices.Load4(index * 16);
+
+	float3 quantizedPosition = float3(SnormToFloat(raw.x), SnormToFloat(raw.x >> 16), SnormToFloat(raw.y));
+	float2 encodedNormal = float2(SnormToFloat(raw.z), SnormToFloat(raw.z >> 16));
+
+	DecodedVertex vertex;
+	vertex.Position = DecodeQuantizedPosition(quantizedPosition);
+	vertex.Normal = DecodeOctahedralNormal(encodedNormal);
+	vertex.TexCoord = f16tof32(uint2(raw.w & 0xFFFF, raw.w >> 16));
+
+	return vertex;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Geometry pass
+// ------------------------------------------------------------------------------------------------
+
+struct GeometryVertexIn
+{
+	float4 Position : POSITION;
+};
+
+struct GeometryVertexOut
+{
+	float4 PositionH : SV_POSITION;
+	nointerpolation uint InstanceId : INSTANCE_ID;
+};
+
+GeometryVertexOut GeometryVS(GeometryVertexIn vin, uint instanceId : SV_InstanceID)
+{
+	GeometryVertexOut vout;
+
+	uint instance = DrawFirstInstance + instanceId;
+
+	float4 positionW = mul(float4(DecodeQuantizedPosition(vin.Position.xyz), 1.0f), InstanceWorlds[instance]);
+	vout.PositionH = mul(positionW, ViewProjection);
+	vout.InstanceId = instance;
+
+	return vout;
+}
+
+// The instance id is stored plus one, so the cleared value 0 means no triangle covers the pixel.
+// SV_PrimitiveID restarts at 0 for every instance, so it is the triangle index within the drawn level of detail.
+// Adding the level's first triangle gives the triangle index within the mesh's index buffer.
+uint2 GeometryPS(GeometryVertexOut pin, uint primitiveId : SV_PrimitiveID) : SV_Target
+{
+	return uint2(pin.InstanceId + 1, DrawFirstTriangle + primitiveId);
+}
+
+// ------------------------------------------------------------------------------------------------
+// Cluster geometry pass
+// ------------------------------------------------------------------------------------------------
+
+// Bound by ClusterCuller::DrawVisibleClusters
+StructuredBuffer<Meshlet> Meshlets : register(t5);
+StructuredBuffer<uint2> VisibleClusters : register(t6);
+
+struct ClusterVertexOut
+{
+	float4 PositionH : SV_POSITION;
+	nointerpolation uint InstanceId : INSTANCE_ID;
+	nointerpolation uint FirstTriangle : FIRST_TRIANGLE;
+};
+
+// Every instance of the draw is one visible cluster, and every vertex one corner of its meshlet
+ClusterVertexOut ClusterGeometryVS(uint vertexId : SV_VertexID, uint clusterIndex : SV_InstanceID)
+{
+	uint2 cluster = VisibleClusters[clusterIndex];
+	Meshlet meshlet = Meshlets[cluster.y];
+
+	ClusterVertexOut vout;
+	vout.InstanceId = cluster.x;
+	vout.FirstTriangle = meshlet.FirstTriangle;
+
+	// All clusters are drawn with the vertex count of the largest meshlet. The surplus triangles collapse
+	// Into a single point, so the rasterizer discards them.
+	if (vertexId >= meshlet.TriangleCount * 3)
+	{
+		vout.PositionH = float4(0.0f, 0.0f, 0.0f, 1.0f);
+		return vout;
+	}
+
+	DecodedVertex vertex = LoadVertex(LoadIndex(meshlet.FirstTriangle * 3 + vertexId));
+	float4 positionW = mul(float4(vertex.Position, 1.0f), InstanceWorlds[cluster.x]);
+	vout.PositionH = mul(positionW, ViewProjection);
+
+	return vout;
+}
+
+// SV_PrimitiveID restarts for every cluster, so the meshlet's first triangle is added to get the triangle within the mesh
+uint2 ClusterGeometryPS(ClusterVertexOut pin, uint primitiveId : SV_PrimitiveID) : SV_Target
+{
+	return uint2(pin.InstanceId + 1, pin.FirstTriangle + primitiveId);
+}
+
+// ------------------------------------------------------------------------------------------------
+// Shading pass
+// ------------------------------------------------------------------------------------------------
+
+Texture2D<uint2> VisibilityTexture : register(t1);
+// A triangle covering the whole screen, generated from the vertex id without any vertex buffer
+float4 ShadingVS(uint vertexId : SV_VertexID) : SV_POSITION
+{
+	float2 texCoord = float2((vertexId << 1) & 2, vertexId & 2);
+	return float4(texCoord * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+}
+
+/*
+ * Perspective correct barycentric coordinates of a pixel and their screen space derivatives.
+ *
+ * Hardware derivatives (ddx/ddy) come from the neighbouring pixels of a 2x2 quad, but in the shading pass
+ * Neighbouring pixels usually belong to other triangles - or other instances - so they are meaningless here.
+ * Instead the derivatives are computed analytically from the triangle itself, which also gives correct
+ * Derivatives along triangle edges, where hardware quads contain helper pixels.
+ */
+struct Barycentrics
+{
+	float3 Weights;
+	// Change of the weights when moving one pixel right or down
+	float3 Ddx;
+	float3 Ddy;
+};
+
+/*
+ * Sets up the plane equations of the triangle and evaluates them at the pixel.
+ *
+ * Barycentric weights divided by w are linear in screen space, so each is a plane a + b * x + c * y.
+ * The gradients (b, c) only depend on the triangle, the evaluation at the pixel is a few multiply-adds.
+ * Dividing by the interpolated 1/w then gives the perspective correct weights.
+ */
+Barycentrics ComputeBarycentrics(float4 positionsH[3], float2 pixelNdc)
+{
+	float3 inverseW = 1.0f / float3(positionsH[0].w, positionsH[1].w, positionsH[2].w);
+
+	float2 ndc0 = positionsH[0].xy * inverseW.x;
+	float2 ndc1 = positionsH[1].xy * inverseW.y;
+	float2 ndc2 = positionsH[2].xy * inverseW.z;
+
+	// Gradients of the weight planes (divided by w) in normalized device coordinates
+	float inverseDeterminant = 1.0f / ((ndc1.x - ndc0.x) * (ndc2.y - ndc0.y) - (ndc1.y - ndc0.y) * (ndc2.x - ndc0.x));
+	float3 planeDdx = float3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * inverseDeterminant * inverseW;
+	float3 planeDdy = float3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * inverseDeterminant * inverseW;
+
+	// Evaluate the planes at the pixel. At vertex 0 the planes are (1/w0, 0, 0).
+	float2 toPixel = pixelNdc - ndc0;
+	float3 planes = float3(inverseW.x, 0.0f, 0.0f) + toPixel.x * planeDdx + toPixel.y * planeDdy;
+	float interpolatedInverseW = planes.x + planes.y + planes.z;
+
+	Barycentrics barycentrics;
+	barycentrics.Weights = planes / interpolatedInverseW;
+
+	// One pixel is 2 / size in normalized device coordinates, and y points down in pixels
+	float3 pixelDdx = planeDdx * (2.0f / RenderTargetSize.x);
+	float3 pixelDdy = planeDdy * (-2.0f / RenderTargetSize.y);
+
+	// Weights at the neighbouring pixels minus the weights here
+	float3 planesRight = planes + pixelDdx;
+	float3 planesDown = planes + pixelDdy;
+	barycentrics.Ddx = planesRight / (planesRight.x + planesRight.y + planesRight.z) - barycentrics.Weights;
+	barycentrics.Ddy = planesDown / (planesDown.x + planesDown.y + planesDown.z) - barycentrics.Weights;
+
+	return barycentrics;
+}
+
+float2 Interpolate(Barycentrics barycentrics, float2 a, float2 b, float2 c, out float2 ddxValue, out float2 ddyValue)
+{
+	ddxValue = a * barycentrics.Ddx.x + b * barycentrics.Ddx.y + c * barycentrics.Ddx.z;
+	ddyValue = a * barycentrics.Ddy.x + b * barycentrics.Ddy.y + c * barycentrics.Ddy.z;
+	return a * barycentrics.Weights.x + b * barycentrics.Weights.y + c * barycentrics.Weights.z;
+}
+
+float3 Interpolate(Barycentrics barycentrics, float3 a, float3 b, float3 c)
+{
+	return a * barycentrics.Weights.x + b * barycentrics.Weights.y + c * barycentrics.Weights.z;
+}
+
+// The attributes of the visible surface at a pixel, as the forward pixel shader would have received them
+struct SurfaceAttributes
+{
+	float3 PositionW;
+	float3 NormalW;
+	float2 TexCoord;
+	// Texture coordinate derivatives, for mip level selection with SampleGrad
+	float2 TexCoordDdx;
+	float2 TexCoordDdy;
+};
+
+SurfaceAttributes ReconstructSurface(uint2 visibility, float2 pixelPosition)
+{
+	float4x4 world = InstanceWorlds[visibility.x - 1];
+	uint firstIndex = visibility.y * 3;
+
+	DecodedVertex vertices[3];
+	float4 positionsH[3];
+	float3 positionsW[3];
+
+	[unroll]
+	for (int i = 0; i < 3; i++)
+	{
+		vertices[i] = LoadVertex(LoadIndex(firstIndex + i));
+		positionsW[i] = mul(float4(vertices[i].Position, 1.0f), world).xyz;
+		positionsH[i] = mul(float4(positionsW[i], 1.0f), ViewProjection);
+	}
+
+	float2 pixelNdc = pixelPosition / RenderTargetSize * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f);
+	Barycentrics barycentrics = ComputeBarycentrics(positionsH, pixelNdc);
+
+	SurfaceAttributes surface;
+	surface.PositionW = Interpolate(barycentrics, positionsW[0], positionsW[1], positionsW[2]);
+
+	float3 normal = Interpolate(barycentrics, vertices[0].Normal, vertices[1].Normal, vertices[2].Normal);
+	surface.NormalW = normalize(mul(normal, (float3x3)world));
+
+	surface.TexCoord = Interpolate(
+		barycentrics,
+		vertices[0].TexCoord,
+		vertices[1].TexCoord,
+		vertices[2].TexCoord,
+		surface.TexCoordDdx,
+		surface.TexCoordDdy);
+
+	return surface;
+}
+
+float4 ShadingPS(float4 positionH : SV_POSITION) : SV_Target
+{
+	uint2 visibility = VisibilityTexture.Load(int3(positionH.xy, 0));
+
+	// Nothing was drawn here, keep the cleared back buffer
+	if (visibility.x == 0)
+		discard;
+
+	SurfaceAttributes surface = ReconstructSurface(visibility, positionH.xy);
+
+	// The mip level is selected from the analytic derivatives, since hardware derivatives are meaningless here
+	float3 textureColor = float3(1.0f, 1.0f, 1.0f);
+
+	if ((ShaderFeatures & SHADER_FEATURE_TEXTURE) != 0)
+		textureColor = DiffuseTexture.SampleGrad(TrilinearSampler, surface.TexCoord, surface.TexCoordDdx, surface.TexCoordDdy).rgb;
+
+	return float4(ShadeSurface(surface.NormalW, surface.PositionW, textureColor, ShaderFeatures), 1.0f);
+}
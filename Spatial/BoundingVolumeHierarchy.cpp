@@ -0,0 +1,848 @@
+﻿#include "BoundingVolumeHierarchy.h"
+
+#include "Externals/SDL/Include/SDL.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// SSE is available on every CPU that can run Direct3D 11. The project isn't built for AVX, so nodes are four wide.
+#include <xmmintrin.h>
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t LeafChild = 0x80000000;
+	const uint32_t EmptyChild = 0xFFFFFFFF;
+
+	// Marks the nodes on a frustum query's stack that lie entirely inside the frustum
+	const uint32_t InsideNode = 0x80000000;
+
+	// Enough treelets to keep every thread busy while the largest ones are refit or rebuilt, but not so many that the
+	// Top tree gets deep
+	const size_t TreeletsPerThread = 4;
+	const size_t MinTreeletInstances = 256;
+
+	// A treelet, or the top tree, is rebuilt once its query cost has grown by this much since it was built
+	const float RebuildCostRatio = 1.3f;
+
+	const int SahBinCount = 16;
+
+	// Below this depth, primitives are split in half instead. Even if the surface area heuristic keeps splitting off
+	// Single primitives, the depth of the tree, and the stacks of the queries, stay bounded.
+	const uint32_t MaxSahDepth = 24;
+
+	// The top tree and a treelet are each at most MaxSahDepth plus the depth of median splits over 2^32 primitives deep,
+	// And every node visited adds at most three more entries than it takes off
+	const int TraversalStackSize = 256;
+
+	double GetSecondsSince(Uint64 startCounter)
+	{
+		return static_cast<double>(SDL_GetPerformanceCounter() - startCounter) / SDL_GetPerformanceFrequency();
+	}
+
+	float GetComponent(const XMFLOAT3& vector, int axis)
+	{
+		return (&vector.x)[axis];
+	}
+
+	float GetSurfaceArea(FXMVECTOR minimum, FXMVECTOR maximum)
+	{
+		const auto size = XMVectorMax(XMVectorSubtract(maximum, minimum), XMVectorZero());
+		return 2.0f * XMVectorGetX(XMVector3Dot(size, XMVectorSwizzle<1, 2, 0, 3>(size)));
+	}
+
+	float ReduceMinimum(const float* lanes)
+	{
+		auto minimum = _mm_load_ps(lanes);
+		minimum = _mm_min_ps(minimum, _mm_shuffle_ps(minimum, minimum, _MM_SHUFFLE(2, 3, 0, 1)));
+		minimum = _mm_min_ps(minimum, _mm_shuffle_ps(minimum, minimum, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(minimum);
+	}
+
+	float ReduceMaximum(const float* lanes)
+	{
+		auto maximum = _mm_load_ps(lanes);
+		maximum = _mm_max_ps(maximum, _mm_shuffle_ps(maximum, maximum, _MM_SHUFFLE(2, 3, 0, 1)));
+		maximum = _mm_max_ps(maximum, _mm_shuffle_ps(maximum, maximum, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(maximum);
+	}
+
+	// Far enough from zero that the reciprocal stays finite, so the slab test never multiplies zero by infinity
+	float GetSafeReciprocal(float value)
+	{
+		return 1.0f / (std::abs(value) > 1e-20f ? value : std::copysign(1e-20f, value));
+	}
+}
+
+Frustum CreateFrustum(FXMMATRIX viewProjection)
+{
+	// A point is inside if its clip space coordinates satisfy -w <= x <= w, -w <= y <= w and 0 <= z <= w. The rows of
+	// The transpose turn those into planes.
+	const auto columns = XMMatrixTranspose(viewProjection);
+
+	const XMVECTOR planes[] = {
+		XMVectorAdd(columns.r[3], columns.r[0]),
+		XMVectorSubtract(columns.r[3], columns.r[0]),
+		XMVectorAdd(columns.r[3], columns.r[1]),
+		XMVectorSubtract(columns.r[3], columns.r[1]),
+		columns.r[2],
+		XMVectorSubtract(columns.r[3], columns.r[2]) };
+
+	Frustum frustum;
+	for (int i = 0; i < 6; i++)
+		XMStoreFloat4(&frustum.Planes[i], XMPlaneNormalize(planes[i]));
+
+	return frustum;
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+	: m_topNodeBegin(0),
+	m_topBuildCost(0.0f),
+	m_instanceCount(0),
+	m_statistics()
+{
+}
+
+void BoundingVolumeHierarchy::Update(const AxisAlignedBox* instanceBounds, size_t instanceCount, JobSystem& jobSystem)
+{
+	m_statistics = BvhUpdateStatistics();
+
+	if (instanceCount != m_instanceCount)
+	{
+		const auto buildStartCounter = SDL_GetPerformanceCounter();
+		Build(instanceBounds, instanceCount, jobSystem);
+		m_statistics.RebuildSeconds = GetSecondsSince(buildStartCounter);
+
+		return;
+	}
+
+	if (m_nodes.empty())
+		return;
+
+	auto startCounter = SDL_GetPerformanceCounter();
+
+	RefitTreelets(instanceBounds, jobSystem);
+	const auto topCost = RefitNodes(m_topNodeBegin, static_cast<uint32_t>(m_nodes.size()), instanceBounds);
+
+	m_statistics.RefitSeconds = GetSecondsSince(startCounter);
+	startCounter = SDL_GetPerformanceCounter();
+
+	if (topCost > m_topBuildCost * RebuildCostRatio)
+	{
+		Build(instanceBounds, instanceCount, jobSystem);
+	}
+	else
+	{
+		m_degradedTreelets.clear();
+
+		for (uint32_t i = 0; i < m_treelets.size(); i++)
+		{
+			if (m_treelets[i].Cost > m_treelets[i].BuildCost * RebuildCostRatio)
+				m_degradedTreelets.push_back(i);
+		}
+
+		if (!m_degradedTreelets.empty())
+		{
+			jobSystem.ParallelFor(m_degradedTreelets.size(), 1, [&](size_t begin, size_t end)
+			{
+				for (auto i = begin; i < end; i++)
+				{
+					const auto treelet = m_degradedTreelets[i];
+					BuildTreelet(m_treelets[treelet], instanceBounds, m_rebuiltNodes[treelet]);
+				}
+			});
+
+			// The treelets' node counts changed, so they are laid out anew, and the top tree, which is only a few
+			// Nodes, is rebuilt with them
+			BuildTopTree(instanceBounds);
+			m_statistics.RebuiltTreeletCount = static_cast<uint32_t>(m_degradedTreelets.size());
+		}
+	}
+
+	m_statistics.RebuildSeconds = GetSecondsSince(startCounter);
+}
+
+uint32_t BoundingVolumeHierarchy::IntersectRay(const Ray& ray, float& hitDistance) const
+{
+	if (m_nodes.empty())
+		return NoBvhInstance;
+
+	const auto originX = _mm_set1_ps(ray.Origin.x);
+	const auto originY = _mm_set1_ps(ray.Origin.y);
+	const auto originZ = _mm_set1_ps(ray.Origin.z);
+	const auto inverseDirectionX = _mm_set1_ps(GetSafeReciprocal(ray.Direction.x));
+	const auto inverseDirectionY = _mm_set1_ps(GetSafeReciprocal(ray.Direction.y));
+	const auto inverseDirectionZ = _mm_set1_ps(GetSafeReciprocal(ray.Direction.z));
+
+	// The ray enters every slab through the side it points away from. Empty lanes have their minimum above their
+	// Maximum, so the ray leaves them before it enters.
+	const auto negativeX = ray.Direction.x < 0.0f;
+	const auto negativeY = ray.Direction.y < 0.0f;
+	const auto negativeZ = ray.Direction.z < 0.0f;
+
+	struct StackEntry
+	{
+		uint32_t Node;
+		float Distance;
+	};
+
+	StackEntry stack[TraversalStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = StackEntry{ m_topNodeBegin, 0.0f };
+
+	auto closestDistance = ray.MaxDistance;
+	auto closestInstance = NoBvhInstance;
+
+	while (stackSize > 0)
+	{
+		const auto entry = stack[--stackSize];
+
+		// A closer hit was found since the node was pushed
+		if (entry.Distance > closestDistance)
+			continue;
+
+		const auto& node = m_nodes[entry.Node];
+
+		const auto nearX = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(negativeX ? node.MaximumX : node.MinimumX), originX), inverseDirectionX);
+		const auto nearY = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(negativeY ? node.MaximumY : node.MinimumY), originY), inverseDirectionY);
+		const auto nearZ = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(negativeZ ? node.MaximumZ : node.MinimumZ), originZ), inverseDirectionZ);
+		const auto farX = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(negativeX ? node.MinimumX : node.MaximumX), originX), inverseDirectionX);
+		const auto farY = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(negativeY ? node.MinimumY : node.MaximumY), originY), inverseDirectionY);
+		const auto farZ = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(negativeZ ? node.MinimumZ : node.MaximumZ), originZ), inverseDirectionZ);
+
+		const auto entryDistances = _mm_max_ps(_mm_max_ps(nearX, nearY), _mm_max_ps(nearZ, _mm_setzero_ps()));
+		const auto exitDistances = _mm_min_ps(_mm_min_ps(farX, farY), farZ);
+
+		const auto hitMask = _mm_movemask_ps(_mm_and_ps(
+			_mm_cmple_ps(entryDistances, exitDistances),
+			_mm_cmple_ps(entryDistances, _mm_set1_ps(closestDistance))));
+
+		if (hitMask == 0)
+			continue;
+
+		alignas(16) float distances[NodeWidth];
+		_mm_store_ps(distances, entryDistances);
+
+		// The child nodes that were hit, pushed farthest first, so the closest is visited next
+		StackEntry hitNodes[NodeWidth];
+		int hitNodeCount = 0;
+
+		for (uint32_t lane = 0; lane < NodeWidth; lane++)
+		{
+			if ((hitMask & (1 << lane)) == 0)
+				continue;
+
+			const auto child = node.Children[lane];
+
+			if (child == EmptyChild)
+				continue;
+
+			if (child & LeafChild)
+			{
+				if (distances[lane] <= closestDistance)
+				{
+					closestDistance = distances[lane];
+					closestInstance = child & ~LeafChild;
+				}
+			}
+			else
+			{
+				auto position = hitNodeCount++;
+				for (; position > 0 && hitNodes[position - 1].Distance < distances[lane]; position--)
+					hitNodes[position] = hitNodes[position - 1];
+
+				hitNodes[position] = StackEntry{ child, distances[lane] };
+			}
+		}
+
+		for (int i = 0; i < hitNodeCount; i++)
+			stack[stackSize++] = hitNodes[i];
+	}
+
+	if (closestInstance != NoBvhInstance)
+		hitDistance = closestDistance;
+
+	return closestInstance;
+}
+
+void BoundingVolumeHierarchy::QueryBox(const AxisAlignedBox& box, std::vector<uint32_t>& instances) const
+{
+	instances.clear();
+
+	if (m_nodes.empty())
+		return;
+
+	const auto boxMinimumX = _mm_set1_ps(box.Minimum.x);
+	const auto boxMinimumY = _mm_set1_ps(box.Minimum.y);
+	const auto boxMinimumZ = _mm_set1_ps(box.Minimum.z);
+	const auto boxMaximumX = _mm_set1_ps(box.Maximum.x);
+	const auto boxMaximumY = _mm_set1_ps(box.Maximum.y);
+	const auto boxMaximumZ = _mm_set1_ps(box.Maximum.z);
+
+	uint32_t stack[TraversalStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = m_topNodeBegin;
+
+	while (stackSize > 0)
+	{
+		const auto& node = m_nodes[stack[--stackSize]];
+
+		// Overlapping unless a child starts past the end of the box, or ends before its start, on any axis
+		const auto overlapX = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.MinimumX), boxMaximumX), _mm_cmpge_ps(_mm_load_ps(node.MaximumX), boxMinimumX));
+		const auto overlapY = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.MinimumY), boxMaximumY), _mm_cmpge_ps(_mm_load_ps(node.MaximumY), boxMinimumY));
+		const auto overlapZ = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.MinimumZ), boxMaximumZ), _mm_cmpge_ps(_mm_load_ps(node.MaximumZ), boxMinimumZ));
+		const auto overlapMask = _mm_movemask_ps(_mm_and_ps(_mm_and_ps(overlapX, overlapY), overlapZ));
+
+		for (uint32_t lane = 0; lane < NodeWidth; lane++)
+		{
+			if ((overlapMask & (1 << lane)) == 0)
+				continue;
+
+			const auto child = node.Children[lane];
+
+			if (child == EmptyChild)
+				continue;
+
+			if (child & LeafChild)
+				instances.push_back(child & ~LeafChild);
+			else
+				stack[stackSize++] = child;
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& instances) const
+{
+	instances.clear();
+
+	if (m_nodes.empty())
+		return;
+
+	uint32_t stack[TraversalStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = m_topNodeBegin;
+
+	while (stackSize > 0)
+	{
+		const auto entry = stack[--stackSize];
+		const auto& node = m_nodes[entry & ~InsideNode];
+
+		// Everything below a node inside the frustum is inside as well, and taken without any more tests
+		if (entry & InsideNode)
+		{
+			for (uint32_t lane = 0; lane < NodeWidth; lane++)
+			{
+				const auto child = node.Children[lane];
+
+				if (child == EmptyChild)
+					continue;
+
+				if (child & LeafChild)
+					instances.push_back(child & ~LeafChild);
+				else
+					stack[stackSize++] = child | InsideNode;
+			}
+
+			continue;
+		}
+
+		const auto half = _mm_set1_ps(0.5f);
+		const auto centerX = _mm_mul_ps(_mm_add_ps(_mm_load_ps(node.MinimumX), _mm_load_ps(node.MaximumX)), half);
+		const auto centerY = _mm_mul_ps(_mm_add_ps(_mm_load_ps(node.MinimumY), _mm_load_ps(node.MaximumY)), half);
+		const auto centerZ = _mm_mul_ps(_mm_add_ps(_mm_load_ps(node.MinimumZ), _mm_load_ps(node.MaximumZ)), half);
+		const auto extentX = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MaximumX), _mm_load_ps(node.MinimumX)), half);
+		const auto extentY = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MaximumY), _mm_load_ps(node.MinimumY)), half);
+		const auto extentZ = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.MaximumZ), _mm_load_ps(node.MinimumZ)), half);
+
+		auto outside = _mm_setzero_ps();
+		auto inside = _mm_cmpeq_ps(outside, outside);
+
+		for (const auto& plane : frustum.Planes)
+		{
+			const auto distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(centerX, _mm_set1_ps(plane.x)), _mm_mul_ps(centerY, _mm_set1_ps(plane.y))),
+				_mm_add_ps(_mm_mul_ps(centerZ, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+
+			// How far the box reaches towards the plane's normal
+			const auto radius = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(extentX, _mm_set1_ps(std::abs(plane.x))), _mm_mul_ps(extentY, _mm_set1_ps(std::abs(plane.y)))),
+				_mm_mul_ps(extentZ, _mm_set1_ps(std::abs(plane.z))));
+
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_sub_ps(distance, radius), _mm_setzero_ps()));
+		}
+
+		const auto outsideMask = _mm_movemask_ps(outside);
+		const auto insideMask = _mm_movemask_ps(inside);
+
+		for (uint32_t lane = 0; lane < NodeWidth; lane++)
+		{
+			if (outsideMask & (1 << lane))
+				continue;
+
+			const auto child = node.Children[lane];
+
+			if (child == EmptyChild)
+				continue;
+
+			if (child & LeafChild)
+				instances.push_back(child & ~LeafChild);
+			else
+				stack[stackSize++] = insideMask & (1 << lane) ? child | InsideNode : child;
+		}
+	}
+}
+
+size_t BoundingVolumeHierarchy::GetNodeCount() const
+{
+	return m_nodes.size();
+}
+
+size_t BoundingVolumeHierarchy::GetTreeletCount() const
+{
+	return m_treelets.size();
+}
+
+const BvhUpdateStatistics& BoundingVolumeHierarchy::GetLastUpdateStatistics() const
+{
+	return m_statistics;
+}
+
+void BoundingVolumeHierarchy::Build(const AxisAlignedBox* instanceBounds, size_t instanceCount, JobSystem& jobSystem)
+{
+	m_instanceCount = instanceCount;
+	m_treelets.clear();
+	m_nodes.clear();
+	m_topNodeBegin = 0;
+	m_topBuildCost = 0.0f;
+
+	m_statistics.FullRebuild = true;
+
+	if (instanceCount == 0)
+		return;
+
+	std::vector<BuildPrimitive> primitives(instanceCount);
+
+	jobSystem.ParallelFor(instanceCount, 4096, [&](size_t begin, size_t end)
+	{
+		for (auto i = begin; i < end; i++)
+		{
+			const auto& bounds = instanceBounds[i];
+			auto& primitive = primitives[i];
+
+			primitive.Minimum = bounds.Minimum;
+			primitive.Maximum = bounds.Maximum;
+			XMStoreFloat3(&primitive.Center,
+				XMVectorScale(XMVectorAdd(XMLoadFloat3(&bounds.Minimum), XMLoadFloat3(&bounds.Maximum)), 0.5f));
+			primitive.Child = static_cast<uint32_t>(i) | LeafChild;
+		}
+	});
+
+	// The same splits as the top of a tree over all instances, down to where the ranges are small enough
+	const auto treeletSize = std::max(
+		MinTreeletInstances,
+		(instanceCount + jobSystem.GetThreadCount() * TreeletsPerThread - 1) / (jobSystem.GetThreadCount() * TreeletsPerThread));
+
+	struct Range
+	{
+		size_t Begin;
+		size_t Count;
+		uint32_t Depth;
+	};
+
+	std::vector<Range> ranges = { Range{ 0, instanceCount, 0 } };
+
+	while (!ranges.empty())
+	{
+		const auto range = ranges.back();
+		ranges.pop_back();
+
+		if (range.Count <= treeletSize)
+		{
+			Treelet treelet = {};
+			treelet.InstanceBegin = static_cast<uint32_t>(range.Begin);
+			treelet.InstanceEnd = static_cast<uint32_t>(range.Begin + range.Count);
+			m_treelets.push_back(treelet);
+
+			continue;
+		}
+
+		const auto lowerCount = SplitPrimitives(&primitives[range.Begin], range.Count, range.Depth);
+		ranges.push_back(Range{ range.Begin, lowerCount, range.Depth + 1 });
+		ranges.push_back(Range{ range.Begin + lowerCount, range.Count - lowerCount, range.Depth + 1 });
+	}
+
+	m_treeletInstances.resize(instanceCount);
+	for (size_t i = 0; i < instanceCount; i++)
+		m_treeletInstances[i] = primitives[i].Child & ~LeafChild;
+
+	m_rebuiltNodes.resize(m_treelets.size());
+
+	jobSystem.ParallelFor(m_treelets.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (auto i = begin; i < end; i++)
+			BuildTreelet(m_treelets[i], instanceBounds, m_rebuiltNodes[i]);
+	});
+
+	BuildTopTree(instanceBounds);
+	m_statistics.RebuiltTreeletCount = static_cast<uint32_t>(m_treelets.size());
+}
+
+void BoundingVolumeHierarchy::BuildTreelet(
+	const Treelet& treelet,
+	const AxisAlignedBox* instanceBounds,
+	std::vector<Node>& nodes) const
+{
+	std::vector<BuildPrimitive> primitives(treelet.InstanceEnd - treelet.InstanceBegin);
+
+	for (size_t i = 0; i < primitives.size(); i++)
+	{
+		const auto instance = m_treeletInstances[treelet.InstanceBegin + i];
+		const auto& bounds = instanceBounds[instance];
+		auto& primitive = primitives[i];
+
+		primitive.Minimum = bounds.Minimum;
+		primitive.Maximum = bounds.Maximum;
+		XMStoreFloat3(&primitive.Center,
+			XMVectorScale(XMVectorAdd(XMLoadFloat3(&bounds.Minimum), XMLoadFloat3(&bounds.Maximum)), 0.5f));
+		primitive.Child = instance | LeafChild;
+	}
+
+	nodes.clear();
+
+	XMVECTOR minimum;
+	XMVECTOR maximum;
+	BuildNode(primitives.data(), primitives.size(), 0, nodes, minimum, maximum);
+}
+
+void BoundingVolumeHierarchy::BuildTopTree(const AxisAlignedBox* instanceBounds)
+{
+	auto& nodes = m_nodeScratch;
+	nodes.clear();
+
+	std::vector<BuildPrimitive> primitives(m_treelets.size());
+
+	for (size_t i = 0; i < m_treelets.size(); i++)
+	{
+		auto& treelet = m_treelets[i];
+		const auto& rebuiltNodes = m_rebuiltNodes[i];
+
+		// Child indices are numbered from the start of wherever the nodes come from
+		const auto sourceBegin = rebuiltNodes.empty() ? treelet.NodeBegin : 0;
+		const auto source = rebuiltNodes.empty() ? &m_nodes[treelet.NodeBegin] : rebuiltNodes.data();
+		const auto sourceCount = rebuiltNodes.empty() ? treelet.NodeEnd - treelet.NodeBegin : static_cast<uint32_t>(rebuiltNodes.size());
+
+		treelet.NodeBegin = static_cast<uint32_t>(nodes.size());
+		treelet.NodeEnd = treelet.NodeBegin + sourceCount;
+
+		for (uint32_t j = 0; j < sourceCount; j++)
+		{
+			auto node = source[j];
+
+			for (auto& child : node.Children)
+			{
+				if ((child & LeafChild) == 0)
+					child = child - sourceBegin + treelet.NodeBegin;
+			}
+
+			nodes.push_back(node);
+		}
+
+		const auto& root = nodes[treelet.NodeBegin];
+		auto& primitive = primitives[i];
+
+		primitive.Minimum = XMFLOAT3(ReduceMinimum(root.MinimumX), ReduceMinimum(root.MinimumY), ReduceMinimum(root.MinimumZ));
+		primitive.Maximum = XMFLOAT3(ReduceMaximum(root.MaximumX), ReduceMaximum(root.MaximumY), ReduceMaximum(root.MaximumZ));
+		XMStoreFloat3(&primitive.Center,
+			XMVectorScale(XMVectorAdd(XMLoadFloat3(&primitive.Minimum), XMLoadFloat3(&primitive.Maximum)), 0.5f));
+		primitive.Child = treelet.NodeBegin;
+	}
+
+	m_topNodeBegin = static_cast<uint32_t>(nodes.size());
+
+	XMVECTOR minimum;
+	XMVECTOR maximum;
+	BuildNode(primitives.data(), primitives.size(), 0, nodes, minimum, maximum);
+
+	m_nodes.swap(nodes);
+
+	for (size_t i = 0; i < m_treelets.size(); i++)
+	{
+		if (m_rebuiltNodes[i].empty())
+			continue;
+
+		auto& treelet = m_treelets[i];
+		treelet.BuildCost = RefitNodes(treelet.NodeBegin, treelet.NodeEnd, instanceBounds);
+		treelet.Cost = treelet.BuildCost;
+
+		m_rebuiltNodes[i].clear();
+	}
+
+	m_topBuildCost = RefitNodes(m_topNodeBegin, static_cast<uint32_t>(m_nodes.size()), instanceBounds);
+}
+
+uint32_t BoundingVolumeHierarchy::BuildNode(
+	BuildPrimitive* primitives,
+	size_t count,
+	uint32_t depth,
+	std::vector<Node>& nodes,
+	XMVECTOR& minimum,
+	XMVECTOR& maximum)
+{
+	const auto nodeIndex = static_cast<uint32_t>(nodes.size());
+
+	Node emptyNode;
+	std::fill(std::begin(emptyNode.MinimumX), std::end(emptyNode.MinimumX), FLT_MAX);
+	std::fill(std::begin(emptyNode.MinimumY), std::end(emptyNode.MinimumY), FLT_MAX);
+	std::fill(std::begin(emptyNode.MinimumZ), std::end(emptyNode.MinimumZ), FLT_MAX);
+	std::fill(std::begin(emptyNode.MaximumX), std::end(emptyNode.MaximumX), -FLT_MAX);
+	std::fill(std::begin(emptyNode.MaximumY), std::end(emptyNode.MaximumY), -FLT_MAX);
+	std::fill(std::begin(emptyNode.MaximumZ), std::end(emptyNode.MaximumZ), -FLT_MAX);
+	std::fill(std::begin(emptyNode.Children), std::end(emptyNode.Children), EmptyChild);
+	nodes.push_back(emptyNode);
+
+	// Up to four groups of primitives, each of which becomes a child: split in two, and each half in two again
+	size_t groupStarts[NodeWidth + 1] = { 0 };
+	size_t groupCount = 0;
+
+	if (count <= NodeWidth)
+	{
+		for (size_t i = 0; i <= count; i++)
+			groupStarts[i] = i;
+
+		groupCount = count;
+	}
+	else
+	{
+		const auto lowerCount = SplitPrimitives(primitives, count, depth);
+		const size_t halves[] = { 0, lowerCount, count };
+
+		for (int half = 0; half < 2; half++)
+		{
+			const auto halfCount = halves[half + 1] - halves[half];
+
+			groupStarts[groupCount++] = halves[half];
+			if (halfCount > 1)
+				groupStarts[groupCount++] = halves[half] + SplitPrimitives(primitives + halves[half], halfCount, depth);
+		}
+
+		groupStarts[groupCount] = count;
+	}
+
+	minimum = XMVectorReplicate(FLT_MAX);
+	maximum = XMVectorReplicate(-FLT_MAX);
+
+	for (size_t group = 0; group < groupCount; group++)
+	{
+		const auto groupBegin = groupStarts[group];
+		const auto groupSize = groupStarts[group + 1] - groupBegin;
+
+		uint32_t child;
+		XMVECTOR childMinimum;
+		XMVECTOR childMaximum;
+
+		if (groupSize == 1)
+		{
+			child = primitives[groupBegin].Child;
+			childMinimum = XMLoadFloat3(&primitives[groupBegin].Minimum);
+			childMaximum = XMLoadFloat3(&primitives[groupBegin].Maximum);
+		}
+		else
+		{
+			child = BuildNode(primitives + groupBegin, groupSize, depth + 1, nodes, childMinimum, childMaximum);
+		}
+
+		// The recursion may have moved the nodes
+		auto& node = nodes[nodeIndex];
+		node.MinimumX[group] = XMVectorGetX(childMinimum);
+		node.MinimumY[group] = XMVectorGetY(childMinimum);
+		node.MinimumZ[group] = XMVectorGetZ(childMinimum);
+		node.MaximumX[group] = XMVectorGetX(childMaximum);
+		node.MaximumY[group] = XMVectorGetY(childMaximum);
+		node.MaximumZ[group] = XMVectorGetZ(childMaximum);
+		node.Children[group] = child;
+
+		minimum = XMVectorMin(minimum, childMinimum);
+		maximum = XMVectorMax(maximum, childMaximum);
+	}
+
+	return nodeIndex;
+}
+
+size_t BoundingVolumeHierarchy::SplitPrimitives(BuildPrimitive* primitives, size_t count, uint32_t depth)
+{
+	auto centerMinimum = XMVectorReplicate(FLT_MAX);
+	auto centerMaximum = XMVectorReplicate(-FLT_MAX);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const auto center = XMLoadFloat3(&primitives[i].Center);
+		centerMinimum = XMVectorMin(centerMinimum, center);
+		centerMaximum = XMVectorMax(centerMaximum, center);
+	}
+
+	// The axis along which the centers spread the farthest
+	XMFLOAT3 extent;
+	XMStoreFloat3(&extent, XMVectorSubtract(centerMaximum, centerMinimum));
+	const auto axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+	const auto axisMinimum = XMVectorGetByIndex(centerMinimum, axis);
+	const auto axisExtent = GetComponent(extent, axis);
+
+	const auto splitInHalf = [&]()
+	{
+		std::nth_element(primitives, primitives + count / 2, primitives + count,
+			[axis](const BuildPrimitive& a, const BuildPrimitive& b)
+		{
+			return GetComponent(a.Center, axis) < GetComponent(b.Center, axis);
+		});
+
+		return count / 2;
+	};
+
+	if (count <= 2 || axisExtent <= 0.0f || depth >= MaxSahDepth)
+		return splitInHalf();
+
+	// The centers are sorted into bins along the axis, and the split between two bins with the lowest cost wins:
+	// The surface area of either side times the number of primitives on it.
+	const auto binScale = SahBinCount / axisExtent;
+	const auto getBin = [=](const BuildPrimitive& primitive)
+	{
+		return std::min(static_cast<int>((GetComponent(primitive.Center, axis) - axisMinimum) * binScale), SahBinCount - 1);
+	};
+
+	XMVECTOR binMinimums[SahBinCount];
+	XMVECTOR binMaximums[SahBinCount];
+	size_t binCounts[SahBinCount] = {};
+
+	for (int bin = 0; bin < SahBinCount; bin++)
+	{
+		binMinimums[bin] = XMVectorReplicate(FLT_MAX);
+		binMaximums[bin] = XMVectorReplicate(-FLT_MAX);
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const auto bin = getBin(primitives[i]);
+		binMinimums[bin] = XMVectorMin(binMinimums[bin], XMLoadFloat3(&primitives[i].Minimum));
+		binMaximums[bin] = XMVectorMax(binMaximums[bin], XMLoadFloat3(&primitives[i].Maximum));
+		binCounts[bin]++;
+	}
+
+	// The cost of everything above each split, swept from the top down
+	float upperCosts[SahBinCount];
+	auto upperMinimum = XMVectorReplicate(FLT_MAX);
+	auto upperMaximum = XMVectorReplicate(-FLT_MAX);
+	size_t upperCount = 0;
+
+	for (int bin = SahBinCount - 1; bin > 0; bin--)
+	{
+		upperMinimum = XMVectorMin(upperMinimum, binMinimums[bin]);
+		upperMaximum = XMVectorMax(upperMaximum, binMaximums[bin]);
+		upperCount += binCounts[bin];
+		upperCosts[bin] = GetSurfaceArea(upperMinimum, upperMaximum) * upperCount;
+	}
+
+	auto lowerMinimum = XMVectorReplicate(FLT_MAX);
+	auto lowerMaximum = XMVectorReplicate(-FLT_MAX);
+	size_t lowerCount = 0;
+
+	auto bestCost = FLT_MAX;
+	auto bestSplit = -1;
+
+	// Split below bin + 1
+	for (int bin = 0; bin < SahBinCount - 1; bin++)
+	{
+		lowerMinimum = XMVectorMin(lowerMinimum, binMinimums[bin]);
+		lowerMaximum = XMVectorMax(lowerMaximum, binMaximums[bin]);
+		lowerCount += binCounts[bin];
+
+		if (lowerCount == 0 || lowerCount == count)
+			continue;
+
+		const auto cost = GetSurfaceArea(lowerMinimum, lowerMaximum) * lowerCount + upperCosts[bin + 1];
+		if (cost < bestCost)
+		{
+			bestCost = cost;
+			bestSplit = bin;
+		}
+	}
+
+	if (bestSplit < 0)
+		return splitInHalf();
+
+	const auto upper = std::partition(primitives, primitives + count, [&](const BuildPrimitive& primitive)
+	{
+		return getBin(primitive) <= bestSplit;
+	});
+
+	return static_cast<size_t>(upper - primitives);
+}
+
+float BoundingVolumeHierarchy::RefitNodes(uint32_t nodeBegin, uint32_t nodeEnd, const AxisAlignedBox* instanceBounds)
+{
+	// Surface area of every node but the first, which is added at the end as the area everything is relative to
+	auto surfaceAreaSum = 0.0f;
+
+	for (auto index = nodeEnd; index-- > nodeBegin;)
+	{
+		auto& node = m_nodes[index];
+
+		for (uint32_t lane = 0; lane < NodeWidth; lane++)
+		{
+			const auto child = node.Children[lane];
+
+			if (child == EmptyChild)
+				continue;
+
+			if (child & LeafChild)
+			{
+				const auto& bounds = instanceBounds[child & ~LeafChild];
+				node.MinimumX[lane] = bounds.Minimum.x;
+				node.MinimumY[lane] = bounds.Minimum.y;
+				node.MinimumZ[lane] = bounds.Minimum.z;
+				node.MaximumX[lane] = bounds.Maximum.x;
+				node.MaximumY[lane] = bounds.Maximum.y;
+				node.MaximumZ[lane] = bounds.Maximum.z;
+			}
+			else
+			{
+				// Later in the range, or the root of a treelet that was refit before the top tree, so already refit
+				const auto& childNode = m_nodes[child];
+				node.MinimumX[lane] = ReduceMinimum(childNode.MinimumX);
+				node.MinimumY[lane] = ReduceMinimum(childNode.MinimumY);
+				node.MinimumZ[lane] = ReduceMinimum(childNode.MinimumZ);
+				node.MaximumX[lane] = ReduceMaximum(childNode.MaximumX);
+				node.MaximumY[lane] = ReduceMaximum(childNode.MaximumY);
+				node.MaximumZ[lane] = ReduceMaximum(childNode.MaximumZ);
+
+				surfaceAreaSum += GetSurfaceArea(
+					XMVectorSet(node.MinimumX[lane], node.MinimumY[lane], node.MinimumZ[lane], 0.0f),
+					XMVectorSet(node.MaximumX[lane], node.MaximumY[lane], node.MaximumZ[lane], 0.0f));
+			}
+		}
+	}
+
+	const auto& first = m_nodes[nodeBegin];
+	const auto firstSurfaceArea = GetSurfaceArea(
+		XMVectorSet(ReduceMinimum(first.MinimumX), ReduceMinimum(first.MinimumY), ReduceMinimum(first.MinimumZ), 0.0f),
+		XMVectorSet(ReduceMaximum(first.MaximumX), ReduceMaximum(first.MaximumY), ReduceMaximum(first.MaximumZ), 0.0f));
+
+	// Every query that reaches the first node visits it. The others are visited as often as a random ray that hits the
+	// First node hits them, which is in proportion to their surface area.
+	return 1.0f + surfaceAreaSum / std::max(firstSurfaceArea, FLT_MIN);
+}
+
+void BoundingVolumeHierarchy::RefitTreelets(const AxisAlignedBox* instanceBounds, JobSystem& jobSystem)
+{
+	jobSystem.ParallelFor(m_treelets.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (auto i = begin; i < end; i++)
+		{
+			auto& treelet = m_treelets[i];
+			treelet.Cost = RefitNodes(treelet.NodeBegin, treelet.NodeEnd, instanceBounds);
+		}
+	});
+}
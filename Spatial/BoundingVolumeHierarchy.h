@@ -0,0 +1,166 @@
+﻿#pragma once
+
+#include "Threading/JobSystem.h"
+
+#include <DirectXMath.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct AxisAlignedBox
+{
+	DirectX::XMFLOAT3 Minimum;
+	DirectX::XMFLOAT3 Maximum;
+};
+
+struct Ray
+{
+	DirectX::XMFLOAT3 Origin;
+	// Doesn't need to be unit length. Hit distances are in multiples of it.
+	DirectX::XMFLOAT3 Direction;
+	float MaxDistance;
+};
+
+// Six planes whose normals point inwards: left, right, bottom, top, near and far
+struct Frustum
+{
+	DirectX::XMFLOAT4 Planes[6];
+};
+
+// The frustum of a view projection matrix with Direct3D's depth range of 0 to 1, in the space the matrix transforms from
+Frustum CreateFrustum(DirectX::FXMMATRIX viewProjection);
+
+// Returned by ray queries that hit nothing
+const uint32_t NoBvhInstance = 0xFFFFFFFF;
+
+// What the last Update call did, and how long it took
+struct BvhUpdateStatistics
+{
+	double RefitSeconds;
+	double RebuildSeconds;
+	uint32_t RebuiltTreeletCount;
+	// Everything was built from scratch, because the instances were moved between treelets or their count changed
+	bool FullRebuild;
+};
+
+/*
+ * A bounding volume hierarchy over the bounds of instances that move every frame, for picking, culling and other
+ * Queries.
+ *
+ * Every node holds the bounds of up to four children, component by component, so a query tests all four with a few
+ * SSE instructions. A child is either another node or a single instance.
+ *
+ * The instances are split into treelets: a few per thread, each a subtree over the instances of one region, and a
+ * Small tree on top of them. All are built top down with the surface area heuristic. Every update refits the bounds of
+ * The treelets in parallel, each treelet's nodes in one backwards sweep, and then the bounds of the top tree.
+ *
+ * Refitting keeps the bounds right, but as the instances move the boxes of a treelet grow and overlap, and queries
+ * Visit more nodes. The refit also sums the surface area of every node relative to the treelet's root, which is its
+ * Expected cost to a query. A treelet whose cost has grown past a threshold since it was built is rebuilt over the
+ * Same instances, in parallel with the others. Instances that moved over to another treelet's region make the
+ * Treelets overlap, which shows in the cost of the top tree. Once that has grown too far, everything is rebuilt.
+ */
+class BoundingVolumeHierarchy
+{
+public:
+	BoundingVolumeHierarchy();
+
+	// Refits the hierarchy to the instances' new bounds, and rebuilds what has become too costly to query.
+	// The first call, and every call with a different instance count, builds it from scratch.
+	void Update(const AxisAlignedBox* instanceBounds, size_t instanceCount, JobSystem& jobSystem);
+
+	// The instance whose bounds the ray enters first, and how far along the ray that is
+	uint32_t IntersectRay(const Ray& ray, float& hitDistance) const;
+
+	// Replaces the contents of instances with the instances whose bounds overlap the box or the frustum. The frustum
+	// Test is conservative: bounds that are close to a corner of the frustum may pass while outside.
+	void QueryBox(const AxisAlignedBox& box, std::vector<uint32_t>& instances) const;
+	void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& instances) const;
+
+	size_t GetNodeCount() const;
+	size_t GetTreeletCount() const;
+
+	const BvhUpdateStatistics& GetLastUpdateStatistics() const;
+
+private:
+	static const uint32_t NodeWidth = 4;
+
+	// The bounds of the children, one lane each. Unused lanes have empty bounds, which no query overlaps.
+	struct alignas(16) Node
+	{
+		float MinimumX[NodeWidth];
+		float MinimumY[NodeWidth];
+		float MinimumZ[NodeWidth];
+		float MaximumX[NodeWidth];
+		float MaximumY[NodeWidth];
+		float MaximumZ[NodeWidth];
+		// Node indices, instance indices marked with LeafChild, or EmptyChild
+		uint32_t Children[NodeWidth];
+	};
+
+	struct Treelet
+	{
+		// Range of m_treeletInstances
+		uint32_t InstanceBegin;
+		uint32_t InstanceEnd;
+		// Range of m_nodes, root first
+		uint32_t NodeBegin;
+		uint32_t NodeEnd;
+		// Query cost right after the treelet was built, and after the last refit
+		float BuildCost;
+		float Cost;
+	};
+
+	// Something to put into a node while building: an instance, or the root of a treelet for the top tree
+	struct BuildPrimitive
+	{
+		DirectX::XMFLOAT3 Minimum;
+		DirectX::XMFLOAT3 Maximum;
+		DirectX::XMFLOAT3 Center;
+		uint32_t Child;
+	};
+
+	// Splits the instances into treelets and builds every treelet and the top tree
+	void Build(const AxisAlignedBox* instanceBounds, size_t instanceCount, JobSystem& jobSystem);
+
+	// Builds the nodes of a treelet into nodes, numbered from 0
+	void BuildTreelet(const Treelet& treelet, const AxisAlignedBox* instanceBounds, std::vector<Node>& nodes) const;
+
+	// Lays out the nodes of the treelets one after another, followed by a new top tree over the treelet roots. Treelets
+	// Whose entry of m_rebuiltNodes is empty keep their nodes from m_nodes.
+	void BuildTopTree(const AxisAlignedBox* instanceBounds);
+
+	// Builds a subtree over the primitives and appends its nodes. Returns the subtree's root, and its bounds through
+	// The last two arguments.
+	static uint32_t BuildNode(
+		BuildPrimitive* primitives,
+		size_t count,
+		uint32_t depth,
+		std::vector<Node>& nodes,
+		DirectX::XMVECTOR& minimum,
+		DirectX::XMVECTOR& maximum);
+
+	// Moves the primitives of the lower half of a surface area heuristic split to the front, and returns their count
+	static size_t SplitPrimitives(BuildPrimitive* primitives, size_t count, uint32_t depth);
+
+	// Refits the nodes in the range, children before parents, and returns their query cost relative to the first node
+	float RefitNodes(uint32_t nodeBegin, uint32_t nodeEnd, const AxisAlignedBox* instanceBounds);
+
+	void RefitTreelets(const AxisAlignedBox* instanceBounds, JobSystem& jobSystem);
+
+	// The treelets, then the top tree, which starts with the root
+	std::vector<Node> m_nodes;
+	std::vector<Node> m_nodeScratch;
+	uint32_t m_topNodeBegin;
+	float m_topBuildCost;
+
+	std::vector<Treelet> m_treelets;
+	std::vector<uint32_t> m_treeletInstances;
+	std::vector<uint32_t> m_degradedTreelets;
+	// One entry per treelet, numbered from 0 within the treelet
+	std::vector<std::vector<Node>> m_rebuiltNodes;
+	size_t m_instanceCount;
+
+	BvhUpdateStatistics m_statistics;
+};
@@ -0,0 +1,343 @@
+﻿#include "BvhBenchmark.h"
+
+#include "Spatial/BoundingVolumeHierarchy.h"
+#include "Externals/SDL/Include/SDL.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const float StepTime = 1.0f / 60.0f;
+	const int StepsPerSecond = 60;
+	const int SimulatedSeconds = 10;
+
+	// Room for about one instance per cell of this size, so the field grows with the instance count
+	const float CellSize = 2.0f;
+	const float MinHalfExtent = 0.25f;
+	const float MaxHalfExtent = 0.75f;
+	const float MaxSpeed = 2.0f;
+
+	const int RayCount = 100000;
+	const int BoxQueryCount = 10000;
+	const float QueryBoxHalfExtent = 2.0f;
+	const int FrustumQueryCount = 100;
+
+	// Queries of each kind that are also answered by testing every instance
+	const int CheckedQueryCount = 200;
+
+	struct DriftingInstance
+	{
+		XMFLOAT3 Position;
+		XMFLOAT3 Velocity;
+		float HalfExtent;
+	};
+
+	double GetSecondsSince(Uint64 startCounter)
+	{
+		return static_cast<double>(SDL_GetPerformanceCounter() - startCounter) / SDL_GetPerformanceFrequency();
+	}
+
+	void StepInstances(std::vector<DriftingInstance>& instances, std::vector<AxisAlignedBox>& bounds, float fieldHalfSize)
+	{
+		for (size_t i = 0; i < instances.size(); i++)
+		{
+			auto& instance = instances[i];
+			auto position = &instance.Position.x;
+			auto velocity = &instance.Velocity.x;
+
+			// Instances bounce off the sides of the field, so it never empties out
+			for (int axis = 0; axis < 3; axis++)
+			{
+				position[axis] += velocity[axis] * StepTime;
+
+				if (std::abs(position[axis]) > fieldHalfSize)
+				{
+					position[axis] = std::copysign(fieldHalfSize, position[axis]);
+					velocity[axis] = -velocity[axis];
+				}
+			}
+
+			const auto halfExtent = XMVectorReplicate(instance.HalfExtent);
+			XMStoreFloat3(&bounds[i].Minimum, XMVectorSubtract(XMLoadFloat3(&instance.Position), halfExtent));
+			XMStoreFloat3(&bounds[i].Maximum, XMVectorAdd(XMLoadFloat3(&instance.Position), halfExtent));
+		}
+	}
+
+	// The distance at which the ray enters the box, or a negative value if it misses
+	float IntersectBox(const Ray& ray, const AxisAlignedBox& box)
+	{
+		auto entry = 0.0f;
+		auto exit = ray.MaxDistance;
+
+		const auto origin = &ray.Origin.x;
+		const auto direction = &ray.Direction.x;
+		const auto minimum = &box.Minimum.x;
+		const auto maximum = &box.Maximum.x;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (direction[axis] == 0.0f)
+			{
+				if (origin[axis] < minimum[axis] || origin[axis] > maximum[axis])
+					return -1.0f;
+
+				continue;
+			}
+
+			// Windows headers define near and far as macros
+			auto slabEntry = (minimum[axis] - origin[axis]) / direction[axis];
+			auto slabExit = (maximum[axis] - origin[axis]) / direction[axis];
+			if (slabEntry > slabExit)
+				std::swap(slabEntry, slabExit);
+
+			entry = std::max(entry, slabEntry);
+			exit = std::min(exit, slabExit);
+		}
+
+		return entry <= exit ? entry : -1.0f;
+	}
+
+	bool OverlapsFrustum(const Frustum& frustum, const AxisAlignedBox& box)
+	{
+		const auto center = XMVectorScale(XMVectorAdd(XMLoadFloat3(&box.Minimum), XMLoadFloat3(&box.Maximum)), 0.5f);
+		const auto extent = XMVectorScale(XMVectorSubtract(XMLoadFloat3(&box.Maximum), XMLoadFloat3(&box.Minimum)), 0.5f);
+
+		for (const auto& plane : frustum.Planes)
+		{
+			const auto planeVector = XMLoadFloat4(&plane);
+			const auto distance = XMVectorGetX(XMVector3Dot(center, planeVector)) + plane.w;
+			const auto radius = XMVectorGetX(XMVector3Dot(extent, XMVectorAbs(planeVector)));
+
+			if (distance + radius < 0.0f)
+				return false;
+		}
+
+		return true;
+	}
+
+	// Compares the instances a query found with the ones testing every instance found, in any order
+	bool AreSameInstances(std::vector<uint32_t> found, std::vector<uint32_t> expected)
+	{
+		std::sort(found.begin(), found.end());
+		std::sort(expected.begin(), expected.end());
+
+		return found == expected;
+	}
+}
+
+void BenchmarkBoundingVolumeHierarchy(size_t instanceCount, JobSystem& jobSystem)
+{
+	std::mt19937 random(42);
+
+	const auto fieldHalfSize = std::cbrt(static_cast<float>(instanceCount)) * CellSize * 0.5f;
+	std::uniform_real_distribution<float> positionDistribution(-fieldHalfSize, fieldHalfSize);
+	std::uniform_real_distribution<float> velocityDistribution(-MaxSpeed, MaxSpeed);
+	std::uniform_real_distribution<float> halfExtentDistribution(MinHalfExtent, MaxHalfExtent);
+	std::uniform_real_distribution<float> directionDistribution(-1.0f, 1.0f);
+
+	std::vector<DriftingInstance> instances(instanceCount);
+	for (auto& instance : instances)
+	{
+		instance.Position = XMFLOAT3(positionDistribution(random), positionDistribution(random), positionDistribution(random));
+		instance.Velocity = XMFLOAT3(velocityDistribution(random), velocityDistribution(random), velocityDistribution(random));
+		instance.HalfExtent = halfExtentDistribution(random);
+	}
+
+	std::vector<AxisAlignedBox> bounds(instanceCount);
+	StepInstances(instances, bounds, fieldHalfSize);
+
+	BoundingVolumeHierarchy hierarchy;
+
+	SDL_Log("Bounding volume hierarchy: %u instances on %u threads, %d seconds at %d Hz",
+		static_cast<unsigned int>(instanceCount),
+		jobSystem.GetThreadCount(),
+		SimulatedSeconds,
+		StepsPerSecond);
+
+	hierarchy.Update(bounds.data(), bounds.size(), jobSystem);
+
+	SDL_Log("Build: %.2f ms, %u nodes, %u treelets",
+		hierarchy.GetLastUpdateStatistics().RebuildSeconds * 1000.0,
+		static_cast<unsigned int>(hierarchy.GetNodeCount()),
+		static_cast<unsigned int>(hierarchy.GetTreeletCount()));
+
+	for (int second = 0; second < SimulatedSeconds; second++)
+	{
+		double refitSeconds = 0.0;
+		double rebuildSeconds = 0.0;
+		uint32_t rebuiltTreeletCount = 0;
+		int fullRebuildCount = 0;
+
+		for (int step = 0; step < StepsPerSecond; step++)
+		{
+			StepInstances(instances, bounds, fieldHalfSize);
+			hierarchy.Update(bounds.data(), bounds.size(), jobSystem);
+
+			const auto& statistics = hierarchy.GetLastUpdateStatistics();
+			refitSeconds += statistics.RefitSeconds;
+			rebuildSeconds += statistics.RebuildSeconds;
+			rebuiltTreeletCount += statistics.RebuiltTreeletCount;
+			fullRebuildCount += statistics.FullRebuild ? 1 : 0;
+		}
+
+		SDL_Log("Second %d: refit %.3f ms, rebuild %.3f ms per update. Treelets rebuilt: %u, full rebuilds: %d",
+			second + 1,
+			refitSeconds * 1000.0 / StepsPerSecond,
+			rebuildSeconds * 1000.0 / StepsPerSecond,
+			rebuiltTreeletCount,
+			fullRebuildCount);
+	}
+
+	// Rays from anywhere in the field in any direction, long enough to cross it
+	std::vector<Ray> rays(RayCount);
+	for (auto& ray : rays)
+	{
+		ray.Origin = XMFLOAT3(positionDistribution(random), positionDistribution(random), positionDistribution(random));
+		ray.Direction = XMFLOAT3(directionDistribution(random), directionDistribution(random), directionDistribution(random));
+		ray.MaxDistance = fieldHalfSize * 4.0f;
+	}
+
+	auto startCounter = SDL_GetPerformanceCounter();
+	int hitCount = 0;
+
+	for (const auto& ray : rays)
+	{
+		float distance;
+		if (hierarchy.IntersectRay(ray, distance) != NoBvhInstance)
+			hitCount++;
+	}
+
+	const auto raySeconds = GetSecondsSince(startCounter);
+
+	int rayMismatchCount = 0;
+	for (int i = 0; i < CheckedQueryCount; i++)
+	{
+		auto closestDistance = FLT_MAX;
+		for (const auto& box : bounds)
+		{
+			const auto distance = IntersectBox(rays[i], box);
+			if (distance >= 0.0f)
+				closestDistance = std::min(closestDistance, distance);
+		}
+
+		float distance;
+		const auto instance = hierarchy.IntersectRay(rays[i], distance);
+
+		// Another instance may be hit at the same distance, so only the distances are compared
+		const auto mismatch = instance == NoBvhInstance
+			? closestDistance != FLT_MAX
+			: std::abs(distance - closestDistance) > 1e-3f * std::max(1.0f, closestDistance);
+
+		if (mismatch)
+			rayMismatchCount++;
+	}
+
+	SDL_Log("Rays: %.3f us per ray, %d of %d hit, %d of %d checked rays mismatched",
+		raySeconds * 1e6 / RayCount,
+		hitCount,
+		RayCount,
+		rayMismatchCount,
+		CheckedQueryCount);
+
+	std::vector<AxisAlignedBox> queryBoxes(BoxQueryCount);
+	for (auto& box : queryBoxes)
+	{
+		const auto center = XMVectorSet(positionDistribution(random), positionDistribution(random), positionDistribution(random), 0.0f);
+		XMStoreFloat3(&box.Minimum, XMVectorSubtract(center, XMVectorReplicate(QueryBoxHalfExtent)));
+		XMStoreFloat3(&box.Maximum, XMVectorAdd(center, XMVectorReplicate(QueryBoxHalfExtent)));
+	}
+
+	std::vector<uint32_t> found;
+	std::vector<uint32_t> expected;
+	size_t boxResultCount = 0;
+
+	startCounter = SDL_GetPerformanceCounter();
+
+	for (const auto& box : queryBoxes)
+	{
+		hierarchy.QueryBox(box, found);
+		boxResultCount += found.size();
+	}
+
+	const auto boxSeconds = GetSecondsSince(startCounter);
+
+	int boxMismatchCount = 0;
+	for (int i = 0; i < CheckedQueryCount; i++)
+	{
+		const auto& queryBox = queryBoxes[i];
+		expected.clear();
+
+		for (size_t j = 0; j < bounds.size(); j++)
+		{
+			const auto& box = bounds[j];
+			if (XMVector3LessOrEqual(XMLoadFloat3(&box.Minimum), XMLoadFloat3(&queryBox.Maximum))
+				&& XMVector3GreaterOrEqual(XMLoadFloat3(&box.Maximum), XMLoadFloat3(&queryBox.Minimum)))
+			{
+				expected.push_back(static_cast<uint32_t>(j));
+			}
+		}
+
+		hierarchy.QueryBox(queryBox, found);
+		if (!AreSameInstances(found, expected))
+			boxMismatchCount++;
+	}
+
+	SDL_Log("Boxes: %.3f us per query, %.1f instances per query, %d of %d checked queries mismatched",
+		boxSeconds * 1e6 / BoxQueryCount,
+		static_cast<double>(boxResultCount) / BoxQueryCount,
+		boxMismatchCount,
+		CheckedQueryCount);
+
+	// Cameras anywhere in the field that look at a random point, and see about as far as the field is wide
+	const auto projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, fieldHalfSize * 2.0f);
+
+	std::vector<Frustum> frustums(FrustumQueryCount);
+	for (auto& frustum : frustums)
+	{
+		const auto eye = XMVectorSet(positionDistribution(random), positionDistribution(random), positionDistribution(random), 0.0f);
+		const auto target = XMVectorSet(positionDistribution(random), positionDistribution(random), positionDistribution(random), 0.0f);
+		const auto view = XMMatrixLookAtLH(eye, target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+		frustum = CreateFrustum(view * projection);
+	}
+
+	size_t frustumResultCount = 0;
+
+	startCounter = SDL_GetPerformanceCounter();
+
+	for (const auto& frustum : frustums)
+	{
+		hierarchy.QueryFrustum(frustum, found);
+		frustumResultCount += found.size();
+	}
+
+	const auto frustumSeconds = GetSecondsSince(startCounter);
+
+	int frustumMismatchCount = 0;
+	for (int i = 0; i < std::min(CheckedQueryCount, FrustumQueryCount); i++)
+	{
+		expected.clear();
+
+		for (size_t j = 0; j < bounds.size(); j++)
+		{
+			if (OverlapsFrustum(frustums[i], bounds[j]))
+				expected.push_back(static_cast<uint32_t>(j));
+		}
+
+		hierarchy.QueryFrustum(frustums[i], found);
+		if (!AreSameInstances(found, expected))
+			frustumMismatchCount++;
+	}
+
+	SDL_Log("Frustums: %.3f ms per query, %.1f instances per query, %d of %d checked queries mismatched",
+		frustumSeconds * 1000.0 / FrustumQueryCount,
+		static_cast<double>(frustumResultCount) / FrustumQueryCount,
+		frustumMismatchCount,
+		std::min(CheckedQueryCount, FrustumQueryCount));
+}
@@ -0,0 +1,12 @@
+﻿#pragma once
+
+#include "Threading/JobSystem.h"
+
+#include <cstddef>
+
+/*
+ * Builds a bounding volume hierarchy over instanceCount boxes that drift through a field, updates it for ten seconds
+ * At 60 Hz and logs the refit and rebuild times of every simulated second. Then times ray, box and frustum queries,
+ * And checks a sample of each against testing every instance.
+ */
+void BenchmarkBoundingVolumeHierarchy(size_t instanceCount, JobSystem& jobSystem);
@@ -0,0 +1,376 @@
+﻿#include "BlockCompression.h"
+
+#include "CustomExceptions/Direct3dException.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+namespace
+{
+	uint32_t GetChannel(uint32_t texel, int channel)
+	{
+		return texel >> (channel * 8) & 0xFF;
+	}
+
+	// Copies a 4x4 block out of an image. Blocks that reach past the edge repeat the last row and column.
+	void ExtractBlock(const Image& image, uint32_t blockX, uint32_t blockY, uint32_t texels[16])
+	{
+		for (uint32_t y = 0; y < 4; y++)
+		{
+			const auto sourceY = std::min(blockY * 4 + y, image.Height - 1);
+
+			for (uint32_t x = 0; x < 4; x++)
+			{
+				const auto sourceX = std::min(blockX * 4 + x, image.Width - 1);
+				texels[y * 4 + x] = image.Texels[static_cast<size_t>(sourceY) * image.Width + sourceX];
+			}
+		}
+	}
+
+	uint16_t PackRgb565(uint32_t red, uint32_t green, uint32_t blue)
+	{
+		return static_cast<uint16_t>((red * 31 + 127) / 255 << 11 | (green * 63 + 127) / 255 << 5 | (blue * 31 + 127) / 255);
+	}
+
+	// Expands to 8 bits per channel by replicating the high bits, like the hardware does
+	uint32_t UnpackRgb565(uint16_t color)
+	{
+		const uint32_t red = color >> 11 & 0x1F;
+		const uint32_t green = color >> 5 & 0x3F;
+		const uint32_t blue = color & 0x1F;
+
+		return PackTexel(red << 3 | red >> 2, green << 2 | green >> 4, blue << 3 | blue >> 2, 255);
+	}
+
+	uint32_t LerpTexel(uint32_t a, uint32_t b, uint32_t weightB, uint32_t divisor)
+	{
+		uint32_t result = 0;
+
+		for (int channel = 0; channel < 4; channel++)
+		{
+			const auto value = (GetChannel(a, channel) * (divisor - weightB) + GetChannel(b, channel) * weightB) / divisor;
+			result |= value << (channel * 8);
+		}
+
+		return result;
+	}
+
+	// Builds the color palette. With color0 <= color1, BC1 has three colors and transparent black.
+	void GetColorPalette(uint16_t color0, uint16_t color1, bool forceFourColors, uint32_t palette[4])
+	{
+		palette[0] = UnpackRgb565(color0);
+		palette[1] = UnpackRgb565(color1);
+
+		if (color0 > color1 || forceFourColors)
+		{
+			palette[2] = LerpTexel(palette[0], palette[1], 1, 3);
+			palette[3] = LerpTexel(palette[0], palette[1], 2, 3);
+		}
+		else
+		{
+			palette[2] = LerpTexel(palette[0], palette[1], 1, 2);
+			palette[3] = 0;
+		}
+	}
+
+	int GetColorDistance(uint32_t a, uint32_t b)
+	{
+		int distance = 0;
+
+		for (int channel = 0; channel < 3; channel++)
+		{
+			const auto difference = static_cast<int>(GetChannel(a, channel)) - static_cast<int>(GetChannel(b, channel));
+			distance += difference * difference;
+		}
+
+		return distance;
+	}
+
+	// Picks the closest palette color for every texel and returns the total squared error
+	int SelectColorIndices(const uint32_t texels[16], uint16_t color0, uint16_t color1, uint32_t& indices)
+	{
+		indices = 0;
+
+		// With equal endpoints the decoder uses the three color mode, but index 0 still decodes to color0
+		// And is always chosen, since every palette entry we compare against is the same color
+		uint32_t palette[4];
+		GetColorPalette(color0, color1, true, palette);
+
+		int totalError = 0;
+
+		for (int i = 0; i < 16; i++)
+		{
+			uint32_t bestIndex = 0;
+			int bestDistance = INT_MAX;
+
+			for (uint32_t index = 0; index < 4; index++)
+			{
+				const auto distance = GetColorDistance(texels[i], palette[index]);
+
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					bestIndex = index;
+				}
+			}
+
+			indices |= bestIndex << (i * 2);
+			totalError += bestDistance;
+		}
+
+		return totalError;
+	}
+
+	void EncodeColorBlock(const uint32_t texels[16], uint8_t* block)
+	{
+		uint32_t minimum[3] = { 255, 255, 255 };
+		uint32_t maximum[3] = { 0, 0, 0 };
+
+		for (int i = 0; i < 16; i++)
+		{
+			for (int channel = 0; channel < 3; channel++)
+			{
+				minimum[channel] = std::min(minimum[channel], GetChannel(texels[i], channel));
+				maximum[channel] = std::max(maximum[channel], GetChannel(texels[i], channel));
+			}
+		}
+
+		// Moving the endpoints inwards by 1/16 of the range usually helps, since the extremes tend to be outliers,
+		// But it costs precision on blocks with only two colors. Both are tried.
+		uint32_t insetMinimum[3];
+		uint32_t insetMaximum[3];
+
+		for (int channel = 0; channel < 3; channel++)
+		{
+			const auto inset = (maximum[channel] - minimum[channel]) / 16;
+			insetMinimum[channel] = minimum[channel] + inset;
+			insetMaximum[channel] = maximum[channel] - inset;
+		}
+
+		// The colors of a block usually lie close to one of the four diagonals of their bounding box.
+		// Red and blue are flipped relative to green to try each of them, and the best fit is kept.
+		uint16_t bestColor0 = 0;
+		uint16_t bestColor1 = 0;
+		uint32_t bestIndices = 0;
+		int bestError = INT_MAX;
+
+		for (int candidate = 0; candidate < 8; candidate++)
+		{
+			const auto low = (candidate & 4) != 0 ? minimum : insetMinimum;
+			const auto high = (candidate & 4) != 0 ? maximum : insetMaximum;
+			const auto flipRed = (candidate & 1) != 0;
+			const auto flipBlue = (candidate & 2) != 0;
+
+			auto color0 = PackRgb565(flipRed ? low[0] : high[0], high[1], flipBlue ? low[2] : high[2]);
+			auto color1 = PackRgb565(flipRed ? high[0] : low[0], low[1], flipBlue ? high[2] : low[2]);
+
+			// color0 > color1 selects the four color mode
+			if (color0 < color1)
+				std::swap(color0, color1);
+
+			uint32_t indices;
+			const auto error = SelectColorIndices(texels, color0, color1, indices);
+
+			if (error < bestError)
+			{
+				bestColor0 = color0;
+				bestColor1 = color1;
+				bestIndices = indices;
+				bestError = error;
+			}
+		}
+
+		// All values are stored little endian
+		block[0] = static_cast<uint8_t>(bestColor0);
+		block[1] = static_cast<uint8_t>(bestColor0 >> 8);
+		block[2] = static_cast<uint8_t>(bestColor1);
+		block[3] = static_cast<uint8_t>(bestColor1 >> 8);
+
+		for (int i = 0; i < 4; i++)
+			block[4 + i] = static_cast<uint8_t>(bestIndices >> (i * 8));
+	}
+
+	void GetAlphaPalette(uint32_t alpha0, uint32_t alpha1, uint32_t palette[8])
+	{
+		palette[0] = alpha0;
+		palette[1] = alpha1;
+
+		if (alpha0 > alpha1)
+		{
+			for (uint32_t i = 1; i < 7; i++)
+				palette[i + 1] = (alpha0 * (7 - i) + alpha1 * i) / 7;
+		}
+		else
+		{
+			for (uint32_t i = 1; i < 5; i++)
+				palette[i + 1] = (alpha0 * (5 - i) + alpha1 * i) / 5;
+
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	void EncodeAlphaBlock(const uint32_t texels[16], uint8_t* block)
+	{
+		uint32_t alpha0 = 0;
+		uint32_t alpha1 = 255;
+
+		for (int i = 0; i < 16; i++)
+		{
+			alpha0 = std::max(alpha0, GetChannel(texels[i], 3));
+			alpha1 = std::min(alpha1, GetChannel(texels[i], 3));
+		}
+
+		uint64_t indices = 0;
+
+		if (alpha0 != alpha1)
+		{
+			uint32_t palette[8];
+			GetAlphaPalette(alpha0, alpha1, palette);
+
+			for (int i = 0; i < 16; i++)
+			{
+				const auto alpha = static_cast<int>(GetChannel(texels[i], 3));
+				uint64_t bestIndex = 0;
+				int bestDistance = INT_MAX;
+
+				for (uint32_t index = 0; index < 8; index++)
+				{
+					const auto distance = std::abs(alpha - static_cast<int>(palette[index]));
+
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						bestIndex = index;
+					}
+				}
+
+				indices |= bestIndex << (i * 3);
+			}
+		}
+
+		block[0] = static_cast<uint8_t>(alpha0);
+		block[1] = static_cast<uint8_t>(alpha1);
+
+		for (int i = 0; i < 6; i++)
+			block[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+	}
+
+	void DecodeColorBlock(const uint8_t* block, bool forceFourColors, uint32_t texels[16])
+	{
+		const auto color0 = static_cast<uint16_t>(block[0] | block[1] << 8);
+		const auto color1 = static_cast<uint16_t>(block[2] | block[3] << 8);
+		const auto indices = static_cast<uint32_t>(block[4] | block[5] << 8 | block[6] << 16) | static_cast<uint32_t>(block[7]) << 24;
+
+		uint32_t palette[4];
+		GetColorPalette(color0, color1, forceFourColors, palette);
+
+		for (int i = 0; i < 16; i++)
+			texels[i] = palette[indices >> (i * 2) & 3];
+	}
+}
+
+TextureData CompressMipChain(const std::vector<Image>& mipChain, DXGI_FORMAT format)
+{
+	if (format != DXGI_FORMAT_BC1_UNORM && format != DXGI_FORMAT_BC3_UNORM)
+		throw Direct3dException("Unsupported block compression format: " + std::to_string(format));
+
+	const auto blockSize = GetBytesPerElement(format);
+
+	TextureData textureData;
+	textureData.Format = format;
+
+	for (const auto& mip : mipChain)
+	{
+		// Levels smaller than 4x4 still take up a whole block
+		const auto blocksWide = (mip.Width + 3) / 4;
+		const auto blocksHigh = (mip.Height + 3) / 4;
+
+		TextureLevel level;
+		level.Width = mip.Width;
+		level.Height = mip.Height;
+		level.RowPitch = blocksWide * blockSize;
+		level.Data.resize(static_cast<size_t>(level.RowPitch) * blocksHigh);
+
+		for (uint32_t blockY = 0; blockY < blocksHigh; blockY++)
+		{
+			for (uint32_t blockX = 0; blockX < blocksWide; blockX++)
+			{
+				uint32_t texels[16];
+				ExtractBlock(mip, blockX, blockY, texels);
+
+				auto block = level.Data.data() + static_cast<size_t>(blockY) * level.RowPitch + blockX * blockSize;
+
+				if (format == DXGI_FORMAT_BC3_UNORM)
+				{
+					EncodeAlphaBlock(texels, block);
+					block += 8;
+				}
+
+				EncodeColorBlock(texels, block);
+			}
+		}
+
+		textureData.Levels.push_back(std::move(level));
+	}
+
+	return textureData;
+}
+
+void DecodeBc1Block(const uint8_t* block, uint32_t texels[16])
+{
+	DecodeColorBlock(block, false, texels);
+}
+
+void DecodeBc3Block(const uint8_t* block, uint32_t texels[16])
+{
+	// The color block of BC3 always uses four colors
+	DecodeColorBlock(block + 8, true, texels);
+
+	uint32_t palette[8];
+	GetAlphaPalette(block[0], block[1], palette);
+
+	uint64_t indices = 0;
+	for (int i = 0; i < 6; i++)
+		indices |= static_cast<uint64_t>(block[2 + i]) << (i * 8);
+
+	for (int i = 0; i < 16; i++)
+		texels[i] = (texels[i] & 0x00FFFFFF) | palette[indices >> (i * 3) & 7] << 24;
+}
+
+Image DecompressLevel(const TextureLevel& level, DXGI_FORMAT format)
+{
+	if (format != DXGI_FORMAT_BC1_UNORM && format != DXGI_FORMAT_BC3_UNORM)
+		throw Direct3dException("Unsupported block compression format: " + std::to_string(format));
+
+	const auto blockSize = GetBytesPerElement(format);
+
+	Image image;
+	image.Width = level.Width;
+	image.Height = level.Height;
+	image.Texels.resize(static_cast<size_t>(level.Width) * level.Height);
+
+	for (uint32_t y = 0; y < level.Height; y += 4)
+	{
+		for (uint32_t x = 0; x < level.Width; x += 4)
+		{
+			const auto block = level.Data.data() + static_cast<size_t>(y / 4) * level.RowPitch + x / 4 * blockSize;
+
+			uint32_t texels[16];
+			if (format == DXGI_FORMAT_BC3_UNORM)
+				DecodeBc3Block(block, texels);
+			else
+				DecodeBc1Block(block, texels);
+
+			// Blocks at the edge may cover texels outside the level
+			for (uint32_t blockY = 0; blockY < 4 && y + blockY < level.Height; blockY++)
+			{
+				for (uint32_t blockX = 0; blockX < 4 && x + blockX < level.Width; blockX++)
+					image.Texels[static_cast<size_t>(y + blockY) * level.Width + x + blockX] = texels[blockY * 4 + blockX];
+			}
+		}
+	}
+
+	return image;
+}
@@ -0,0 +1,27 @@
+﻿#pragma once
+
+#include "Texture/Image.h"
+#include "Texture/TextureData.h"
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * BC1 and BC3 block compression.
+ *
+ * BC1 stores a 4x4 block as two RGB565 endpoints and a 2-bit index per texel into the four colors interpolated
+ * Between them (8 bytes, 8:1 compared to RGBA8). BC3 adds a separate alpha block with two 8-bit endpoints
+ * And 3-bit indices into eight interpolated values (16 bytes, 4:1).
+ *
+ * The encoder fits the endpoints to the bounding box of the block's colors, which is fast enough to compress
+ * At load time. The decoders are the reference the GPU implements and are used to measure compression error.
+ */
+
+// Compresses a mip chain to BC1_UNORM (ignoring alpha) or BC3_UNORM
+TextureData CompressMipChain(const std::vector<Image>& mipChain, DXGI_FORMAT format);
+
+void DecodeBc1Block(const uint8_t* block, uint32_t texels[16]);
+void DecodeBc3Block(const uint8_t* block, uint32_t texels[16]);
+
+// Decompresses a BC1 or BC3 level back to RGBA8
+Image DecompressLevel(const TextureLevel& level, DXGI_FORMAT format);
@@ -0,0 +1,228 @@
+﻿#include "DdsLoader.h"
+
+#include "CustomExceptions/Direct3dException.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <cstdint>
+
+namespace
+{
+	// The layout of the DDS file headers, see "DDS_HEADER structure" in the Direct3D documentation
+	struct DdsPixelFormat
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t FourCC;
+		uint32_t RgbBitCount;
+		uint32_t RedBitMask;
+		uint32_t GreenBitMask;
+		uint32_t BlueBitMask;
+		uint32_t AlphaBitMask;
+	};
+
+	struct DdsHeader
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t Height;
+		uint32_t Width;
+		uint32_t PitchOrLinearSize;
+		uint32_t Depth;
+		uint32_t MipMapCount;
+		uint32_t Reserved1[11];
+		DdsPixelFormat PixelFormat;
+		uint32_t Caps;
+		uint32_t Caps2;
+		uint32_t Caps3;
+		uint32_t Caps4;
+		uint32_t Reserved2;
+	};
+
+	struct DdsHeaderDx10
+	{
+		uint32_t DxgiFormat;
+		uint32_t ResourceDimension;
+		uint32_t MiscFlag;
+		uint32_t ArraySize;
+		uint32_t MiscFlags2;
+	};
+
+	static_assert(sizeof(DdsHeader) == 124, "The DDS header must match the file layout");
+	static_assert(sizeof(DdsHeaderDx10) == 20, "The DX10 header must match the file layout");
+	static_assert(MaxDdsHeadersSize == 4 + sizeof(DdsHeader) + sizeof(DdsHeaderDx10), "MaxDdsHeadersSize must match the headers");
+
+	const uint32_t DdsPixelFormatFourCC = 0x4;
+	const uint32_t DdsPixelFormatRgb = 0x40;
+	const uint32_t DdsResourceDimensionTexture2d = 3;
+
+	constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+	{
+		return static_cast<uint32_t>(a) | static_cast<uint32_t>(b) << 8 | static_cast<uint32_t>(c) << 16 | static_cast<uint32_t>(d) << 24;
+	}
+
+	DXGI_FORMAT GetLegacyFormat(const DdsPixelFormat& pixelFormat)
+	{
+		if ((pixelFormat.Flags & DdsPixelFormatFourCC) != 0)
+		{
+			if (pixelFormat.FourCC == MakeFourCC('D', 'X', 'T', '1'))
+				return DXGI_FORMAT_BC1_UNORM;
+
+			if (pixelFormat.FourCC == MakeFourCC('D', 'X', 'T', '5'))
+				return DXGI_FORMAT_BC3_UNORM;
+		}
+		else if ((pixelFormat.Flags & DdsPixelFormatRgb) != 0
+			&& pixelFormat.RgbBitCount == 32
+			&& pixelFormat.RedBitMask == 0x000000FF
+			&& pixelFormat.GreenBitMask == 0x0000FF00
+			&& pixelFormat.BlueBitMask == 0x00FF0000)
+		{
+			return DXGI_FORMAT_R8G8B8A8_UNORM;
+		}
+
+		return DXGI_FORMAT_UNKNOWN;
+	}
+
+	bool IsSupportedFormat(DXGI_FORMAT format)
+	{
+		return IsBlockCompressed(format)
+			|| format == DXGI_FORMAT_R8G8B8A8_UNORM
+			|| format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+	}
+
+	// Parses the headers at the start of a DDS file, returning the description and the offset of the first level
+	TextureDescription ParseDdsHeaders(const uint8_t* data, size_t size, size_t& dataOffset)
+	{
+		DdsHeader header;
+
+		if (size < 4 || memcmp(data, "DDS ", 4) != 0)
+			throw Direct3dException("Not a DDS file");
+
+		if (size < 4 + sizeof(header))
+			throw Direct3dException("Truncated DDS file");
+
+		memcpy(&header, data + 4, sizeof(header));
+		dataOffset = 4 + sizeof(header);
+
+		TextureDescription description;
+		description.Format = GetLegacyFormat(header.PixelFormat);
+		description.Width = header.Width;
+		description.Height = header.Height;
+		description.LevelCount = std::max(header.MipMapCount, 1u);
+
+		if (description.Width == 0 || description.Height == 0)
+			throw Direct3dException("DDS texture has no texels");
+
+		// A full mip chain ends at 1x1, and the level sizes are computed by shifting, so more levels can't be valid
+		uint32_t maxLevelCount = 1;
+		for (auto size = std::max(description.Width, description.Height); size > 1; size >>= 1)
+			maxLevelCount++;
+
+		if (description.LevelCount > maxLevelCount)
+			throw Direct3dException("Invalid DDS mip level count: " + std::to_string(description.LevelCount));
+
+		if ((header.PixelFormat.Flags & DdsPixelFormatFourCC) != 0 && header.PixelFormat.FourCC == MakeFourCC('D', 'X', '1', '0'))
+		{
+			DdsHeaderDx10 dx10Header;
+
+			if (size < dataOffset + sizeof(dx10Header))
+				throw Direct3dException("Truncated DDS file");
+
+			memcpy(&dx10Header, data + dataOffset, sizeof(dx10Header));
+			dataOffset += sizeof(dx10Header);
+
+			if (dx10Header.ResourceDimension != DdsResourceDimensionTexture2d || dx10Header.ArraySize > 1)
+				throw Direct3dException("Only single 2D textures are supported in DDS files");
+
+			description.Format = static_cast<DXGI_FORMAT>(dx10Header.DxgiFormat);
+		}
+
+		if (!IsSupportedFormat(description.Format))
+			throw Direct3dException("Unsupported DDS texture format: " + std::to_string(description.Format));
+
+		return description;
+	}
+
+	// Reads the headers of a DDS file, returning the description and the offset of the first level
+	TextureDescription ReadDdsHeaders(std::ifstream& file, size_t& dataOffset)
+	{
+		uint8_t headers[MaxDdsHeadersSize];
+		file.read(reinterpret_cast<char*>(headers), sizeof(headers));
+
+		// Files without the DX10 header and tiny levels can be shorter than the buffer
+		const auto readSize = static_cast<size_t>(file.gcount());
+		file.clear();
+
+		return ParseDdsHeaders(headers, readSize, dataOffset);
+	}
+
+	std::ifstream OpenDdsFile(const std::wstring& fileName)
+	{
+		std::ifstream file(fileName, std::ios::binary);
+
+		if (!file)
+			throw Direct3dException("Failed to open DDS file");
+
+		return file;
+	}
+}
+
+TextureDescription LoadDdsDescription(const std::wstring& fileName)
+{
+	auto file = OpenDdsFile(fileName);
+	size_t dataOffset;
+
+	return ReadDdsHeaders(file, dataOffset);
+}
+
+TextureData LoadDdsLevels(const std::wstring& fileName, uint32_t firstLevel, uint32_t endLevel)
+{
+	auto file = OpenDdsFile(fileName);
+	size_t offset;
+	const auto description = ReadDdsHeaders(file, offset);
+
+	endLevel = std::min(endLevel, description.LevelCount);
+
+	// Levels are stored back to back, from the largest to the smallest, so we skip the ones before the first level
+	for (uint32_t level = 0; level < firstLevel && level < endLevel; level++)
+	{
+		offset += GetLevelSizeInBytes(
+			description.Format,
+			GetLevelWidth(description, level),
+			GetLevelHeight(description, level));
+	}
+
+	file.seekg(offset);
+
+	TextureData textureData;
+	textureData.Format = description.Format;
+
+	for (auto levelIndex = firstLevel; levelIndex < endLevel; levelIndex++)
+	{
+		TextureLevel level;
+		level.Width = GetLevelWidth(description, levelIndex);
+		level.Height = GetLevelHeight(description, levelIndex);
+		level.RowPitch = GetRowPitch(description.Format, level.Width);
+		level.Data.resize(GetLevelSizeInBytes(description.Format, level.Width, level.Height));
+
+		if (!file.read(reinterpret_cast<char*>(level.Data.data()), level.Data.size()))
+			throw Direct3dException("Truncated DDS file");
+
+		textureData.Levels.push_back(std::move(level));
+	}
+
+	return textureData;
+}
+
+TextureData LoadDdsFile(const std::wstring& fileName)
+{
+	return LoadDdsLevels(fileName, 0, UINT32_MAX);
+}
+
+TextureDescription ParseDdsDescription(const uint8_t* data, size_t size)
+{
+	size_t dataOffset;
+
+	return ParseDdsHeaders(data, size, dataOffset);
+}
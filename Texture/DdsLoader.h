@@ -0,0 +1,28 @@
+﻿#pragma once
+
+#include "Texture/TextureData.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Loads a 2D texture with all its mip levels from a DDS file, without converting it.
+ *
+ * Supported formats are BC1, BC3 and BC7 (both as legacy DXT1/DXT5 FourCC codes and through the DX10 header extension)
+ * And uncompressed 32-bit RGBA. Block compressed textures are uploaded exactly as they are stored,
+ * So authoring tools can spend as much time on compression quality as they like.
+ */
+TextureData LoadDdsFile(const std::wstring& fileName);
+
+// Reads only the headers
+TextureDescription LoadDdsDescription(const std::wstring& fileName);
+
+// Loads the mip levels [firstLevel, endLevel), reading nothing but their bytes. Used to stream in single levels.
+TextureData LoadDdsLevels(const std::wstring& fileName, uint32_t firstLevel, uint32_t endLevel);
+
+// Enough bytes from the start of a DDS file for ParseDdsDescription: the magic number, the header and the DX10 header
+const size_t MaxDdsHeadersSize = 4 + 124 + 20;
+
+// Decodes the headers of a DDS file that have already been read into memory, e.g. by the asynchronous asset loader
+TextureDescription ParseDdsDescription(const uint8_t* data, size_t size);
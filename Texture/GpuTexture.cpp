@@ -0,0 +1,66 @@
+﻿#include "GpuTexture.h"
+
+#include "CustomExceptions/Direct3dException.h"
+
+#include <string>
+#include <vector>
+
+GpuTexture::GpuTexture(ID3D11Device* device, const TextureData& textureData)
+	: m_format(textureData.Format),
+	m_sizeInBytes(textureData.GetSizeInBytes())
+{
+	const auto& levels = textureData.Levels;
+
+	if (levels.empty())
+		throw Direct3dException("Failed to create texture. The texture has no mip levels");
+
+	D3D11_TEXTURE2D_DESC textureDesc;
+	textureDesc.Width = levels[0].Width;
+	textureDesc.Height = levels[0].Height;
+	textureDesc.MipLevels = static_cast<UINT>(levels.size());
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = textureData.Format;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.SampleDesc.Quality = 0;
+	// We upload rows in linear order. The driver rearranges the texels into the GPU's own tiled layout,
+	// Which keeps the texels of a 2D neighbourhood close together in memory for the texture cache.
+	textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	textureDesc.CPUAccessFlags = 0;
+	textureDesc.MiscFlags = 0;
+
+	std::vector<D3D11_SUBRESOURCE_DATA> initialData(levels.size());
+
+	for (size_t level = 0; level < levels.size(); level++)
+	{
+		initialData[level].pSysMem = levels[level].Data.data();
+		initialData[level].SysMemPitch = levels[level].RowPitch;
+		initialData[level].SysMemSlicePitch = 0;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	const auto textureCreationResult = device->CreateTexture2D(&textureDesc, initialData.data(), texture.GetAddressOf());
+
+	if (textureCreationResult != S_OK)
+		throw Direct3dException("Failed to create texture. Error code: " + std::to_string(textureCreationResult));
+
+	const auto viewCreationResult = device->CreateShaderResourceView(texture.Get(), nullptr, m_view.GetAddressOf());
+
+	if (viewCreationResult != S_OK)
+		throw Direct3dException("Failed to create texture view. Error code: " + std::to_string(viewCreationResult));
+}
+
+ID3D11ShaderResourceView* GpuTexture::GetView() const
+{
+	return m_view.Get();
+}
+
+DXGI_FORMAT GpuTexture::GetFormat() const
+{
+	return m_format;
+}
+
+size_t GpuTexture::GetSizeInBytes() const
+{
+	return m_sizeInBytes;
+}
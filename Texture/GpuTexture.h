@@ -0,0 +1,25 @@
+﻿#pragma once
+
+#include "Texture/TextureData.h"
+
+#include <wrl/client.h>
+#include <d3d11.h>
+
+// A mip mapped texture uploaded to an immutable GPU texture, in whatever format the texture data is stored in
+class GpuTexture
+{
+public:
+	GpuTexture(ID3D11Device* device, const TextureData& textureData);
+
+	ID3D11ShaderResourceView* GetView() const;
+
+	DXGI_FORMAT GetFormat() const;
+
+	// Size of all mip levels in GPU memory, not counting any padding the driver adds
+	size_t GetSizeInBytes() const;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_view;
+	DXGI_FORMAT m_format;
+	size_t m_sizeInBytes;
+};
@@ -0,0 +1,21 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * An uncompressed image with 8 bits per channel, stored row by row without padding.
+ * Each texel is a packed R8G8B8A8 value with red in the lowest byte, which matches DXGI_FORMAT_R8G8B8A8_UNORM.
+ */
+struct Image
+{
+	uint32_t Width;
+	uint32_t Height;
+	std::vector<uint32_t> Texels;
+};
+
+// Packs a color into a texel. The channels are in [0, 255].
+inline uint32_t PackTexel(uint32_t red, uint32_t green, uint32_t blue, uint32_t alpha)
+{
+	return red | green << 8 | blue << 16 | alpha << 24;
+}
@@ -0,0 +1,24 @@
+﻿#include "ImageGenerator.h"
+
+#include <algorithm>
+
+Image CreateCheckerImage(uint32_t size, uint32_t cellCount, uint32_t firstTexel, uint32_t secondTexel)
+{
+	Image image;
+	image.Width = size;
+	image.Height = size;
+	image.Texels.resize(static_cast<size_t>(size) * size);
+
+	const auto cellSize = std::max(size / std::max(cellCount, 1u), 1u);
+
+	for (uint32_t y = 0; y < size; y++)
+	{
+		for (uint32_t x = 0; x < size; x++)
+		{
+			const auto isFirstCell = (x / cellSize + y / cellSize) % 2 == 0;
+			image.Texels[static_cast<size_t>(y) * size + x] = isFirstCell ? firstTexel : secondTexel;
+		}
+	}
+
+	return image;
+}
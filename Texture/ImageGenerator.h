@@ -0,0 +1,6 @@
+﻿#pragma once
+
+#include "Texture/Image.h"
+
+// Creates a square checkerboard with cellCount x cellCount cells, alternating between the two texel values
+Image CreateCheckerImage(uint32_t size, uint32_t cellCount, uint32_t firstTexel, uint32_t secondTexel);
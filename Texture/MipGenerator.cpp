@@ -0,0 +1,107 @@
+﻿#include "MipGenerator.h"
+
+#include <algorithm>
+
+// SSE2 is available on every CPU that can run Direct3D 11
+#include <emmintrin.h>
+
+namespace
+{
+	// Averages four texels channel by channel, rounding to nearest
+	uint32_t AverageTexels(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+	{
+		uint32_t average = 0;
+
+		for (int shift = 0; shift < 32; shift += 8)
+		{
+			const auto sum = (a >> shift & 0xFF) + (b >> shift & 0xFF) + (c >> shift & 0xFF) + (d >> shift & 0xFF);
+			average |= (sum + 2) / 4 << shift;
+		}
+
+		return average;
+	}
+}
+
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levelCount = 1;
+
+	while (width > 1 || height > 1)
+	{
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+		levelCount++;
+	}
+
+	return levelCount;
+}
+
+Image DownsampleImage(const Image& image)
+{
+	Image mip;
+	mip.Width = std::max(image.Width / 2, 1u);
+	mip.Height = std::max(image.Height / 2, 1u);
+	mip.Texels.resize(static_cast<size_t>(mip.Width) * mip.Height);
+
+	// A dimension of 1 is repeated instead of halved
+	const uint32_t columnStep = image.Width > 1 ? 1 : 0;
+	const uint32_t rowStep = image.Height > 1 ? image.Width : 0;
+
+	const auto zero = _mm_setzero_si128();
+	const auto roundingBias = _mm_set1_epi16(2);
+
+	for (uint32_t y = 0; y < mip.Height; y++)
+	{
+		const auto sourceRow = image.Texels.data() + static_cast<size_t>(y) * 2 * image.Width;
+		const auto nextSourceRow = sourceRow + rowStep;
+		const auto destinationRow = mip.Texels.data() + static_cast<size_t>(y) * mip.Width;
+
+		uint32_t x = 0;
+
+		// Four source texels of two rows make two destination texels
+		if (columnStep != 0)
+		{
+			for (; x + 2 <= mip.Width; x += 2)
+			{
+				const auto top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceRow + x * 2));
+				const auto bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(nextSourceRow + x * 2));
+
+				// Widen the channels to 16 bits and add the rows. Low: texels 0 and 1, high: texels 2 and 3.
+				const auto low = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+				const auto high = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+
+				// Add the horizontal neighbours: texel 0 + 1 and texel 2 + 3
+				const auto lowSum = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+				const auto highSum = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+				const auto sums = _mm_unpacklo_epi64(lowSum, highSum);
+
+				const auto averages = _mm_srli_epi16(_mm_add_epi16(sums, roundingBias), 2);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(destinationRow + x), _mm_packus_epi16(averages, averages));
+			}
+		}
+
+		for (; x < mip.Width; x++)
+		{
+			const auto sourceColumn = x * 2;
+			destinationRow[x] = AverageTexels(
+				sourceRow[sourceColumn],
+				sourceRow[sourceColumn + columnStep],
+				nextSourceRow[sourceColumn],
+				nextSourceRow[sourceColumn + columnStep]);
+		}
+	}
+
+	return mip;
+}
+
+std::vector<Image> GenerateMipChain(const Image& image)
+{
+	std::vector<Image> mipChain;
+	mipChain.reserve(GetMipLevelCount(image.Width, image.Height));
+	mipChain.push_back(image);
+
+	while (mipChain.back().Width > 1 || mipChain.back().Height > 1)
+		mipChain.push_back(DownsampleImage(mipChain.back()));
+
+	return mipChain;
+}
@@ -0,0 +1,20 @@
+﻿#pragma once
+
+#include "Texture/Image.h"
+
+#include <vector>
+
+// Number of levels in a full mip chain, down to and including the 1x1 level
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height);
+
+/*
+ * Halves the size of an image with a 2x2 box filter.
+ * Two destination texels (eight 16-bit channel sums) are computed per SIMD operation.
+ *
+ * For odd sizes, the last row or column of the source is dropped, like the hardware does
+ * When it generates mips. Each dimension stops at 1.
+ */
+Image DownsampleImage(const Image& image);
+
+// Creates the full mip chain of an image. Level 0 is a copy of the image itself.
+std::vector<Image> GenerateMipChain(const Image& image);
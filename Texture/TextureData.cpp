@@ -0,0 +1,88 @@
+﻿#include "TextureData.h"
+
+#include <algorithm>
+#include <cstring>
+
+size_t TextureData::GetSizeInBytes() const
+{
+	size_t sizeInBytes = 0;
+
+	for (const auto& level : Levels)
+		sizeInBytes += level.Data.size();
+
+	return sizeInBytes;
+}
+
+bool IsBlockCompressed(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+uint32_t GetBytesPerElement(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+		return 8;
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return 16;
+	default:
+		return 4;
+	}
+}
+
+uint32_t GetRowPitch(DXGI_FORMAT format, uint32_t width)
+{
+	return (IsBlockCompressed(format) ? (width + 3) / 4 : width) * GetBytesPerElement(format);
+}
+
+size_t GetLevelSizeInBytes(DXGI_FORMAT format, uint32_t width, uint32_t height)
+{
+	const auto rowCount = IsBlockCompressed(format) ? (height + 3) / 4 : height;
+	return static_cast<size_t>(GetRowPitch(format, width)) * rowCount;
+}
+
+uint32_t GetLevelWidth(const TextureDescription& description, uint32_t level)
+{
+	return std::max(description.Width >> level, 1u);
+}
+
+uint32_t GetLevelHeight(const TextureDescription& description, uint32_t level)
+{
+	return std::max(description.Height >> level, 1u);
+}
+
+TextureData CreateTextureData(const std::vector<Image>& mipChain)
+{
+	TextureData textureData;
+	textureData.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+	for (const auto& mip : mipChain)
+	{
+		TextureLevel level;
+		level.Width = mip.Width;
+		level.Height = mip.Height;
+		level.RowPitch = mip.Width * sizeof(uint32_t);
+		level.Data.resize(mip.Texels.size() * sizeof(uint32_t));
+		memcpy(level.Data.data(), mip.Texels.data(), level.Data.size());
+
+		textureData.Levels.push_back(std::move(level));
+	}
+
+	return textureData;
+}
@@ -0,0 +1,59 @@
+﻿#pragma once
+
+#include "Texture/Image.h"
+
+#include <dxgiformat.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The format and size of a texture, known before any of its texels are loaded
+struct TextureDescription
+{
+	DXGI_FORMAT Format;
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t LevelCount;
+};
+
+// One mip level of a texture, in the memory layout Direct3D expects for its format
+struct TextureLevel
+{
+	uint32_t Width;
+	uint32_t Height;
+	// Bytes between rows of texels, or between rows of 4x4 blocks for block compressed formats
+	uint32_t RowPitch;
+	std::vector<uint8_t> Data;
+};
+
+/*
+ * The texels of a mip mapped 2D texture, ready to be uploaded.
+ *
+ * Block compressed formats (BC1 - BC7) store each 4x4 texel block in 8 or 16 bytes. The GPU samples
+ * Them directly - the texture units decode only the blocks a sample touches - so they stay compressed in GPU memory
+ * And every cache line fetched holds 4 to 8 times as many texels.
+ */
+struct TextureData
+{
+	DXGI_FORMAT Format;
+	std::vector<TextureLevel> Levels;
+
+	size_t GetSizeInBytes() const;
+};
+
+bool IsBlockCompressed(DXGI_FORMAT format);
+
+// Bytes per 4x4 block for block compressed formats, bytes per texel otherwise
+uint32_t GetBytesPerElement(DXGI_FORMAT format);
+
+// Size of a mip level. Block compressed levels are rounded up to whole blocks.
+uint32_t GetRowPitch(DXGI_FORMAT format, uint32_t width);
+size_t GetLevelSizeInBytes(DXGI_FORMAT format, uint32_t width, uint32_t height);
+
+// Size of a mip level of a texture, counting from the largest level
+uint32_t GetLevelWidth(const TextureDescription& description, uint32_t level);
+uint32_t GetLevelHeight(const TextureDescription& description, uint32_t level);
+
+// Creates uncompressed R8G8B8A8 texture data from a mip chain
+TextureData CreateTextureData(const std::vector<Image>& mipChain);
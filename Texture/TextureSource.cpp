@@ -0,0 +1,39 @@
+﻿#include "TextureSource.h"
+
+#include "Texture/DdsLoader.h"
+
+TextureSource CreateDdsTextureSource(const std::wstring& fileName)
+{
+	return CreateDdsTextureSource(fileName, LoadDdsDescription(fileName));
+}
+
+TextureSource CreateDdsTextureSource(const std::wstring& fileName, const TextureDescription& description)
+{
+	TextureSource source;
+	source.Description = description;
+	source.LoadLevels = [fileName](uint32_t firstLevel, uint32_t endLevel)
+	{
+		return LoadDdsLevels(fileName, firstLevel, endLevel);
+	};
+
+	return source;
+}
+
+TextureSource CreateMemoryTextureSource(std::shared_ptr<const TextureData> textureData)
+{
+	TextureSource source;
+	source.Description.Format = textureData->Format;
+	source.Description.Width = textureData->Levels[0].Width;
+	source.Description.Height = textureData->Levels[0].Height;
+	source.Description.LevelCount = static_cast<uint32_t>(textureData->Levels.size());
+	source.LoadLevels = [textureData](uint32_t firstLevel, uint32_t endLevel)
+	{
+		TextureData levels;
+		levels.Format = textureData->Format;
+		levels.Levels.assign(textureData->Levels.begin() + firstLevel, textureData->Levels.begin() + endLevel);
+
+		return levels;
+	};
+
+	return source;
+}
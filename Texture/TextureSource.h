@@ -0,0 +1,28 @@
+﻿#pragma once
+
+#include "Texture/TextureData.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+
+/*
+ * Where the mip levels of a streamed texture come from.
+ * LoadLevels is called on worker threads, so it must not touch anything shared without synchronization.
+ */
+struct TextureSource
+{
+	TextureDescription Description;
+
+	// Loads the mip levels [firstLevel, endLevel)
+	std::function<TextureData(uint32_t firstLevel, uint32_t endLevel)> LoadLevels;
+};
+
+// Streams the levels of a DDS file from disk
+TextureSource CreateDdsTextureSource(const std::wstring& fileName);
+
+// Same as above, for a file whose headers have already been read
+TextureSource CreateDdsTextureSource(const std::wstring& fileName, const TextureDescription& description);
+
+// Serves the levels from texture data that is already in memory, e.g. a texture generated at startup
+TextureSource CreateMemoryTextureSource(std::shared_ptr<const TextureData> textureData);
@@ -0,0 +1,387 @@
+﻿#include "TextureStreamer.h"
+
+#include "CustomExceptions/Direct3dException.h"
+#include "Externals/SDL/Include/SDL.h"
+
+#include <algorithm>
+#include <string>
+
+using namespace Microsoft::WRL;
+
+TextureStreamer::TextureStreamer(ID3D11Device* device, JobSystem& jobSystem, size_t budgetInBytes)
+	: m_device(device),
+	m_jobSystem(jobSystem),
+	m_budgetInBytes(budgetInBytes),
+	m_residentBytes(0),
+	m_pendingBytes(0),
+	m_frame(0),
+	m_loadedLevels(0),
+	m_evictedLevels(0),
+	m_failedLoads(0)
+{
+}
+
+StreamedTextureHandle TextureStreamer::AddTexture(TextureSource source)
+{
+	m_textures.push_back(CreateStreamedTexture(std::move(source)));
+
+	return static_cast<StreamedTextureHandle>(m_textures.size() - 1);
+}
+
+void TextureStreamer::ReplaceTexture(StreamedTextureHandle texture, TextureSource source)
+{
+	// Created first, so the old texture stays intact if this throws
+	auto newTexture = CreateStreamedTexture(std::move(source));
+	auto& oldTexture = *m_textures[texture];
+	const auto& oldDescription = oldTexture.Source.Description;
+
+	// The load job only holds on to its own PendingLoad, so the result is simply never picked up
+	if (oldTexture.Load)
+		m_pendingBytes -= GetLevelRangeSize(oldDescription, oldTexture.Load->FirstLevel, oldTexture.ResidentLevel);
+
+	m_residentBytes -= GetLevelRangeSize(oldDescription, oldTexture.ResidentLevel, oldDescription.LevelCount);
+	m_textures[texture] = std::move(newTexture);
+}
+
+std::unique_ptr<TextureStreamer::StreamedTexture> TextureStreamer::CreateStreamedTexture(TextureSource source)
+{
+	auto texture = std::make_unique<StreamedTexture>();
+	texture->Source = std::move(source);
+
+	const auto& description = texture->Source.Description;
+
+	// The tail starts at the first level that is small enough
+	uint32_t tailLevel = 0;
+	while (tailLevel + 1 < description.LevelCount
+		&& std::max(GetLevelWidth(description, tailLevel), GetLevelHeight(description, tailLevel)) > MinimumResidentSize)
+	{
+		tailLevel++;
+	}
+
+	while (tailLevel > 0 && !CanBeTopLevel(description, tailLevel))
+		tailLevel--;
+
+	const auto tailLevels = texture->Source.LoadLevels(tailLevel, description.LevelCount);
+
+	std::vector<D3D11_SUBRESOURCE_DATA> initialData(tailLevels.Levels.size());
+
+	for (size_t i = 0; i < tailLevels.Levels.size(); i++)
+	{
+		initialData[i].pSysMem = tailLevels.Levels[i].Data.data();
+		initialData[i].SysMemPitch = tailLevels.Levels[i].RowPitch;
+		initialData[i].SysMemSlicePitch = 0;
+	}
+
+	CreateTexture(*texture, tailLevel, initialData.data());
+
+	texture->TailLevel = tailLevel;
+	texture->RequestedLevel = tailLevel;
+	texture->LastUsedFrame = m_frame;
+	texture->LoadFailed = false;
+	m_residentBytes += GetLevelRangeSize(description, tailLevel, description.LevelCount);
+
+	return texture;
+}
+
+void TextureStreamer::RequestLevel(StreamedTextureHandle texture, uint32_t finestLevel)
+{
+	auto& streamedTexture = *m_textures[texture];
+
+	// The first request in a frame replaces the one from the previous frame, later ones can only ask for more
+	if (streamedTexture.LastUsedFrame != m_frame)
+		streamedTexture.RequestedLevel = streamedTexture.TailLevel;
+
+	streamedTexture.RequestedLevel = std::min(streamedTexture.RequestedLevel, finestLevel);
+	streamedTexture.LastUsedFrame = m_frame;
+}
+
+void TextureStreamer::Update(ID3D11DeviceContext* deviceContext)
+{
+	// Finished loads
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		auto& texture = m_textures[i];
+
+		if (!texture->Load || !texture->Load->Counter.IsDone())
+			continue;
+
+		const auto load = std::move(texture->Load);
+		const auto loadSize = GetLevelRangeSize(texture->Source.Description, load->FirstLevel, texture->ResidentLevel);
+		m_pendingBytes -= loadSize;
+
+		if (!load->Error.empty())
+		{
+			SDL_Log("Failed to stream levels %u to %u of texture %u, keeping the resident levels: %s",
+				load->FirstLevel, texture->ResidentLevel - 1, static_cast<unsigned int>(i), load->Error.c_str());
+
+			m_failedLoads++;
+			texture->LoadFailed = true;
+			continue;
+		}
+
+		m_loadedLevels += texture->ResidentLevel - load->FirstLevel;
+		SetResidentLevel(*texture, deviceContext, load->FirstLevel, &load->Levels);
+	}
+
+	// New loads, for the finest levels that fit in the budget
+	for (auto& texture : m_textures)
+	{
+		if (texture->Load
+			|| texture->LoadFailed
+			|| texture->LastUsedFrame != m_frame
+			|| texture->RequestedLevel >= texture->ResidentLevel)
+		{
+			continue;
+		}
+
+		const auto& description = texture->Source.Description;
+
+		for (auto firstLevel = texture->RequestedLevel; firstLevel < texture->ResidentLevel; firstLevel++)
+		{
+			if (!CanBeTopLevel(description, firstLevel))
+				continue;
+
+			if (MakeRoom(deviceContext, GetLevelRangeSize(description, firstLevel, texture->ResidentLevel), *texture))
+			{
+				StartLoad(*texture, firstLevel);
+				break;
+			}
+		}
+	}
+
+	m_frame++;
+}
+
+ID3D11ShaderResourceView* TextureStreamer::GetView(StreamedTextureHandle texture) const
+{
+	return m_textures[texture]->View.Get();
+}
+
+const TextureDescription& TextureStreamer::GetDescription(StreamedTextureHandle texture) const
+{
+	return m_textures[texture]->Source.Description;
+}
+
+TextureStreamingStatistics TextureStreamer::GetStatistics() const
+{
+	TextureStreamingStatistics statistics = {};
+	statistics.ResidentBytes = m_residentBytes;
+	statistics.BudgetBytes = m_budgetInBytes;
+	statistics.LoadedLevels = m_loadedLevels;
+	statistics.EvictedLevels = m_evictedLevels;
+	statistics.FailedLoads = m_failedLoads;
+
+	for (const auto& texture : m_textures)
+	{
+		const auto levelCount = texture->Source.Description.LevelCount;
+
+		statistics.ResidentLevels += levelCount - texture->ResidentLevel;
+		statistics.RequestedLevels += levelCount - texture->RequestedLevel;
+		statistics.PendingLoads += texture->Load ? 1 : 0;
+	}
+
+	return statistics;
+}
+
+size_t TextureStreamer::GetLevelRangeSize(const TextureDescription& description, uint32_t firstLevel, uint32_t endLevel)
+{
+	size_t sizeInBytes = 0;
+
+	for (auto level = firstLevel; level < endLevel; level++)
+	{
+		sizeInBytes += GetLevelSizeInBytes(
+			description.Format,
+			GetLevelWidth(description, level),
+			GetLevelHeight(description, level));
+	}
+
+	return sizeInBytes;
+}
+
+bool TextureStreamer::CanBeTopLevel(const TextureDescription& description, uint32_t level)
+{
+	if (!IsBlockCompressed(description.Format))
+		return true;
+
+	return GetLevelWidth(description, level) % 4 == 0 && GetLevelHeight(description, level) % 4 == 0;
+}
+
+void TextureStreamer::CreateTexture(StreamedTexture& texture, uint32_t firstLevel, const D3D11_SUBRESOURCE_DATA* initialData)
+{
+	const auto& description = texture.Source.Description;
+
+	D3D11_TEXTURE2D_DESC textureDesc;
+	textureDesc.Width = GetLevelWidth(description, firstLevel);
+	textureDesc.Height = GetLevelHeight(description, firstLevel);
+	textureDesc.MipLevels = description.LevelCount - firstLevel;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = description.Format;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.SampleDesc.Quality = 0;
+	// Not immutable, since streamed in levels are written with UpdateSubresource
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	textureDesc.CPUAccessFlags = 0;
+	textureDesc.MiscFlags = 0;
+
+	ComPtr<ID3D11Texture2D> newTexture;
+	const auto textureCreationResult = m_device->CreateTexture2D(&textureDesc, initialData, newTexture.GetAddressOf());
+
+	if (textureCreationResult != S_OK)
+		throw Direct3dException("Failed to create streamed texture. Error code: " + std::to_string(textureCreationResult));
+
+	ComPtr<ID3D11ShaderResourceView> newView;
+	const auto viewCreationResult = m_device->CreateShaderResourceView(newTexture.Get(), nullptr, newView.GetAddressOf());
+
+	if (viewCreationResult != S_OK)
+		throw Direct3dException("Failed to create streamed texture view. Error code: " + std::to_string(viewCreationResult));
+
+	texture.Texture = newTexture;
+	texture.View = newView;
+	texture.ResidentLevel = firstLevel;
+}
+
+void TextureStreamer::SetResidentLevel(
+	StreamedTexture& texture,
+	ID3D11DeviceContext* deviceContext,
+	uint32_t firstLevel,
+	const TextureData* newLevels)
+{
+	const auto& description = texture.Source.Description;
+	const auto oldTexture = texture.Texture;
+	const auto oldFirstLevel = texture.ResidentLevel;
+
+	CreateTexture(texture, firstLevel, nullptr);
+
+	for (auto level = firstLevel; level < description.LevelCount; level++)
+	{
+		const auto destinationSubresource = level - firstLevel;
+
+		if (level >= oldFirstLevel)
+		{
+			deviceContext->CopySubresourceRegion(
+				texture.Texture.Get(),
+				destinationSubresource,
+				0, 0, 0,
+				oldTexture.Get(),
+				level - oldFirstLevel,
+				nullptr);
+		}
+		else
+		{
+			const auto& newLevel = newLevels->Levels[level - firstLevel];
+			deviceContext->UpdateSubresource(
+				texture.Texture.Get(),
+				destinationSubresource,
+				nullptr,
+				newLevel.Data.data(),
+				newLevel.RowPitch,
+				0);
+		}
+	}
+
+	m_residentBytes = m_residentBytes
+		+ GetLevelRangeSize(description, firstLevel, description.LevelCount)
+		- GetLevelRangeSize(description, oldFirstLevel, description.LevelCount);
+}
+
+bool TextureStreamer::MakeRoom(ID3D11DeviceContext* deviceContext, size_t sizeInBytes, const StreamedTexture& requester)
+{
+	auto fits = [this, sizeInBytes]()
+	{
+		return m_residentBytes + m_pendingBytes + sizeInBytes <= m_budgetInBytes;
+	};
+
+	if (fits())
+		return true;
+
+	// Textures with pending loads keep their levels, so the loaded levels still fit on top of them
+	std::vector<StreamedTexture*> candidates;
+
+	for (auto& texture : m_textures)
+	{
+		if (texture.get() != &requester && !texture->Load && texture->ResidentLevel < texture->TailLevel)
+			candidates.push_back(texture.get());
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const StreamedTexture* a, const StreamedTexture* b)
+	{
+		return a->LastUsedFrame < b->LastUsedFrame;
+	});
+
+	// First pass: levels finer than requested. Second pass: everything but the tail of textures unused this frame.
+	for (int pass = 0; pass < 2 && !fits(); pass++)
+	{
+		for (auto texture : candidates)
+		{
+			const auto usedThisFrame = texture->LastUsedFrame == m_frame;
+
+			if (pass == 1 && usedThisFrame)
+				continue;
+
+			const auto keptLevel = pass == 0 ? texture->RequestedLevel : texture->TailLevel;
+			auto firstLevel = texture->ResidentLevel;
+
+			// Drop the finest levels one at a time, until the load fits
+			while (firstLevel < keptLevel
+				&& m_residentBytes - GetLevelRangeSize(texture->Source.Description, texture->ResidentLevel, firstLevel)
+					+ m_pendingBytes + sizeInBytes > m_budgetInBytes)
+			{
+				firstLevel++;
+			}
+
+			// The requested level needn't be a valid top level. If there is no valid one from here to the kept level,
+			// Evict less: take the coarsest valid one before here, or leave the texture alone if there is none.
+			const auto fittingLevel = firstLevel;
+
+			while (firstLevel < keptLevel && !CanBeTopLevel(texture->Source.Description, firstLevel))
+				firstLevel++;
+
+			if (!CanBeTopLevel(texture->Source.Description, firstLevel))
+			{
+				firstLevel = fittingLevel;
+
+				while (firstLevel > texture->ResidentLevel && !CanBeTopLevel(texture->Source.Description, firstLevel))
+					firstLevel--;
+			}
+
+			if (firstLevel != texture->ResidentLevel)
+			{
+				m_evictedLevels += firstLevel - texture->ResidentLevel;
+				SetResidentLevel(*texture, deviceContext, firstLevel, nullptr);
+			}
+
+			if (fits())
+				return true;
+		}
+	}
+
+	return fits();
+}
+
+void TextureStreamer::StartLoad(StreamedTexture& texture, uint32_t firstLevel)
+{
+	auto load = std::make_shared<PendingLoad>();
+	load->FirstLevel = firstLevel;
+
+	const auto endLevel = texture.ResidentLevel;
+	auto loadLevels = texture.Source.LoadLevels;
+
+	m_pendingBytes += GetLevelRangeSize(texture.Source.Description, firstLevel, endLevel);
+
+	// The job only touches the load it owns a reference to, so it is safe even if the streamer goes away first.
+	// Exceptions must not escape a job, so a failure is handed to the main thread as an error message.
+	m_jobSystem.ScheduleBackground([load, loadLevels, firstLevel, endLevel]()
+	{
+		try
+		{
+			load->Levels = loadLevels(firstLevel, endLevel);
+		}
+		catch (const std::exception& ex)
+		{
+			load->Error = ex.what();
+		}
+	}, &load->Counter);
+
+	texture.Load = std::move(load);
+}
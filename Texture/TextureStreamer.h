@@ -0,0 +1,131 @@
+﻿#pragma once
+
+#include "Texture/TextureSource.h"
+#include "Threading/JobSystem.h"
+
+#include <wrl/client.h>
+#include <d3d11.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using StreamedTextureHandle = uint32_t;
+
+struct TextureStreamingStatistics
+{
+	size_t ResidentBytes;
+	size_t BudgetBytes;
+	// Mip levels summed over all textures
+	uint32_t ResidentLevels;
+	uint32_t RequestedLevels;
+	uint32_t PendingLoads;
+	// Totals since the streamer was created
+	uint32_t LoadedLevels;
+	uint32_t EvictedLevels;
+	uint32_t FailedLoads;
+};
+
+/*
+ * Keeps only the mip levels the current view needs in GPU memory.
+ *
+ * The smallest levels of every texture are always resident, so a texture can be sampled at any time.
+ * Each frame the renderer requests the finest level it needs, and missing levels are loaded from the texture's
+ * Source by background jobs, which never hold up the frame's own jobs. When a load has finished, the texture is
+ * Recreated with the new levels and the levels that were already resident are copied over on the GPU.
+ *
+ * The resident levels of all textures must fit in the memory budget. To make room for a load, levels that are
+ * No longer requested are evicted first, then the levels of textures that weren't used in the current frame -
+ * Least recently used texture first in both cases. If that isn't enough, fewer levels are loaded.
+ *
+ * A load that fails is logged and dropped. The texture keeps the levels it has and doesn't stream any finer ones.
+ */
+class TextureStreamer
+{
+public:
+	// Levels up to this many texels on a side are always resident
+	static const uint32_t MinimumResidentSize = 64;
+
+	TextureStreamer(ID3D11Device* device, JobSystem& jobSystem, size_t budgetInBytes);
+
+	// Adds a texture and loads its always resident levels right away
+	StreamedTextureHandle AddTexture(TextureSource source);
+
+	// Releases all levels of a texture and puts another one in its place, e.g. when a placeholder has been loaded.
+	// A load that is still running for the old texture is dropped.
+	void ReplaceTexture(StreamedTextureHandle texture, TextureSource source);
+
+	// Marks the texture as used in the current frame, needing the levels from finestLevel down
+	void RequestLevel(StreamedTextureHandle texture, uint32_t finestLevel);
+
+	// Completes finished loads, then evicts levels and starts new loads. Call once per frame, after all requests.
+	void Update(ID3D11DeviceContext* deviceContext);
+
+	ID3D11ShaderResourceView* GetView(StreamedTextureHandle texture) const;
+	const TextureDescription& GetDescription(StreamedTextureHandle texture) const;
+
+	TextureStreamingStatistics GetStatistics() const;
+
+private:
+	struct PendingLoad
+	{
+		JobCounter Counter;
+		uint32_t FirstLevel;
+		TextureData Levels;
+		// Empty if the load succeeded
+		std::string Error;
+	};
+
+	struct StreamedTexture
+	{
+		TextureSource Source;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> Texture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> View;
+		// The resident levels are [ResidentLevel, LevelCount)
+		uint32_t ResidentLevel;
+		// Levels from here on are never evicted
+		uint32_t TailLevel;
+		uint32_t RequestedLevel;
+		uint64_t LastUsedFrame;
+		std::shared_ptr<PendingLoad> Load;
+		bool LoadFailed;
+	};
+
+	// Creates a texture with its always resident levels
+	std::unique_ptr<StreamedTexture> CreateStreamedTexture(TextureSource source);
+
+	// Size of the levels [firstLevel, endLevel) of a texture
+	static size_t GetLevelRangeSize(const TextureDescription& description, uint32_t firstLevel, uint32_t endLevel);
+
+	// Block compressed textures need a top level whose size is a multiple of the block size
+	static bool CanBeTopLevel(const TextureDescription& description, uint32_t level);
+
+	// Creates a texture holding the levels [firstLevel, LevelCount)
+	void CreateTexture(StreamedTexture& texture, uint32_t firstLevel, const D3D11_SUBRESOURCE_DATA* initialData);
+
+	// Recreates the texture with the given first level. Levels that are already resident are copied from the old texture,
+	// Finer levels are taken from newLevels, which starts at firstLevel.
+	void SetResidentLevel(
+		StreamedTexture& texture,
+		ID3D11DeviceContext* deviceContext,
+		uint32_t firstLevel,
+		const TextureData* newLevels);
+
+	// Evicts levels of other textures until the given number of bytes fits in the budget
+	bool MakeRoom(ID3D11DeviceContext* deviceContext, size_t sizeInBytes, const StreamedTexture& requester);
+
+	void StartLoad(StreamedTexture& texture, uint32_t firstLevel);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> m_device;
+	JobSystem& m_jobSystem;
+	std::vector<std::unique_ptr<StreamedTexture>> m_textures;
+	size_t m_budgetInBytes;
+	size_t m_residentBytes;
+	// Memory reserved for loads that haven't finished yet
+	size_t m_pendingBytes;
+	uint64_t m_frame;
+	uint32_t m_loadedLevels;
+	uint32_t m_evictedLevels;
+	uint32_t m_failedLoads;
+};
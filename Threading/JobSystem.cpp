@@ -0,0 +1,211 @@
+﻿#include "JobSystem.h"
+
+#include <algorithm>
+
+JobCounter::JobCounter()
+	: m_pendingJobs(0)
+{
+}
+
+bool JobCounter::IsDone() const
+{
+	return m_pendingJobs.load(std::memory_order_acquire) == 0;
+}
+
+JobSystem::JobSystem(unsigned int workerCount)
+	: m_shuttingDown(false)
+{
+	if (workerCount == 0)
+		// hardware_concurrency returns 0 if the number of hardware threads can't be determined
+		workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+	m_workers.reserve(workerCount);
+
+	for (unsigned int i = 0; i < workerCount; i++)
+		m_workers.emplace_back(&JobSystem::WorkerLoop, this);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_shuttingDown = true;
+	}
+
+	m_queueCondition.notify_all();
+
+	for (auto& worker : m_workers)
+		worker.join();
+}
+
+void JobSystem::Schedule(std::function<void()> job, JobCounter* counter)
+{
+	if (counter != nullptr)
+		counter->m_pendingJobs.fetch_add(1, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_queue.push_back({ std::move(job), counter });
+	}
+
+	m_queueCondition.notify_one();
+}
+
+void JobSystem::ScheduleBackground(std::function<void()> job, JobCounter* counter)
+{
+	if (counter != nullptr)
+		counter->m_pendingJobs.fetch_add(1, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_backgroundQueue.push_back({ std::move(job), counter });
+	}
+
+	m_queueCondition.notify_one();
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	while (!counter.IsDone())
+	{
+		// Nothing left to help with means the remaining jobs are running on other threads, or are background jobs
+		// Waiting for a worker
+		if (!TryExecuteOneJob())
+			std::this_thread::yield();
+	}
+
+	std::exception_ptr exception;
+
+	{
+		std::lock_guard<std::mutex> lock(counter.m_exceptionMutex);
+		exception = counter.m_exception;
+		counter.m_exception = nullptr;
+	}
+
+	if (exception)
+		std::rethrow_exception(exception);
+}
+
+void JobSystem::ParallelFor(size_t count, size_t batchSize, const std::function<void(size_t begin, size_t end)>& body)
+{
+	if (count == 0)
+		return;
+
+	batchSize = std::max<size_t>(batchSize, 1);
+	const size_t batchCount = (count + batchSize - 1) / batchSize;
+
+	// Batches are handed out through a shared counter rather than one job per batch,
+	// So uneven batches balance themselves and scheduling cost doesn't grow with the batch count
+	std::atomic<size_t> nextBatch(0);
+
+	auto processBatches = [&]()
+	{
+		for (auto batch = nextBatch.fetch_add(1); batch < batchCount; batch = nextBatch.fetch_add(1))
+		{
+			const size_t begin = batch * batchSize;
+			body(begin, std::min(begin + batchSize, count));
+		}
+	};
+
+	JobCounter counter;
+	const auto helperCount = std::min<size_t>(m_workers.size(), batchCount - 1);
+
+	for (size_t i = 0; i < helperCount; i++)
+		Schedule(processBatches, &counter);
+
+	// The helpers reference this frame, so they must have finished before an exception may leave it
+	std::exception_ptr exception;
+
+	try
+	{
+		processBatches();
+	}
+	catch (...)
+	{
+		exception = std::current_exception();
+
+		// The remaining batches are skipped
+		nextBatch.store(batchCount);
+	}
+
+	Wait(counter);
+
+	if (exception)
+		std::rethrow_exception(exception);
+}
+
+unsigned int JobSystem::GetThreadCount() const
+{
+	return static_cast<unsigned int>(m_workers.size()) + 1;
+}
+
+void JobSystem::WorkerLoop()
+{
+	for (;;)
+	{
+		QueuedJob queuedJob;
+
+		{
+			std::unique_lock<std::mutex> lock(m_queueMutex);
+			m_queueCondition.wait(lock, [this]()
+			{
+				return m_shuttingDown || !m_queue.empty() || !m_backgroundQueue.empty();
+			});
+
+			// Background jobs only run when no other job is waiting
+			auto& queue = !m_queue.empty() ? m_queue : m_backgroundQueue;
+
+			if (queue.empty())
+				return;
+
+			queuedJob = std::move(queue.front());
+			queue.pop_front();
+		}
+
+		Execute(queuedJob);
+	}
+}
+
+bool JobSystem::TryExecuteOneJob()
+{
+	QueuedJob queuedJob;
+
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+
+		if (m_queue.empty())
+			return false;
+
+		queuedJob = std::move(m_queue.front());
+		m_queue.pop_front();
+	}
+
+	Execute(queuedJob);
+
+	return true;
+}
+
+void JobSystem::Execute(QueuedJob& queuedJob)
+{
+	// Nobody waits for a job without a counter, so there is nowhere to hand its exceptions to
+	if (queuedJob.Counter == nullptr)
+	{
+		queuedJob.Job();
+		return;
+	}
+
+	// The counter is decremented even if the job throws, or its waiters would never return
+	try
+	{
+		queuedJob.Job();
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(queuedJob.Counter->m_exceptionMutex);
+
+		if (!queuedJob.Counter->m_exception)
+			queuedJob.Counter->m_exception = std::current_exception();
+	}
+
+	queuedJob.Counter->m_pendingJobs.fetch_sub(1, std::memory_order_release);
+}
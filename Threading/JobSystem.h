@@ -0,0 +1,88 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts the jobs of a group that haven't finished yet, so they can be waited on together
+class JobCounter
+{
+public:
+	JobCounter();
+
+	bool IsDone() const;
+
+private:
+	friend class JobSystem;
+
+	std::atomic<size_t> m_pendingJobs;
+
+	// The first exception that escaped one of the jobs, rethrown by Wait
+	std::mutex m_exceptionMutex;
+	std::exception_ptr m_exception;
+};
+
+/*
+ * A pool of worker threads executing jobs from a shared queue.
+ *
+ * Threads waiting on a JobCounter help executing queued jobs instead of blocking, so jobs may schedule
+ * And wait on other jobs without deadlocking the pool.
+ *
+ * Long running work that nobody waits for right away, like decoding assets, goes into a second queue. Only the
+ * Workers take jobs from it, and only while the first one is empty, so a thread that waits for a short job never
+ * Picks up a long one and stalls.
+ */
+class JobSystem
+{
+public:
+	// A worker count of 0 creates one worker per hardware thread, minus one for the calling thread
+	explicit JobSystem(unsigned int workerCount = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// Queues a job. If a counter is given, it is incremented now and decremented when the job has finished.
+	void Schedule(std::function<void()> job, JobCounter* counter = nullptr);
+
+	// Queues a job that only the workers execute, never a thread that waits. There is always at least one worker.
+	void ScheduleBackground(std::function<void()> job, JobCounter* counter = nullptr);
+
+	// Executes queued jobs on the calling thread until all jobs of the counter have finished. If any of them threw,
+	// The first exception is rethrown here, once all of them have finished.
+	void Wait(JobCounter& counter);
+
+	/*
+	 * Calls body(begin, end) for consecutive ranges of at most batchSize elements covering [0, count),
+	 * Spread over the workers and the calling thread. Returns when every range has been processed, and rethrows the
+	 * First exception thrown by body.
+	 */
+	void ParallelFor(size_t count, size_t batchSize, const std::function<void(size_t begin, size_t end)>& body);
+
+	// Number of threads that execute jobs, including the calling thread
+	unsigned int GetThreadCount() const;
+
+private:
+	struct QueuedJob
+	{
+		std::function<void()> Job;
+		JobCounter* Counter;
+	};
+
+	void WorkerLoop();
+	bool TryExecuteOneJob();
+	void Execute(QueuedJob& queuedJob);
+
+	std::vector<std::thread> m_workers;
+	std::deque<QueuedJob> m_queue;
+	std::deque<QueuedJob> m_backgroundQueue;
+	std::mutex m_queueMutex;
+	std::condition_variable m_queueCondition;
+	bool m_shuttingDown;
+};
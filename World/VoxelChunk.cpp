@@ -0,0 +1,151 @@
+﻿#include "VoxelChunk.h"
+
+#include <algorithm>
+
+VoxelChunk::VoxelChunk()
+	: m_palette(1, EmptyVoxel),
+	m_paletteReferenceCounts(1, VoxelChunkVolume),
+	m_bitsPerVoxel(0)
+{
+}
+
+VoxelType VoxelChunk::Get(int x, int y, int z) const
+{
+	return m_palette[ReadPaletteIndex(GetVoxelIndex(x, y, z))];
+}
+
+bool VoxelChunk::Set(int x, int y, int z, VoxelType type)
+{
+	const auto voxelIndex = GetVoxelIndex(x, y, z);
+	const auto oldPaletteIndex = ReadPaletteIndex(voxelIndex);
+
+	if (m_palette[oldPaletteIndex] == type)
+		return false;
+
+	// Released first, so the entry can be reused right away if this was its last voxel
+	m_paletteReferenceCounts[oldPaletteIndex]--;
+
+	const auto paletteIndex = FindOrAddPaletteEntry(type);
+	m_paletteReferenceCounts[paletteIndex]++;
+
+	// A chunk that has become uniform again doesn't need any indices
+	if (m_paletteReferenceCounts[paletteIndex] == VoxelChunkVolume)
+	{
+		m_palette.assign(1, type);
+		m_paletteReferenceCounts.assign(1, VoxelChunkVolume);
+		m_packedIndices.clear();
+		m_packedIndices.shrink_to_fit();
+		m_bitsPerVoxel = 0;
+		return true;
+	}
+
+	WritePaletteIndex(voxelIndex, paletteIndex);
+	return true;
+}
+
+void VoxelChunk::Decode(VoxelType* voxels) const
+{
+	if (m_bitsPerVoxel == 0)
+	{
+		std::fill(voxels, voxels + VoxelChunkVolume, m_palette[0]);
+		return;
+	}
+
+	// Every word holds a whole number of indices, so they can be shifted out one after the other
+	const auto indicesPerWord = 64 / m_bitsPerVoxel;
+	const auto mask = (uint64_t(1) << m_bitsPerVoxel) - 1;
+
+	for (size_t wordIndex = 0; wordIndex < m_packedIndices.size(); wordIndex++)
+	{
+		auto word = m_packedIndices[wordIndex];
+
+		for (uint32_t i = 0; i < indicesPerWord; i++)
+		{
+			*voxels++ = m_palette[static_cast<size_t>(word & mask)];
+			word >>= m_bitsPerVoxel;
+		}
+	}
+}
+
+bool VoxelChunk::IsEmpty() const
+{
+	return m_bitsPerVoxel == 0 && m_palette[0] == EmptyVoxel;
+}
+
+uint32_t VoxelChunk::GetBitsPerVoxel() const
+{
+	return m_bitsPerVoxel;
+}
+
+size_t VoxelChunk::GetMemoryUsage() const
+{
+	return m_palette.size() * (sizeof(VoxelType) + sizeof(uint32_t)) + m_packedIndices.size() * sizeof(uint64_t);
+}
+
+int VoxelChunk::GetVoxelIndex(int x, int y, int z)
+{
+	return x + VoxelChunkSize * (y + VoxelChunkSize * z);
+}
+
+uint32_t VoxelChunk::ReadPaletteIndex(int voxelIndex) const
+{
+	if (m_bitsPerVoxel == 0)
+		return 0;
+
+	const auto bit = static_cast<uint32_t>(voxelIndex) * m_bitsPerVoxel;
+	const auto mask = (uint64_t(1) << m_bitsPerVoxel) - 1;
+
+	return static_cast<uint32_t>((m_packedIndices[bit / 64] >> (bit % 64)) & mask);
+}
+
+void VoxelChunk::WritePaletteIndex(int voxelIndex, uint32_t paletteIndex)
+{
+	const auto bit = static_cast<uint32_t>(voxelIndex) * m_bitsPerVoxel;
+	const auto mask = ((uint64_t(1) << m_bitsPerVoxel) - 1) << (bit % 64);
+
+	auto& word = m_packedIndices[bit / 64];
+	word = (word & ~mask) | (static_cast<uint64_t>(paletteIndex) << (bit % 64));
+}
+
+uint32_t VoxelChunk::FindOrAddPaletteEntry(VoxelType type)
+{
+	const auto paletteSize = static_cast<uint32_t>(m_palette.size());
+	auto unusedEntry = paletteSize;
+
+	for (uint32_t i = 0; i < paletteSize; i++)
+	{
+		if (m_palette[i] == type)
+			return i;
+
+		if (m_paletteReferenceCounts[i] == 0 && unusedEntry == paletteSize)
+			unusedEntry = i;
+	}
+
+	if (unusedEntry < paletteSize)
+	{
+		m_palette[unusedEntry] = type;
+		return unusedEntry;
+	}
+
+	if (paletteSize >= (1u << m_bitsPerVoxel))
+		Repack(m_bitsPerVoxel == 0 ? 1 : m_bitsPerVoxel * 2);
+
+	m_palette.push_back(type);
+	m_paletteReferenceCounts.push_back(0);
+
+	return paletteSize;
+}
+
+void VoxelChunk::Repack(uint32_t bitsPerVoxel)
+{
+	std::vector<uint64_t> packedIndices(VoxelChunkVolume / 64 * bitsPerVoxel);
+
+	for (int i = 0; i < VoxelChunkVolume; i++)
+	{
+		const auto bit = static_cast<uint32_t>(i) * bitsPerVoxel;
+		packedIndices[bit / 64] |= static_cast<uint64_t>(ReadPaletteIndex(i)) << (bit % 64);
+	}
+
+	m_packedIndices.swap(packedIndices);
+	m_bitsPerVoxel = bitsPerVoxel;
+}
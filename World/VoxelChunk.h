@@ -0,0 +1,66 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Voxel types identify the material of a voxel. Type 0 is empty space, every other type is a solid, opaque voxel.
+typedef uint16_t VoxelType;
+
+const VoxelType EmptyVoxel = 0;
+
+// Chunks are cubes of VoxelChunkSize voxels along every axis
+const int VoxelChunkSize = 32;
+const int VoxelChunkVolume = VoxelChunkSize * VoxelChunkSize * VoxelChunkSize;
+
+/*
+ * A cube of voxels, stored palette compressed.
+ *
+ * A chunk rarely contains more than a handful of different types, so instead of storing the type of every voxel,
+ * The chunk keeps a palette of the types it contains, and every voxel stores an index into the palette with just
+ * Enough bits to address it. A chunk of stone, dirt and grass takes 2 bits per voxel (8 KB) instead of 16 bits (64 KB),
+ * And a chunk of only one type - all air or all stone - takes no index bits at all.
+ *
+ * Index widths are powers of two, so an index never straddles two words of the packed index array. When a new type no
+ * Longer fits the palette, all indices are repacked with twice the width. Palette entries that no voxel refers to
+ * Anymore are reused by the next new type.
+ *
+ * Voxels are addressed with chunk local coordinates in [0, VoxelChunkSize).
+ */
+class VoxelChunk
+{
+public:
+	// A new chunk is empty
+	VoxelChunk();
+
+	VoxelType Get(int x, int y, int z) const;
+
+	// Returns true if the type of the voxel changed
+	bool Set(int x, int y, int z, VoxelType type);
+
+	// Writes the types of all voxels, x varying fastest and z slowest. Much faster than calling Get for every voxel.
+	void Decode(VoxelType* voxels) const;
+
+	bool IsEmpty() const;
+
+	uint32_t GetBitsPerVoxel() const;
+
+	// Bytes used by the palette and the packed indices
+	size_t GetMemoryUsage() const;
+
+private:
+	static int GetVoxelIndex(int x, int y, int z);
+
+	uint32_t ReadPaletteIndex(int voxelIndex) const;
+	void WritePaletteIndex(int voxelIndex, uint32_t paletteIndex);
+
+	// Returns the palette index of the type, adding it to the palette (and widening the indices) if necessary
+	uint32_t FindOrAddPaletteEntry(VoxelType type);
+	void Repack(uint32_t bitsPerVoxel);
+
+	std::vector<VoxelType> m_palette;
+	// Number of voxels using every palette entry
+	std::vector<uint32_t> m_paletteReferenceCounts;
+	std::vector<uint64_t> m_packedIndices;
+	uint32_t m_bitsPerVoxel;
+};
@@ -0,0 +1,227 @@
+﻿#include "VoxelMesher.h"
+
+#include "Externals/SDL/Include/SDL.h"
+
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	// The chunk with a border of one voxel taken from its neighbours, so the faces on the chunk's border can be
+	// Decided without looking up other chunks in the inner loop
+	const int PaddedChunkSize = VoxelChunkSize + 2;
+
+	// Distance between neighbouring voxels of the padded chunk along x, y and z
+	const int PaddedStrides[3] = { 1, PaddedChunkSize, PaddedChunkSize * PaddedChunkSize };
+
+	int GetPaddedIndex(int x, int y, int z)
+	{
+		return (x + 1) + PaddedChunkSize * ((y + 1) + PaddedChunkSize * (z + 1));
+	}
+
+	void LoadPaddedChunk(const VoxelWorld& world, uint32_t chunkIndex, std::vector<VoxelType>& voxels)
+	{
+		voxels.assign(PaddedChunkSize * PaddedChunkSize * PaddedChunkSize, EmptyVoxel);
+
+		std::vector<VoxelType> chunkVoxels(VoxelChunkVolume);
+		world.GetChunk(chunkIndex).Decode(chunkVoxels.data());
+
+		for (int z = 0; z < VoxelChunkSize; z++)
+		{
+			for (int y = 0; y < VoxelChunkSize; y++)
+			{
+				std::memcpy(
+					&voxels[GetPaddedIndex(0, y, z)],
+					&chunkVoxels[VoxelChunkSize * (y + VoxelChunkSize * z)],
+					VoxelChunkSize * sizeof(VoxelType));
+			}
+		}
+
+		// Faces only look at the voxels in front of them, so the edges and corners of the border aren't needed
+		const auto coordinates = world.GetChunkCoordinates(chunkIndex);
+		const auto originX = coordinates.X * VoxelChunkSize;
+		const auto originY = coordinates.Y * VoxelChunkSize;
+		const auto originZ = coordinates.Z * VoxelChunkSize;
+
+		for (int a = 0; a < VoxelChunkSize; a++)
+		{
+			for (int b = 0; b < VoxelChunkSize; b++)
+			{
+				voxels[GetPaddedIndex(-1, a, b)] = world.GetVoxel(originX - 1, originY + a, originZ + b);
+				voxels[GetPaddedIndex(VoxelChunkSize, a, b)] = world.GetVoxel(originX + VoxelChunkSize, originY + a, originZ + b);
+				voxels[GetPaddedIndex(a, -1, b)] = world.GetVoxel(originX + a, originY - 1, originZ + b);
+				voxels[GetPaddedIndex(a, VoxelChunkSize, b)] = world.GetVoxel(originX + a, originY + VoxelChunkSize, originZ + b);
+				voxels[GetPaddedIndex(a, b, -1)] = world.GetVoxel(originX + a, originY + b, originZ - 1);
+				voxels[GetPaddedIndex(a, b, VoxelChunkSize)] = world.GetVoxel(originX + a, originY + b, originZ + VoxelChunkSize);
+			}
+		}
+	}
+
+	// Adds a quad covering [u, u + width) x [v, v + height) of the plane at the given slice of the axis
+	void AddQuad(
+		Mesh<VertexWithPositionNormalTexture>& mesh,
+		int axis,
+		int slice,
+		int u,
+		int v,
+		int width,
+		int height,
+		bool facesPositiveAxis)
+	{
+		const auto uAxis = (axis + 1) % 3;
+		const auto vAxis = (axis + 2) % 3;
+
+		float normal[3] = { 0.0f, 0.0f, 0.0f };
+		normal[axis] = facesPositiveAxis ? 1.0f : -1.0f;
+
+		const auto firstVertex = static_cast<uint32_t>(mesh.Vertices.size());
+
+		// The corners (0, 0), (width, 0), (width, height) and (0, height) of the quad
+		for (int corner = 0; corner < 4; corner++)
+		{
+			const auto uOffset = corner == 1 || corner == 2 ? width : 0;
+			const auto vOffset = corner >= 2 ? height : 0;
+
+			float position[3];
+			position[axis] = static_cast<float>(slice);
+			position[uAxis] = static_cast<float>(u + uOffset);
+			position[vAxis] = static_cast<float>(v + vOffset);
+
+			VertexWithPositionNormalTexture vertex;
+			vertex.Position = XMFLOAT3(position[0], position[1], position[2]);
+			vertex.Normal = XMFLOAT3(normal[0], normal[1], normal[2]);
+			vertex.TexCoord = XMFLOAT2(static_cast<float>(uOffset), static_cast<float>(vOffset));
+
+			mesh.Vertices.push_back(vertex);
+		}
+
+		// The u and v axes follow the axis cyclically, so u x v points along the positive axis. Seen from that side,
+		// The corners are in clockwise order.
+		const uint32_t positiveOrder[6] = { 0, 1, 2, 0, 2, 3 };
+		const uint32_t negativeOrder[6] = { 0, 2, 1, 0, 3, 2 };
+		const auto order = facesPositiveAxis ? positiveOrder : negativeOrder;
+
+		for (int i = 0; i < 6; i++)
+			mesh.Indices.push_back(firstVertex + order[i]);
+	}
+}
+
+VoxelChunkMesh MeshVoxelChunk(const VoxelWorld& world, uint32_t chunkIndex)
+{
+	const auto startCounter = SDL_GetPerformanceCounter();
+
+	VoxelChunkMesh chunkMesh;
+	chunkMesh.ChunkIndex = chunkIndex;
+	chunkMesh.NaiveTriangleCount = 0;
+
+	// Only the chunk's own voxels have faces, so the air above the terrain costs nothing
+	if (world.GetChunk(chunkIndex).IsEmpty())
+	{
+		chunkMesh.MeshingSeconds =
+			static_cast<double>(SDL_GetPerformanceCounter() - startCounter) / SDL_GetPerformanceFrequency();
+
+		return chunkMesh;
+	}
+
+	std::vector<VoxelType> voxels;
+	LoadPaddedChunk(world, chunkIndex, voxels);
+
+	// The visible faces of one slice. Positive values are faces of the voxel behind the slice, which face along the
+	// Axis, negative values faces of the voxel in front of it, which face against it. Zero means no face.
+	std::vector<int32_t> mask(VoxelChunkSize * VoxelChunkSize);
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const auto uStride = PaddedStrides[(axis + 1) % 3];
+		const auto vStride = PaddedStrides[(axis + 2) % 3];
+
+		// Slice s lies between voxel s - 1 and voxel s along the axis. The first and last slice are the chunk's border,
+		// Where only the faces of the chunk's own voxels are meshed.
+		for (int slice = 0; slice <= VoxelChunkSize; slice++)
+		{
+			const auto sliceStart = GetPaddedIndex(0, 0, 0) + (slice - 1) * PaddedStrides[axis];
+
+			for (int v = 0; v < VoxelChunkSize; v++)
+			{
+				for (int u = 0; u < VoxelChunkSize; u++)
+				{
+					const auto behindIndex = sliceStart + u * uStride + v * vStride;
+					const auto behind = voxels[behindIndex];
+					const auto inFront = voxels[behindIndex + PaddedStrides[axis]];
+
+					auto& face = mask[u + v * VoxelChunkSize];
+
+					if (behind != EmptyVoxel && inFront == EmptyVoxel && slice > 0)
+						face = behind;
+					else if (behind == EmptyVoxel && inFront != EmptyVoxel && slice < VoxelChunkSize)
+						face = -static_cast<int32_t>(inFront);
+					else
+						face = 0;
+
+					if (face != 0)
+						chunkMesh.NaiveTriangleCount += 2;
+				}
+			}
+
+			// Every face is merged into the first rectangle that reaches it, scanning row by row
+			for (int v = 0; v < VoxelChunkSize; v++)
+			{
+				for (int u = 0; u < VoxelChunkSize;)
+				{
+					const auto face = mask[u + v * VoxelChunkSize];
+
+					if (face == 0)
+					{
+						u++;
+						continue;
+					}
+
+					auto width = 1;
+					while (u + width < VoxelChunkSize && mask[u + width + v * VoxelChunkSize] == face)
+						width++;
+
+					auto height = 1;
+					for (; v + height < VoxelChunkSize; height++)
+					{
+						const auto row = &mask[u + (v + height) * VoxelChunkSize];
+
+						auto rowMatches = true;
+						for (auto i = 0; i < width && rowMatches; i++)
+							rowMatches = row[i] == face;
+
+						if (!rowMatches)
+							break;
+					}
+
+					AddQuad(chunkMesh.Geometry, axis, slice, u, v, width, height, face > 0);
+
+					for (auto row = v; row < v + height; row++)
+						std::memset(&mask[u + row * VoxelChunkSize], 0, width * sizeof(int32_t));
+
+					u += width;
+				}
+			}
+		}
+	}
+
+	chunkMesh.MeshingSeconds =
+		static_cast<double>(SDL_GetPerformanceCounter() - startCounter) / SDL_GetPerformanceFrequency();
+
+	return chunkMesh;
+}
+
+std::vector<VoxelChunkMesh> MeshDirtyVoxelChunks(VoxelWorld& world, JobSystem& jobSystem)
+{
+	const auto dirtyChunks = world.TakeDirtyChunks();
+	std::vector<VoxelChunkMesh> chunkMeshes(dirtyChunks.size());
+
+	// Chunks are meshed independently of each other. A chunk takes long enough that every chunk is worth its own job.
+	jobSystem.ParallelFor(dirtyChunks.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (auto i = begin; i < end; i++)
+			chunkMeshes[i] = MeshVoxelChunk(world, dirtyChunks[i]);
+	});
+
+	return chunkMeshes;
+}
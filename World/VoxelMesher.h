@@ -0,0 +1,33 @@
+﻿#pragma once
+
+#include "Mesh/Mesh.h"
+#include "Rendering/VertexDefinitions.h"
+#include "Threading/JobSystem.h"
+#include "World/VoxelWorld.h"
+
+#include <cstdint>
+#include <vector>
+
+struct VoxelChunkMesh
+{
+	uint32_t ChunkIndex;
+	// Positions are in voxels, relative to the minimum corner of the chunk. Texture coordinates repeat once per voxel.
+	Mesh<VertexWithPositionNormalTexture> Geometry;
+	// The triangles a mesher emitting two triangles per visible voxel face would have produced
+	uint32_t NaiveTriangleCount;
+	double MeshingSeconds;
+};
+
+/*
+ * Meshes the visible faces of a chunk - the faces between a solid voxel of the chunk and an empty voxel - with greedy
+ * Meshing, as described in Lysenko - "Meshing in a Minecraft Game" (2012).
+ *
+ * The chunk is swept one slice at a time along every axis. The visible faces of a slice are collected into a mask,
+ * And neighbouring faces with the same type and direction are merged into rectangles: every rectangle grows along
+ * The row as far as it can, then row by row as long as the whole row matches. Every rectangle becomes one quad, so a
+ * Flat area of a single type costs two triangles no matter how many voxels it covers.
+ */
+VoxelChunkMesh MeshVoxelChunk(const VoxelWorld& world, uint32_t chunkIndex);
+
+// Meshes all dirty chunks of the world in parallel, one chunk per job, and clears their dirty flags
+std::vector<VoxelChunkMesh> MeshDirtyVoxelChunks(VoxelWorld& world, JobSystem& jobSystem);
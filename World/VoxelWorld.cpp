@@ -0,0 +1,146 @@
+﻿#include "VoxelWorld.h"
+
+VoxelWorld::VoxelWorld(int chunkCountX, int chunkCountY, int chunkCountZ)
+	: m_chunkCountX(chunkCountX),
+	m_chunkCountY(chunkCountY),
+	m_chunkCountZ(chunkCountZ),
+	m_chunks(static_cast<size_t>(chunkCountX) * chunkCountY * chunkCountZ),
+	m_dirtyFlags(m_chunks.size(), 0)
+{
+}
+
+VoxelType VoxelWorld::GetVoxel(int x, int y, int z) const
+{
+	if (!IsInside(x, y, z))
+		return EmptyVoxel;
+
+	const auto& chunk = m_chunks[GetChunkIndex(x / VoxelChunkSize, y / VoxelChunkSize, z / VoxelChunkSize)];
+
+	return chunk.Get(x % VoxelChunkSize, y % VoxelChunkSize, z % VoxelChunkSize);
+}
+
+void VoxelWorld::SetVoxel(int x, int y, int z, VoxelType type)
+{
+	if (!IsInside(x, y, z))
+		return;
+
+	const auto chunkX = x / VoxelChunkSize;
+	const auto chunkY = y / VoxelChunkSize;
+	const auto chunkZ = z / VoxelChunkSize;
+	const auto localX = x % VoxelChunkSize;
+	const auto localY = y % VoxelChunkSize;
+	const auto localZ = z % VoxelChunkSize;
+
+	auto& chunk = m_chunks[GetChunkIndex(chunkX, chunkY, chunkZ)];
+	const auto wasEmpty = chunk.Get(localX, localY, localZ) == EmptyVoxel;
+
+	if (!chunk.Set(localX, localY, localZ, type))
+		return;
+
+	MarkChunkDirty(chunkX, chunkY, chunkZ);
+
+	// The neighbours only see whether the voxel is solid, not its type
+	if (wasEmpty == (type == EmptyVoxel))
+		return;
+
+	if (localX == 0)
+		MarkChunkDirty(chunkX - 1, chunkY, chunkZ);
+	else if (localX == VoxelChunkSize - 1)
+		MarkChunkDirty(chunkX + 1, chunkY, chunkZ);
+
+	if (localY == 0)
+		MarkChunkDirty(chunkX, chunkY - 1, chunkZ);
+	else if (localY == VoxelChunkSize - 1)
+		MarkChunkDirty(chunkX, chunkY + 1, chunkZ);
+
+	if (localZ == 0)
+		MarkChunkDirty(chunkX, chunkY, chunkZ - 1);
+	else if (localZ == VoxelChunkSize - 1)
+		MarkChunkDirty(chunkX, chunkY, chunkZ + 1);
+}
+
+int VoxelWorld::GetSizeX() const
+{
+	return m_chunkCountX * VoxelChunkSize;
+}
+
+int VoxelWorld::GetSizeY() const
+{
+	return m_chunkCountY * VoxelChunkSize;
+}
+
+int VoxelWorld::GetSizeZ() const
+{
+	return m_chunkCountZ * VoxelChunkSize;
+}
+
+uint32_t VoxelWorld::GetChunkCount() const
+{
+	return static_cast<uint32_t>(m_chunks.size());
+}
+
+VoxelChunkCoordinates VoxelWorld::GetChunkCoordinates(uint32_t chunkIndex) const
+{
+	const auto index = static_cast<int>(chunkIndex);
+
+	return VoxelChunkCoordinates{
+		index % m_chunkCountX,
+		index / m_chunkCountX % m_chunkCountY,
+		index / (m_chunkCountX * m_chunkCountY)
+	};
+}
+
+VoxelChunk& VoxelWorld::GetChunk(uint32_t chunkIndex)
+{
+	return m_chunks[chunkIndex];
+}
+
+const VoxelChunk& VoxelWorld::GetChunk(uint32_t chunkIndex) const
+{
+	return m_chunks[chunkIndex];
+}
+
+void VoxelWorld::MarkChunkDirty(uint32_t chunkIndex)
+{
+	if (m_dirtyFlags[chunkIndex])
+		return;
+
+	m_dirtyFlags[chunkIndex] = 1;
+	m_dirtyChunks.push_back(chunkIndex);
+}
+
+void VoxelWorld::MarkAllChunksDirty()
+{
+	for (uint32_t i = 0; i < GetChunkCount(); i++)
+		MarkChunkDirty(i);
+}
+
+std::vector<uint32_t> VoxelWorld::TakeDirtyChunks()
+{
+	for (const auto chunkIndex : m_dirtyChunks)
+		m_dirtyFlags[chunkIndex] = 0;
+
+	std::vector<uint32_t> dirtyChunks;
+	dirtyChunks.swap(m_dirtyChunks);
+
+	return dirtyChunks;
+}
+
+bool VoxelWorld::IsInside(int x, int y, int z) const
+{
+	return x >= 0 && y >= 0 && z >= 0 && x < GetSizeX() && y < GetSizeY() && z < GetSizeZ();
+}
+
+uint32_t VoxelWorld::GetChunkIndex(int chunkX, int chunkY, int chunkZ) const
+{
+	return static_cast<uint32_t>(chunkX + m_chunkCountX * (chunkY + m_chunkCountY * chunkZ));
+}
+
+void VoxelWorld::MarkChunkDirty(int chunkX, int chunkY, int chunkZ)
+{
+	// Chunks outside the world don't exist, and there is nothing to mesh there
+	if (chunkX < 0 || chunkY < 0 || chunkZ < 0 || chunkX >= m_chunkCountX || chunkY >= m_chunkCountY || chunkZ >= m_chunkCountZ)
+		return;
+
+	MarkChunkDirty(GetChunkIndex(chunkX, chunkY, chunkZ));
+}
@@ -0,0 +1,62 @@
+﻿#pragma once
+
+#include "World/VoxelChunk.h"
+
+#include <cstdint>
+#include <vector>
+
+struct VoxelChunkCoordinates
+{
+	int X;
+	int Y;
+	int Z;
+};
+
+/*
+ * A box shaped world of voxel chunks. Everything outside of the box is empty.
+ *
+ * The world remembers which chunks are dirty - changed since they were last meshed - so only those are meshed again.
+ * Since the faces on a chunk's border depend on the voxels of its neighbours, a voxel on the border that turns from
+ * Empty to solid or back also marks the neighbour across that border as dirty.
+ *
+ * Voxels are addressed with world coordinates, where voxel (0, 0, 0) is the minimum corner of chunk (0, 0, 0).
+ * The world isn't synchronized. Chunks may be meshed in parallel, as long as no voxels are changed meanwhile.
+ */
+class VoxelWorld
+{
+public:
+	VoxelWorld(int chunkCountX, int chunkCountY, int chunkCountZ);
+
+	VoxelType GetVoxel(int x, int y, int z) const;
+	void SetVoxel(int x, int y, int z, VoxelType type);
+
+	// Size of the world in voxels
+	int GetSizeX() const;
+	int GetSizeY() const;
+	int GetSizeZ() const;
+
+	uint32_t GetChunkCount() const;
+	VoxelChunkCoordinates GetChunkCoordinates(uint32_t chunkIndex) const;
+
+	// Chunks changed directly instead of through SetVoxel must be marked dirty by the caller
+	VoxelChunk& GetChunk(uint32_t chunkIndex);
+	const VoxelChunk& GetChunk(uint32_t chunkIndex) const;
+
+	void MarkChunkDirty(uint32_t chunkIndex);
+	void MarkAllChunksDirty();
+
+	// Returns the chunks that became dirty since the last call, in the order they became dirty, and clears their flags
+	std::vector<uint32_t> TakeDirtyChunks();
+
+private:
+	bool IsInside(int x, int y, int z) const;
+	uint32_t GetChunkIndex(int chunkX, int chunkY, int chunkZ) const;
+	void MarkChunkDirty(int chunkX, int chunkY, int chunkZ);
+
+	int m_chunkCountX;
+	int m_chunkCountY;
+	int m_chunkCountZ;
+	std::vector<VoxelChunk> m_chunks;
+	std::vector<uint8_t> m_dirtyFlags;
+	std::vector<uint32_t> m_dirtyChunks;
+};
@@ -1,8 +1,55 @@
-#include "Externals/SDL/Include/SDL.h"
+﻿#include "Externals/SDL/Include/SDL.h"
 #include "Externals/SDL/Include/SDL_syswm.h"
 
 // Own Engine Headers
+#include "Asset/AssetContainer.h"
+#include "Asset/AssetConverter.h"
+#include "Asset/AssetLoader.h"
+#include "Compute/ComputeBenchmark.h"
 #include "CustomExceptions/Direct3dException.h"
+#include "Diagnostics/GpuTimer.h"
+#include "Diagnostics/PipelineStatistics.h"
+#include "Entity/Components.h"
+#include "Entity/EntityBenchmark.h"
+#include "Entity/EntityManager.h"
+#include "Entity/TransformHierarchy.h"
+#include "Entity/TransformSystems.h"
+#include "Mesh/GpuMesh.h"
+#include "Mesh/MeshGenerator.h"
+#include "Mesh/MeshletBuilder.h"
+#include "Mesh/MeshOptimizer.h"
+#include "Mesh/MeshQuantization.h"
+#include "Mesh/MeshSimplifier.h"
+#include "Physics/PhysicsBenchmark.h"
+#include "Physics/RigidBodyWorld.h"
+#include "Rendering/ClusterCuller.h"
+#include "Rendering/InstanceBuffer.h"
+#include "Rendering/PipelineState.h"
+#include "Rendering/ShaderCompiler.h"
+#include "Rendering/VertexDefinitions.h"
+#include "Rendering/VertexLayout.h"
+#include "Rendering/VisibilityBuffer.h"
+#include "Spatial/BoundingVolumeHierarchy.h"
+#include "Spatial/BvhBenchmark.h"
+#include "Texture/BlockCompression.h"
+#include "Texture/DdsLoader.h"
+#include "Texture/ImageGenerator.h"
+#include "Texture/MipGenerator.h"
+#include "Texture/TextureSource.h"
+#include "Texture/TextureStreamer.h"
+#include "Threading/JobSystem.h"
+#include "World/VoxelMesher.h"
+#include "World/VoxelWorld.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 
 // We include atlbase in order to use the ATL smart pointer
 // Microsoft::WRL:ComPtr (template smart-pointer for COM objects)
@@ -34,24 +81,230 @@ using namespace DirectX;
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "d3dcompiler.lib")
 
+// Dimensions of the main window client area.
+// The back buffer, depth/stencil buffer and viewport all use these dimensions.
+const int windowWidth = 640;
+const int windowHeight = 480;
+
 // Direct3D variables
 ComPtr<IDXGISwapChain> direct3dSwapChain;
 ComPtr<ID3D11Device> direct3dDevice;
 ComPtr<ID3D11DeviceContext> direct3dDeviceContext;
 ComPtr<ID3D11RenderTargetView> mRenderTargetView;
 ComPtr<ID3D11DepthStencilView> mDepthStencilView;
+ComPtr<ID3D11RasterizerState> mRasterizerState;
 D3D_FEATURE_LEVEL direct3dFeatureLevel;
 
-typedef struct VertexDefinition1
+// Multi-sampling settings
+// 4X MSAA is supported by all Direct3D 11 capable devices for all render target formats,
+// But the supported quality level may vary. We query it after the device has been created.
+bool mEnable4xMsaa = true;
+UINT m4xMsaaQuality = 0;
+
+// Worker threads shared by all CPU side systems
+std::unique_ptr<JobSystem> mJobSystem;
+
+// Reads and decodes assets in the background while the scene is already rendering
+std::unique_ptr<AssetLoader> mAssetLoader;
+
+// GPU memory that streamed texture mip levels may use
+const size_t textureStreamingBudget = 16 * 1024 * 1024;
+
+// Assets converted offline with --convert. The cube mesh and texture are used from here when the container has them.
+const std::wstring sceneAssetFileName = L"Assets/Scene.rca";
+
+// Per-frame triangle counts and GPU time
+std::unique_ptr<PipelineStatistics> mPipelineStatistics;
+std::unique_ptr<GpuTimer> mSceneGpuTimer;
+Uint32 lastStatisticsReportTime = 0;
+double accumulatedSceneGpuTime = 0.0;
+int measuredSceneFrames = 0;
+
+// Scene variables
+struct PerMeshConstants
+{
+	XMFLOAT4 PositionScale;
+	XMFLOAT4 PositionOffset;
+	// Tells shaders that fetch indices themselves how the index buffer is stored
+	UINT Use16BitIndices;
+	UINT Padding[3];
+};
+
+struct PerFrameConstants
+{
+	XMFLOAT4X4 ViewProjection;
+	XMFLOAT3 EyePosition;
+	// Only read by the generic pipeline and the visibility buffer shading pass
+	UINT ShaderFeatures;
+	XMFLOAT2 RenderTargetSize;
+	XMFLOAT2 Padding;
+};
+
+// The scene is a field of small, overlapping cubes, which produces a lot of overdraw
+const int cubeFieldWidth = 20;
+const int cubeFieldDepth = 20;
+const int cubeFieldHeight = 5;
+const int cubeCount = cubeFieldWidth * cubeFieldDepth * cubeFieldHeight;
+const float cubeHalfExtent = 0.25f;
+const float cubeSpacing = 0.35f;
+
+// The generated cube's faces are tessellated like an imported mesh would be. Its levels of detail take the distant cubes
+// Back down to 12 triangles.
+const uint32_t cubeSubdivisions = 8;
+
+// The coarsest level of detail whose error covers at most this many pixels is drawn
+const float maxLodPixelError = 1.0f;
+
+// The pipeline used to draw the cube. Lighting, specular and texturing can be toggled with F1, F2 and F5,
+// And F3 switches between the specialized permutations and the generic uber shader.
+PipelineStateDescription mCubePipelineDescription = {
+	DepthMode::ReadWrite,
+	BlendMode::Opaque,
+	ShaderFeatureLighting | ShaderFeatureSpecular | ShaderFeatureTexture,
+	false
+};
+
+// F4 switches between forward rendering and visibility buffer rendering
+bool mUseVisibilityBuffer = false;
+
+// F6 toggles culling the cube's meshlets before the visibility buffer geometry pass
+bool mUseClusterCulling = true;
+
+// F7 toggles selecting a level of detail for every cube. Without it, all cubes are drawn with full detail.
+bool mUseLods = true;
+
+// F8 switches between the cube field and a voxel terrain. The terrain is always rendered forward.
+bool mShowVoxelWorld = false;
+
+// Every layer of the cube field is attached to a parent node, which F9 sets turning around the vertical axis.
+// F10 stops the cubes from spinning around their own centers. With both stopped, no world matrix is recomputed.
+bool mRotateCubeLayers = true;
+bool mSpinCubes = true;
+
+// F11 drops the cubes onto an invisible floor and lets them fall, collide and settle. The cubes start out apart, since
+// The spinning cubes overlap. Turning it off again puts them back where they were.
+const float physicsCubeSpacing = 0.6f;
+const float physicsFloorHeight = -1.5f;
+const float physicsStepTime = 1.0f / 60.0f;
+
+bool mSimulateCubePhysics = false;
+std::unique_ptr<RigidBodyWorld> mCubePhysics;
+// Frame time that hasn't been simulated yet, since the physics always steps by physicsStepTime
+float mCubePhysicsTimeAccumulator = 0.0f;
+
+// A bounding volume hierarchy over the bounds of the cubes, in the order the entity manager iterates them, which is
+// Refit every frame. It finds the cubes in the view frustum, and the cube under the mouse on a left click.
+std::vector<AxisAlignedBox> mCubeBounds;
+std::unique_ptr<BoundingVolumeHierarchy> mCubeBoundingVolumeHierarchy;
+std::vector<uint32_t> mCubesInFrustum;
+// The camera of the last frame, which turns mouse positions into rays
+XMFLOAT4X4 mLastViewProjection;
+
+// The voxel terrain is 256 x 64 x 256 voxels. Its chunks are meshed on the worker threads, and a ball flying over the
+// Terrain changes a few of them every frame, which are then meshed again.
+const int voxelWorldChunkCountX = 8;
+const int voxelWorldChunkCountY = 2;
+const int voxelWorldChunkCountZ = 8;
+const float voxelSize = 0.05f;
+const int voxelBallRadius = 4;
+
+const VoxelType stoneVoxel = 1;
+const VoxelType dirtVoxel = 2;
+const VoxelType grassVoxel = 3;
+const VoxelType ballVoxel = 4;
+
+// The arrow keys move the camera towards and away from the cubes
+float mCameraDistanceScale = 1.0f;
+
+std::shared_ptr<ShaderCache> mShaderCache;
+std::unique_ptr<PipelineStateCache> mCubePipelineStateCache;
+std::unique_ptr<VisibilityBuffer> mVisibilityBuffer;
+ComPtr<ID3D11Buffer> mPerMeshConstantBuffer;
+ComPtr<ID3D11Buffer> mPerFrameConstantBuffer;
+std::unique_ptr<InstanceBuffer> mCubeInstanceBuffer;
+// Every cube is an entity. Its rotation is integrated from its angular velocity every frame.
+std::unique_ptr<EntityManager> mEntities;
+std::unique_ptr<TransformHierarchy> mTransformHierarchy;
+std::vector<TransformNode> mCubeLayerNodes;
+std::vector<float> mCubeLayerAngles;
+float mLastFrameTime = 0.0f;
+// The world matrices of the cubes in the order the entity manager iterates them
+std::vector<XMFLOAT4X4> mCubeWorldMatrices;
+// The world matrices in the order they are uploaded, grouped by level of detail, and the draw of every group
+std::vector<XMFLOAT4X4> mCubeInstanceWorldMatrices;
+std::vector<MeshLodBatch> mCubeLodBatches;
+std::shared_ptr<const AssetContainer> mSceneAssets;
+std::unique_ptr<GpuMesh> mCubeMesh;
+std::unique_ptr<ClusterCuller> mCubeClusterCuller;
+std::unique_ptr<TextureStreamer> mTextureStreamer;
+StreamedTextureHandle mCubeTextureHandle;
+AssetLoadHandle mCubeTextureLoad = InvalidAssetLoadHandle;
+ComPtr<ID3D11SamplerState> mTrilinearSampler;
+
+// Every chunk mesh is quantized on its own, so it comes with its own per mesh constants. Empty chunks have no mesh.
+struct VoxelChunkGpuMesh
+{
+	std::unique_ptr<GpuMesh> Geometry;
+	ComPtr<ID3D11Buffer> PerMeshConstantBuffer;
+};
+
+// Meshing times and triangle counts of the chunks meshed since the last report
+struct VoxelMeshingStatistics
 {
-	XMFLOAT3 Position;
-} VertexWithPosition;
+	uint32_t MeshedChunks;
+	double TotalSeconds;
+	double LongestSeconds;
+	uint64_t Triangles;
+	uint64_t NaiveTriangles;
+};
+
+std::unique_ptr<VoxelWorld> mVoxelWorld;
+std::vector<VoxelChunkGpuMesh> mVoxelChunkMeshes;
+// One world matrix per chunk, which places the chunk and scales voxels to voxelSize
+std::unique_ptr<InstanceBuffer> mVoxelChunkInstanceBuffer;
+XMINT3 mVoxelBallCenter;
+bool mVoxelBallPlaced = false;
+VoxelMeshingStatistics mVoxelMeshingStatistics = {};
 
 // Function Prototypes
+int RunAssetConversion(int argc, char *argv[]);
+int RunEntityBenchmark(int argc, char *argv[]);
+int RunPhysicsBenchmark(int argc, char *argv[]);
+int RunBoundingVolumeHierarchyBenchmark(int argc, char *argv[]);
+int RunComputeBenchmark(int argc, char *argv[]);
 void InitializeDirect3d(HWND windowHandle);
+void InitializeScene();
+void LoadCubeTexture();
+void InitializeVoxelWorld();
+void ReportVoxelMeshingStatistics(const char* description);
+void HandleKeyDown(SDL_Keycode key);
+void PickCube(int x, int y);
+void RenderScene(float totalTimeInSeconds);
 
 int main(int argc, char *argv[])
 {
+	// Converts source assets into an asset container instead of running the application:
+	// RotatingCube3d --convert <output.rca> <input files...>
+	// RotatingCube3d --benchmark-import <input.obj>
+	if (argc >= 3 && (std::string(argv[1]) == "--convert" || std::string(argv[1]) == "--benchmark-import"))
+		return RunAssetConversion(argc, argv);
+
+	// RotatingCube3d --benchmark-entities [entity count]
+	if (argc >= 2 && std::string(argv[1]) == "--benchmark-entities")
+		return RunEntityBenchmark(argc, argv);
+
+	// RotatingCube3d --benchmark-physics [box count]
+	if (argc >= 2 && std::string(argv[1]) == "--benchmark-physics")
+		return RunPhysicsBenchmark(argc, argv);
+
+	// RotatingCube3d --benchmark-bvh [instance count]
+	if (argc >= 2 && std::string(argv[1]) == "--benchmark-bvh")
+		return RunBoundingVolumeHierarchyBenchmark(argc, argv);
+
+	// RotatingCube3d --benchmark-compute [element count]
+	if (argc >= 2 && std::string(argv[1]) == "--benchmark-compute")
+		return RunComputeBenchmark(argc, argv);
+
 	// SDL Init must be called before any other SDL function
 	// This is in order to initialize SDL
 	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS | SDL_INIT_AUDIO) != 0)
@@ -61,6 +314,11 @@ int main(int argc, char *argv[])
 	}
 
 	SDL_Log("SDL initialized...");
+
+	mJobSystem = std::make_unique<JobSystem>();
+	SDL_Log("Job system started with %u threads...", mJobSystem->GetThreadCount());
+
+	mAssetLoader = std::make_unique<AssetLoader>(*mJobSystem);
 	
 	SDL_Log("Initializing main window...");
 
@@ -68,8 +326,8 @@ int main(int argc, char *argv[])
 		"Rotating Cube",
 		SDL_WINDOWPOS_CENTERED,
 		SDL_WINDOWPOS_CENTERED,
-		640,
-		480,
+		windowWidth,
+		windowHeight,
 		0
 	);
 
@@ -96,6 +354,12 @@ int main(int argc, char *argv[])
 	{
 		SDL_Log("Initializing Direct3D...");
 		InitializeDirect3d(windowHandle);
+
+		mPipelineStatistics = std::make_unique<PipelineStatistics>(direct3dDevice.Get());
+		mSceneGpuTimer = std::make_unique<GpuTimer>(direct3dDevice.Get());
+
+		SDL_Log("Initializing scene...");
+		InitializeScene();
 	}
 	catch (Direct3dException ex)
 	{
@@ -112,8 +376,15 @@ int main(int argc, char *argv[])
 		{
 			if (e.type == SDL_QUIT)
 				quit = true;
+			else if (e.type == SDL_KEYDOWN)
+				HandleKeyDown(e.key.keysym.sym);
+			else if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT && !mShowVoxelWorld)
+				PickCube(e.button.x, e.button.y);
 		}
 
+		// Hands over the assets that finished loading since the last frame
+		mAssetLoader->DeliverCompletions();
+
 		// Clear the back buffer to deep blue
 		direct3dDeviceContext->ClearRenderTargetView(mRenderTargetView.Get(), DirectX::Colors::CornflowerBlue);
 
@@ -124,12 +395,123 @@ int main(int argc, char *argv[])
 			0
 		);
 
-		// Render stuff here!
+		mPipelineStatistics->BeginFrame(direct3dDeviceContext.Get());
+		mSceneGpuTimer->Begin(direct3dDeviceContext.Get());
+
+		RenderScene(SDL_GetTicks() / 1000.0f);
+
+		// Streams in the texture levels requested while rendering
+		mTextureStreamer->Update(direct3dDeviceContext.Get());
+
+		mSceneGpuTimer->End(direct3dDeviceContext.Get());
+		mPipelineStatistics->EndFrame(direct3dDeviceContext.Get());
 
 		// Switch the back buffer and the front buffer
 		direct3dSwapChain->Present(0, 0);
+
+		double sceneGpuTime;
+		if (mSceneGpuTimer->TryGetElapsedMilliseconds(direct3dDeviceContext.Get(), sceneGpuTime))
+		{
+			accumulatedSceneGpuTime += sceneGpuTime;
+			measuredSceneFrames++;
+		}
+
+		// Report the triangle counts of a recently finished frame once per second
+		TriangleStatistics triangleStatistics;
+		if (mPipelineStatistics->TryGetFrameStatistics(direct3dDeviceContext.Get(), triangleStatistics)
+			&& SDL_GetTicks() - lastStatisticsReportTime >= 1000)
+		{
+			SDL_Log("Triangles - input: %llu, clipper input: %llu, clipper output: %llu (as counted by the driver)",
+				triangleStatistics.InputTriangles,
+				triangleStatistics.ClipperInputTriangles,
+				triangleStatistics.ClipperOutputTriangles);
+
+			if (measuredSceneFrames > 0)
+			{
+				SDL_Log("Scene GPU time: %.4f ms (%s, %s pipeline, %u permutations, %u compiling)",
+					accumulatedSceneGpuTime / measuredSceneFrames,
+					mUseVisibilityBuffer ? "visibility buffer" : "forward",
+					mCubePipelineDescription.Generic ? "generic" : "specialized",
+					static_cast<unsigned int>(mCubePipelineStateCache->GetPermutationCount()),
+					static_cast<unsigned int>(mCubePipelineStateCache->GetPendingPermutationCount()));
+
+				accumulatedSceneGpuTime = 0.0;
+				measuredSceneFrames = 0;
+			}
+
+			const auto streamingStatistics = mTextureStreamer->GetStatistics();
+
+			SDL_Log("Texture streaming - resident levels: %u/%u, pending loads: %u, memory: %u/%u KB, loaded: %u, evicted: %u, "
+				"failed loads: %u",
+				streamingStatistics.ResidentLevels,
+				streamingStatistics.RequestedLevels,
+				streamingStatistics.PendingLoads,
+				static_cast<unsigned int>(streamingStatistics.ResidentBytes / 1024),
+				static_cast<unsigned int>(streamingStatistics.BudgetBytes / 1024),
+				streamingStatistics.LoadedLevels,
+				streamingStatistics.EvictedLevels,
+				streamingStatistics.FailedLoads);
+
+			std::string lodInstanceCounts;
+			for (const auto& batch : mCubeLodBatches)
+				lodInstanceCounts += (lodInstanceCounts.empty() ? "" : ", ") + std::to_string(batch.InstanceCount);
+
+			SDL_Log("Cube LODs - instances per level: %s (%s)", lodInstanceCounts.c_str(), mUseLods ? "selected" : "off");
+
+			SDL_Log("Transforms - nodes: %u, world matrices recomputed last frame: %u",
+				static_cast<unsigned int>(mTransformHierarchy->GetNodeCount()),
+				mTransformHierarchy->GetUpdatedNodeCount());
+
+			const auto& bvhStatistics = mCubeBoundingVolumeHierarchy->GetLastUpdateStatistics();
+
+			SDL_Log("Cube BVH - nodes: %u, treelets: %u, last update: refit %.3f ms, rebuild %.3f ms, treelets rebuilt: %u%s. Cubes in the view frustum: %u",
+				static_cast<unsigned int>(mCubeBoundingVolumeHierarchy->GetNodeCount()),
+				static_cast<unsigned int>(mCubeBoundingVolumeHierarchy->GetTreeletCount()),
+				bvhStatistics.RefitSeconds * 1000.0,
+				bvhStatistics.RebuildSeconds * 1000.0,
+				bvhStatistics.RebuiltTreeletCount,
+				bvhStatistics.FullRebuild ? " (full rebuild)" : "",
+				static_cast<unsigned int>(mCubesInFrustum.size()));
+
+			if (mCubePhysics)
+			{
+				const auto& physicsStatistics = mCubePhysics->GetLastStepStatistics();
+
+				SDL_Log("Physics - last step: velocities %.2f ms, broadphase %.2f ms, narrowphase %.2f ms, islands %.2f ms, solver %.2f ms, positions %.2f ms. Pairs: %u, touching: %u, contacts: %u, islands: %u, largest: %u bodies, asleep: %u bodies",
+					physicsStatistics.VelocitySeconds * 1000.0,
+					physicsStatistics.BroadphaseSeconds * 1000.0,
+					physicsStatistics.NarrowphaseSeconds * 1000.0,
+					physicsStatistics.IslandSeconds * 1000.0,
+					physicsStatistics.SolverSeconds * 1000.0,
+					physicsStatistics.PositionSeconds * 1000.0,
+					physicsStatistics.PairCount,
+					physicsStatistics.ManifoldCount,
+					physicsStatistics.ContactCount,
+					physicsStatistics.IslandCount,
+					physicsStatistics.LargestIslandBodyCount,
+					physicsStatistics.AsleepBodyCount);
+			}
+
+			if (mVoxelMeshingStatistics.MeshedChunks > 0)
+				ReportVoxelMeshingStatistics("Voxel remeshing");
+
+			const auto loaderStatistics = mAssetLoader->GetStatistics();
+
+			SDL_Log("Asset loading - pending: %u, queued reads: %u, completed: %u, failed: %u, cancelled: %u, read: %u KB",
+				loaderStatistics.PendingLoads,
+				loaderStatistics.QueuedReads,
+				loaderStatistics.CompletedLoads,
+				loaderStatistics.FailedLoads,
+				loaderStatistics.CancelledLoads,
+				static_cast<unsigned int>(loaderStatistics.BytesRead / 1024));
+
+			lastStatisticsReportTime = SDL_GetTicks();
+		}
 	}
 
+	// Loads still in flight are cancelled. Their completions refer to the streamer and the device.
+	mAssetLoader.reset();
+
 	// SDL Quit should be called before an SDL application exits, to safely shut down
 	// All subsystems.
 	SDL_Quit();
@@ -137,6 +519,73 @@ int main(int argc, char *argv[])
 	return 0;
 }
 
+int RunAssetConversion(int argc, char *argv[])
+{
+	std::vector<std::wstring> fileNames;
+	for (int i = 2; i < argc; i++)
+		fileNames.push_back(std::wstring(argv[i], argv[i] + strlen(argv[i])));
+
+	// The importers parse and deduplicate in parallel
+	JobSystem jobSystem;
+
+	try
+	{
+		if (std::string(argv[1]) == "--benchmark-import")
+			BenchmarkObjImport(fileNames[0], jobSystem);
+		else
+			ConvertAssets(std::vector<std::wstring>(fileNames.begin() + 1, fileNames.end()), fileNames[0], jobSystem);
+	}
+	catch (Direct3dException ex)
+	{
+		SDL_Log("Asset conversion failed: %s", ex.what());
+		return 1;
+	}
+
+	return 0;
+}
+
+int RunEntityBenchmark(int argc, char *argv[])
+{
+	const auto entityCount = argc >= 3 ? static_cast<size_t>(std::strtoul(argv[2], nullptr, 10)) : 1000000;
+
+	JobSystem jobSystem;
+	BenchmarkEntityUpdate(entityCount, jobSystem);
+	BenchmarkRotatingInstances(entityCount, jobSystem);
+	CheckRotationDrift();
+
+	return 0;
+}
+
+int RunPhysicsBenchmark(int argc, char *argv[])
+{
+	const auto boxCount = argc >= 3 ? static_cast<size_t>(std::strtoul(argv[2], nullptr, 10)) : 50000;
+
+	JobSystem jobSystem;
+	BenchmarkRigidBodies(boxCount, jobSystem);
+
+	return 0;
+}
+
+int RunBoundingVolumeHierarchyBenchmark(int argc, char *argv[])
+{
+	const auto instanceCount = argc >= 3 ? static_cast<size_t>(std::strtoul(argv[2], nullptr, 10)) : 100000;
+
+	JobSystem jobSystem;
+	BenchmarkBoundingVolumeHierarchy(instanceCount, jobSystem);
+
+	return 0;
+}
+
+int RunComputeBenchmark(int argc, char *argv[])
+{
+	const auto elementCount = argc >= 3 ? static_cast<size_t>(std::strtoul(argv[2], nullptr, 10)) : 4000000;
+
+	JobSystem jobSystem;
+	BenchmarkComputeKernels(elementCount, jobSystem);
+
+	return 0;
+}
+
 void InitializeDeviceAndDeviceContext()
 {
 	SDL_Log("Initializing Direct3D Device and DeviceContext...");
@@ -175,6 +624,47 @@ void InitializeDeviceAndDeviceContext()
 
 		throw Direct3dException(errorMessage);
 	}
+
+	// Check the 4X MSAA quality level support for our back buffer format.
+	// With MSAA, coverage and depth testing are done per sample, while the pixel shader is only
+	// Executed once per pixel. The hardware also stores pixels whose samples are all equal (which is the case
+	// For every pixel in the interior of a triangle) in compressed form, so we only pay the extra bandwidth
+	// Along triangle edges.
+	const auto multisampleQualityResult = direct3dDevice->CheckMultisampleQualityLevels(
+		DXGI_FORMAT_R8G8B8A8_UNORM,
+		4,
+		&m4xMsaaQuality
+	);
+
+	if (multisampleQualityResult != S_OK)
+		throw Direct3dException("Failed to check 4X MSAA quality level support. Error code: "
+			+ std::to_string(multisampleQualityResult));
+
+	// A quality level of 0 means that the sample count is not supported at all
+	if (m4xMsaaQuality == 0)
+	{
+		SDL_Log("4X MSAA is not supported by the device, falling back to no anti-aliasing...");
+		mEnable4xMsaa = false;
+	}
+}
+
+DXGI_SAMPLE_DESC GetSampleDescription()
+{
+	DXGI_SAMPLE_DESC sampleDesc;
+
+	if (mEnable4xMsaa)
+	{
+		sampleDesc.Count = 4;
+		// Valid quality levels are between 0 and one less than the level returned by CheckMultisampleQualityLevels
+		sampleDesc.Quality = m4xMsaaQuality - 1;
+	}
+	else
+	{
+		sampleDesc.Count = 1;
+		sampleDesc.Quality = 0;
+	}
+
+	return sampleDesc;
 }
 
 void InitializeSwapChain(HWND windowHandle)
@@ -201,10 +691,13 @@ void InitializeSwapChain(HWND windowHandle)
 
 	// SampleDesc describes multi-sampling parameters
 	// Count = 1 and Quality = 0 means no anti-aliasing
-	sd.SampleDesc.Count = 1; // Number of multi-samples per pixel
-	sd.SampleDesc.Quality = 0; // The image quality level. Higher quality = lower performance
+	// Count = Number of multi-samples per pixel
+	// Quality = The image quality level. Higher quality = lower performance
+	// When the swap chain uses DXGI_SWAP_EFFECT_DISCARD, the multi-sampled back buffer
+	// Is resolved to a single sample per pixel when it is presented.
+	sd.SampleDesc = GetSampleDescription();
 
-							   // We specify that we use the given surface / resource as output render target
+	// We specify that we use the given surface / resource as output render target
 	sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
 
 	// The amount of buffers in the swap chain.
@@ -278,14 +771,13 @@ void InitializeBackBufferAndDepthStencilView()
 	// Now we need to create the depth/stencil buffer
 	// This is just a 2D texture that stores the depth information
 	D3D11_TEXTURE2D_DESC depthStencilDesc;
-	depthStencilDesc.Width = 640;
-	depthStencilDesc.Height = 480;
+	depthStencilDesc.Width = windowWidth;
+	depthStencilDesc.Height = windowHeight;
 	depthStencilDesc.MipLevels = 1;
 	depthStencilDesc.ArraySize = 1;
 	depthStencilDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
-	// We do not want to use anti-aliasing right now
-	depthStencilDesc.SampleDesc.Count = 1;
-	depthStencilDesc.SampleDesc.Quality = 0;
+	// The depth/stencil buffer must use the same multi-sampling settings as the render target
+	depthStencilDesc.SampleDesc = GetSampleDescription();
 	depthStencilDesc.Usage = D3D11_USAGE_DEFAULT;
 	depthStencilDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
 	depthStencilDesc.CPUAccessFlags = 0;
@@ -323,21 +815,1048 @@ void InitializeBackBufferAndDepthStencilView()
 void InitializeViewport()
 {
 	// We create the viewport
+	// The viewport must match the render target. A viewport larger than the render target
+	// Maps geometry to pixels that don't exist, which only wastes rasterization work
+	// And pushes more triangles outside the clipping guard band.
 	D3D11_VIEWPORT vp;
 	vp.TopLeftX = 0;
 	vp.TopLeftY = 0;
-	vp.Width = static_cast<float>(800);
-	vp.Height = static_cast<float>(600);
+	vp.Width = static_cast<float>(windowWidth);
+	vp.Height = static_cast<float>(windowHeight);
 	vp.MinDepth = 0.0f;
 	vp.MaxDepth = 1.0f;
 
 	direct3dDeviceContext->RSSetViewports(1, &vp);
 }
 
+void InitializeRasterizerState()
+{
+	SDL_Log("Initializing Direct3D rasterizer state...");
+
+	// The rasterizer state configures how primitives are clipped and converted to pixels.
+	// Clipping in homogeneous clip space is performed by the hardware clipper, which uses a guard band
+	// That is much larger than the viewport. Triangles that only cross the left, right, top or bottom
+	// Planes (but stay inside the guard band) are never actually clipped - the rasterizer simply skips
+	// The pixels outside the viewport. Only triangles crossing the near/far planes or leaving the guard band
+	// Are split into new triangles.
+	// Backface culling is also done here, during primitive setup. Triangles whose vertices are ordered
+	// Counter-clockwise on screen face away from the camera and are discarded before rasterization,
+	// Which removes half of the triangles of every closed mesh. Zero-area triangles and triangles
+	// That don't cover any sample centers are likewise discarded by setup and never reach the pixel shader.
+	// To keep cubes close to the camera on this fast path, we must not enable scissoring (which
+	// Would force an extra clip against the scissor rectangle) and we keep depth clipping enabled
+	// So that the near plane rejects geometry behind the camera.
+	D3D11_RASTERIZER_DESC rasterizerDesc;
+	rasterizerDesc.FillMode = D3D11_FILL_SOLID;
+	rasterizerDesc.CullMode = D3D11_CULL_BACK;
+	rasterizerDesc.FrontCounterClockwise = false;
+	rasterizerDesc.DepthBias = 0;
+	rasterizerDesc.DepthBiasClamp = 0.0f;
+	rasterizerDesc.SlopeScaledDepthBias = 0.0f;
+	rasterizerDesc.DepthClipEnable = true;
+	rasterizerDesc.ScissorEnable = false;
+	// Multi-sampled rasterization must be enabled for MSAA render targets to get per-sample coverage
+	rasterizerDesc.MultisampleEnable = mEnable4xMsaa;
+	rasterizerDesc.AntialiasedLineEnable = false;
+
+	const auto rasterizerStateCreationResult =
+		direct3dDevice->CreateRasterizerState(&rasterizerDesc, mRasterizerState.GetAddressOf());
+
+	if (rasterizerStateCreationResult != S_OK)
+		throw Direct3dException("Failed to create rasterizer state. Error Code: "
+			+ std::to_string(rasterizerStateCreationResult));
+
+	direct3dDeviceContext->RSSetState(mRasterizerState.Get());
+}
+
 void InitializeDirect3d(HWND windowHandle)
 {
 	InitializeDeviceAndDeviceContext();
 	InitializeSwapChain(windowHandle);
 	InitializeBackBufferAndDepthStencilView();
 	InitializeViewport();
-}
\ No newline at end of file
+	InitializeRasterizerState();
+}
+
+ComPtr<ID3D11Buffer> CreateConstantBuffer(UINT byteWidth)
+{
+	D3D11_BUFFER_DESC constantBufferDesc;
+	constantBufferDesc.ByteWidth = byteWidth;
+	constantBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	constantBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	constantBufferDesc.CPUAccessFlags = 0;
+	constantBufferDesc.MiscFlags = 0;
+	constantBufferDesc.StructureByteStride = 0;
+
+	ComPtr<ID3D11Buffer> constantBuffer;
+
+	const auto constantBufferCreationResult =
+		direct3dDevice->CreateBuffer(&constantBufferDesc, nullptr, constantBuffer.GetAddressOf());
+
+	if (constantBufferCreationResult != S_OK)
+		throw Direct3dException("Failed to create constant buffer. Error code: "
+			+ std::to_string(constantBufferCreationResult));
+
+	return constantBuffer;
+}
+
+double GetSecondsSince(Uint64 startCounter)
+{
+	return static_cast<double>(SDL_GetPerformanceCounter() - startCounter) / SDL_GetPerformanceFrequency();
+}
+
+double ComputeRootMeanSquareError(const Image& image, const Image& reference)
+{
+	double squaredErrorSum = 0.0;
+
+	for (size_t i = 0; i < reference.Texels.size(); i++)
+	{
+		for (int shift = 0; shift < 32; shift += 8)
+		{
+			const double difference = static_cast<int>(image.Texels[i] >> shift & 0xFF)
+				- static_cast<int>(reference.Texels[i] >> shift & 0xFF);
+			squaredErrorSum += difference * difference;
+		}
+	}
+
+	return std::sqrt(squaredErrorSum / (reference.Texels.size() * 4));
+}
+
+// Compresses a mip chain and logs the encode and decode throughput, the compression ratio and the error of the top level
+TextureData CompressAndMeasure(const std::vector<Image>& mipChain, DXGI_FORMAT format, const char* formatName)
+{
+	const auto encodeStart = SDL_GetPerformanceCounter();
+	const auto textureData = CompressMipChain(mipChain, format);
+	const auto encodeSeconds = GetSecondsSince(encodeStart);
+
+	const auto decodeStart = SDL_GetPerformanceCounter();
+	auto decodedTopLevel = DecompressLevel(textureData.Levels[0], format);
+	const auto decodeSeconds = GetSecondsSince(decodeStart);
+
+	auto reference = mipChain[0];
+
+	// BC1 has no alpha channel
+	if (format == DXGI_FORMAT_BC1_UNORM)
+	{
+		for (auto& texel : reference.Texels)
+			texel |= 0xFF000000;
+	}
+
+	size_t texelCount = 0;
+	for (const auto& mip : mipChain)
+		texelCount += mip.Texels.size();
+
+	SDL_Log("%s: %.1f:1, encode: %.1f Mtexels/s, decode: %.1f Mtexels/s, RMSE: %.2f",
+		formatName,
+		static_cast<double>(texelCount * sizeof(uint32_t)) / textureData.GetSizeInBytes(),
+		texelCount / encodeSeconds / 1000000.0,
+		reference.Texels.size() / decodeSeconds / 1000000.0,
+		ComputeRootMeanSquareError(decodedTopLevel, reference));
+
+	return textureData;
+}
+
+TextureData CreateCheckerTextureData()
+{
+	const auto checker = CreateCheckerImage(512, 8, PackTexel(255, 255, 255, 255), PackTexel(64, 64, 64, 255));
+
+	const auto mipGenerationStart = SDL_GetPerformanceCounter();
+	const auto mipChain = GenerateMipChain(checker);
+	const auto mipGenerationSeconds = GetSecondsSince(mipGenerationStart);
+
+	SDL_Log("Generated %u mip levels in %.3f ms (%.1f Mtexels/s)",
+		static_cast<unsigned int>(mipChain.size()),
+		mipGenerationSeconds * 1000.0,
+		checker.Texels.size() / mipGenerationSeconds / 1000000.0);
+
+	// The checkerboard is opaque, so BC1 is used. BC3 is only measured for comparison.
+	CompressAndMeasure(mipChain, DXGI_FORMAT_BC3_UNORM, "BC3");
+	return CompressAndMeasure(mipChain, DXGI_FORMAT_BC1_UNORM, "BC1");
+}
+
+// A single grey texel, shown until the real texture has been loaded
+TextureData CreatePlaceholderTextureData()
+{
+	TextureLevel level;
+	level.Width = 1;
+	level.Height = 1;
+	level.RowPitch = sizeof(uint32_t);
+	level.Data = { 128, 128, 128, 255 };
+
+	TextureData textureData;
+	textureData.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	textureData.Levels.push_back(std::move(level));
+
+	return textureData;
+}
+
+// Loads the cube texture in the background and swaps it in for the placeholder when it is done.
+// A load that is still running is cancelled.
+void LoadCubeTexture()
+{
+	// Only the headers of a DDS file authored offline are read on the I/O thread and parsed on a worker. The texture
+	// Streamer then reads the levels from disk as they are needed, so the finest levels are only in memory while the
+	// Cube is close enough to use them.
+	// Without a file, a block compressed checkerboard is generated on a worker instead and streamed from memory.
+	const std::wstring cubeTextureFileName = L"Assets/CubeTexture.dds";
+
+	std::function<TextureSource(std::vector<uint8_t>&)> createSource;
+
+	AssetLoadRequest request = {};
+	request.Priority = LoadPriority::High;
+
+	if (std::ifstream(cubeTextureFileName).good())
+	{
+		request.FileName = cubeTextureFileName;
+		request.MaxReadSize = MaxDdsHeadersSize;
+		createSource = [cubeTextureFileName](std::vector<uint8_t>& headerData)
+		{
+			return CreateDdsTextureSource(cubeTextureFileName, ParseDdsDescription(headerData.data(), headerData.size()));
+		};
+	}
+	else
+	{
+		createSource = [](std::vector<uint8_t>&)
+		{
+			return CreateMemoryTextureSource(std::make_shared<const TextureData>(CreateCheckerTextureData()));
+		};
+	}
+
+	// The completion replaces the placeholder on the main thread
+	request.Decode = [createSource](std::vector<uint8_t>& fileData) -> std::function<void()>
+	{
+		const auto source = createSource(fileData);
+
+		return [source]()
+		{
+			mTextureStreamer->ReplaceTexture(mCubeTextureHandle, source);
+
+			SDL_Log("Cube texture loaded. Format: %d, %ux%u, %u mip levels",
+				static_cast<int>(source.Description.Format),
+				source.Description.Width,
+				source.Description.Height,
+				source.Description.LevelCount);
+		};
+	};
+
+	request.Failed = [](const std::string& error)
+	{
+		SDL_Log("Failed to load the cube texture, keeping the placeholder: %s", error.c_str());
+	};
+
+	mAssetLoader->Cancel(mCubeTextureLoad);
+	mCubeTextureLoad = mAssetLoader->Load(std::move(request));
+}
+
+// Gently rolling hills of stone, covered by a few layers of dirt and a layer of grass
+int GetVoxelTerrainHeight(int x, int z)
+{
+	const auto height = 24.0f
+		+ 8.0f * std::sin(x * 0.05f) * std::cos(z * 0.07f)
+		+ 3.0f * std::sin(x * 0.21f + z * 0.13f);
+
+	return static_cast<int>(height);
+}
+
+void ReportVoxelMeshingStatistics(const char* description)
+{
+	const auto& statistics = mVoxelMeshingStatistics;
+
+	SDL_Log("%s - %u chunks, %.3f ms per chunk (longest %.3f ms), triangles per chunk: %.0f, per-face meshing: %.0f (%.1fx more)",
+		description,
+		statistics.MeshedChunks,
+		statistics.TotalSeconds * 1000.0 / statistics.MeshedChunks,
+		statistics.LongestSeconds * 1000.0,
+		static_cast<double>(statistics.Triangles) / statistics.MeshedChunks,
+		static_cast<double>(statistics.NaiveTriangles) / statistics.MeshedChunks,
+		statistics.Triangles > 0 ? static_cast<double>(statistics.NaiveTriangles) / statistics.Triangles : 1.0);
+
+	mVoxelMeshingStatistics = {};
+}
+
+// Meshes the dirty chunks on the worker threads and replaces their GPU meshes
+void RemeshDirtyVoxelChunks()
+{
+	const auto chunkMeshes = MeshDirtyVoxelChunks(*mVoxelWorld, *mJobSystem);
+
+	for (const auto& chunkMesh : chunkMeshes)
+	{
+		auto& statistics = mVoxelMeshingStatistics;
+		statistics.MeshedChunks++;
+		statistics.TotalSeconds += chunkMesh.MeshingSeconds;
+		statistics.LongestSeconds = std::max(statistics.LongestSeconds, chunkMesh.MeshingSeconds);
+		statistics.Triangles += chunkMesh.Geometry.GetTriangleCount();
+		statistics.NaiveTriangles += chunkMesh.NaiveTriangleCount;
+
+		auto& gpuMesh = mVoxelChunkMeshes[chunkMesh.ChunkIndex];
+
+		if (chunkMesh.Geometry.Indices.empty())
+		{
+			gpuMesh.Geometry.reset();
+			continue;
+		}
+
+		const auto quantizedChunk = QuantizeMesh(chunkMesh.Geometry);
+
+		gpuMesh.Geometry = std::make_unique<GpuMesh>(direct3dDevice.Get(), quantizedChunk.Geometry);
+
+		if (!gpuMesh.PerMeshConstantBuffer)
+			gpuMesh.PerMeshConstantBuffer = CreateConstantBuffer(sizeof(PerMeshConstants));
+
+		const auto& positionScale = quantizedChunk.PositionScale;
+		const auto& positionOffset = quantizedChunk.PositionOffset;
+
+		PerMeshConstants perMeshConstants = {};
+		perMeshConstants.PositionScale = XMFLOAT4(positionScale.x, positionScale.y, positionScale.z, 0.0f);
+		perMeshConstants.PositionOffset = XMFLOAT4(positionOffset.x, positionOffset.y, positionOffset.z, 0.0f);
+		perMeshConstants.Use16BitIndices = gpuMesh.Geometry->GetIndexFormat() == DXGI_FORMAT_R16_UINT;
+
+		direct3dDeviceContext->UpdateSubresource(gpuMesh.PerMeshConstantBuffer.Get(), 0, nullptr, &perMeshConstants, 0, 0);
+	}
+}
+
+void InitializeVoxelWorld()
+{
+	mVoxelWorld = std::make_unique<VoxelWorld>(voxelWorldChunkCountX, voxelWorldChunkCountY, voxelWorldChunkCountZ);
+
+	const auto chunkCount = mVoxelWorld->GetChunkCount();
+
+	// Every chunk is filled by its own job. Writing to the chunks directly bypasses the dirty tracking,
+	// So all chunks are marked dirty afterwards.
+	const auto generationStartCounter = SDL_GetPerformanceCounter();
+
+	mJobSystem->ParallelFor(chunkCount, 1, [](size_t begin, size_t end)
+	{
+		for (auto i = begin; i < end; i++)
+		{
+			auto& chunk = mVoxelWorld->GetChunk(static_cast<uint32_t>(i));
+			const auto coordinates = mVoxelWorld->GetChunkCoordinates(static_cast<uint32_t>(i));
+
+			for (int z = 0; z < VoxelChunkSize; z++)
+			{
+				for (int x = 0; x < VoxelChunkSize; x++)
+				{
+					// Height of the surface above the bottom of the chunk
+					const auto height = GetVoxelTerrainHeight(
+						coordinates.X * VoxelChunkSize + x,
+						coordinates.Z * VoxelChunkSize + z) - coordinates.Y * VoxelChunkSize;
+
+					for (int y = 0; y < VoxelChunkSize && y <= height; y++)
+						chunk.Set(x, y, z, y == height ? grassVoxel : y > height - 4 ? dirtVoxel : stoneVoxel);
+				}
+			}
+		}
+	});
+
+	mVoxelWorld->MarkAllChunksDirty();
+
+	size_t memoryUsage = 0;
+	for (uint32_t i = 0; i < chunkCount; i++)
+		memoryUsage += mVoxelWorld->GetChunk(i).GetMemoryUsage();
+
+	SDL_Log("Voxel terrain generated in %.3f ms. %u chunks, %u KB palette compressed, %u KB uncompressed",
+		GetSecondsSince(generationStartCounter) * 1000.0,
+		chunkCount,
+		static_cast<unsigned int>(memoryUsage / 1024),
+		static_cast<unsigned int>(chunkCount * VoxelChunkVolume * sizeof(VoxelType) / 1024));
+
+	// The chunks never move. Their meshes are in voxels, so the world matrices scale them to voxelSize
+	// And center the terrain below the camera's focus.
+	std::vector<XMFLOAT4X4> chunkWorldMatrices(chunkCount);
+
+	for (uint32_t i = 0; i < chunkCount; i++)
+	{
+		const auto coordinates = mVoxelWorld->GetChunkCoordinates(i);
+		const auto translation = XMMatrixTranslation(
+			(coordinates.X * VoxelChunkSize - mVoxelWorld->GetSizeX() / 2) * voxelSize,
+			(coordinates.Y * VoxelChunkSize - 24) * voxelSize,
+			(coordinates.Z * VoxelChunkSize - mVoxelWorld->GetSizeZ() / 2) * voxelSize);
+
+		XMStoreFloat4x4(&chunkWorldMatrices[i], XMMatrixTranspose(XMMatrixScaling(voxelSize, voxelSize, voxelSize) * translation));
+	}
+
+	mVoxelChunkInstanceBuffer = std::make_unique<InstanceBuffer>(direct3dDevice.Get(), chunkCount);
+	mVoxelChunkInstanceBuffer->Update(direct3dDeviceContext.Get(), chunkWorldMatrices.data(), chunkCount);
+
+	mVoxelChunkMeshes.resize(chunkCount);
+
+	const auto meshingStartCounter = SDL_GetPerformanceCounter();
+	RemeshDirtyVoxelChunks();
+
+	SDL_Log("Voxel terrain meshed in %.3f ms on %u threads",
+		GetSecondsSince(meshingStartCounter) * 1000.0,
+		mJobSystem->GetThreadCount());
+
+	ReportVoxelMeshingStatistics("Voxel meshing");
+}
+
+// The cubes spin around their own centers, slightly out of phase with their neighbours.
+// Their transforms are relative to the layer of the field they are in.
+void CreateCubeEntities()
+{
+	mEntities = std::make_unique<EntityManager>();
+	mTransformHierarchy = std::make_unique<TransformHierarchy>();
+
+	for (int y = 0; y < cubeFieldHeight; y++)
+	{
+		TransformComponent layerTransform = {};
+		layerTransform.Position = XMFLOAT3(0.0f, (y - (cubeFieldHeight - 1) * 0.5f) * cubeSpacing, 0.0f);
+		layerTransform.Scale = 1.0f;
+		layerTransform.Rotation = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+
+		mCubeLayerNodes.push_back(mTransformHierarchy->AddNode(NoTransformNode, layerTransform));
+		mCubeLayerAngles.push_back(0.0f);
+	}
+
+	mEntities->CreateEntities<
+		TransformComponent,
+		AngularVelocityComponent,
+		TransformNodeComponent,
+		RenderMeshComponent,
+		BoundsComponent,
+		RigidBodyComponent>(cubeCount);
+
+	mEntities->ForEachChunk<TransformComponent, AngularVelocityComponent, TransformNodeComponent, BoundsComponent>(
+		[](size_t firstIndex,
+			size_t count,
+			TransformComponent* transforms,
+			AngularVelocityComponent* angularVelocities,
+			TransformNodeComponent* nodes,
+			BoundsComponent* bounds)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			const auto index = static_cast<int>(firstIndex + i);
+			const auto x = index % cubeFieldWidth;
+			const auto z = index / cubeFieldWidth % cubeFieldDepth;
+			const auto y = index / (cubeFieldWidth * cubeFieldDepth);
+
+			auto& transform = transforms[i];
+			transform.Position = XMFLOAT3(
+				(x - (cubeFieldWidth - 1) * 0.5f) * cubeSpacing,
+				0.0f,
+				(z - (cubeFieldDepth - 1) * 0.5f) * cubeSpacing);
+			transform.Scale = 1.0f;
+
+			const auto angle = index * 0.1f;
+			XMStoreFloat4(&transform.Rotation,
+				XMQuaternionRotationMatrix(XMMatrixRotationY(angle) * XMMatrixRotationX(angle * 0.5f)));
+
+			// Around the vertical axis, tumbling forward at half that speed
+			angularVelocities[i].Angular = XMFLOAT3(0.5f, 1.0f, 0.0f);
+
+			nodes[i].Node = mTransformHierarchy->AddNode(mCubeLayerNodes[y], transform);
+
+			// The center follows the world matrix
+			bounds[i].Radius = cubeHalfExtent * 1.7321f;
+		}
+	});
+}
+
+// Gives every cube a body. They are dropped in layers onto the floor, slightly tilted and every other layer offset by
+// Half a cube, so they land on edges and corners and tumble instead of stacking neatly.
+void StartCubePhysics()
+{
+	mCubePhysics = std::make_unique<RigidBodyWorld>();
+	mCubePhysicsTimeAccumulator = 0.0f;
+
+	// Wide enough for the cubes that tumble off the edge of the pile
+	const auto floorHalfSize = std::max(cubeFieldWidth, cubeFieldDepth) * physicsCubeSpacing;
+
+	RigidBodyDescription floor = {};
+	floor.Position = XMFLOAT3(0.0f, physicsFloorHeight - 1.0f, 0.0f);
+	floor.Rotation = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+	floor.HalfExtents = XMFLOAT3(floorHalfSize, 1.0f, floorHalfSize);
+	mCubePhysics->AddBox(floor);
+
+	mEntities->ForEachChunk<RigidBodyComponent>([](size_t firstIndex, size_t count, RigidBodyComponent* bodies)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			const auto index = static_cast<int>(firstIndex + i);
+			const auto x = index % cubeFieldWidth;
+			const auto z = index / cubeFieldWidth % cubeFieldDepth;
+			const auto y = index / (cubeFieldWidth * cubeFieldDepth);
+			const auto offset = y % 2 == 0 ? 0.0f : physicsCubeSpacing * 0.5f;
+
+			RigidBodyDescription cube = {};
+			cube.Position = XMFLOAT3(
+				(x - (cubeFieldWidth - 1) * 0.5f) * physicsCubeSpacing + offset,
+				physicsFloorHeight + cubeHalfExtent + (y + 1) * physicsCubeSpacing,
+				(z - (cubeFieldDepth - 1) * 0.5f) * physicsCubeSpacing + offset);
+			XMStoreFloat4(&cube.Rotation,
+				XMQuaternionRotationRollPitchYaw(0.08f * std::sin(index * 1.7f), 0.0f, 0.08f * std::cos(index * 1.7f)));
+			cube.HalfExtents = XMFLOAT3(cubeHalfExtent, cubeHalfExtent, cubeHalfExtent);
+			cube.Mass = 1.0f;
+
+			bodies[i].Body = mCubePhysics->AddBox(cube);
+		}
+	});
+}
+
+// The physics always steps by physicsStepTime, however long the frame took, so it behaves the same at any frame rate
+void StepCubePhysics(float deltaTime)
+{
+	mCubePhysicsTimeAccumulator += deltaTime;
+
+	while (mCubePhysicsTimeAccumulator >= physicsStepTime)
+	{
+		mCubePhysics->Step(physicsStepTime, *mJobSystem);
+		mCubePhysicsTimeAccumulator -= physicsStepTime;
+	}
+}
+
+void InitializeScene()
+{
+	// Compiled shader byte code is kept in the ShaderCache directory between runs
+	mShaderCache = std::make_shared<ShaderCache>(L"ShaderCache");
+
+	// Pipeline permutations of the cube shader are created on demand, for QuantizedVertex input
+	const auto inputElements = VertexLayout<QuantizedVertex>::Attributes::GetInputElements();
+
+	mCubePipelineStateCache = std::make_unique<PipelineStateCache>(
+		direct3dDevice.Get(),
+		L"Shaders/Cube.hlsl",
+		inputElements.data(),
+		static_cast<UINT>(inputElements.size()),
+		mShaderCache,
+		*mJobSystem);
+
+	// Every other permutation falls back to the generic one, so it must work. Creating it here lets a failure stop
+	// The initialization instead of the render loop.
+	auto genericCubePipelineDescription = mCubePipelineDescription;
+	genericCubePipelineDescription.Generic = true;
+	mCubePipelineStateCache->GetPipelineState(genericCubePipelineDescription);
+
+	mVisibilityBuffer = std::make_unique<VisibilityBuffer>(
+		direct3dDevice.Get(),
+		*mShaderCache,
+		windowWidth,
+		windowHeight);
+
+	// Constant buffers. Their sizes must be multiples of 16 bytes.
+	mPerMeshConstantBuffer = CreateConstantBuffer(sizeof(PerMeshConstants));
+	mPerFrameConstantBuffer = CreateConstantBuffer(sizeof(PerFrameConstants));
+
+	// The world matrices of all cubes are recomputed every frame
+	mCubeInstanceBuffer = std::make_unique<InstanceBuffer>(direct3dDevice.Get(), cubeCount);
+	mCubeWorldMatrices.resize(cubeCount);
+	mCubeInstanceWorldMatrices.resize(cubeCount);
+	CreateCubeEntities();
+
+	// Built by the first update, and refit by every one after it
+	mCubeBounds.resize(cubeCount);
+	mCubeBoundingVolumeHierarchy = std::make_unique<BoundingVolumeHierarchy>();
+	XMStoreFloat4x4(&mLastViewProjection, XMMatrixIdentity());
+
+	// The asset container is mapped, not read. Only the pages of the assets that are actually used get loaded.
+	if (std::ifstream(sceneAssetFileName).good())
+	{
+		const auto mappingStartCounter = SDL_GetPerformanceCounter();
+		mSceneAssets = std::make_shared<const AssetContainer>(sceneAssetFileName);
+
+		SDL_Log("Asset container mapped in %.3f ms. %u meshes, %u textures, %u KB",
+			GetSecondsSince(mappingStartCounter) * 1000.0,
+			mSceneAssets->GetMeshCount(),
+			mSceneAssets->GetTextureCount(),
+			static_cast<unsigned int>(mSceneAssets->GetFileSize() / 1024));
+	}
+
+	// The cube mesh
+	XMFLOAT3 positionScale;
+	XMFLOAT3 positionOffset;
+	const auto cubeMeshAsset = mSceneAssets ? mSceneAssets->FindMesh("Cube") : -1;
+
+	if (cubeMeshAsset >= 0)
+	{
+		// Converted meshes are already optimized and quantized, and Direct3D copies them straight out of the mapping
+		const auto uploadStartCounter = SDL_GetPerformanceCounter();
+		const auto cube = mSceneAssets->GetMesh(cubeMeshAsset);
+
+		mCubeMesh = std::make_unique<GpuMesh>(
+			direct3dDevice.Get(),
+			cube.Vertices,
+			cube.VertexCount,
+			static_cast<UINT>(sizeof(QuantizedVertex)),
+			cube.Indices,
+			cube.IndexCount,
+			cube.IndexFormat,
+			cube.Lods,
+			cube.LodCount);
+
+		positionScale = cube.PositionScale;
+		positionOffset = cube.PositionOffset;
+
+		// Meshlets are built by the converter, containers written before that have none
+		if (cube.MeshletCount > 0)
+		{
+			mCubeClusterCuller = std::make_unique<ClusterCuller>(
+				direct3dDevice.Get(),
+				*mShaderCache,
+				cube.Meshlets,
+				cube.MeshletCount,
+				cubeCount,
+				windowWidth,
+				windowHeight);
+		}
+
+		SDL_Log("Cube mesh uploaded from the asset container in %.3f ms. %u vertices, %u triangles, %u meshlets, %u LODs",
+			GetSecondsSince(uploadStartCounter) * 1000.0,
+			cube.VertexCount,
+			mCubeMesh->GetLods()[0].IndexCount / 3,
+			cube.MeshletCount,
+			mCubeMesh->GetLodCount());
+	}
+	else
+	{
+		// Every mesh is optimized for the post-transform vertex cache and vertex fetch before it is uploaded
+		auto cube = CreateCubeMeshWithNormals(cubeHalfExtent, cubeSubdivisions);
+		const auto optimizationReport = OptimizeMesh(cube);
+
+		SDL_Log("Cube mesh optimized. ACMR before: %.3f, after: %.3f",
+			optimizationReport.AcmrBefore,
+			optimizationReport.AcmrAfter);
+
+		// Splitting into meshlets reorders the triangles, so it happens before the index buffer is uploaded
+		const auto meshlets = BuildMeshlets(cube);
+
+		SDL_Log("Cube mesh split into %u meshlets", static_cast<unsigned int>(meshlets.size()));
+
+		// The levels of detail go behind level 0 in the index buffer, so the meshlets stay valid
+		const auto lods = GenerateMeshLods(cube);
+
+		for (size_t i = 0; i < lods.size(); i++)
+		{
+			SDL_Log("Cube mesh LOD %u: %u triangles, error %.5f",
+				static_cast<unsigned int>(i),
+				lods[i].IndexCount / 3,
+				lods[i].Error);
+		}
+
+		// Meshes are quantized to 16 bytes per vertex before they are uploaded, which halves vertex fetch bandwidth
+		const auto quantizedCube = QuantizeMesh(cube);
+
+		SDL_Log("Cube mesh quantized. Vertex size: %u bytes, was %u bytes",
+			static_cast<unsigned int>(sizeof(QuantizedVertex)),
+			static_cast<unsigned int>(sizeof(VertexWithPositionNormalTexture)));
+
+		mCubeMesh = std::make_unique<GpuMesh>(direct3dDevice.Get(), quantizedCube.Geometry, lods);
+
+		mCubeClusterCuller = std::make_unique<ClusterCuller>(
+			direct3dDevice.Get(),
+			*mShaderCache,
+			meshlets.data(),
+			static_cast<UINT>(meshlets.size()),
+			cubeCount,
+			windowWidth,
+			windowHeight);
+
+		positionScale = quantizedCube.PositionScale;
+		positionOffset = quantizedCube.PositionOffset;
+	}
+
+	// The cube texture
+	// A texture in the asset container is already in memory as far as we are concerned, so it is streamed right away.
+	// Otherwise the cube shows a placeholder until the real texture has been loaded in the background.
+	mTextureStreamer = std::make_unique<TextureStreamer>(direct3dDevice.Get(), *mJobSystem, textureStreamingBudget);
+
+	const auto cubeTextureAsset = mSceneAssets ? mSceneAssets->FindTexture("CubeTexture") : -1;
+
+	if (cubeTextureAsset >= 0)
+	{
+		mCubeTextureHandle = mTextureStreamer->AddTexture(CreateAssetTextureSource(mSceneAssets, cubeTextureAsset));
+	}
+	else
+	{
+		mCubeTextureHandle = mTextureStreamer->AddTexture(
+			CreateMemoryTextureSource(std::make_shared<const TextureData>(CreatePlaceholderTextureData())));
+
+		LoadCubeTexture();
+	}
+
+	// Trilinear filtering blends between the two closest mip levels, so there are no visible seams where the level changes
+	D3D11_SAMPLER_DESC samplerDesc = {};
+	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+	samplerDesc.MipLODBias = 0.0f;
+	samplerDesc.MaxAnisotropy = 1;
+	samplerDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+	samplerDesc.MinLOD = 0.0f;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+
+	const auto samplerStateCreationResult =
+		direct3dDevice->CreateSamplerState(&samplerDesc, mTrilinearSampler.GetAddressOf());
+
+	if (samplerStateCreationResult != S_OK)
+		throw Direct3dException("Failed to create sampler state. Error code: "
+			+ std::to_string(samplerStateCreationResult));
+
+	// The per mesh constants never change
+	PerMeshConstants perMeshConstants = {};
+	perMeshConstants.PositionScale = XMFLOAT4(positionScale.x, positionScale.y, positionScale.z, 0.0f);
+	perMeshConstants.PositionOffset = XMFLOAT4(positionOffset.x, positionOffset.y, positionOffset.z, 0.0f);
+	perMeshConstants.Use16BitIndices = mCubeMesh->GetIndexFormat() == DXGI_FORMAT_R16_UINT;
+
+	direct3dDeviceContext->UpdateSubresource(mPerMeshConstantBuffer.Get(), 0, nullptr, &perMeshConstants, 0, 0);
+
+	InitializeVoxelWorld();
+}
+
+void HandleKeyDown(SDL_Keycode key)
+{
+	switch (key)
+	{
+	case SDLK_F1:
+		mCubePipelineDescription.ShaderFeatures ^= ShaderFeatureLighting;
+		break;
+	case SDLK_F2:
+		mCubePipelineDescription.ShaderFeatures ^= ShaderFeatureSpecular;
+		break;
+	case SDLK_F3:
+		mCubePipelineDescription.Generic = !mCubePipelineDescription.Generic;
+		break;
+	case SDLK_F4:
+		mUseVisibilityBuffer = !mUseVisibilityBuffer;
+		SDL_Log("Rendering mode: %s", mUseVisibilityBuffer ? "visibility buffer" : "forward");
+		break;
+	case SDLK_F5:
+		mCubePipelineDescription.ShaderFeatures ^= ShaderFeatureTexture;
+		break;
+	case SDLK_F6:
+		mUseClusterCulling = !mUseClusterCulling;
+		SDL_Log("Cluster culling: %s", mUseClusterCulling ? "on" : "off");
+		break;
+	case SDLK_F7:
+		mUseLods = !mUseLods;
+		SDL_Log("Level of detail selection: %s", mUseLods ? "on" : "off");
+		break;
+	case SDLK_F8:
+		mShowVoxelWorld = !mShowVoxelWorld;
+		SDL_Log("Scene: %s", mShowVoxelWorld ? "voxel terrain" : "cube field");
+		break;
+	case SDLK_F9:
+		mRotateCubeLayers = !mRotateCubeLayers;
+		SDL_Log("Cube layer rotation: %s", mRotateCubeLayers ? "on" : "off");
+		break;
+	case SDLK_F10:
+		mSpinCubes = !mSpinCubes;
+		SDL_Log("Cube spin: %s", mSpinCubes ? "on" : "off");
+		break;
+	case SDLK_F11:
+		mSimulateCubePhysics = !mSimulateCubePhysics;
+
+		if (mSimulateCubePhysics)
+			StartCubePhysics();
+		else
+			mCubePhysics.reset();
+
+		SDL_Log("Cube physics: %s", mSimulateCubePhysics ? "on" : "off");
+		break;
+	case SDLK_UP:
+		mCameraDistanceScale = std::max(mCameraDistanceScale * 0.9f, 0.4f);
+		break;
+	case SDLK_DOWN:
+		mCameraDistanceScale = std::min(mCameraDistanceScale * 1.1f, 2.0f);
+		break;
+	default:
+		break;
+	}
+}
+
+// Logs the cube whose bounds are under the mouse, if there is one
+void PickCube(int x, int y)
+{
+	// The mouse position in normalized device coordinates, on the near and on the far plane
+	const auto deviceX = 2.0f * x / windowWidth - 1.0f;
+	const auto deviceY = 1.0f - 2.0f * y / windowHeight;
+
+	const auto inverseViewProjection = XMMatrixInverse(nullptr, XMLoadFloat4x4(&mLastViewProjection));
+	const auto nearPoint = XMVector3TransformCoord(XMVectorSet(deviceX, deviceY, 0.0f, 1.0f), inverseViewProjection);
+	const auto farPoint = XMVector3TransformCoord(XMVectorSet(deviceX, deviceY, 1.0f, 1.0f), inverseViewProjection);
+
+	// Hit distances are fractions of the way from the near plane to the far plane
+	Ray ray;
+	XMStoreFloat3(&ray.Origin, nearPoint);
+	XMStoreFloat3(&ray.Direction, XMVectorSubtract(farPoint, nearPoint));
+	ray.MaxDistance = 1.0f;
+
+	float hitDistance;
+	const auto cube = mCubeBoundingVolumeHierarchy->IntersectRay(ray, hitDistance);
+
+	if (cube == NoBvhInstance)
+	{
+		SDL_Log("Picked no cube");
+		return;
+	}
+
+	SDL_Log("Picked cube %u, %.2f units past the near plane",
+		cube,
+		hitDistance * XMVectorGetX(XMVector3Length(XMVectorSubtract(farPoint, nearPoint))));
+}
+
+void UpdateCubeEntities(float deltaTime, FXMVECTOR eyePosition, float projectionScale)
+{
+	// The bodies move the cubes instead of the transform hierarchy, which keeps the cubes' old transforms meanwhile
+	if (mSimulateCubePhysics)
+		StepCubePhysics(deltaTime);
+
+	if (mSpinCubes && !mSimulateCubePhysics)
+	{
+		IntegrateAngularVelocities(*mEntities, *mJobSystem, deltaTime);
+		CopyTransformsToHierarchy(*mEntities, *mJobSystem, *mTransformHierarchy);
+	}
+
+	// Neighbouring layers turn in opposite directions
+	if (mRotateCubeLayers && !mSimulateCubePhysics)
+	{
+		for (size_t layer = 0; layer < mCubeLayerNodes.size(); layer++)
+		{
+			mCubeLayerAngles[layer] += deltaTime * (layer % 2 == 0 ? 0.2f : -0.2f);
+
+			auto layerTransform = mTransformHierarchy->GetLocalTransform(mCubeLayerNodes[layer]);
+			XMStoreFloat4(&layerTransform.Rotation, XMQuaternionRotationRollPitchYaw(0.0f, mCubeLayerAngles[layer], 0.0f));
+
+			mTransformHierarchy->SetLocalTransform(mCubeLayerNodes[layer], layerTransform);
+		}
+	}
+
+	mTransformHierarchy->UpdateWorldMatrices(*mJobSystem);
+
+	const auto lodCount = mUseLods ? mCubeMesh->GetLodCount() : 1;
+
+	mEntities->ForEachChunk<TransformNodeComponent, BoundsComponent, RenderMeshComponent, RigidBodyComponent>(*mJobSystem,
+		[=](size_t firstIndex,
+			size_t count,
+			TransformNodeComponent* nodes,
+			BoundsComponent* bounds,
+			RenderMeshComponent* renderMeshes,
+			RigidBodyComponent* bodies)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			const auto world = mSimulateCubePhysics
+				? mCubePhysics->GetWorldMatrix(bodies[i].Body)
+				: XMLoadFloat4x4(&mTransformHierarchy->GetWorldMatrix(nodes[i].Node));
+
+			// HLSL expects column major matrices by default, so we transpose before uploading
+			XMStoreFloat4x4(&mCubeWorldMatrices[firstIndex + i], XMMatrixTranspose(world));
+			XMStoreFloat3(&bounds[i].Center, world.r[3]);
+
+			const auto radius = XMVectorReplicate(bounds[i].Radius);
+			XMStoreFloat3(&mCubeBounds[firstIndex + i].Minimum, XMVectorSubtract(world.r[3], radius));
+			XMStoreFloat3(&mCubeBounds[firstIndex + i].Maximum, XMVectorAdd(world.r[3], radius));
+
+			// The level is chosen for the closest point of the cube's bounding sphere
+			const auto distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&bounds[i].Center), eyePosition)))
+				- bounds[i].Radius;
+			renderMeshes[i].Lod = SelectMeshLod(mCubeMesh->GetLods(), lodCount, distance, projectionScale, maxLodPixelError);
+		}
+	});
+
+	mCubeBoundingVolumeHierarchy->Update(mCubeBounds.data(), mCubeBounds.size(), *mJobSystem);
+
+	// The instances are grouped by level, so every level is drawn with a single draw call.
+	// Within a level they keep their order, which changes only when a cube switches levels.
+	mCubeLodBatches.assign(lodCount, MeshLodBatch{ 0, 0, 0 });
+
+	// Same query as above, so firstIndex numbers the cubes the same way
+	mEntities->ForEachChunk<TransformNodeComponent, BoundsComponent, RenderMeshComponent, RigidBodyComponent>(
+		[](size_t, size_t count, TransformNodeComponent*, BoundsComponent*, RenderMeshComponent* renderMeshes, RigidBodyComponent*)
+	{
+		for (size_t i = 0; i < count; i++)
+			mCubeLodBatches[renderMeshes[i].Lod].InstanceCount++;
+	});
+
+	for (uint32_t lod = 0; lod < lodCount; lod++)
+	{
+		mCubeLodBatches[lod].Lod = lod;
+		mCubeLodBatches[lod].FirstInstance = lod > 0
+			? mCubeLodBatches[lod - 1].FirstInstance + mCubeLodBatches[lod - 1].InstanceCount
+			: 0;
+	}
+
+	std::vector<uint32_t> nextInstance(lodCount);
+	for (uint32_t lod = 0; lod < lodCount; lod++)
+		nextInstance[lod] = mCubeLodBatches[lod].FirstInstance;
+
+	mEntities->ForEachChunk<TransformNodeComponent, BoundsComponent, RenderMeshComponent, RigidBodyComponent>(
+		[&](size_t firstIndex, size_t count, TransformNodeComponent*, BoundsComponent*, RenderMeshComponent* renderMeshes, RigidBodyComponent*)
+	{
+		for (size_t i = 0; i < count; i++)
+			mCubeInstanceWorldMatrices[nextInstance[renderMeshes[i].Lod]++] = mCubeWorldMatrices[firstIndex + i];
+	});
+}
+
+// Returns the finest mip level of the cube texture that the closest cube can show
+uint32_t GetRequiredCubeTextureLevel(FXMVECTOR eyePosition, float verticalFieldOfView)
+{
+	// Closest point of the bounds of the cube field. The rotating cubes reach out to their corners.
+	const auto cornerDistance = cubeHalfExtent * 1.7321f;
+	const auto fieldBounds = XMVectorSet(
+		(cubeFieldWidth - 1) * 0.5f * cubeSpacing + cornerDistance,
+		(cubeFieldHeight - 1) * 0.5f * cubeSpacing + cornerDistance,
+		(cubeFieldDepth - 1) * 0.5f * cubeSpacing + cornerDistance,
+		0.0f);
+	const auto closestPoint = XMVectorClamp(eyePosition, XMVectorNegate(fieldBounds), fieldBounds);
+	const auto distance = std::max(XMVectorGetX(XMVector3Length(XMVectorSubtract(eyePosition, closestPoint))), 0.1f);
+
+	// The texture covers one face of a cube. The level whose size matches the face's size on screen is needed.
+	const auto facePixels = 2.0f * cubeHalfExtent * windowHeight / (2.0f * std::tan(verticalFieldOfView * 0.5f) * distance);
+	const auto textureSize = static_cast<float>(mTextureStreamer->GetDescription(mCubeTextureHandle).Width);
+	const auto level = std::floor(std::log2(textureSize / facePixels));
+
+	return level > 0.0f ? static_cast<uint32_t>(level) : 0;
+}
+
+// Moves the ball along a circle over the terrain. Only the chunks the ball enters or leaves become dirty.
+void UpdateVoxelBall(float totalTimeInSeconds)
+{
+	const auto angle = totalTimeInSeconds * 0.4f;
+	const XMINT3 center(
+		mVoxelWorld->GetSizeX() / 2 + static_cast<int>(std::cos(angle) * mVoxelWorld->GetSizeX() * 0.375f),
+		mVoxelWorld->GetSizeY() * 3 / 4,
+		mVoxelWorld->GetSizeZ() / 2 + static_cast<int>(std::sin(angle) * mVoxelWorld->GetSizeZ() * 0.375f));
+
+	if (mVoxelBallPlaced && center.x == mVoxelBallCenter.x && center.y == mVoxelBallCenter.y && center.z == mVoxelBallCenter.z)
+		return;
+
+	// Replaces the voxels of the sphere that have the type from, so the ball never eats into the terrain
+	const auto replaceSphere = [](const XMINT3& sphereCenter, VoxelType from, VoxelType to)
+	{
+		for (int z = -voxelBallRadius; z <= voxelBallRadius; z++)
+		{
+			for (int y = -voxelBallRadius; y <= voxelBallRadius; y++)
+			{
+				for (int x = -voxelBallRadius; x <= voxelBallRadius; x++)
+				{
+					if (x * x + y * y + z * z > voxelBallRadius * voxelBallRadius)
+						continue;
+
+					if (mVoxelWorld->GetVoxel(sphereCenter.x + x, sphereCenter.y + y, sphereCenter.z + z) == from)
+						mVoxelWorld->SetVoxel(sphereCenter.x + x, sphereCenter.y + y, sphereCenter.z + z, to);
+				}
+			}
+		}
+	};
+
+	if (mVoxelBallPlaced)
+		replaceSphere(mVoxelBallCenter, ballVoxel, EmptyVoxel);
+
+	replaceSphere(center, EmptyVoxel, ballVoxel);
+
+	mVoxelBallCenter = center;
+	mVoxelBallPlaced = true;
+}
+
+void RenderVoxelWorld(float totalTimeInSeconds)
+{
+	UpdateVoxelBall(totalTimeInSeconds);
+	RemeshDirtyVoxelChunks();
+
+	direct3dDeviceContext->OMSetRenderTargets(1, mRenderTargetView.GetAddressOf(), mDepthStencilView.Get());
+
+	mCubePipelineStateCache->GetPipelineState(mCubePipelineDescription).Bind(direct3dDeviceContext.Get());
+
+	ID3D11ShaderResourceView* instanceBufferView = mVoxelChunkInstanceBuffer->GetView();
+	direct3dDeviceContext->VSSetShaderResources(0, 1, &instanceBufferView);
+	direct3dDeviceContext->PSSetShaderResources(0, 1, &instanceBufferView);
+
+	// Instance i of the instance buffer is the world matrix of chunk i
+	for (UINT i = 0; i < static_cast<UINT>(mVoxelChunkMeshes.size()); i++)
+	{
+		const auto& chunkMesh = mVoxelChunkMeshes[i];
+
+		if (!chunkMesh.Geometry)
+			continue;
+
+		direct3dDeviceContext->VSSetConstantBuffers(0, 1, chunkMesh.PerMeshConstantBuffer.GetAddressOf());
+		direct3dDeviceContext->PSSetConstantBuffers(0, 1, chunkMesh.PerMeshConstantBuffer.GetAddressOf());
+
+		chunkMesh.Geometry->DrawLodInstanced(direct3dDeviceContext.Get(), 0, i, 1);
+	}
+}
+
+void RenderScene(float totalTimeInSeconds)
+{
+	// Camera
+	const auto eyePosition = XMVectorScale(XMVectorSet(0.0f, 4.0f, -9.0f, 0.0f), mCameraDistanceScale);
+	const auto focusPosition = XMVectorZero();
+	const auto upDirection = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+
+	const auto view = XMMatrixLookAtLH(eyePosition, focusPosition, upDirection);
+	const auto projection = XMMatrixPerspectiveFovLH(
+		XM_PIDIV4,
+		static_cast<float>(windowWidth) / static_cast<float>(windowHeight),
+		0.1f,
+		100.0f);
+
+	mTextureStreamer->RequestLevel(mCubeTextureHandle, GetRequiredCubeTextureLevel(eyePosition, XM_PIDIV4));
+
+	// The number of pixels a length of 1 covers at a distance of 1
+	const auto projectionScale = windowHeight / (2.0f * std::tan(XM_PIDIV4 * 0.5f));
+
+	// Long pauses, like while the voxel terrain was shown, are skipped instead of integrated in one big step
+	const auto deltaTime = std::min(totalTimeInSeconds - mLastFrameTime, 0.1f);
+	mLastFrameTime = totalTimeInSeconds;
+
+	// The voxel terrain has instances of its own
+	if (!mShowVoxelWorld)
+	{
+		UpdateCubeEntities(deltaTime, eyePosition, projectionScale);
+		mCubeInstanceBuffer->Update(direct3dDeviceContext.Get(), mCubeInstanceWorldMatrices.data(), cubeCount);
+
+		// Only counted for the statistics. The cubes are still drawn in their level of detail batches.
+		mCubeBoundingVolumeHierarchy->QueryFrustum(CreateFrustum(view * projection), mCubesInFrustum);
+	}
+
+	// Mouse clicks are picked with the camera the cubes were last drawn with
+	XMStoreFloat4x4(&mLastViewProjection, view * projection);
+
+	PerFrameConstants perFrameConstants = {};
+	XMStoreFloat4x4(&perFrameConstants.ViewProjection, XMMatrixTranspose(view * projection));
+	XMStoreFloat3(&perFrameConstants.EyePosition, eyePosition);
+	perFrameConstants.ShaderFeatures = mCubePipelineDescription.ShaderFeatures;
+	perFrameConstants.RenderTargetSize = XMFLOAT2(static_cast<float>(windowWidth), static_cast<float>(windowHeight));
+
+	direct3dDeviceContext->UpdateSubresource(mPerFrameConstantBuffer.Get(), 0, nullptr, &perFrameConstants, 0, 0);
+
+	ID3D11Buffer* constantBuffers[] = { mPerMeshConstantBuffer.Get(), mPerFrameConstantBuffer.Get() };
+	direct3dDeviceContext->VSSetConstantBuffers(0, 2, constantBuffers);
+	direct3dDeviceContext->PSSetConstantBuffers(0, 2, constantBuffers);
+	direct3dDeviceContext->CSSetConstantBuffers(0, 2, constantBuffers);
+
+	ID3D11ShaderResourceView* instanceBufferView = mCubeInstanceBuffer->GetView();
+	direct3dDeviceContext->VSSetShaderResources(0, 1, &instanceBufferView);
+	direct3dDeviceContext->PSSetShaderResources(0, 1, &instanceBufferView);
+	direct3dDeviceContext->CSSetShaderResources(0, 1, &instanceBufferView);
+
+	ID3D11ShaderResourceView* textureView = mTextureStreamer->GetView(mCubeTextureHandle);
+	direct3dDeviceContext->PSSetShaderResources(4, 1, &textureView);
+	direct3dDeviceContext->PSSetSamplers(0, 1, mTrilinearSampler.GetAddressOf());
+
+	if (mShowVoxelWorld)
+	{
+		RenderVoxelWorld(totalTimeInSeconds);
+		return;
+	}
+
+	if (mUseVisibilityBuffer)
+	{
+		if (mUseClusterCulling && mCubeClusterCuller)
+			mVisibilityBuffer->RenderClusters(direct3dDeviceContext.Get(), *mCubeMesh, *mCubeClusterCuller, cubeCount);
+		else
+			mVisibilityBuffer->RenderGeometry(direct3dDeviceContext.Get(), *mCubeMesh, mCubeLodBatches);
+
+		mVisibilityBuffer->Shade(direct3dDeviceContext.Get(), mRenderTargetView.Get(), *mCubeMesh);
+		return;
+	}
+
+	// The visibility buffer passes bind their own targets, so the back buffer is bound again every frame
+	direct3dDeviceContext->OMSetRenderTargets(1, mRenderTargetView.GetAddressOf(), mDepthStencilView.Get());
+
+	mCubePipelineStateCache->GetPipelineState(mCubePipelineDescription).Bind(direct3dDeviceContext.Get());
+
+	mCubeMesh->DrawLodBatches(direct3dDeviceContext.Get(), mCubeLodBatches);
+}